@@ -0,0 +1,184 @@
+#include "CmdEncoder.h"
+
+#include <string.h>
+
+static uint32_t
+BindPointIndex(VkPipelineBindPoint bindPoint)
+{
+    ASSERT(bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS || bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE);
+    return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE;
+}
+
+void
+CmdEncoder_Begin(CmdEncoder& enc, VkCommandBuffer cmd)
+{
+    enc.cmd = cmd;
+    CmdEncoder_Invalidate(enc);
+}
+
+void
+CmdEncoder_Invalidate(CmdEncoder& enc)
+{
+    for (CmdEncoderBindPoint& bp : enc.bindPoints) bp = { };
+    enc.bViewport = false;
+    enc.bScissor = false;
+    enc.bVertexBuffer = false;
+    enc.bIndexBuffer = false;
+    enc.pushLayout = nullptr;
+    enc.pushValidDwords = 0;
+}
+
+void
+CmdEncoder_ResetStats(CmdEncoder& enc)
+{
+    enc.stats = { };
+}
+
+uint32_t
+CmdEncoder_GetEmittedStateCount(const CmdEncoder& enc)
+{
+    uint32_t n = 0;
+    for (int k = 0; k < CmdKind_Draw; ++k) n += enc.stats.emitted[k];
+    return n;
+}
+
+uint32_t
+CmdEncoder_GetFilteredStateCount(const CmdEncoder& enc)
+{
+    uint32_t n = 0;
+    for (int k = 0; k < CmdKind_Draw; ++k) n += enc.stats.filtered[k];
+    return n;
+}
+
+// Counts the call, returns bRedundant.
+static bool
+Filter(CmdEncoder& enc, CmdEncoderKind kind, bool bRedundant)
+{
+    ++(bRedundant ? enc.stats.filtered : enc.stats.emitted)[kind];
+    return bRedundant;
+}
+
+void
+CmdEncoder_BindPipeline(CmdEncoder& enc, VkPipelineBindPoint bindPoint, VkPipeline pso)
+{
+    CmdEncoderBindPoint& bp = enc.bindPoints[BindPointIndex(bindPoint)];
+    if (Filter(enc, CmdKind_BindPipeline, bp.pipeline == pso)) return;
+    bp.pipeline = pso;
+    vkCmdBindPipeline(enc.cmd, bindPoint, pso);
+}
+
+void
+CmdEncoder_BindDescriptorSets(CmdEncoder& enc, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                              uint32_t firstSet, uint32_t setCount, const VkDescriptorSet *sets,
+                              uint32_t dynamicOffsetCount, const uint32_t *dynamicOffsets)
+{
+    CmdEncoderBindPoint& bp = enc.bindPoints[BindPointIndex(bindPoint)];
+    bool bRedundant = dynamicOffsetCount == 0 && bp.setLayout == layout && firstSet + setCount <= CMDENC_MAX_SETS;
+    for (uint32_t i = 0; bRedundant && i < setCount; ++i) {
+        bRedundant = bp.sets[firstSet + i] == sets[i];
+    }
+    if (Filter(enc, CmdKind_BindDescriptorSets, bRedundant)) return;
+
+    if (bp.setLayout != layout) {
+        memset(bp.sets, 0, sizeof bp.sets);
+        bp.setLayout = layout;
+    }
+    for (uint32_t i = 0; i < setCount && firstSet + i < CMDENC_MAX_SETS; ++i) {
+        /* Dynamic offsets aren't cached, so a set bound with them must not match the next bind. */
+        bp.sets[firstSet + i] = dynamicOffsetCount ? nullptr : sets[i];
+    }
+    vkCmdBindDescriptorSets(enc.cmd, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+}
+
+void
+CmdEncoder_SetViewport(CmdEncoder& enc, const VkViewport& viewport)
+{
+    if (Filter(enc, CmdKind_SetViewport, enc.bViewport && !memcmp(&enc.viewport, &viewport, sizeof viewport))) return;
+    enc.bViewport = true;
+    enc.viewport = viewport;
+    vkCmdSetViewport(enc.cmd, 0, 1, &viewport);
+}
+
+void
+CmdEncoder_SetScissor(CmdEncoder& enc, const VkRect2D& scissor)
+{
+    if (Filter(enc, CmdKind_SetScissor, enc.bScissor && !memcmp(&enc.scissor, &scissor, sizeof scissor))) return;
+    enc.bScissor = true;
+    enc.scissor = scissor;
+    vkCmdSetScissor(enc.cmd, 0, 1, &scissor);
+}
+
+void
+CmdEncoder_PushConstants(CmdEncoder& enc, VkPipelineLayout layout, VkShaderStageFlags stages,
+                         uint32_t offset, uint32_t size, const void *data)
+{
+    ASSERT(offset % 4 == 0 && size % 4 == 0 && offset + size <= CMDENC_PUSH_BYTES);
+    uint32_t const first = offset / 4, count = size / 4;
+    uint32_t const mask = (count == 32 ? ~0u : (1u << count) - 1) << first;
+
+    bool bRedundant = enc.pushLayout == layout && (enc.pushValidDwords & mask) == mask &&
+                      !memcmp(enc.pushBytes + offset, data, size);
+    for (uint32_t i = first; bRedundant && i < first + count; ++i) {
+        bRedundant = enc.pushStages[i] == stages;
+    }
+    if (Filter(enc, CmdKind_PushConstants, bRedundant)) return;
+
+    if (enc.pushLayout != layout) {
+        enc.pushLayout = layout;
+        enc.pushValidDwords = 0;
+    }
+    enc.pushValidDwords |= mask;
+    for (uint32_t i = first; i < first + count; ++i) enc.pushStages[i] = stages;
+    memcpy(enc.pushBytes + offset, data, size);
+    vkCmdPushConstants(enc.cmd, layout, stages, offset, size, data);
+}
+
+void
+CmdEncoder_BindVertexBuffer(CmdEncoder& enc, VkBuffer buffer, VkDeviceSize offset)
+{
+    if (Filter(enc, CmdKind_BindVertexBuffer,
+               enc.bVertexBuffer && enc.vertexBuffer == buffer && enc.vertexOffset == offset)) {
+        return;
+    }
+    enc.bVertexBuffer = true;
+    enc.vertexBuffer = buffer;
+    enc.vertexOffset = offset;
+    vkCmdBindVertexBuffers(enc.cmd, 0, 1, &buffer, &offset);
+}
+
+void
+CmdEncoder_BindIndexBuffer(CmdEncoder& enc, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    if (Filter(enc, CmdKind_BindIndexBuffer, enc.bIndexBuffer && enc.indexBuffer == buffer &&
+                                             enc.indexOffset == offset && enc.indexType == indexType)) {
+        return;
+    }
+    enc.bIndexBuffer = true;
+    enc.indexBuffer = buffer;
+    enc.indexOffset = offset;
+    enc.indexType = indexType;
+    vkCmdBindIndexBuffer(enc.cmd, buffer, offset, indexType);
+}
+
+void
+CmdEncoder_Draw(CmdEncoder& enc, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+                uint32_t firstInstance)
+{
+    ++enc.stats.emitted[CmdKind_Draw];
+    vkCmdDraw(enc.cmd, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void
+CmdEncoder_DrawIndexed(CmdEncoder& enc, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+                       int32_t vertexOffset, uint32_t firstInstance)
+{
+    ++enc.stats.emitted[CmdKind_Draw];
+    vkCmdDrawIndexed(enc.cmd, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void
+CmdEncoder_DrawIndirect(CmdEncoder& enc, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+    ++enc.stats.emitted[CmdKind_Draw];
+    vkCmdDrawIndirect(enc.cmd, buffer, offset, drawCount, stride);
+}
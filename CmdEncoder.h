@@ -0,0 +1,90 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    Thin wrapper around a VkCommandBuffer for draw recording that remembers the bound state and drops calls that
+    wouldn't change it: pipelines, layouts and descriptor sets per bind point, viewport 0, scissor 0, vertex
+    buffer 0, the index buffer and the push constant bytes. Draws always go through, but are counted.
+
+    The cache only knows what went through the encoder. Call CmdEncoder_Begin for each command buffer, and
+    CmdEncoder_Invalidate after recording into it directly (vkCmd* calls, or a module taking a VkCommandBuffer),
+    since that may have changed anything.
+
+    Descriptor sets with dynamic offsets are always bound. Binding sets or pushing constants with a different
+    layout forgets the cached sets/constants of the old one, which is stricter than the spec's compatibility rules
+    but never wrong.
+*/
+
+#define CMDENC_MAX_SETS 4
+#define CMDENC_PUSH_BYTES 128 // the minimum maxPushConstantsSize, all any pipeline here uses
+
+enum CmdEncoderKind {
+    CmdKind_BindPipeline,
+    CmdKind_BindDescriptorSets,
+    CmdKind_SetViewport,
+    CmdKind_SetScissor,
+    CmdKind_PushConstants,
+    CmdKind_BindVertexBuffer,
+    CmdKind_BindIndexBuffer,
+    CmdKind_Draw, // any kind, never filtered
+    CmdKind_Count
+};
+
+struct CmdEncoderStats {
+    uint32_t emitted[CmdKind_Count];
+    uint32_t filtered[CmdKind_Count];
+};
+
+struct CmdEncoderBindPoint {
+    VkPipeline pipeline;
+    VkPipelineLayout setLayout; // of the cached sets
+    VkDescriptorSet sets[CMDENC_MAX_SETS];
+};
+
+struct CmdEncoder {
+    VkCommandBuffer cmd;
+
+    CmdEncoderBindPoint bindPoints[2]; // graphics, compute
+    bool bViewport, bScissor, bVertexBuffer, bIndexBuffer;
+    VkViewport viewport;
+    VkRect2D scissor;
+    VkBuffer vertexBuffer;
+    VkDeviceSize vertexOffset;
+    VkBuffer indexBuffer;
+    VkDeviceSize indexOffset;
+    VkIndexType indexType;
+
+    VkPipelineLayout pushLayout;
+    uint32_t pushValidDwords; // bit i: pushBytes[4i, 4i+4) and pushStages[i] are known
+    VkShaderStageFlags pushStages[CMDENC_PUSH_BYTES / 4];
+    ubyte pushBytes[CMDENC_PUSH_BYTES];
+
+    CmdEncoderStats stats; // kept across Begin, see CmdEncoder_ResetStats
+};
+
+// Starts recording into cmd (already begun) with nothing known.
+void CmdEncoder_Begin(CmdEncoder& enc, VkCommandBuffer cmd);
+void CmdEncoder_Invalidate(CmdEncoder& enc);
+void CmdEncoder_ResetStats(CmdEncoder& enc);
+// Sums of emitted and filtered over all kinds but draws.
+uint32_t CmdEncoder_GetEmittedStateCount(const CmdEncoder& enc);
+uint32_t CmdEncoder_GetFilteredStateCount(const CmdEncoder& enc);
+
+void CmdEncoder_BindPipeline(CmdEncoder& enc, VkPipelineBindPoint bindPoint, VkPipeline pso);
+void CmdEncoder_BindDescriptorSets(CmdEncoder& enc, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                   uint32_t firstSet, uint32_t setCount, const VkDescriptorSet *sets,
+                                   uint32_t dynamicOffsetCount = 0, const uint32_t *dynamicOffsets = nullptr);
+void CmdEncoder_SetViewport(CmdEncoder& enc, const VkViewport& viewport);
+void CmdEncoder_SetScissor(CmdEncoder& enc, const VkRect2D& scissor);
+void CmdEncoder_PushConstants(CmdEncoder& enc, VkPipelineLayout layout, VkShaderStageFlags stages,
+                              uint32_t offset, uint32_t size, const void *data);
+void CmdEncoder_BindVertexBuffer(CmdEncoder& enc, VkBuffer buffer, VkDeviceSize offset);
+void CmdEncoder_BindIndexBuffer(CmdEncoder& enc, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+
+void CmdEncoder_Draw(CmdEncoder& enc, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+                     uint32_t firstInstance);
+void CmdEncoder_DrawIndexed(CmdEncoder& enc, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+                            int32_t vertexOffset, uint32_t firstInstance);
+void CmdEncoder_DrawIndirect(CmdEncoder& enc, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+                             uint32_t stride);
@@ -0,0 +1,136 @@
+#include "ComputeOutput.h"
+
+#include <stdio.h>
+
+#define COMPUTE_OUT_GROUP_SIZE 8 // shaders/compute_out.comp local_size_x and _y
+
+struct ComputeOutPushConstants {
+    uint32_t width, height;
+    float secs;
+    uint32_t bEncodeSrgb;
+};
+
+bool
+ComputeOut_Create(ComputeOutput& co, const VulkanRenderer& vkr, const Swapchain& sc, uint32_t slotCount)
+{
+    co = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    VkDevice const device = vkr.device;
+
+    if (sc.storageFormat == VK_FORMAT_UNDEFINED) {
+        puts("compute output: the swapchain images can't be storage images");
+        return false;
+    }
+    if (!vkr.caps.features.shaderStorageImageWriteWithoutFormat) {
+        puts("compute output: needs shaderStorageImageWriteWithoutFormat");
+        return false;
+    }
+    VkShaderModule const cs = VKH_LoadShaderModule(device, "shaders/compute_out.comp.spv");
+    if (!cs) {
+        return false;
+    }
+
+    const VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &co.setLayout));
+
+    const VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, slotCount };
+    VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.maxSets = slotCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &co.descriptorPool));
+
+    VkDescriptorSetLayout setLayouts[GPUTIMER_MAX_SLOTS];
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        setLayouts[i] = co.setLayout;
+    }
+    VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = co.descriptorPool;
+    allocInfo.descriptorSetCount = slotCount;
+    allocInfo.pSetLayouts = setLayouts;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, co.sets));
+
+    const VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputeOutPushConstants) };
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &co.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &co.pipelineLayout));
+
+    VkComputePipelineCreateInfo computeInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    computeInfo.stage = {
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT, cs, "main"
+    };
+    computeInfo.layout = co.pipelineLayout;
+    VkResult const res = vkCreateComputePipelines(device, nullptr, 1, &computeInfo, nullptr, &co.pipeline);
+    vkDestroyShaderModule(device, cs, nullptr);
+    if (res != VK_SUCCESS) {
+        ComputeOut_Destroy(co, device);
+        return false;
+    }
+
+    co.bEncodeSrgb = sc.storageFormat != sc.format;
+    printf("compute output: storage format %d%s\n", sc.storageFormat, co.bEncodeSrgb ? ", sRGB encoded in the shader" : "");
+    return true;
+}
+
+void
+ComputeOut_Destroy(ComputeOutput& co, VkDevice device)
+{
+    vkDestroyPipeline(device, co.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, co.pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, co.descriptorPool, nullptr); // frees the sets
+    vkDestroyDescriptorSetLayout(device, co.setLayout, nullptr);
+    co = { };
+}
+
+void
+ComputeOut_CmdDispatch(ComputeOutput& co, VkDevice device, VkCommandBuffer cmd, uint32_t slot,
+                       VkImage image, VkImageView storageView, VkExtent2D extent, float secs)
+{
+    /* The slot's set was last used by the frame waited on, so it can be pointed at this frame's image. */
+    const VkDescriptorImageInfo imageInfo = { nullptr, storageView, VK_IMAGE_LAYOUT_GENERAL };
+    VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = co.sets[slot];
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    /* The whole image is overwritten, so the old contents can go. The source stage is the one the acquire
+       semaphore is waited at, which chains the transition after the presentation engine is done reading. */
+    VkImageMemoryBarrier ib = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    ib.srcAccessMask = 0;
+    ib.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    ib.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ib.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib.image = image;
+    ib.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &ib);
+
+    const ComputeOutPushConstants pc = { extent.width, extent.height, secs, uint32_t(co.bEncodeSrgb) };
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, co.pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, co.pipelineLayout, 0, 1, &co.sets[slot], 0, nullptr);
+    vkCmdPushConstants(cmd, co.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof pc, &pc);
+    vkCmdDispatch(cmd, (extent.width + COMPUTE_OUT_GROUP_SIZE - 1) / COMPUTE_OUT_GROUP_SIZE,
+                  (extent.height + COMPUTE_OUT_GROUP_SIZE - 1) / COMPUTE_OUT_GROUP_SIZE, 1);
+
+    /*  Presentation is ordered by the release semaphore, no destination access needed. The destination stage is
+        color attachment output, not bottom of pipe (which orders nothing after it), so the later barriers on the
+        image, FrameCapture's and MultiOut's from ALL_COMMANDS, chain after the dispatch and the transition.
+    */
+    ib.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    ib.dstAccessMask = 0;
+    ib.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    ib.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &ib);
+}
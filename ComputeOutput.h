@@ -0,0 +1,37 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "VulkanSwapchain.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+
+/*
+    Compute output: a full-screen compute shader writes the frame straight into the swapchain image through a
+    storage view, with no render pass, framebuffer or offscreen image to copy from.
+
+    The swapchain needs STORAGE usage (Swapchain_InitParams) and a storage format: its own, or for sRGB formats
+    the UNORM alias with VK_KHR_swapchain_mutable_format, the shader then encodes sRGB itself. The storage views
+    are per swapchain image and owned by the caller (they're retired with the swapchain), only the frame slot's
+    descriptor set is pointed at the current one.
+
+    ComputeOut_CmdDispatch takes the image from UNDEFINED to GENERAL, dispatches, and leaves it PRESENT_SRC_KHR.
+    The acquire semaphore wait must be at VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT instead of color attachment output.
+
+    Needs shaders/compute_out.comp.spv and shaderStorageImageWriteWithoutFormat.
+*/
+
+struct ComputeOutput {
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sets[GPUTIMER_MAX_SLOTS];
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline; // null if not created
+    bool bEncodeSrgb;
+};
+
+// Returns false, with co zeroed, if the swapchain can't be a storage image or the shader is missing.
+bool ComputeOut_Create(ComputeOutput& co, const VulkanRenderer& vkr, const Swapchain& sc, uint32_t slotCount);
+void ComputeOut_Destroy(ComputeOutput& co, VkDevice device);
+
+// After the slot's fence wait. storageView is a sc.storageFormat view of image.
+void ComputeOut_CmdDispatch(ComputeOutput& co, VkDevice device, VkCommandBuffer cmd, uint32_t slot,
+                            VkImage image, VkImageView storageView, VkExtent2D extent, float secs);
@@ -0,0 +1,410 @@
+#include "DrawBench.h"
+#include "VulkanSwapchain.h" // OS_GetTicks
+#include "shaders.h"
+
+#include <stdio.h>
+
+#define DRAWBENCH_CALLS 20000 // per recorded command buffer
+#define DRAWBENCH_SUBMITS 2000
+#define DRAWBENCH_BATCH 16 // command buffers per vkQueueSubmit in the batched case
+#define DRAWBENCH_REPEATS 5 // the fastest is kept
+
+enum {
+    Pattern_Draw,
+    Pattern_PushDraw,
+    Pattern_BindPushDraw,
+    Pattern_Submit,
+    Pattern_SubmitBatch,
+    Pattern_Count
+};
+
+static const char *const PatternNames[Pattern_Count] = {
+    "draw",
+    "push + draw",
+    "bind + push + draw",
+    "submit, 1 cmd buffer",
+    "submit, 16 cmd buffers",
+};
+
+enum { Dispatch_Loader, Dispatch_Global, Dispatch_Table, Dispatch_Count };
+
+/* The timed calls, through volk's globals or through a table. Templates so the call sites are the same code. */
+struct GlobalDispatch {
+    void CmdDraw(VkCommandBuffer cmd, uint32_t vertexCount) const
+    {
+        vkCmdDraw(cmd, vertexCount, 1, 0, 0);
+    }
+    void CmdPushConstants(VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t size, const void *p) const
+    {
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, size, p);
+    }
+    void CmdBindPipeline(VkCommandBuffer cmd, VkPipeline pso) const
+    {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pso);
+    }
+    VkResult QueueSubmit(VkQueue queue, const VkSubmitInfo& info) const
+    {
+        return vkQueueSubmit(queue, 1, &info, nullptr);
+    }
+};
+
+struct TableDispatch {
+    const VolkDeviceTable *t;
+
+    void CmdDraw(VkCommandBuffer cmd, uint32_t vertexCount) const
+    {
+        t->vkCmdDraw(cmd, vertexCount, 1, 0, 0);
+    }
+    void CmdPushConstants(VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t size, const void *p) const
+    {
+        t->vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, size, p);
+    }
+    void CmdBindPipeline(VkCommandBuffer cmd, VkPipeline pso) const
+    {
+        t->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pso);
+    }
+    VkResult QueueSubmit(VkQueue queue, const VkSubmitInfo& info) const
+    {
+        return t->vkQueueSubmit(queue, 1, &info, nullptr);
+    }
+};
+
+struct BenchContext {
+    const VulkanRenderer *vkr;
+    double nsPerTick;
+
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkPipelineLayout layout;
+    VkPipeline pso[2]; // differ in cull mode, so a bind isn't a no-op
+
+    VkCommandPool recordPool; // reset before each recording
+    VkCommandBuffer cmd;
+    VkCommandPool submitPool;
+    VkCommandBuffer empty[DRAWBENCH_BATCH]; // SIMULTANEOUS_USE, submitted over and over
+    VkFence fence;
+};
+
+#define BENCH_EXTENT 64
+#define BENCH_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+static bool
+CreateTarget(BenchContext& ctx)
+{
+    VkDevice const device = ctx.vkr->device;
+
+    VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = BENCH_FORMAT;
+    info.extent = { BENCH_EXTENT, BENCH_EXTENT, 1 };
+    info.mipLevels = 1;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &info, nullptr, &ctx.image) != VK_SUCCESS) return false;
+
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(device, ctx.image, &req);
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = req.size;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(ctx.vkr->caps.memory, req.memoryTypeBits,
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(device, &allocInfo, nullptr, &ctx.memory) != VK_SUCCESS) {
+        return false;
+    }
+    VK_CHECK(vkBindImageMemory(device, ctx.image, ctx.memory, 0));
+
+    VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    viewInfo.image = ctx.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = BENCH_FORMAT;
+    viewInfo.components = COMPONENT_MAPPING_IDENTITY;
+    viewInfo.subresourceRange = FULL_IMAGE_RANGE_COLOR;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &ctx.view));
+
+    /* Nothing is kept, only the recording is being measured. */
+    VkAttachmentDescription const attachment = {
+        0, BENCH_FORMAT, VK_SAMPLE_COUNT_1_BIT,
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+    VkAttachmentReference const colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = { };
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+    VkRenderPassCreateInfo rpInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+    rpInfo.attachmentCount = 1;
+    rpInfo.pAttachments = &attachment;
+    rpInfo.subpassCount = 1;
+    rpInfo.pSubpasses = &subpass;
+    VK_CHECK(vkCreateRenderPass(device, &rpInfo, nullptr, &ctx.renderPass));
+
+    VkFramebufferCreateInfo fbInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+    fbInfo.renderPass = ctx.renderPass;
+    fbInfo.attachmentCount = 1;
+    fbInfo.pAttachments = &ctx.view;
+    fbInfo.width = BENCH_EXTENT;
+    fbInfo.height = BENCH_EXTENT;
+    fbInfo.layers = 1;
+    VK_CHECK(vkCreateFramebuffer(device, &fbInfo, nullptr, &ctx.framebuffer));
+    return true;
+}
+
+// The built in hello shaders, 32 bytes of push constants for the vertex shader.
+static void
+CreatePipelines(BenchContext& ctx)
+{
+    VkDevice const device = ctx.vkr->device;
+
+    VkPushConstantRange const range = { VK_SHADER_STAGE_VERTEX_BIT, 0, 32 };
+    VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &range;
+    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &ctx.layout));
+
+    size_t codeByteSize;
+    const uint32_t *pCode = get_hello_vertex_spirv(&codeByteSize);
+    VkShaderModule const vs = VKH_CreateShaderModule(device, pCode, codeByteSize);
+    pCode = get_hello_fragment_spirv(&codeByteSize);
+    VkShaderModule const fs = VKH_CreateShaderModule(device, pCode, codeByteSize);
+
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vs, "main" },
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main" },
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkViewport const viewport = { 0, 0, float(BENCH_EXTENT), float(BENCH_EXTENT), 0.0f, 1.0f };
+    VkRect2D const scissor = { { 0, 0 }, { BENCH_EXTENT, BENCH_EXTENT } };
+    VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+    VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    raster.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineColorBlendAttachmentState blendAttachment = { };
+    blendAttachment.colorWriteMask = 0xf;
+    VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkGraphicsPipelineCreateInfo psoInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    psoInfo.stageCount = lengthof(stages);
+    psoInfo.pStages = stages;
+    psoInfo.pVertexInputState = &vertexInput;
+    psoInfo.pInputAssemblyState = &inputAssembly;
+    psoInfo.pViewportState = &viewportState;
+    psoInfo.pRasterizationState = &raster;
+    psoInfo.pMultisampleState = &multisample;
+    psoInfo.pColorBlendState = &blend;
+    psoInfo.layout = ctx.layout;
+    psoInfo.renderPass = ctx.renderPass;
+    for (uint32_t i = 0; i < lengthof(ctx.pso); ++i) {
+        raster.cullMode = i ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+        VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &psoInfo, nullptr, &ctx.pso[i]));
+    }
+    vkDestroyShaderModule(device, vs, nullptr);
+    vkDestroyShaderModule(device, fs, nullptr);
+}
+
+static void
+DestroyContext(BenchContext& ctx)
+{
+    VkDevice const device = ctx.vkr->device;
+    vkDestroyFence(device, ctx.fence, nullptr);
+    vkDestroyCommandPool(device, ctx.submitPool, nullptr);
+    vkDestroyCommandPool(device, ctx.recordPool, nullptr);
+    for (VkPipeline pso : ctx.pso) vkDestroyPipeline(device, pso, nullptr);
+    vkDestroyPipelineLayout(device, ctx.layout, nullptr);
+    vkDestroyFramebuffer(device, ctx.framebuffer, nullptr);
+    vkDestroyRenderPass(device, ctx.renderPass, nullptr);
+    vkDestroyImageView(device, ctx.view, nullptr);
+    vkDestroyImage(device, ctx.image, nullptr);
+    vkFreeMemory(device, ctx.memory, nullptr);
+}
+
+/*  ns per iteration of a recording pattern: one draw, plus a push and a bind depending on the pattern.
+    Only the loop is timed, the command buffer is then submitted and waited on so the driver's memory for it is
+    recycled the same way each repeat.
+*/
+template<class D>
+static double
+TimeRecording(const D& d, const BenchContext& ctx, int pattern)
+{
+    VkDevice const device = ctx.vkr->device;
+    VkCommandBuffer const cmd = ctx.cmd;
+    double best = 1e30;
+    for (int rep = 0; rep < DRAWBENCH_REPEATS; ++rep) {
+        VK_CHECK(vkResetCommandPool(device, ctx.recordPool, 0));
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+        VkRenderPassBeginInfo rpBegin = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rpBegin.renderPass = ctx.renderPass;
+        rpBegin.framebuffer = ctx.framebuffer;
+        rpBegin.renderArea = { { 0, 0 }, { BENCH_EXTENT, BENCH_EXTENT } };
+        vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx.pso[0]);
+
+        float pc[8] = { 0.1f, 0, 0, 0.1f, 0, 0, 0, 0 }; // small triangles at the center
+        vkCmdPushConstants(cmd, ctx.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pc, pc);
+
+        os_tick_t const start = OS_GetTicks();
+        switch (pattern) {
+        case Pattern_Draw:
+            for (uint32_t i = 0; i < DRAWBENCH_CALLS; ++i) {
+                d.CmdDraw(cmd, 3);
+            }
+            break;
+        case Pattern_PushDraw:
+            for (uint32_t i = 0; i < DRAWBENCH_CALLS; ++i) {
+                pc[4] = float(i & 7) * 0.01f; // different data each time, like per-draw transforms
+                d.CmdPushConstants(cmd, ctx.layout, sizeof pc, pc);
+                d.CmdDraw(cmd, 3);
+            }
+            break;
+        case Pattern_BindPushDraw:
+            for (uint32_t i = 0; i < DRAWBENCH_CALLS; ++i) {
+                d.CmdBindPipeline(cmd, ctx.pso[(i + 1) & 1]);
+                pc[4] = float(i & 7) * 0.01f;
+                d.CmdPushConstants(cmd, ctx.layout, sizeof pc, pc);
+                d.CmdDraw(cmd, 3);
+            }
+            break;
+        }
+        double const ns = double(OS_GetTicks() - start) * ctx.nsPerTick / DRAWBENCH_CALLS;
+        best = Min(best, ns);
+
+        vkCmdEndRenderPass(cmd);
+        VK_CHECK(vkEndCommandBuffer(cmd));
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        VK_CHECK(vkQueueSubmit(ctx.vkr->universalQueue0, 1, &submitInfo, ctx.fence));
+        VK_CHECK(vkWaitForFences(device, 1, &ctx.fence, true, uint64_t(-1)));
+        VK_CHECK(vkResetFences(device, 1, &ctx.fence));
+    }
+    return best;
+}
+
+// ns per vkQueueSubmit of 1 or DRAWBENCH_BATCH empty command buffers, no semaphores or fence.
+template<class D>
+static double
+TimeSubmits(const D& d, const BenchContext& ctx, bool bBatch)
+{
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = bBatch ? DRAWBENCH_BATCH : 1;
+    submitInfo.pCommandBuffers = ctx.empty;
+    uint32_t const submits = bBatch ? DRAWBENCH_SUBMITS / DRAWBENCH_BATCH : DRAWBENCH_SUBMITS;
+    double best = 1e30;
+    for (int rep = 0; rep < DRAWBENCH_REPEATS; ++rep) {
+        os_tick_t const start = OS_GetTicks();
+        for (uint32_t i = 0; i < submits; ++i) {
+            VK_CHECK(d.QueueSubmit(ctx.vkr->universalQueue0, submitInfo));
+        }
+        double const ns = double(OS_GetTicks() - start) * ctx.nsPerTick / submits;
+        best = Min(best, ns);
+        VK_CHECK(vkQueueWaitIdle(ctx.vkr->universalQueue0)); // don't let the queue back up into the next repeat
+    }
+    return best;
+}
+
+template<class D>
+static void
+RunPatterns(const D& d, const BenchContext& ctx, double *nsOut)
+{
+    nsOut[Pattern_Draw] = TimeRecording(d, ctx, Pattern_Draw);
+    nsOut[Pattern_PushDraw] = TimeRecording(d, ctx, Pattern_PushDraw);
+    nsOut[Pattern_BindPushDraw] = TimeRecording(d, ctx, Pattern_BindPushDraw);
+    nsOut[Pattern_Submit] = TimeSubmits(d, ctx, false);
+    nsOut[Pattern_SubmitBatch] = TimeSubmits(d, ctx, true);
+}
+
+int
+DrawBench_Run(const VulkanRenderer& vkr)
+{
+    VkDevice const device = vkr.device;
+
+    BenchContext ctx = { };
+    ctx.vkr = &vkr;
+    ctx.nsPerTick = 1e9 / double(OS_TicksPerSecond());
+    if (!CreateTarget(ctx)) {
+        puts("bench-draws: couldn't create the render target");
+        DestroyContext(ctx);
+        return 1;
+    }
+    CreatePipelines(ctx);
+
+    ctx.recordPool = VKH_CreateCommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, vkr.families.universal);
+    ctx.cmd = VKH_AllocateCommandBuffer(device, ctx.recordPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    ctx.submitPool = VKH_CreateCommandPool(device, 0, vkr.families.universal);
+    for (VkCommandBuffer& cmd : ctx.empty) {
+        cmd = VKH_AllocateCommandBuffer(device, ctx.submitPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+        VK_CHECK(vkEndCommandBuffer(cmd));
+    }
+    VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &ctx.fence));
+
+    /*  What vkGetInstanceProcAddr hands out for device commands are the loader's trampolines, which look up the
+        dispatch table through the command buffer or queue each call. Only the timed ones are filled in.
+    */
+    VolkDeviceTable loaderTable = { };
+    loaderTable.vkCmdDraw = (PFN_vkCmdDraw)vkGetInstanceProcAddr(vkr.instance, "vkCmdDraw");
+    loaderTable.vkCmdPushConstants = (PFN_vkCmdPushConstants)vkGetInstanceProcAddr(vkr.instance, "vkCmdPushConstants");
+    loaderTable.vkCmdBindPipeline = (PFN_vkCmdBindPipeline)vkGetInstanceProcAddr(vkr.instance, "vkCmdBindPipeline");
+    loaderTable.vkQueueSubmit = (PFN_vkQueueSubmit)vkGetInstanceProcAddr(vkr.instance, "vkQueueSubmit");
+    bool const bLoader = loaderTable.vkCmdDraw && loaderTable.vkCmdPushConstants && loaderTable.vkCmdBindPipeline &&
+                         loaderTable.vkQueueSubmit;
+
+    VolkDeviceTable deviceTable;
+    volkLoadDeviceTable(&deviceTable, device);
+
+    double ns[Dispatch_Count][Pattern_Count] = { };
+    if (bLoader) RunPatterns(TableDispatch{ &loaderTable }, ctx, ns[Dispatch_Loader]);
+    RunPatterns(GlobalDispatch{ }, ctx, ns[Dispatch_Global]);
+    RunPatterns(TableDispatch{ &deviceTable }, ctx, ns[Dispatch_Table]);
+
+    printf("bench-draws: %s, ns per call, fastest of %d runs of %d draws / %d submits\n",
+           vkr.caps.props.deviceName, DRAWBENCH_REPEATS, DRAWBENCH_CALLS, DRAWBENCH_SUBMITS);
+    puts("  pattern                       loader    global     table");
+    for (int p = 0; p < Pattern_Count; ++p) {
+        printf("  %-26s ", PatternNames[p]);
+        if (bLoader) printf("%8.1f  ", ns[Dispatch_Loader][p]);
+        else printf("%8s  ", "-");
+        printf("%8.1f  %8.1f\n", ns[Dispatch_Global][p], ns[Dispatch_Table][p]);
+    }
+
+    /* Each pattern adds one call to the previous one, so the differences are the calls on their own. */
+    puts("  per call, from the differences:");
+    static const char *const CallNames[] = { "vkCmdDraw", "vkCmdPushConstants", "vkCmdBindPipeline" };
+    for (int c = 0; c < 3; ++c) {
+        printf("  %-26s ", CallNames[c]);
+        for (int d = 0; d < Dispatch_Count; ++d) {
+            double const v = c ? ns[d][c] - ns[d][c - 1] : ns[d][c];
+            if (d == Dispatch_Loader && !bLoader) printf("%8s  ", "-");
+            else printf("%8.1f  ", v);
+        }
+        putchar('\n');
+    }
+    printf("  vkQueueSubmit per cmd buffer, batched:  %.1f ns (global)\n",
+           ns[Dispatch_Global][Pattern_SubmitBatch] / DRAWBENCH_BATCH);
+
+    DestroyContext(ctx);
+    return 0;
+}
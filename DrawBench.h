@@ -0,0 +1,19 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    --bench-draws: CPU cost of the calls a frame makes most, in ns per call, to budget draw counts.
+
+    Records large command buffers of vkCmdDraw, vkCmdPushConstants + vkCmdDraw and vkCmdBindPipeline +
+    vkCmdPushConstants + vkCmdDraw into a small offscreen target, and times vkQueueSubmit with one command buffer
+    per submit and with a batch per submit. The per-call costs are the differences between the patterns.
+
+    Each pattern runs through three sets of function pointers:
+      loader  vkGetInstanceProcAddr's trampolines, what an app without volkLoadDevice calls.
+      global  volk's globals after volkLoadDevice, which is what the rest of vklab calls.
+      table   a VolkDeviceTable from volkLoadDeviceTable, what you'd keep per device with more than one device.
+    global and table call the driver directly, the difference is only where the pointer is loaded from.
+*/
+
+int DrawBench_Run(const VulkanRenderer& vkr);
@@ -0,0 +1,106 @@
+#include "DynamicResolution.h"
+
+#include <math.h>
+
+void
+DynRes_Init(DynResController& dr, float frameSecs, float minScale)
+{
+    dr = { };
+    dr.targetSecs = frameSecs * 0.9f; // headroom for the estimate lagging behind
+    dr.minScale = minScale;
+    dr.scale = 1.0f;
+}
+
+bool
+DynRes_ChooseFilter(VkPhysicalDevice physicalDevice, VkFormat format, VkFilter *pFilter)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    VkFormatFeatureFlags const blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((props.optimalTilingFeatures & blit) != blit) {
+        return false;
+    }
+    *pFilter = (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR
+                                                                                                  : VK_FILTER_NEAREST;
+    return true;
+}
+
+VkExtent2D
+DynRes_BeginFrame(DynResController& dr, uint32_t slot, VkExtent2D full)
+{
+    dr.slotScale[slot] = dr.scale;
+    /* Even sizes, so a 2x downscale lines up with whole pixels. */
+    uint32_t const w = uint32_t(float(full.width) * dr.scale) & ~1u;
+    uint32_t const h = uint32_t(float(full.height) * dr.scale) & ~1u;
+    return { Min(Max(w, 2u), full.width), Min(Max(h, 2u), full.height) };
+}
+
+void
+DynRes_RetireSlot(DynResController& dr, uint32_t slot, float gpuSecs, bool hasGpuTime)
+{
+    float const rendered = dr.slotScale[slot];
+    dr.slotScale[slot] = 0.0f;
+    if (!hasGpuTime || rendered == 0.0f || gpuSecs <= 0.0f) {
+        return;
+    }
+
+    /* Pixels go with the square of the scale. Limit how far one sample can move it. */
+    float const ratio = Min(Max(sqrtf(dr.targetSecs / gpuSecs), 0.7f), 1.2f);
+    float const wanted = Min(Max(rendered * ratio, dr.minScale), 1.0f);
+    if (fabsf(wanted - dr.scale) < 0.01f) {
+        return;
+    }
+    dr.scale += (wanted - dr.scale) * (wanted < dr.scale ? 0.5f : 0.1f);
+    ++dr.changes;
+}
+
+void
+DynRes_CmdBlit(VkCommandBuffer cmd, VkImage src, VkExtent2D srcExtent, VkImage dst, VkExtent2D dstExtent,
+               VkFilter filter)
+{
+    /*  src: the render pass's color writes before the read. dst: the old contents can go. The source stage is the
+        one the acquire semaphore is waited at, which chains the transition after the presentation engine is done.
+    */
+    VkImageMemoryBarrier ib[2];
+    ib[1] = ib[0] = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    ib[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    ib[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    ib[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    ib[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ib[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[0].image = src;
+    ib[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    ib[1].srcAccessMask = 0;
+    ib[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    ib[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ib[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ib[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[1].image = dst;
+    ib[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, ib);
+
+    VkImageBlit region;
+    region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.srcOffsets[0] = { 0, 0, 0 };
+    region.srcOffsets[1] = { int32_t(srcExtent.width), int32_t(srcExtent.height), 1 };
+    region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.dstOffsets[0] = { 0, 0, 0 };
+    region.dstOffsets[1] = { int32_t(dstExtent.width), int32_t(dstExtent.height), 1 };
+    vkCmdBlitImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &region, filter);
+
+    /*  Presentation is ordered by the release semaphore. The destination stage is color attachment output, not
+        bottom of pipe, so the later barriers on the image (FrameCapture's and MultiOut's, from ALL_COMMANDS) chain
+        after the blit. src needs no transition back, the render pass starts from UNDEFINED, only its writes have
+        to wait for this read.
+    */
+    ib[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    ib[1].dstAccessMask = 0;
+    ib[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ib[1].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &ib[1]);
+}
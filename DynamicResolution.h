@@ -0,0 +1,51 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+
+/*
+    Dynamic resolution: hold a GPU frame time by rendering fewer pixels when the load goes up, instead of
+    missing refreshes. The render pass draws into the top-left part of an offscreen image the size of the
+    swapchain (RenderTargets with bOffscreen), and DynRes_CmdBlit scales that part up to the whole swapchain
+    image with vkCmdBlitImage. The render area, viewport and scissor are what shrink, nothing is reallocated.
+
+    The controller takes each slot's GPU time once its fence is waited on, so it reacts a couple of frames
+    late. GPU time is taken as proportional to the pixel count, which it is for the pixel-bound part of the
+    frame, and the scale is the square root of the wanted change, smoothed: it drops quickly when over the
+    target and recovers slowly, so a single spike doesn't make it hunt.
+
+    The swapchain needs TRANSFER_DST usage, and the format has to be a blit source and destination with
+    optimal tiling (true of the usual sRGB and UNORM 8-bit formats). Filtering is linear when supported.
+    The offscreen attachment's final layout is COLOR_ATTACHMENT_OPTIMAL, the blit takes it from there. The
+    acquire semaphore wait must cover VK_PIPELINE_STAGE_TRANSFER_BIT, that's where the swapchain image is
+    first written.
+*/
+
+struct DynResController {
+    float targetSecs; // GPU time aimed for, a bit under the frame budget
+    float minScale;
+    float scale; // of the width and height, in [minScale, 1]
+    float slotScale[GPUTIMER_MAX_SLOTS]; // what the frame in flight from each slot was rendered at, 0 if none
+    uint32_t changes; // scale updates, for the title
+};
+
+// frameSecs: the frame budget, e.g. the refresh interval.
+void DynRes_Init(DynResController& dr, float frameSecs, float minScale);
+
+/*  Whether format can be blitted from and to, and the filter to do it with. Returns false if it can't be,
+    dynamic resolution is then unavailable.
+*/
+bool DynRes_ChooseFilter(VkPhysicalDevice physicalDevice, VkFormat format, VkFilter *pFilter);
+
+// The extent to render this frame at, full scaled by the current scale. Remembered for the slot.
+VkExtent2D DynRes_BeginFrame(DynResController& dr, uint32_t slot, VkExtent2D full);
+
+// After the slot's fence wait, with its GPU time (GpuTimer_GetSlotSecs).
+void DynRes_RetireSlot(DynResController& dr, uint32_t slot, float gpuSecs, bool hasGpuTime);
+
+/*  After the render pass. Blits the srcExtent corner of src (the offscreen image, COLOR_ATTACHMENT_OPTIMAL) to
+    all of dst (the swapchain image, any layout, its contents are dropped). Leaves dst in PRESENT_SRC_KHR and
+    orders the next frame's render pass after the read of src.
+*/
+void DynRes_CmdBlit(VkCommandBuffer cmd, VkImage src, VkExtent2D srcExtent, VkImage dst, VkExtent2D dstExtent,
+                    VkFilter filter);
@@ -0,0 +1,69 @@
+#include "FrameArena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+bool
+FrameArena_Create(FrameArenas& fa, uint32_t slotCount, uint32_t threadCount, size_t bytesPerArena)
+{
+    fa = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS && threadCount <= FRAMEARENA_MAX_THREADS);
+    /* Arenas don't share cache lines, and with the base aligned every push's offset alignment is its address's. */
+    bytesPerArena = (bytesPerArena + FRAMEARENA_MAX_ALIGN - 1) & ~size_t(FRAMEARENA_MAX_ALIGN - 1);
+    fa.memory = static_cast<ubyte *>(malloc(bytesPerArena * slotCount * threadCount + FRAMEARENA_MAX_ALIGN - 1));
+    if (!fa.memory) {
+        puts("frame arena: out of memory");
+        return false;
+    }
+    fa.slotCount = slotCount;
+    fa.threadCount = threadCount;
+    ubyte *p = fa.memory + (-uintptr_t(fa.memory) & (FRAMEARENA_MAX_ALIGN - 1));
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        for (uint32_t thread = 0; thread < threadCount; ++thread) {
+            LinearArena& a = fa.arenas[slot][thread];
+            a.base = p;
+            a.capacity = bytesPerArena;
+            p += bytesPerArena;
+        }
+    }
+    return true;
+}
+
+void
+FrameArena_Destroy(FrameArenas& fa)
+{
+    free(fa.memory);
+    fa = { };
+}
+
+void
+FrameArena_ResetSlot(FrameArenas& fa, uint32_t slot)
+{
+    if (slot >= fa.slotCount) return;
+    for (uint32_t thread = 0; thread < fa.threadCount; ++thread) {
+        fa.arenas[slot][thread].used = 0;
+    }
+}
+
+size_t
+FrameArena_GetHighWater(const FrameArenas& fa, uint32_t thread)
+{
+    size_t highWater = 0;
+    for (uint32_t slot = 0; slot < fa.slotCount; ++slot) {
+        highWater = Max(highWater, fa.arenas[slot][thread].highWater);
+    }
+    return highWater;
+}
+
+void
+FrameArena_PrintReport(const FrameArenas& fa)
+{
+    for (uint32_t thread = 0; thread < fa.threadCount; ++thread) {
+        uint32_t failed = 0;
+        for (uint32_t slot = 0; slot < fa.slotCount; ++slot) {
+            failed += fa.arenas[slot][thread].failedCount;
+        }
+        printf("frame arena, thread %u: high water %.1f KiB of %.1f KiB, %u pushes didn't fit\n", thread,
+               FrameArena_GetHighWater(fa, thread) / 1024.0, fa.arenas[0][thread].capacity / 1024.0, failed);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "common.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+    Scratch memory for things that only live until a frame slot's fence: draw lists, barriers, descriptor writes,
+    submit infos. Bump allocation out of one block made at startup, so the frame loop never calls malloc.
+
+    There's a LinearArena per frame slot and per thread (thread 0 is the render thread), so threads never share
+    one and nothing is locked. FrameArena_ResetSlot frees a slot's arenas all at once by setting used to 0; call
+    it after the slot's fence wait, like the other *_RetireSlot calls.
+
+    Running out returns null (and counts it) instead of growing, the high water marks say what capacity is
+    actually needed.
+*/
+
+#define FRAMEARENA_MAX_THREADS 16 // JOBS_MAX_THREADS
+#define FRAMEARENA_MAX_ALIGN 64 // every arena's base is aligned to this, pushes align their offset from it
+
+struct LinearArena {
+    ubyte *base;
+    size_t capacity;
+    size_t used;
+    size_t highWater; // most ever used
+    uint32_t failedCount; // pushes that didn't fit
+};
+
+// Null if it doesn't fit. align must be a power of two, at most FRAMEARENA_MAX_ALIGN.
+inline void *
+Arena_Push(LinearArena& a, size_t bytes, size_t align = 16)
+{
+    ASSERT(align && !(align & (align - 1)) && align <= FRAMEARENA_MAX_ALIGN);
+    size_t const start = (a.used + (align - 1)) & ~(align - 1);
+    if (start > a.capacity || bytes > a.capacity - start) {
+        ++a.failedCount;
+        return nullptr;
+    }
+    a.used = start + bytes;
+    a.highWater = Max(a.highWater, a.used);
+    return a.base + start;
+}
+
+// Uninitialized.
+template<class T> inline T *
+Arena_PushArray(LinearArena& a, size_t count)
+{
+    static_assert(alignof(T) <= FRAMEARENA_MAX_ALIGN, "over-aligned for the arenas' base");
+    return static_cast<T *>(Arena_Push(a, count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+}
+
+template<class T> inline T *
+Arena_PushArrayZero(LinearArena& a, size_t count)
+{
+    T *p = Arena_PushArray<T>(a, count);
+    if (p) memset(p, 0, count * sizeof(T));
+    return p;
+}
+
+// For scratch that's only needed inside a function: take a mark, push, then pop back to it.
+inline size_t Arena_GetMark(const LinearArena& a) { return a.used; }
+inline void Arena_PopToMark(LinearArena& a, size_t mark) { ASSERT(mark <= a.used); a.used = mark; }
+
+struct FrameArenas {
+    ubyte *memory; // every arena, one allocation, as malloc returned it (the arenas start FRAMEARENA_MAX_ALIGN aligned)
+    uint32_t slotCount;
+    uint32_t threadCount;
+    LinearArena arenas[GPUTIMER_MAX_SLOTS][FRAMEARENA_MAX_THREADS];
+};
+
+// Returns false, with fa zeroed, if the memory can't be allocated.
+bool FrameArena_Create(FrameArenas& fa, uint32_t slotCount, uint32_t threadCount, size_t bytesPerArena);
+void FrameArena_Destroy(FrameArenas& fa);
+
+// After the slot's fence wait, every frame. Nothing pushed to the slot's arenas may be used after this.
+void FrameArena_ResetSlot(FrameArenas& fa, uint32_t slot);
+
+inline LinearArena&
+FrameArena_Get(FrameArenas& fa, uint32_t slot, uint32_t thread)
+{
+    ASSERT(slot < fa.slotCount && thread < fa.threadCount);
+    return fa.arenas[slot][thread];
+}
+
+// Max high water mark of one thread's arenas over the slots.
+size_t FrameArena_GetHighWater(const FrameArenas& fa, uint32_t thread);
+// One line per thread: high water against capacity, and failed pushes.
+void FrameArena_PrintReport(const FrameArenas& fa);
@@ -0,0 +1,301 @@
+#include "FrameCapture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* RLE per row (packets don't cross rows), origin at the top left. */
+bool
+FrameCapture_WriteTga(const char *path, const ubyte *pixels, uint32_t width, uint32_t height, bool bBgra,
+                      ubyte *rowScratch)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+
+    ubyte header[18] = { };
+    header[2] = 10; // RLE true color
+    header[12] = ubyte(width); header[13] = ubyte(width >> 8);
+    header[14] = ubyte(height); header[15] = ubyte(height >> 8);
+    header[16] = 24;
+    header[17] = 0x20; // top-left origin
+    fwrite(header, 1, sizeof header, f);
+
+    ubyte *const row = rowScratch;
+    for (uint32_t y = 0; y < height; ++y) {
+        const ubyte *src = pixels + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; ++x, src += 4) {
+            row[x*3 + 0] = bBgra ? src[0] : src[2];
+            row[x*3 + 1] = src[1];
+            row[x*3 + 2] = bBgra ? src[2] : src[0];
+        }
+        for (uint32_t x = 0; x < width; ) {
+            const ubyte *p = row + x*3;
+            uint32_t run = 1;
+            while (x + run < width && run < 128 && !memcmp(p, p + run*3, 3)) ++run;
+            if (run > 1) {
+                fputc(int(0x80 | (run - 1)), f);
+                fwrite(p, 1, 3, f);
+                x += run;
+                continue;
+            }
+            /* Literal packet up to the start of the next run. */
+            uint32_t n = 1;
+            while (x + n < width && n < 128 && !(x + n + 1 < width && !memcmp(p + n*3, p + (n + 1)*3, 3))) ++n;
+            fputc(int(n - 1), f);
+            fwrite(p, 1, n * 3, f);
+            x += n;
+        }
+    }
+    bool const ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+static void
+WriteCapture(FrameCapture& fc, const CaptureBuffer& cb)
+{
+    CaptureWorkerState& ws = fc.ws;
+    const ubyte *pixels = static_cast<const ubyte *>(cb.readback.pMapped);
+    char path[64];
+
+    if (cb.kinds & (CaptureKind_Screenshot | CaptureKind_Sequence)) {
+        if (ws.rowCapacity < cb.width) {
+            free(ws.row);
+            ws.row = static_cast<ubyte *>(malloc(size_t(cb.width) * 3));
+            ws.rowCapacity = ws.row ? cb.width : 0;
+            if (!ws.row) {
+                puts("capture: out of memory");
+                return;
+            }
+        }
+    }
+    if (cb.kinds & CaptureKind_Screenshot) {
+        sprintf(path, "screenshot_%04u.tga", cb.screenshotNumber);
+        bool const ok = FrameCapture_WriteTga(path, pixels, cb.width, cb.height, fc.bBgra, ws.row);
+        printf("capture: %s %s\n", ok ? "wrote" : "couldn't write", path);
+    }
+    if (cb.kinds & CaptureKind_Sequence) {
+        sprintf(path, "capture_%02u_%06u.tga", cb.recordingNumber, cb.frameNumber);
+        if (!FrameCapture_WriteTga(path, pixels, cb.width, cb.height, fc.bBgra, ws.row)) {
+            printf("capture: couldn't write %s\n", path);
+        }
+    }
+    if (cb.kinds & CaptureKind_RawVideo) {
+        /* A new file per recording, and when the size changes, as the frames have no headers. */
+        if (ws.rawFile && (ws.rawRecording != cb.recordingNumber || ws.rawWidth != cb.width || ws.rawHeight != cb.height)) {
+            fclose(ws.rawFile);
+            ws.rawFile = nullptr;
+        }
+        if (!ws.rawFile) {
+            sprintf(path, "capture_%02u_%ux%u.%s", cb.recordingNumber, cb.width, cb.height, fc.bBgra ? "bgra" : "rgba");
+            ws.rawFile = fopen(path, "wb");
+            ws.rawRecording = cb.recordingNumber;
+            ws.rawWidth = cb.width;
+            ws.rawHeight = cb.height;
+            printf("capture: %s %s\n", ws.rawFile ? "recording to" : "couldn't open", path);
+        }
+        if (ws.rawFile) {
+            fwrite(pixels, 1, size_t(cb.width) * cb.height * 4, ws.rawFile);
+        }
+    }
+    if (cb.kinds & CaptureKind_Callback) {
+        cb.callback(cb.callbackUser, pixels, cb.width, cb.height, fc.bBgra);
+    }
+}
+
+static void
+CaptureWorker(void *arg)
+{
+    FrameCapture& fc = *static_cast<FrameCapture *>(arg);
+    for (;;) {
+        OS_WaitSemaphore(fc.queuedJobs);
+        uint32_t const b = fc.jobs[fc.ws.jobTail++ % lengthof(fc.jobs)];
+        if (b == CAPTURE_NONE) break;
+        WriteCapture(fc, fc.buffers[b]);
+        OS_PostSemaphore(fc.freeBuffers);
+    }
+    if (fc.ws.rawFile) {
+        fclose(fc.ws.rawFile);
+    }
+    free(fc.ws.row);
+    fc.ws = { };
+}
+
+static void
+QueueJob(FrameCapture& fc, uint32_t b)
+{
+    fc.jobs[fc.jobHead++ % lengthof(fc.jobs)] = b;
+    OS_PostSemaphore(fc.queuedJobs);
+}
+
+bool
+FrameCapture_Create(FrameCapture& fc, VkFormat swapchainFormat, bool bRawVideo)
+{
+    fc = { };
+    switch (swapchainFormat) {
+    case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB:
+        fc.bBgra = true;
+        break;
+    case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB:
+        break;
+    default:
+        printf("capture: swapchain format %d not supported\n", int(swapchainFormat));
+        return false;
+    }
+    fc.bRawVideo = bRawVideo;
+    for (uint32_t& b : fc.slotBuffer) b = CAPTURE_NONE;
+
+    bool ok = OS_CreateSemaphore(&fc.queuedJobs, 0, lengthof(fc.jobs)) &&
+              OS_CreateSemaphore(&fc.freeBuffers, CAPTURE_RING_SIZE, CAPTURE_RING_SIZE) &&
+              OS_StartThread(&fc.worker, CaptureWorker, &fc);
+    if (!ok) {
+        puts("capture: couldn't start the worker thread");
+        OS_DestroySemaphore(fc.queuedJobs);
+        OS_DestroySemaphore(fc.freeBuffers);
+        fc = { };
+    }
+    return ok;
+}
+
+void
+FrameCapture_Destroy(FrameCapture& fc, VkDevice device)
+{
+    if (fc.worker.handle) {
+        for (uint32_t slot = 0; slot < lengthof(fc.slotBuffer); ++slot) {
+            FrameCapture_RetireSlot(fc, slot);
+        }
+        QueueJob(fc, CAPTURE_NONE);
+        OS_JoinThread(fc.worker);
+    }
+    OS_DestroySemaphore(fc.queuedJobs);
+    OS_DestroySemaphore(fc.freeBuffers);
+    for (CaptureBuffer& cb : fc.buffers) {
+        VKH_DestroyBuffer(device, cb.readback);
+    }
+    fc = { };
+}
+
+void
+FrameCapture_RequestScreenshot(FrameCapture& fc)
+{
+    fc.bScreenshotPending = true;
+}
+
+void
+FrameCapture_ToggleRecording(FrameCapture& fc)
+{
+    if (fc.bRecording) {
+        printf("capture: recording %u stopped, %u frames, %u dropped\n", fc.recordingCount - 1,
+               fc.recordedFrames, fc.droppedFrames);
+        fc.bRecording = false;
+        return;
+    }
+    fc.bRecording = true;
+    fc.recordedFrames = 0;
+    fc.droppedFrames = 0;
+    printf("capture: recording %u started\n", fc.recordingCount++);
+}
+
+void
+FrameCapture_RequestCallback(FrameCapture& fc, capture_callback fn, void *user)
+{
+    fc.pendingCallback = fn;
+    fc.pendingCallbackUser = user;
+}
+
+void
+FrameCapture_RetireSlot(FrameCapture& fc, uint32_t slot)
+{
+    if (!fc.worker.handle) return;
+    uint32_t const b = fc.slotBuffer[slot];
+    if (b != CAPTURE_NONE) {
+        fc.slotBuffer[slot] = CAPTURE_NONE;
+        QueueJob(fc, b);
+    }
+}
+
+void
+FrameCapture_CmdCapture(FrameCapture& fc, const VulkanRenderer& vkr, VkCommandBuffer cmd, uint32_t slot,
+                        VkImage image, VkImageLayout layout, VkExtent2D extent)
+{
+    if (!fc.worker.handle || !(fc.bScreenshotPending || fc.bRecording || fc.pendingCallback)) return;
+    ASSERT(fc.slotBuffer[slot] == CAPTURE_NONE);
+
+    if (!OS_TryWaitSemaphore(fc.freeBuffers)) {
+        ++fc.droppedFrames; // a pending screenshot is just taken a frame later
+        return;
+    }
+    uint32_t const b = fc.nextBuffer;
+    CaptureBuffer& cb = fc.buffers[b];
+
+    /* The worker is done with it and so is the GPU (its frame retired before the job was queued). */
+    VkDeviceSize const bytes = VkDeviceSize(extent.width) * extent.height * 4;
+    if (cb.readback.size < bytes) {
+        VKH_DestroyBuffer(vkr.device, cb.readback);
+        if (VKH_CreateBuffer(vkr, bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &cb.readback) != VK_SUCCESS) {
+            printf("capture: couldn't allocate a %ux%u readback buffer, stopping\n", extent.width, extent.height);
+            OS_PostSemaphore(fc.freeBuffers); // still next in ring order
+            fc.bScreenshotPending = false;
+            fc.pendingCallback = nullptr;
+            if (fc.bRecording) FrameCapture_ToggleRecording(fc);
+            return;
+        }
+    }
+    fc.nextBuffer = (b + 1) % CAPTURE_RING_SIZE;
+    fc.slotBuffer[slot] = b;
+
+    cb.width = extent.width;
+    cb.height = extent.height;
+    cb.kinds = 0;
+    if (fc.bScreenshotPending) {
+        cb.kinds |= CaptureKind_Screenshot;
+        cb.screenshotNumber = fc.screenshotCount++;
+        fc.bScreenshotPending = false;
+    }
+    if (fc.pendingCallback) {
+        cb.kinds |= CaptureKind_Callback;
+        cb.callback = fc.pendingCallback;
+        cb.callbackUser = fc.pendingCallbackUser;
+        fc.pendingCallback = nullptr;
+    }
+    if (fc.bRecording) {
+        cb.kinds |= fc.bRawVideo ? CaptureKind_RawVideo : CaptureKind_Sequence;
+        cb.recordingNumber = fc.recordingCount - 1;
+        cb.frameNumber = fc.recordedFrames++;
+    }
+
+    /*  Whatever wrote the image last (a render pass, whose final layout transition only has the implicit
+        dependency to BOTTOM_OF_PIPE, a blit or a dispatch), this waits for it and its transition.
+    */
+    VkImageMemoryBarrier ib = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    ib.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    ib.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    ib.oldLayout = layout;
+    ib.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib.image = image;
+    ib.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &ib);
+
+    VkBufferImageCopy region = { };
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cb.readback.buffer, 1, &region);
+
+    /*  Back for the present, which waits on the submit's semaphore, so no later stage needs to wait. An image
+        that's written again, like the regression run's offscreen one, has everything after wait for the copy.
+    */
+    ib.srcAccessMask = 0;
+    ib.dstAccessMask = 0;
+    ib.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ib.newLayout = layout;
+    VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    mb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    VkPipelineStageFlags const laterStages = layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+                                           ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | laterStages,
+                         0, 1, &mb, 0, nullptr, 1, &ib);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "VulkanSwapchain.h" // os_thread, os_semaphore
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+
+#include <stdio.h>
+
+/*
+    Screenshots and recording without stalling the render loop.
+
+    FrameCapture_CmdCapture records a copy of the presented image into the next buffer of a ring of host-visible
+    readback buffers, at the end of the frame's command buffer. Nothing on the CPU touches that buffer until
+    FrameCapture_RetireSlot, after the slot's fence wait, hands it to a worker thread, which encodes and writes
+    the file and then gives the buffer back. If every buffer is still queued or being written the frame just
+    isn't captured (counted in droppedFrames), the render loop never waits for the disk.
+
+    Screenshots are screenshot_NNNN.tga. Recording writes capture_RR_NNNNNN.tga per frame, or with bRawVideo one
+    capture_RR_WxH.bgra (or .rgba, the swapchain's byte order) file of raw frames, e.g. for
+    `ffmpeg -f rawvideo -pix_fmt bgra -s WxH -r 60 -i capture_00_WxH.bgra out.mp4`.
+    TGAs are RLE compressed 24-bit, alpha dropped.
+
+    Only 8-bit RGBA/BGRA swapchain formats, and the swapchain needs TRANSFER_SRC usage.
+*/
+
+#define CAPTURE_RING_SIZE 8
+#define CAPTURE_NONE UINT32_MAX
+
+enum CaptureKindBits : uint32_t {
+    CaptureKind_Screenshot = 1,
+    CaptureKind_Sequence = 2, // recording, one TGA per frame
+    CaptureKind_RawVideo = 4, // recording, appended to one file
+    CaptureKind_Callback = 8, // FrameCapture_RequestCallback
+};
+
+// Called on the worker thread. pixels are width*height, 4 bytes each in the swapchain's order, valid during the call.
+typedef void (*capture_callback)(void *user, const ubyte *pixels, uint32_t width, uint32_t height, bool bBgra);
+
+struct CaptureBuffer {
+    BufferAllocation readback; // allocated on first use, grown when a bigger frame comes along
+    // What to do with it, set when the copy is recorded:
+    uint32_t width, height;
+    uint32_t kinds; // CaptureKindBits
+    uint32_t screenshotNumber;
+    uint32_t recordingNumber;
+    uint32_t frameNumber; // within the recording
+    capture_callback callback;
+    void *callbackUser;
+};
+
+// Only touched by the worker thread.
+struct CaptureWorkerState {
+    uint32_t jobTail;
+    ubyte *row; // one converted row
+    uint32_t rowCapacity;
+    FILE *rawFile;
+    uint32_t rawRecording, rawWidth, rawHeight;
+};
+
+struct FrameCapture {
+    CaptureBuffer buffers[CAPTURE_RING_SIZE]; // used and freed in ring order, so the next free one is nextBuffer
+    uint32_t nextBuffer;
+    uint32_t slotBuffer[GPUTIMER_MAX_SLOTS]; // buffer the slot's commands copy into, CAPTURE_NONE if none
+    bool bBgra; // byte order of the swapchain format
+    bool bRawVideo;
+
+    // Render thread to worker: buffer indices (or CAPTURE_NONE to quit), one queuedJobs post each.
+    uint32_t jobs[CAPTURE_RING_SIZE + 1];
+    uint32_t jobHead;
+    os_semaphore queuedJobs;
+    os_semaphore freeBuffers; // posted by the worker when it's done with a buffer
+    os_thread worker;
+    CaptureWorkerState ws;
+
+    // Requests
+    bool bScreenshotPending;
+    bool bRecording;
+    capture_callback pendingCallback; // null once it's taken
+    void *pendingCallbackUser;
+    uint32_t screenshotCount;
+    uint32_t recordingCount;
+    uint32_t recordedFrames; // in the current recording
+    uint32_t droppedFrames; // in the current recording, or screenshots delayed
+};
+
+// Returns false, with fc zeroed, if the format isn't supported or the worker can't be started.
+bool FrameCapture_Create(FrameCapture& fc, VkFormat swapchainFormat, bool bRawVideo);
+// The GPU must be idle. Writes out what's still queued, then stops the worker.
+void FrameCapture_Destroy(FrameCapture& fc, VkDevice device);
+
+void FrameCapture_RequestScreenshot(FrameCapture& fc);
+void FrameCapture_ToggleRecording(FrameCapture& fc);
+// The next captured frame is also handed to fn.
+void FrameCapture_RequestCallback(FrameCapture& fc, capture_callback fn, void *user);
+
+// 24-bit RLE TGA, alpha dropped. rowScratch holds at least 3*width bytes.
+bool FrameCapture_WriteTga(const char *path, const ubyte *pixels, uint32_t width, uint32_t height, bool bBgra,
+                           ubyte *rowScratch);
+
+// Call after the slot's fence wait, every frame. These do nothing if fc wasn't created.
+void FrameCapture_RetireSlot(FrameCapture& fc, uint32_t slot);
+
+/*  After the render pass, when image holds the finished frame. It's in layout and left in it: PRESENT_SRC_KHR
+    for a swapchain image, else later commands that use the image wait for the copy.
+*/
+void FrameCapture_CmdCapture(FrameCapture& fc, const VulkanRenderer& vkr, VkCommandBuffer cmd, uint32_t slot,
+                             VkImage image, VkImageLayout layout, VkExtent2D extent);
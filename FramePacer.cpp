@@ -0,0 +1,82 @@
+#include "FramePacer.h"
+
+#include "common.h"
+
+static inline float
+Ema(float avg, float sample)
+{
+    float const K = 16.0f; // same weighting as the title's frame time average
+    return avg * ((K-1) / K) + sample * (1 / K);
+}
+
+void
+FramePacer_Init(FramePacer& fp, int64_t ticksPerSec, bool enabled)
+{
+    fp = { };
+    fp.enabled = enabled;
+    fp.ticksPerSec = ticksPerSec;
+    fp.secsPerTick = 1.0f / float(ticksPerSec);
+    fp.marginSecs = 0.001f;
+}
+
+os_tick_t
+FramePacer_RetireFrame(FramePacer& fp, os_tick_t submitTicks, os_tick_t fenceReturnTicks,
+                       float gpuSecs, bool hasGpuTime)
+{
+    if (submitTicks == 0) { // nothing was submitted from this slot yet
+        return fenceReturnTicks;
+    }
+
+    os_tick_t doneTicks = fenceReturnTicks;
+    if (hasGpuTime) {
+        fp.gpuSecsAvg = Ema(fp.gpuSecsAvg, gpuSecs);
+
+        /* The GPU starts a frame when it is submitted or when the previous one is done, whichever is later. */
+        os_tick_t const startTicks = submitTicks > fp.lastGpuDoneTicks ? submitTicks : fp.lastGpuDoneTicks;
+        os_tick_t const estimate = startTicks + os_tick_t(gpuSecs * float(fp.ticksPerSec));
+        if (estimate < doneTicks) {
+            doneTicks = estimate;
+        }
+    }
+    fp.lastGpuDoneTicks = doneTicks;
+    return doneTicks;
+}
+
+float
+FramePacer_AddLatencySample(FramePacer& fp, os_tick_t inputEventTicks, os_tick_t gpuDoneTicks)
+{
+    float const secs = float(gpuDoneTicks - inputEventTicks) * fp.secsPerTick;
+    fp.latencySecsLast = secs;
+    fp.latencySecsAvg = fp.latencySamples++ ? Ema(fp.latencySecsAvg, secs) : secs;
+    return secs;
+}
+
+void
+FramePacer_WaitForFrameStart(FramePacer& fp)
+{
+    if (!fp.enabled || fp.lastSubmitTicks == 0) {
+        return;
+    }
+
+    /*  After waiting on this slot's fence the only GPU work that can still be in flight is the last submission.
+        It started no earlier than its submit or the retired frame's completion, so this underestimates
+        when the GPU goes idle, which errs on the side of sleeping too little.
+    */
+    os_tick_t const lastStartTicks = fp.lastSubmitTicks > fp.lastGpuDoneTicks ? fp.lastSubmitTicks : fp.lastGpuDoneTicks;
+    os_tick_t const gpuIdleTicks = lastStartTicks + os_tick_t(fp.gpuSecsAvg * float(fp.ticksPerSec));
+    os_tick_t const startTicks = gpuIdleTicks - os_tick_t((fp.cpuSecsAvg + fp.marginSecs) * float(fp.ticksPerSec));
+
+    os_tick_t const nowTicks = OS_GetTicks();
+    if (startTicks > nowTicks) {
+        /* Never sleep more than a quarter second, in case an estimate is garbage (e.g. after a hitch). */
+        os_tick_t const maxTicks = fp.ticksPerSec / 4;
+        OS_SleepUntilTicks(startTicks - nowTicks < maxTicks ? startTicks : nowTicks + maxTicks);
+    }
+}
+
+void
+FramePacer_OnSubmit(FramePacer& fp, os_tick_t frameStartTicks, os_tick_t submitTicks)
+{
+    fp.cpuSecsAvg = Ema(fp.cpuSecsAvg, float(submitTicks - frameStartTicks) * fp.secsPerTick);
+    fp.lastSubmitTicks = submitTicks;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VulkanSwapchain.h" // os_tick_t
+
+/*
+    Just-in-time frame start, for input-to-present latency.
+
+    Without this the loop samples input and time, then blocks in the fence wait and vkAcquireNextImageKHR,
+    so what it renders is already old when the GPU gets to it. With pacing enabled the loop does the blocking
+    first, then sleeps until roughly (when the GPU will go idle) - (how long the CPU takes to record and submit),
+    and only then samples input. Both durations are measured: CPU with OS ticks, GPU with timestamps.
+
+    Vulkan 1.2 core has no way to know when an image actually reaches the screen, so "present" here means
+    the frame's GPU work is complete. Under FIFO the scanout adds up to one more refresh interval.
+*/
+
+struct FramePacer {
+    bool enabled;
+
+    int64_t ticksPerSec;
+    float secsPerTick;
+
+    float cpuSecsAvg; // frame start (input sampled) -> vkQueueSubmit returned
+    float gpuSecsAvg; // from GPU timestamps
+    float marginSecs; // headroom so the GPU does not starve when the estimates are a bit off
+
+    os_tick_t lastSubmitTicks; // most recent submission, which is the only work still in flight after the fence wait
+    os_tick_t lastGpuDoneTicks; // estimate for the most recently retired frame
+
+    float latencySecsAvg; // key event -> GPU done, only updated for frames that consumed a key event
+    float latencySecsLast;
+    uint32_t latencySamples;
+};
+
+void FramePacer_Init(FramePacer& fp, int64_t ticksPerSec, bool enabled);
+
+/*  Call right after the fence (or vkDeviceWaitIdle) for a frame returns. fenceReturnTicks is an upper bound for
+    when the frame finished, submitTicks + queued work + gpuSecs is the other estimate, the smaller one is used.
+    Returns the estimated completion tick.
+*/
+os_tick_t FramePacer_RetireFrame(FramePacer& fp, os_tick_t submitTicks, os_tick_t fenceReturnTicks,
+                                 float gpuSecs, bool hasGpuTime);
+
+// Returns the input-to-present latency in seconds, and folds it into the running stats.
+float FramePacer_AddLatencySample(FramePacer& fp, os_tick_t inputEventTicks, os_tick_t gpuDoneTicks);
+
+// Blocks until the estimated just-in-time frame start. Does nothing if pacing is disabled.
+void FramePacer_WaitForFrameStart(FramePacer& fp);
+
+void FramePacer_OnSubmit(FramePacer& fp, os_tick_t frameStartTicks, os_tick_t submitTicks);
@@ -0,0 +1,2122 @@
+#include "FrameTrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every volk global the trace replaces, restored from ts.next by Trace_Uninstall. */
+#define TRACE_HOOKS(X) \
+    X(vkAllocateMemory) X(vkFreeMemory) X(vkMapMemory) X(vkUnmapMemory) \
+    X(vkCreateBuffer) X(vkDestroyBuffer) X(vkBindBufferMemory) \
+    X(vkCreateImage) X(vkDestroyImage) X(vkBindImageMemory) \
+    X(vkCreateImageView) X(vkDestroyImageView) X(vkCreateSampler) X(vkDestroySampler) \
+    X(vkCreateShaderModule) X(vkDestroyShaderModule) \
+    X(vkCreateDescriptorSetLayout) X(vkDestroyDescriptorSetLayout) \
+    X(vkCreatePipelineLayout) X(vkDestroyPipelineLayout) \
+    X(vkCreateRenderPass) X(vkDestroyRenderPass) X(vkCreateFramebuffer) X(vkDestroyFramebuffer) \
+    X(vkCreateGraphicsPipelines) X(vkCreateComputePipelines) X(vkDestroyPipeline) \
+    X(vkAllocateDescriptorSets) X(vkFreeDescriptorSets) X(vkResetDescriptorPool) X(vkDestroyDescriptorPool) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCreateSwapchainKHR) X(vkDestroySwapchainKHR) X(vkGetSwapchainImagesKHR) \
+    X(vkAllocateCommandBuffers) X(vkFreeCommandBuffers) X(vkDestroyCommandPool) X(vkBeginCommandBuffer) \
+    X(vkQueueSubmit) \
+    X(vkCmdBeginRenderPass) X(vkCmdEndRenderPass) X(vkCmdBindPipeline) X(vkCmdBindDescriptorSets) \
+    X(vkCmdPushConstants) X(vkCmdSetViewport) X(vkCmdSetScissor) X(vkCmdBindVertexBuffers) \
+    X(vkCmdBindIndexBuffer) X(vkCmdDraw) X(vkCmdDrawIndexed) X(vkCmdDrawIndirect) X(vkCmdDispatch) \
+    X(vkCmdPipelineBarrier) X(vkCmdCopyBuffer) X(vkCmdCopyBufferToImage) X(vkCmdCopyImageToBuffer) \
+    X(vkCmdCopyImage) X(vkCmdBlitImage) X(vkCmdFillBuffer) X(vkCmdUpdateBuffer)
+
+#define TRACE_MAX_SWAPCHAINS 8
+
+/* Handle kinds that are looked up like objects but never written. */
+enum {
+    TraceKind_Memory = TraceChunk_Count,
+    TraceKind_Swapchain,
+};
+
+enum {
+    TraceWarn_UnknownObject = 1 << 0,
+    TraceWarn_DescriptorCopy = 1 << 1,
+    TraceWarn_Specialization = 1 << 2,
+    TraceWarn_TexelBuffer = 1 << 3,
+};
+
+static const char *const TraceWarnings[] = {
+    "objects created before the trace was installed",
+    "descriptor copies",
+    "specialization constants",
+    "texel buffer descriptors",
+};
+
+struct Bytes {
+    uint8_t *data;
+    size_t count;
+    size_t capacity;
+};
+
+/* Appends size bytes, copied from p or zeroed, and returns where they went (until the next append). */
+static void *
+Bytes_Append(Bytes& b, const void *p, size_t size)
+{
+    if (b.count + size > b.capacity) {
+        b.capacity = Max(Max(b.capacity * 2, b.count + size), size_t(256));
+        b.data = (uint8_t *)realloc(b.data, b.capacity);
+        if (!b.data) {
+            puts("trace: out of memory");
+            exit(1);
+        }
+    }
+    void *const dst = b.data + b.count;
+    if (p) {
+        memcpy(dst, p, size);
+    } else {
+        memset(dst, 0, size);
+    }
+    b.count += size;
+    return dst;
+}
+
+static void
+Bytes_Free(Bytes& b)
+{
+    free(b.data);
+    b = { };
+}
+
+template<class T> static void
+GrowArray(T *&a, uint32_t& capacity, uint32_t needed)
+{
+    if (needed > capacity) {
+        capacity = Max(capacity * 2, Max(needed, 64u));
+        a = (T *)realloc(a, capacity * sizeof(T));
+        if (!a) {
+            puts("trace: out of memory");
+            exit(1);
+        }
+    }
+}
+
+struct TraceObject {
+    uint64_t handle; // 0 once destroyed, the record stays
+    uint64_t owner; // the pool of a descriptor set, the swapchain of a swapchain image
+    uint32_t type; // TraceChunkType
+    bool bNeeded; // used by the frame being captured, directly or through another object
+    bool bTaken; // contents read back for this capture
+    bool bCopyable; // images: color, one sample, TRANSFER_SRC usage
+    uint32_t memory; // buffers and images: index in ts.memories, UINT32_MAX if unbound
+    VkDeviceSize memoryOffset;
+    uint32_t *layouts; // images: per mip level, as of the last submit
+    Bytes info; // the chunk payload before any data
+    Bytes data; // buffers and images: the contents, for the capture. Descriptor sets: TraceDescriptor array.
+};
+
+struct TraceMemory {
+    VkDeviceMemory handle;
+    VkMemoryPropertyFlags flags;
+    uint8_t *pMapped; // offset 0 of the memory, null if not mapped
+};
+
+struct TraceLayoutChange {
+    uint32_t image, baseMip, mipCount, layout;
+};
+
+struct TraceCmdBuffer {
+    VkCommandBuffer handle;
+    VkCommandPool pool;
+    bool bRecording; // begun while a frame was armed
+    Bytes stream; // TraceCmdHeader + payload
+    Bytes layouts; // TraceLayoutChange, applied when submitted
+};
+
+struct HandleEntry {
+    uint64_t handle; // 0 with kind 0 is empty, with kind UINT32_MAX removed
+    uint32_t kind;
+    uint32_t index;
+};
+
+struct TraceSwapchain {
+    VkSwapchainKHR handle;
+    VkSwapchainCreateFlagsKHR flags;
+    VkFormat format;
+    VkExtent2D extent;
+    uint32_t arrayLayers;
+    VkImageUsageFlags usage;
+};
+
+static struct TraceState {
+    VkDevice device; // null if not installed
+    VkPhysicalDevice physicalDevice;
+    VkPhysicalDeviceMemoryProperties memoryProps;
+    VolkDeviceTable next; // what the hooks call, and what the trace itself uses
+    const char *path;
+    VkCommandPool commandPool; // for reading back
+    VkCommandBuffer commandBuffer;
+
+    TraceObject *objects; // indexed by id
+    uint32_t objectCount, objectCapacity;
+    TraceMemory *memories;
+    uint32_t memoryCount, memoryCapacity;
+    TraceCmdBuffer *cmdBuffers;
+    uint32_t cmdBufferCount, cmdBufferCapacity;
+    uint32_t lastCmdBuffer; // last one found, command hooks mostly see the same one in a row
+    HandleEntry *handles;
+    uint32_t handleCapacity, handleUsed; // used counts removed entries until the next rehash
+    TraceSwapchain swapchains[TRACE_MAX_SWAPCHAINS];
+
+    bool bRequest;
+    uint32_t requestFrame; // TRACE_NEXT_FRAME for any
+    bool bArmed;
+    uint32_t frameIndex;
+    Bytes submitted; // the captured command buffer chunks, in submit order
+    uint32_t submittedCount;
+    uint32_t warnings; // TraceWarn_ bits, printed and cleared by the next capture
+} ts;
+
+static void
+Warn(uint32_t bit)
+{
+    ts.warnings |= bit;
+}
+
+//----- Handle map, open addressing -----
+
+static uint32_t
+HandleSlot(uint64_t handle, uint32_t kind)
+{
+    uint64_t const h = (handle ^ (uint64_t(kind) << 56)) * 0x9E3779B97F4A7C15ull;
+    return uint32_t(h >> 32) & (ts.handleCapacity - 1);
+}
+
+static void
+Handles_Insert(uint64_t handle, uint32_t kind, uint32_t index)
+{
+    if ((ts.handleUsed + 1) * 2 > ts.handleCapacity) {
+        HandleEntry *const old = ts.handles;
+        uint32_t const oldCapacity = ts.handleCapacity;
+        uint32_t live = 0;
+        for (uint32_t i = 0; i < oldCapacity; ++i) {
+            live += old[i].handle != 0;
+        }
+        ts.handleCapacity = Max(oldCapacity, 1024u);
+        while ((live + 1) * 4 > ts.handleCapacity) {
+            ts.handleCapacity *= 2;
+        }
+        ts.handles = (HandleEntry *)calloc(ts.handleCapacity, sizeof(HandleEntry));
+        ts.handleUsed = 0;
+        for (uint32_t i = 0; i < oldCapacity; ++i) {
+            if (old[i].handle) {
+                Handles_Insert(old[i].handle, old[i].kind, old[i].index);
+            }
+        }
+        free(old);
+    }
+    for (uint32_t i = HandleSlot(handle, kind);; i = (i + 1) & (ts.handleCapacity - 1)) {
+        HandleEntry& e = ts.handles[i];
+        if (e.handle == handle && e.kind == kind) {
+            e.index = index; // a handle the driver reused, the destroy was missed
+            return;
+        }
+        if (!e.handle && e.kind == 0) {
+            e = { handle, kind, index };
+            ++ts.handleUsed;
+            return;
+        }
+    }
+}
+
+static HandleEntry *
+Handles_Find(uint64_t handle, uint32_t kind)
+{
+    if (!handle || !ts.handleCapacity) {
+        return nullptr;
+    }
+    for (uint32_t i = HandleSlot(handle, kind);; i = (i + 1) & (ts.handleCapacity - 1)) {
+        HandleEntry& e = ts.handles[i];
+        if (e.handle == handle && e.kind == kind) {
+            return &e;
+        }
+        if (!e.handle && e.kind == 0) {
+            return nullptr;
+        }
+    }
+}
+
+//----- Objects -----
+
+/* Both kinds of pipeline share the VkPipeline handles. */
+static uint32_t
+LookupKind(uint32_t type)
+{
+    return type == TraceChunk_ComputePipeline ? uint32_t(TraceChunk_GraphicsPipeline) : type;
+}
+
+static uint32_t
+NewObject(uint32_t type, uint64_t handle)
+{
+    GrowArray(ts.objects, ts.objectCapacity, ts.objectCount + 1);
+    uint32_t const id = ts.objectCount++;
+    TraceObject& o = ts.objects[id];
+    o = { };
+    o.handle = handle;
+    o.type = type;
+    o.memory = UINT32_MAX;
+    Handles_Insert(handle, LookupKind(type), id);
+    return id;
+}
+
+/* The new object's payload, valid until the next object is made. */
+static Bytes&
+NewInfo(uint32_t type, uint64_t handle)
+{
+    uint32_t const id = NewObject(type, handle);
+    return ts.objects[id].info;
+}
+
+static uint32_t
+Find(uint64_t handle, uint32_t type)
+{
+    if (!handle) {
+        return TRACE_NO_ID;
+    }
+    const HandleEntry *e = Handles_Find(handle, LookupKind(type));
+    if (!e) {
+        Warn(TraceWarn_UnknownObject);
+        return TRACE_NO_ID;
+    }
+    return e->index;
+}
+
+static void
+Mark(uint32_t id)
+{
+    if (id != TRACE_NO_ID) {
+        ts.objects[id].bNeeded = true;
+    }
+}
+
+/* Find, for the commands of the captured frame: the object is needed. */
+static uint32_t
+Use(uint64_t handle, uint32_t type)
+{
+    uint32_t const id = Find(handle, type);
+    Mark(id);
+    return id;
+}
+
+static void
+DestroyObject(uint64_t handle, uint32_t type)
+{
+    if (HandleEntry *e = Handles_Find(handle, LookupKind(type))) {
+        ts.objects[e->index].handle = 0;
+        e->handle = 0;
+        e->kind = UINT32_MAX;
+    }
+}
+
+template<class T> static T *
+Info(uint32_t id)
+{
+    return (T *)ts.objects[id].info.data;
+}
+
+static TraceCmdBuffer *
+FindCmdBuffer(VkCommandBuffer handle)
+{
+    if (ts.lastCmdBuffer < ts.cmdBufferCount && ts.cmdBuffers[ts.lastCmdBuffer].handle == handle) {
+        return &ts.cmdBuffers[ts.lastCmdBuffer];
+    }
+    for (uint32_t i = 0; i < ts.cmdBufferCount; ++i) {
+        if (ts.cmdBuffers[i].handle == handle) {
+            ts.lastCmdBuffer = i;
+            return &ts.cmdBuffers[i];
+        }
+    }
+    return nullptr;
+}
+
+/* The command buffer if its commands are being captured. */
+static TraceCmdBuffer *
+Recording(VkCommandBuffer handle)
+{
+    if (!ts.bArmed) {
+        return nullptr;
+    }
+    TraceCmdBuffer *cb = FindCmdBuffer(handle);
+    return cb && cb->bRecording ? cb : nullptr;
+}
+
+/* Room for a command's payload, zeroed, padded. Valid until the next append to the stream. */
+static void *
+Cmd(TraceCmdBuffer& cb, uint32_t type, size_t size)
+{
+    const TraceCmdHeader h = { type, uint32_t(size) };
+    Bytes_Append(cb.stream, &h, sizeof h);
+    return Bytes_Append(cb.stream, nullptr, TraceFile_AlignUp(size));
+}
+
+static void
+RemoveCmdBuffer(uint32_t i)
+{
+    Bytes_Free(ts.cmdBuffers[i].stream);
+    Bytes_Free(ts.cmdBuffers[i].layouts);
+    ts.cmdBuffers[i] = ts.cmdBuffers[--ts.cmdBufferCount];
+    ts.lastCmdBuffer = 0;
+}
+
+/*  Bytes per texel block of the color formats that can be read back, 0 for the others. Blocks are 1x1, or 4x4
+    for the compressed formats.
+*/
+static uint32_t
+FormatBlockBytes(VkFormat format, uint32_t *pBlockSize)
+{
+    uint32_t const f = uint32_t(format);
+    *pBlockSize = 1;
+    if (f == VK_FORMAT_UNDEFINED) return 0;
+    if (f == VK_FORMAT_R4G4_UNORM_PACK8) return 1;
+    if (f <= VK_FORMAT_A1R5G5B5_UNORM_PACK16) return 2;
+    if (f <= VK_FORMAT_R8_SRGB) return 1;
+    if (f <= VK_FORMAT_R8G8_SRGB) return 2;
+    if (f <= VK_FORMAT_B8G8R8_SRGB) return 3;
+    if (f <= VK_FORMAT_A2B10G10R10_SINT_PACK32) return 4;
+    if (f <= VK_FORMAT_R16_SFLOAT) return 2;
+    if (f <= VK_FORMAT_R16G16_SFLOAT) return 4;
+    if (f <= VK_FORMAT_R16G16B16_SFLOAT) return 6;
+    if (f <= VK_FORMAT_R16G16B16A16_SFLOAT) return 8;
+    if (f <= VK_FORMAT_R32_SFLOAT) return 4;
+    if (f <= VK_FORMAT_R32G32_SFLOAT) return 8;
+    if (f <= VK_FORMAT_R32G32B32_SFLOAT) return 12;
+    if (f <= VK_FORMAT_R32G32B32A32_SFLOAT) return 16;
+    if (f <= VK_FORMAT_R64G64B64A64_SFLOAT) return 8 * ((f - VK_FORMAT_R64_UINT) / 3 + 1);
+    if (f <= VK_FORMAT_E5B9G9R9_UFLOAT_PACK32) return 4;
+    if (f <= VK_FORMAT_D32_SFLOAT_S8_UINT) return 0; // depth/stencil
+    *pBlockSize = 4;
+    if (f <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK) return 8;
+    if (f <= VK_FORMAT_BC3_SRGB_BLOCK) return 16;
+    if (f <= VK_FORMAT_BC4_SNORM_BLOCK) return 8;
+    if (f <= VK_FORMAT_BC7_SRGB_BLOCK) return 16;
+    if (f <= VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) return 8;
+    if (f <= VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) return 16;
+    if (f <= VK_FORMAT_EAC_R11_SNORM_BLOCK) return 8;
+    if (f <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK) return 16;
+    if (f <= VK_FORMAT_ASTC_4x4_SRGB_BLOCK) return 16;
+    return 0;
+}
+
+static VkDeviceSize
+LevelBytes(const TraceImage& img, uint32_t mip)
+{
+    uint32_t blockSize;
+    uint32_t const blockBytes = FormatBlockBytes(VkFormat(img.format), &blockSize);
+    uint32_t const w = Max(img.width >> mip, 1u), h = Max(img.height >> mip, 1u), d = Max(img.depth >> mip, 1u);
+    return VkDeviceSize((w + blockSize - 1) / blockSize) * ((h + blockSize - 1) / blockSize) * d *
+           img.arrayLayers * blockBytes;
+}
+
+//----- Memory -----
+
+static TraceMemory *
+FindMemory(VkDeviceMemory memory)
+{
+    const HandleEntry *e = Handles_Find((uint64_t)memory, TraceKind_Memory);
+    return e ? &ts.memories[e->index] : nullptr;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                      VkDeviceMemory *pMemory)
+{
+    VkResult const res = ts.next.vkAllocateMemory(device, pInfo, pAlloc, pMemory);
+    if (res == VK_SUCCESS) {
+        GrowArray(ts.memories, ts.memoryCapacity, ts.memoryCount + 1);
+        ts.memories[ts.memoryCount] = { *pMemory, ts.memoryProps.memoryTypes[pInfo->memoryTypeIndex].propertyFlags };
+        Handles_Insert((uint64_t)*pMemory, TraceKind_Memory, ts.memoryCount++);
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAlloc)
+{
+    if (HandleEntry *e = Handles_Find((uint64_t)memory, TraceKind_Memory)) {
+        ts.memories[e->index] = { };
+        e->handle = 0;
+        e->kind = UINT32_MAX;
+    }
+    ts.next.vkFreeMemory(device, memory, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+                 VkMemoryMapFlags flags, void **ppData)
+{
+    VkResult const res = ts.next.vkMapMemory(device, memory, offset, size, flags, ppData);
+    TraceMemory *m = FindMemory(memory);
+    if (res == VK_SUCCESS && m) {
+        m->pMapped = (uint8_t *)*ppData - offset;
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkUnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+    if (TraceMemory *m = FindMemory(memory)) {
+        m->pMapped = nullptr;
+    }
+    ts.next.vkUnmapMemory(device, memory);
+}
+
+//----- Buffers and images -----
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateBuffer(VkDevice device, const VkBufferCreateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                    VkBuffer *pBuffer)
+{
+    VkBufferCreateInfo info = *pInfo;
+    info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VkResult const res = ts.next.vkCreateBuffer(device, &info, pAlloc, pBuffer);
+    if (res == VK_SUCCESS) {
+        uint32_t const id = NewObject(TraceChunk_Buffer, (uint64_t)*pBuffer);
+        TraceBuffer *b = (TraceBuffer *)Bytes_Append(ts.objects[id].info, nullptr, sizeof(TraceBuffer));
+        b->size = pInfo->size;
+        b->usage = pInfo->usage;
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)buffer, TraceChunk_Buffer);
+    ts.next.vkDestroyBuffer(device, buffer, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize offset)
+{
+    uint32_t const id = Find((uint64_t)buffer, TraceChunk_Buffer);
+    const HandleEntry *m = Handles_Find((uint64_t)memory, TraceKind_Memory);
+    if (id != TRACE_NO_ID && m) {
+        ts.objects[id].memory = m->index;
+        ts.objects[id].memoryOffset = offset;
+        Info<TraceBuffer>(id)->memoryFlags = ts.memories[m->index].flags;
+    }
+    return ts.next.vkBindBufferMemory(device, buffer, memory, offset);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateImage(VkDevice device, const VkImageCreateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                   VkImage *pImage)
+{
+    VkImageCreateInfo info = *pInfo;
+    uint32_t blockSize;
+    bool bCopyable = pInfo->samples == VK_SAMPLE_COUNT_1_BIT && FormatBlockBytes(pInfo->format, &blockSize) &&
+                     !(pInfo->usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+    if (bCopyable && !(info.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(ts.physicalDevice, pInfo->format, &props);
+        VkFormatFeatureFlags const features = pInfo->tiling == VK_IMAGE_TILING_OPTIMAL ? props.optimalTilingFeatures
+                                                                                       : props.linearTilingFeatures;
+        bCopyable = (features & VK_FORMAT_FEATURE_TRANSFER_SRC_BIT) != 0;
+        if (bCopyable) {
+            info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+    }
+    VkResult const res = ts.next.vkCreateImage(device, &info, pAlloc, pImage);
+    if (res == VK_SUCCESS) {
+        uint32_t const id = NewObject(TraceChunk_Image, (uint64_t)*pImage);
+        TraceObject& o = ts.objects[id];
+        o.bCopyable = bCopyable;
+        o.layouts = (uint32_t *)malloc(pInfo->mipLevels * sizeof(uint32_t));
+        for (uint32_t m = 0; m < pInfo->mipLevels; ++m) {
+            o.layouts[m] = pInfo->initialLayout;
+        }
+        TraceImage *img = (TraceImage *)Bytes_Append(o.info, nullptr, sizeof(TraceImage));
+        img->flags = pInfo->flags;
+        img->imageType = pInfo->imageType;
+        img->format = pInfo->format;
+        img->width = pInfo->extent.width;
+        img->height = pInfo->extent.height;
+        img->depth = pInfo->extent.depth;
+        img->mipLevels = pInfo->mipLevels;
+        img->arrayLayers = pInfo->arrayLayers;
+        img->samples = pInfo->samples;
+        img->tiling = pInfo->tiling;
+        img->usage = pInfo->usage;
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)image, TraceChunk_Image);
+    ts.next.vkDestroyImage(device, image, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize offset)
+{
+    uint32_t const id = Find((uint64_t)image, TraceChunk_Image);
+    const HandleEntry *m = Handles_Find((uint64_t)memory, TraceKind_Memory);
+    if (id != TRACE_NO_ID && m) {
+        ts.objects[id].memory = m->index;
+        ts.objects[id].memoryOffset = offset;
+        Info<TraceImage>(id)->memoryFlags = ts.memories[m->index].flags;
+    }
+    return ts.next.vkBindImageMemory(device, image, memory, offset);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateImageView(VkDevice device, const VkImageViewCreateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                       VkImageView *pView)
+{
+    VkResult const res = ts.next.vkCreateImageView(device, pInfo, pAlloc, pView);
+    if (res == VK_SUCCESS) {
+        TraceImageView v = { };
+        v.image = Find((uint64_t)pInfo->image, TraceChunk_Image);
+        v.viewType = pInfo->viewType;
+        v.format = pInfo->format;
+        v.components[0] = pInfo->components.r;
+        v.components[1] = pInfo->components.g;
+        v.components[2] = pInfo->components.b;
+        v.components[3] = pInfo->components.a;
+        v.aspect = pInfo->subresourceRange.aspectMask;
+        v.baseMip = pInfo->subresourceRange.baseMipLevel;
+        v.mipCount = pInfo->subresourceRange.levelCount;
+        v.baseLayer = pInfo->subresourceRange.baseArrayLayer;
+        v.layerCount = pInfo->subresourceRange.layerCount;
+        for (const VkBaseInStructure *s = (const VkBaseInStructure *)pInfo->pNext; s; s = s->pNext) {
+            if (s->sType == VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO) {
+                v.usage = ((const VkImageViewUsageCreateInfo *)s)->usage;
+            }
+        }
+        Bytes_Append(NewInfo(TraceChunk_ImageView, (uint64_t)*pView), &v, sizeof v);
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyImageView(VkDevice device, VkImageView view, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)view, TraceChunk_ImageView);
+    ts.next.vkDestroyImageView(device, view, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateSampler(VkDevice device, const VkSamplerCreateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                     VkSampler *pSampler)
+{
+    VkResult const res = ts.next.vkCreateSampler(device, pInfo, pAlloc, pSampler);
+    if (res == VK_SUCCESS) {
+        const TraceSampler s = {
+            uint32_t(pInfo->magFilter), uint32_t(pInfo->minFilter), uint32_t(pInfo->mipmapMode),
+            uint32_t(pInfo->addressModeU), uint32_t(pInfo->addressModeV), uint32_t(pInfo->addressModeW),
+            pInfo->mipLodBias, pInfo->anisotropyEnable, pInfo->maxAnisotropy,
+            pInfo->compareEnable, uint32_t(pInfo->compareOp), pInfo->minLod, pInfo->maxLod,
+            uint32_t(pInfo->borderColor), pInfo->unnormalizedCoordinates
+        };
+        Bytes_Append(NewInfo(TraceChunk_Sampler, (uint64_t)*pSampler), &s, sizeof s);
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroySampler(VkDevice device, VkSampler sampler, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)sampler, TraceChunk_Sampler);
+    ts.next.vkDestroySampler(device, sampler, pAlloc);
+}
+
+//----- Shaders, layouts, render passes, framebuffers -----
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateShaderModule(VkDevice device, const VkShaderModuleCreateInfo *pInfo,
+                          const VkAllocationCallbacks *pAlloc, VkShaderModule *pModule)
+{
+    VkResult const res = ts.next.vkCreateShaderModule(device, pInfo, pAlloc, pModule);
+    if (res == VK_SUCCESS) {
+        Bytes& b = NewInfo(TraceChunk_ShaderModule, (uint64_t)*pModule);
+        const TraceShaderModule m = { pInfo->codeSize };
+        Bytes_Append(b, &m, sizeof m);
+        Bytes_Append(b, pInfo->pCode, pInfo->codeSize);
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyShaderModule(VkDevice device, VkShaderModule module, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)module, TraceChunk_ShaderModule); // pipelines made from it can still be written
+    ts.next.vkDestroyShaderModule(device, module, pAlloc);
+}
+
+/* pImmutableSamplers is ignored for the other descriptor types. */
+static bool
+HasImmutableSamplers(const VkDescriptorSetLayoutBinding& b)
+{
+    return b.pImmutableSamplers && (b.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+                                    b.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo *pInfo,
+                                 const VkAllocationCallbacks *pAlloc, VkDescriptorSetLayout *pLayout)
+{
+    VkResult const res = ts.next.vkCreateDescriptorSetLayout(device, pInfo, pAlloc, pLayout);
+    if (res == VK_SUCCESS) {
+        Bytes& b = NewInfo(TraceChunk_SetLayout, (uint64_t)*pLayout);
+        TraceSetLayout l = { pInfo->flags, pInfo->bindingCount };
+        for (uint32_t i = 0; i < pInfo->bindingCount; ++i) {
+            if (HasImmutableSamplers(pInfo->pBindings[i])) {
+                l.immutableSamplerCount += pInfo->pBindings[i].descriptorCount;
+            }
+        }
+        Bytes_Append(b, &l, sizeof l);
+        uint32_t samplerCount = 0;
+        for (uint32_t i = 0; i < pInfo->bindingCount; ++i) {
+            const VkDescriptorSetLayoutBinding& src = pInfo->pBindings[i];
+            TraceSetLayoutBinding dst = {
+                src.binding, uint32_t(src.descriptorType), src.descriptorCount, src.stageFlags, TRACE_NO_ID
+            };
+            if (HasImmutableSamplers(src)) {
+                dst.firstImmutableSampler = samplerCount;
+                samplerCount += src.descriptorCount;
+            }
+            Bytes_Append(b, &dst, sizeof dst);
+        }
+        for (uint32_t i = 0; i < pInfo->bindingCount; ++i) {
+            const VkDescriptorSetLayoutBinding& src = pInfo->pBindings[i];
+            for (uint32_t k = 0; HasImmutableSamplers(src) && k < src.descriptorCount; ++k) {
+                uint32_t const id = Find((uint64_t)src.pImmutableSamplers[k], TraceChunk_Sampler);
+                Bytes_Append(b, &id, sizeof id);
+            }
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout layout, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)layout, TraceChunk_SetLayout);
+    ts.next.vkDestroyDescriptorSetLayout(device, layout, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreatePipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo *pInfo,
+                            const VkAllocationCallbacks *pAlloc, VkPipelineLayout *pLayout)
+{
+    VkResult const res = ts.next.vkCreatePipelineLayout(device, pInfo, pAlloc, pLayout);
+    if (res == VK_SUCCESS) {
+        Bytes& b = NewInfo(TraceChunk_PipelineLayout, (uint64_t)*pLayout);
+        const TracePipelineLayout l = { pInfo->setLayoutCount, pInfo->pushConstantRangeCount };
+        Bytes_Append(b, &l, sizeof l);
+        for (uint32_t i = 0; i < pInfo->setLayoutCount; ++i) {
+            uint32_t const id = Find((uint64_t)pInfo->pSetLayouts[i], TraceChunk_SetLayout);
+            Bytes_Append(b, &id, sizeof id);
+        }
+        for (uint32_t i = 0; i < pInfo->pushConstantRangeCount; ++i) {
+            const VkPushConstantRange& src = pInfo->pPushConstantRanges[i];
+            const TracePushRange dst = { src.stageFlags, src.offset, src.size };
+            Bytes_Append(b, &dst, sizeof dst);
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyPipelineLayout(VkDevice device, VkPipelineLayout layout, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)layout, TraceChunk_PipelineLayout);
+    ts.next.vkDestroyPipelineLayout(device, layout, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateRenderPass(VkDevice device, const VkRenderPassCreateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                        VkRenderPass *pRenderPass)
+{
+    VkResult const res = ts.next.vkCreateRenderPass(device, pInfo, pAlloc, pRenderPass);
+    if (res != VK_SUCCESS) {
+        return res;
+    }
+    /* References and preserves are gathered first, the subpasses point into them. */
+    Bytes refs = { }, preserves = { };
+    TraceRenderPass rp = { pInfo->attachmentCount, pInfo->subpassCount, pInfo->dependencyCount };
+    Bytes& b = NewInfo(TraceChunk_RenderPass, (uint64_t)*pRenderPass);
+    Bytes_Append(b, &rp, sizeof rp);
+    for (uint32_t i = 0; i < pInfo->attachmentCount; ++i) {
+        const VkAttachmentDescription& a = pInfo->pAttachments[i];
+        const TraceAttachment t = {
+            a.flags, uint32_t(a.format), uint32_t(a.samples), uint32_t(a.loadOp), uint32_t(a.storeOp),
+            uint32_t(a.stencilLoadOp), uint32_t(a.stencilStoreOp), uint32_t(a.initialLayout), uint32_t(a.finalLayout)
+        };
+        Bytes_Append(b, &t, sizeof t);
+    }
+    for (uint32_t i = 0; i < pInfo->subpassCount; ++i) {
+        const VkSubpassDescription& s = pInfo->pSubpasses[i];
+        TraceSubpass t = { };
+        t.bindPoint = s.pipelineBindPoint;
+        t.firstRef = uint32_t(refs.count / sizeof(TraceAttachmentRef));
+        t.inputCount = s.inputAttachmentCount;
+        t.colorCount = s.colorAttachmentCount;
+        t.bResolve = s.pResolveAttachments != nullptr;
+        t.bDepth = s.pDepthStencilAttachment != nullptr;
+        Bytes_Append(refs, s.pInputAttachments, s.inputAttachmentCount * sizeof(VkAttachmentReference));
+        Bytes_Append(refs, s.pColorAttachments, s.colorAttachmentCount * sizeof(VkAttachmentReference));
+        if (t.bResolve) {
+            Bytes_Append(refs, s.pResolveAttachments, s.colorAttachmentCount * sizeof(VkAttachmentReference));
+        }
+        if (t.bDepth) {
+            Bytes_Append(refs, s.pDepthStencilAttachment, sizeof(VkAttachmentReference));
+        }
+        t.firstPreserve = uint32_t(preserves.count / sizeof(uint32_t));
+        t.preserveCount = s.preserveAttachmentCount;
+        Bytes_Append(preserves, s.pPreserveAttachments, s.preserveAttachmentCount * sizeof(uint32_t));
+        Bytes_Append(b, &t, sizeof t);
+    }
+    for (uint32_t i = 0; i < pInfo->dependencyCount; ++i) {
+        const VkSubpassDependency& d = pInfo->pDependencies[i];
+        const TraceDependency t = {
+            d.srcSubpass, d.dstSubpass, d.srcStageMask, d.dstStageMask, d.srcAccessMask, d.dstAccessMask,
+            d.dependencyFlags
+        };
+        Bytes_Append(b, &t, sizeof t);
+    }
+    /* VkAttachmentReference is the same two uint32_t as TraceAttachmentRef. */
+    Bytes_Append(b, refs.data, refs.count);
+    Bytes_Append(b, preserves.data, preserves.count);
+    TraceRenderPass *p = (TraceRenderPass *)b.data;
+    p->refCount = uint32_t(refs.count / sizeof(TraceAttachmentRef));
+    p->preserveCount = uint32_t(preserves.count / sizeof(uint32_t));
+    Bytes_Free(refs);
+    Bytes_Free(preserves);
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)renderPass, TraceChunk_RenderPass);
+    ts.next.vkDestroyRenderPass(device, renderPass, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo *pInfo, const VkAllocationCallbacks *pAlloc,
+                         VkFramebuffer *pFramebuffer)
+{
+    VkResult const res = ts.next.vkCreateFramebuffer(device, pInfo, pAlloc, pFramebuffer);
+    if (res == VK_SUCCESS) {
+        const TraceFramebuffer f = {
+            Find((uint64_t)pInfo->renderPass, TraceChunk_RenderPass),
+            pInfo->width, pInfo->height, pInfo->layers, pInfo->attachmentCount
+        };
+        Bytes& b = NewInfo(TraceChunk_Framebuffer, (uint64_t)*pFramebuffer);
+        Bytes_Append(b, &f, sizeof f);
+        for (uint32_t i = 0; i < pInfo->attachmentCount; ++i) {
+            uint32_t const id = Find((uint64_t)pInfo->pAttachments[i], TraceChunk_ImageView);
+            Bytes_Append(b, &id, sizeof id);
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)framebuffer, TraceChunk_Framebuffer);
+    ts.next.vkDestroyFramebuffer(device, framebuffer, pAlloc);
+}
+
+//----- Pipelines -----
+
+static TraceShaderStage
+ShaderStage(const VkPipelineShaderStageCreateInfo& s)
+{
+    TraceShaderStage t = { };
+    t.stage = s.stage;
+    t.module = Find((uint64_t)s.module, TraceChunk_ShaderModule);
+    strncpy(t.name, s.pName, sizeof t.name - 1);
+    if (s.pSpecializationInfo) {
+        Warn(TraceWarn_Specialization);
+    }
+    return t;
+}
+
+static TraceStencilOp
+StencilOp(const VkStencilOpState& s)
+{
+    return { uint32_t(s.failOp), uint32_t(s.passOp), uint32_t(s.depthFailOp), uint32_t(s.compareOp),
+             s.compareMask, s.writeMask, s.reference };
+}
+
+static void
+RecordGraphicsPipeline(VkPipeline pipeline, const VkGraphicsPipelineCreateInfo& ci)
+{
+    TraceGraphicsPipeline p = { };
+    p.flags = ci.flags;
+    p.layout = Find((uint64_t)ci.layout, TraceChunk_PipelineLayout);
+    p.renderPass = Find((uint64_t)ci.renderPass, TraceChunk_RenderPass);
+    p.subpass = ci.subpass;
+    p.stageCount = ci.stageCount;
+    const VkPipelineVertexInputStateCreateInfo *vi = ci.pVertexInputState;
+    p.bindingCount = vi ? vi->vertexBindingDescriptionCount : 0;
+    p.attributeCount = vi ? vi->vertexAttributeDescriptionCount : 0;
+    if (const VkPipelineInputAssemblyStateCreateInfo *ia = ci.pInputAssemblyState) {
+        p.topology = ia->topology;
+        p.primitiveRestartEnable = ia->primitiveRestartEnable;
+    }
+    if (const VkPipelineRasterizationStateCreateInfo *rs = ci.pRasterizationState) {
+        p.depthClampEnable = rs->depthClampEnable;
+        p.rasterizerDiscardEnable = rs->rasterizerDiscardEnable;
+        p.polygonMode = rs->polygonMode;
+        p.cullMode = rs->cullMode;
+        p.frontFace = rs->frontFace;
+        p.depthBiasEnable = rs->depthBiasEnable;
+        p.depthBiasConstantFactor = rs->depthBiasConstantFactor;
+        p.depthBiasClamp = rs->depthBiasClamp;
+        p.depthBiasSlopeFactor = rs->depthBiasSlopeFactor;
+        p.lineWidth = rs->lineWidth;
+    }
+    p.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    if (const VkPipelineMultisampleStateCreateInfo *ms = ci.pMultisampleState) {
+        p.rasterizationSamples = ms->rasterizationSamples;
+        p.sampleShadingEnable = ms->sampleShadingEnable;
+        p.minSampleShading = ms->minSampleShading;
+        p.alphaToCoverageEnable = ms->alphaToCoverageEnable;
+        p.alphaToOneEnable = ms->alphaToOneEnable;
+    }
+    if (const VkPipelineDepthStencilStateCreateInfo *ds = ci.pDepthStencilState) {
+        p.bDepthStencil = 1;
+        p.depthTestEnable = ds->depthTestEnable;
+        p.depthWriteEnable = ds->depthWriteEnable;
+        p.depthCompareOp = ds->depthCompareOp;
+        p.depthBoundsTestEnable = ds->depthBoundsTestEnable;
+        p.stencilTestEnable = ds->stencilTestEnable;
+        p.front = StencilOp(ds->front);
+        p.back = StencilOp(ds->back);
+        p.minDepthBounds = ds->minDepthBounds;
+        p.maxDepthBounds = ds->maxDepthBounds;
+    }
+    const VkPipelineColorBlendStateCreateInfo *cb = ci.pColorBlendState;
+    if (cb) {
+        p.bColorBlend = 1;
+        p.logicOpEnable = cb->logicOpEnable;
+        p.logicOp = cb->logicOp;
+        p.blendAttachmentCount = cb->attachmentCount;
+        memcpy(p.blendConstants, cb->blendConstants, sizeof p.blendConstants);
+    }
+    bool bDynamicViewport = false, bDynamicScissor = false;
+    if (const VkPipelineDynamicStateCreateInfo *dyn = ci.pDynamicState) {
+        p.dynamicStateCount = dyn->dynamicStateCount;
+        for (uint32_t i = 0; i < dyn->dynamicStateCount; ++i) {
+            bDynamicViewport |= dyn->pDynamicStates[i] == VK_DYNAMIC_STATE_VIEWPORT;
+            bDynamicScissor |= dyn->pDynamicStates[i] == VK_DYNAMIC_STATE_SCISSOR;
+        }
+    }
+    const VkPipelineViewportStateCreateInfo *vp = ci.pViewportState;
+    if (vp) {
+        p.viewportCount = vp->viewportCount;
+        p.scissorCount = vp->scissorCount;
+        p.staticViewportCount = !bDynamicViewport && vp->pViewports ? vp->viewportCount : 0;
+        p.staticScissorCount = !bDynamicScissor && vp->pScissors ? vp->scissorCount : 0;
+    }
+
+    Bytes& b = NewInfo(TraceChunk_GraphicsPipeline, (uint64_t)pipeline);
+    Bytes_Append(b, &p, sizeof p);
+    for (uint32_t i = 0; i < ci.stageCount; ++i) {
+        TraceShaderStage const stage = ShaderStage(ci.pStages[i]);
+        Bytes_Append(b, &stage, sizeof stage);
+    }
+    for (uint32_t i = 0; i < p.bindingCount; ++i) {
+        const VkVertexInputBindingDescription& d = vi->pVertexBindingDescriptions[i];
+        const TraceVertexBinding t = { d.binding, d.stride, uint32_t(d.inputRate) };
+        Bytes_Append(b, &t, sizeof t);
+    }
+    for (uint32_t i = 0; i < p.attributeCount; ++i) {
+        const VkVertexInputAttributeDescription& d = vi->pVertexAttributeDescriptions[i];
+        const TraceVertexAttribute t = { d.location, d.binding, uint32_t(d.format), d.offset };
+        Bytes_Append(b, &t, sizeof t);
+    }
+    for (uint32_t i = 0; i < p.blendAttachmentCount; ++i) {
+        const VkPipelineColorBlendAttachmentState& a = cb->pAttachments[i];
+        const TraceBlendAttachment t = {
+            a.blendEnable, uint32_t(a.srcColorBlendFactor), uint32_t(a.dstColorBlendFactor), uint32_t(a.colorBlendOp),
+            uint32_t(a.srcAlphaBlendFactor), uint32_t(a.dstAlphaBlendFactor), uint32_t(a.alphaBlendOp), a.colorWriteMask
+        };
+        Bytes_Append(b, &t, sizeof t);
+    }
+    /* VkViewport, VkRect2D and VkDynamicState have the layouts of their trace counterparts. */
+    Bytes_Append(b, p.staticViewportCount ? vp->pViewports : nullptr, p.staticViewportCount * sizeof(VkViewport));
+    Bytes_Append(b, p.staticScissorCount ? vp->pScissors : nullptr, p.staticScissorCount * sizeof(VkRect2D));
+    if (p.dynamicStateCount) {
+        Bytes_Append(b, ci.pDynamicState->pDynamicStates, p.dynamicStateCount * sizeof(VkDynamicState));
+    }
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateGraphicsPipelines(VkDevice device, VkPipelineCache cache, uint32_t count,
+                               const VkGraphicsPipelineCreateInfo *pInfos, const VkAllocationCallbacks *pAlloc,
+                               VkPipeline *pPipelines)
+{
+    VkResult const res = ts.next.vkCreateGraphicsPipelines(device, cache, count, pInfos, pAlloc, pPipelines);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pPipelines[i]) {
+            RecordGraphicsPipeline(pPipelines[i], pInfos[i]);
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateComputePipelines(VkDevice device, VkPipelineCache cache, uint32_t count,
+                              const VkComputePipelineCreateInfo *pInfos, const VkAllocationCallbacks *pAlloc,
+                              VkPipeline *pPipelines)
+{
+    VkResult const res = ts.next.vkCreateComputePipelines(device, cache, count, pInfos, pAlloc, pPipelines);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pPipelines[i]) {
+            const TraceComputePipeline p = {
+                pInfos[i].flags, Find((uint64_t)pInfos[i].layout, TraceChunk_PipelineLayout),
+                ShaderStage(pInfos[i].stage)
+            };
+            Bytes_Append(NewInfo(TraceChunk_ComputePipeline, (uint64_t)pPipelines[i]), &p, sizeof p);
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyObject((uint64_t)pipeline, TraceChunk_GraphicsPipeline);
+    ts.next.vkDestroyPipeline(device, pipeline, pAlloc);
+}
+
+//----- Descriptor sets -----
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkAllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo *pInfo, VkDescriptorSet *pSets)
+{
+    VkResult const res = ts.next.vkAllocateDescriptorSets(device, pInfo, pSets);
+    if (res == VK_SUCCESS) {
+        for (uint32_t i = 0; i < pInfo->descriptorSetCount; ++i) {
+            const TraceDescriptorSet s = { Find((uint64_t)pInfo->pSetLayouts[i], TraceChunk_SetLayout) };
+            uint32_t const id = NewObject(TraceChunk_DescriptorSet, (uint64_t)pSets[i]);
+            ts.objects[id].owner = (uint64_t)pInfo->descriptorPool;
+            Bytes_Append(ts.objects[id].info, &s, sizeof s);
+        }
+    }
+    return res;
+}
+
+/* Sets are few, pools are reset or destroyed rarely. */
+static void
+DestroyPoolSets(VkDescriptorPool pool)
+{
+    for (uint32_t id = 0; id < ts.objectCount; ++id) {
+        const TraceObject& o = ts.objects[id];
+        if (o.type == TraceChunk_DescriptorSet && o.handle && o.owner == (uint64_t)pool) {
+            DestroyObject(o.handle, TraceChunk_DescriptorSet);
+        }
+    }
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkFreeDescriptorSets(VkDevice device, VkDescriptorPool pool, uint32_t count, const VkDescriptorSet *pSets)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        DestroyObject((uint64_t)pSets[i], TraceChunk_DescriptorSet);
+    }
+    return ts.next.vkFreeDescriptorSets(device, pool, count, pSets);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkResetDescriptorPool(VkDevice device, VkDescriptorPool pool, VkDescriptorPoolResetFlags flags)
+{
+    DestroyPoolSets(pool);
+    return ts.next.vkResetDescriptorPool(device, pool, flags);
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyDescriptorPool(VkDevice device, VkDescriptorPool pool, const VkAllocationCallbacks *pAlloc)
+{
+    DestroyPoolSets(pool);
+    ts.next.vkDestroyDescriptorPool(device, pool, pAlloc);
+}
+
+static const TraceSetLayoutBinding *
+FindBinding(uint32_t setLayout, uint32_t binding)
+{
+    if (setLayout == TRACE_NO_ID) {
+        return nullptr;
+    }
+    const TraceSetLayout *l = Info<TraceSetLayout>(setLayout);
+    const TraceSetLayoutBinding *b = (const TraceSetLayoutBinding *)(l + 1);
+    for (uint32_t i = 0; i < l->bindingCount; ++i) {
+        if (b[i].binding == binding) {
+            return &b[i];
+        }
+    }
+    return nullptr;
+}
+
+static void
+SetDescriptor(TraceObject& set, const TraceDescriptor& d)
+{
+    TraceDescriptor *a = (TraceDescriptor *)set.data.data;
+    uint32_t const n = uint32_t(set.data.count / sizeof(TraceDescriptor));
+    for (uint32_t i = 0; i < n; ++i) {
+        if (a[i].binding == d.binding && a[i].arrayElement == d.arrayElement) {
+            a[i] = d;
+            return;
+        }
+    }
+    Bytes_Append(set.data, &d, sizeof d);
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkUpdateDescriptorSets(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet *pWrites,
+                            uint32_t copyCount, const VkCopyDescriptorSet *pCopies)
+{
+    ts.next.vkUpdateDescriptorSets(device, writeCount, pWrites, copyCount, pCopies);
+    if (copyCount) {
+        Warn(TraceWarn_DescriptorCopy);
+    }
+    for (uint32_t w = 0; w < writeCount; ++w) {
+        const VkWriteDescriptorSet& write = pWrites[w];
+        uint32_t const setId = Find((uint64_t)write.dstSet, TraceChunk_DescriptorSet);
+        if (setId == TRACE_NO_ID) {
+            continue;
+        }
+        /* A write past the end of a binding carries on into the next one. */
+        uint32_t const setLayout = Info<TraceDescriptorSet>(setId)->setLayout;
+        const TraceSetLayoutBinding *binding = FindBinding(setLayout, write.dstBinding);
+        uint32_t element = write.dstArrayElement;
+        for (uint32_t i = 0; i < write.descriptorCount && binding; ++i, ++element) {
+            while (binding && element >= binding->descriptorCount) {
+                element -= binding->descriptorCount;
+                binding = FindBinding(setLayout, binding->binding + 1);
+            }
+            if (!binding) {
+                break;
+            }
+            TraceDescriptor d = { };
+            d.binding = binding->binding;
+            d.arrayElement = element;
+            d.descriptorType = write.descriptorType;
+            d.object = d.sampler = TRACE_NO_ID;
+            switch (write.descriptorType) {
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                if (write.descriptorType != VK_DESCRIPTOR_TYPE_SAMPLER) {
+                    d.object = Find((uint64_t)write.pImageInfo[i].imageView, TraceChunk_ImageView);
+                    d.imageLayout = write.pImageInfo[i].imageLayout;
+                }
+                if (write.descriptorType <= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER &&
+                    binding->firstImmutableSampler == TRACE_NO_ID) { // else the sampler is ignored
+                    d.sampler = Find((uint64_t)write.pImageInfo[i].sampler, TraceChunk_Sampler);
+                }
+                break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                d.object = Find((uint64_t)write.pBufferInfo[i].buffer, TraceChunk_Buffer);
+                d.offset = write.pBufferInfo[i].offset;
+                d.range = write.pBufferInfo[i].range;
+                break;
+            default:
+                Warn(TraceWarn_TexelBuffer);
+                continue;
+            }
+            SetDescriptor(ts.objects[setId], d);
+        }
+    }
+}
+
+//----- Swapchains -----
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkCreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pInfo, const VkAllocationCallbacks *pAlloc,
+                          VkSwapchainKHR *pSwapchain)
+{
+    VkResult const res = ts.next.vkCreateSwapchainKHR(device, pInfo, pAlloc, pSwapchain);
+    if (res == VK_SUCCESS) {
+        for (TraceSwapchain& s : ts.swapchains) {
+            if (!s.handle) {
+                s = { *pSwapchain, pInfo->flags, pInfo->imageFormat, pInfo->imageExtent, pInfo->imageArrayLayers,
+                      pInfo->imageUsage };
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks *pAlloc)
+{
+    if (swapchain) {
+        for (TraceSwapchain& s : ts.swapchains) {
+            if (s.handle == swapchain) {
+                s = { };
+            }
+        }
+        for (uint32_t id = 0; id < ts.objectCount; ++id) {
+            const TraceObject& o = ts.objects[id];
+            if (o.type == TraceChunk_Image && o.handle && o.owner == (uint64_t)swapchain) {
+                DestroyObject(o.handle, TraceChunk_Image);
+            }
+        }
+    }
+    ts.next.vkDestroySwapchainKHR(device, swapchain, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain, uint32_t *pCount, VkImage *pImages)
+{
+    VkResult const res = ts.next.vkGetSwapchainImagesKHR(device, swapchain, pCount, pImages);
+    const TraceSwapchain *sc = nullptr;
+    for (const TraceSwapchain& s : ts.swapchains) {
+        if (s.handle == swapchain) {
+            sc = &s;
+        }
+    }
+    if (!pImages || !sc || (res != VK_SUCCESS && res != VK_INCOMPLETE)) {
+        return res;
+    }
+    for (uint32_t i = 0; i < *pCount; ++i) {
+        if (Handles_Find((uint64_t)pImages[i], TraceChunk_Image)) {
+            continue; // asked for again
+        }
+        uint32_t const id = NewObject(TraceChunk_Image, (uint64_t)pImages[i]);
+        TraceObject& o = ts.objects[id];
+        o.owner = (uint64_t)swapchain;
+        o.layouts = (uint32_t *)malloc(sizeof(uint32_t));
+        o.layouts[0] = VK_IMAGE_LAYOUT_UNDEFINED;
+        TraceImage *img = (TraceImage *)Bytes_Append(o.info, nullptr, sizeof(TraceImage));
+        img->flags = (sc->flags & VK_SWAPCHAIN_CREATE_MUTABLE_FORMAT_BIT_KHR)
+                   ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT : 0;
+        img->imageType = VK_IMAGE_TYPE_2D;
+        img->format = sc->format;
+        img->width = sc->extent.width;
+        img->height = sc->extent.height;
+        img->depth = 1;
+        img->mipLevels = 1;
+        img->arrayLayers = sc->arrayLayers;
+        img->samples = VK_SAMPLE_COUNT_1_BIT;
+        img->tiling = VK_IMAGE_TILING_OPTIMAL;
+        img->usage = sc->usage;
+        img->memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        img->bSwapchain = 1;
+    }
+    return res;
+}
+
+//----- Command buffers -----
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo *pInfo,
+                              VkCommandBuffer *pCommandBuffers)
+{
+    VkResult const res = ts.next.vkAllocateCommandBuffers(device, pInfo, pCommandBuffers);
+    if (res == VK_SUCCESS) {
+        GrowArray(ts.cmdBuffers, ts.cmdBufferCapacity, ts.cmdBufferCount + pInfo->commandBufferCount);
+        for (uint32_t i = 0; i < pInfo->commandBufferCount; ++i) {
+            ts.cmdBuffers[ts.cmdBufferCount++] = { pCommandBuffers[i], pInfo->commandPool };
+        }
+    }
+    return res;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkFreeCommandBuffers(VkDevice device, VkCommandPool pool, uint32_t count, const VkCommandBuffer *pCommandBuffers)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        if (TraceCmdBuffer *cb = FindCmdBuffer(pCommandBuffers[i])) {
+            RemoveCmdBuffer(uint32_t(cb - ts.cmdBuffers));
+        }
+    }
+    ts.next.vkFreeCommandBuffers(device, pool, count, pCommandBuffers);
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkDestroyCommandPool(VkDevice device, VkCommandPool pool, const VkAllocationCallbacks *pAlloc)
+{
+    for (uint32_t i = ts.cmdBufferCount; i--;) {
+        if (ts.cmdBuffers[i].pool == pool) {
+            RemoveCmdBuffer(i);
+        }
+    }
+    ts.next.vkDestroyCommandPool(device, pool, pAlloc);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkBeginCommandBuffer(VkCommandBuffer cmd, const VkCommandBufferBeginInfo *pInfo)
+{
+    if (TraceCmdBuffer *cb = FindCmdBuffer(cmd)) {
+        cb->bRecording = ts.bArmed;
+        cb->stream.count = 0;
+        cb->layouts.count = 0;
+    }
+    return ts.next.vkBeginCommandBuffer(cmd, pInfo);
+}
+
+static void
+AddLayoutChange(TraceCmdBuffer& cb, uint32_t image, uint32_t baseMip, uint32_t mipCount, VkImageLayout layout)
+{
+    if (image != TRACE_NO_ID) {
+        const TraceLayoutChange c = { image, baseMip, mipCount, uint32_t(layout) };
+        Bytes_Append(cb.layouts, &c, sizeof c);
+    }
+}
+
+static void
+ApplyLayoutChanges(TraceCmdBuffer& cb)
+{
+    const TraceLayoutChange *c = (const TraceLayoutChange *)cb.layouts.data;
+    for (size_t i = 0, n = cb.layouts.count / sizeof *c; i < n; ++i) {
+        TraceObject& o = ts.objects[c[i].image];
+        uint32_t const mipLevels = ((const TraceImage *)o.info.data)->mipLevels;
+        uint32_t const end = c[i].mipCount == VK_REMAINING_MIP_LEVELS ? mipLevels
+                                                                      : Min(c[i].baseMip + c[i].mipCount, mipLevels);
+        for (uint32_t m = c[i].baseMip; m < end; ++m) {
+            o.layouts[m] = c[i].layout;
+        }
+    }
+    cb.layouts.count = 0;
+}
+
+//----- Capture: what's needed, reading it back, writing the file -----
+
+static void
+MarkRefs(uint32_t id)
+{
+    const TraceObject& o = ts.objects[id];
+    switch (o.type) {
+    case TraceChunk_ImageView:
+        Mark(Info<TraceImageView>(id)->image);
+        break;
+    case TraceChunk_SetLayout: {
+        const TraceSetLayout *l = Info<TraceSetLayout>(id);
+        const uint32_t *samplers = (const uint32_t *)((const TraceSetLayoutBinding *)(l + 1) + l->bindingCount);
+        for (uint32_t i = 0; i < l->immutableSamplerCount; ++i) {
+            Mark(samplers[i]);
+        }
+    } break;
+    case TraceChunk_PipelineLayout: {
+        const TracePipelineLayout *l = Info<TracePipelineLayout>(id);
+        for (uint32_t i = 0; i < l->setLayoutCount; ++i) {
+            Mark(((const uint32_t *)(l + 1))[i]);
+        }
+    } break;
+    case TraceChunk_Framebuffer: {
+        const TraceFramebuffer *f = Info<TraceFramebuffer>(id);
+        Mark(f->renderPass);
+        for (uint32_t i = 0; i < f->attachmentCount; ++i) {
+            Mark(((const uint32_t *)(f + 1))[i]);
+        }
+    } break;
+    case TraceChunk_GraphicsPipeline: {
+        const TraceGraphicsPipeline *p = Info<TraceGraphicsPipeline>(id);
+        Mark(p->layout);
+        Mark(p->renderPass);
+        for (uint32_t i = 0; i < p->stageCount; ++i) {
+            Mark(((const TraceShaderStage *)(p + 1))[i].module);
+        }
+    } break;
+    case TraceChunk_ComputePipeline:
+        Mark(Info<TraceComputePipeline>(id)->layout);
+        Mark(Info<TraceComputePipeline>(id)->stage.module);
+        break;
+    case TraceChunk_DescriptorSet: {
+        Mark(Info<TraceDescriptorSet>(id)->setLayout);
+        const TraceDescriptor *d = (const TraceDescriptor *)o.data.data;
+        for (size_t i = 0, n = o.data.count / sizeof *d; i < n; ++i) {
+            Mark(d[i].object);
+            Mark(d[i].sampler);
+        }
+    } break;
+    }
+}
+
+struct TraceReadback {
+    uint32_t id;
+    uint32_t mip; // UINT32_MAX for a buffer
+    VkDeviceSize offset; // in the readback buffer
+    VkDeviceSize size;
+};
+
+/*  Reads back what the frame's commands use that hasn't been yet. The queue is drained first, so the contents are
+    those the frame starts with. Images get their TraceImageLevel array here, with or without contents.
+*/
+static void
+Snapshot(VkQueue queue)
+{
+    VK_CHECK(ts.next.vkQueueWaitIdle(queue));
+
+    /* Only descriptor sets refer to objects created after them, everything else refers back. */
+    for (uint32_t id = 0; id < ts.objectCount; ++id) {
+        if (ts.objects[id].bNeeded && ts.objects[id].type == TraceChunk_DescriptorSet) {
+            MarkRefs(id);
+        }
+    }
+    for (uint32_t id = ts.objectCount; id--;) {
+        if (ts.objects[id].bNeeded && ts.objects[id].type != TraceChunk_DescriptorSet) {
+            MarkRefs(id);
+        }
+    }
+
+    Bytes readbacks = { };
+    VkDeviceSize total = 0;
+    for (uint32_t id = 0; id < ts.objectCount; ++id) {
+        TraceObject& o = ts.objects[id];
+        if (!o.bNeeded || o.bTaken || (o.type != TraceChunk_Buffer && o.type != TraceChunk_Image)) {
+            continue;
+        }
+        o.bTaken = true;
+        if (o.type == TraceChunk_Buffer) {
+            VkDeviceSize const size = Info<TraceBuffer>(id)->size;
+            const TraceMemory *m = o.memory != UINT32_MAX ? &ts.memories[o.memory] : nullptr;
+            if (!m || !o.handle) {
+                continue;
+            }
+            if (m->pMapped) {
+                Bytes_Append(o.data, m->pMapped + o.memoryOffset, size_t(size));
+            } else {
+                const TraceReadback r = { id, UINT32_MAX, total, size };
+                Bytes_Append(readbacks, &r, sizeof r);
+                total += (size + 15) & ~VkDeviceSize(15);
+            }
+            continue;
+        }
+        const TraceImage img = *Info<TraceImage>(id);
+        Bytes_Append(o.data, nullptr, img.mipLevels * sizeof(TraceImageLevel));
+        VkDeviceSize dataOffset = 0;
+        for (uint32_t m = 0; m < img.mipLevels; ++m) {
+            TraceImageLevel& level = ((TraceImageLevel *)o.data.data)[m];
+            level.layout = o.layouts[m];
+            bool const bDefined = level.layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+                                  level.layout != VK_IMAGE_LAYOUT_PREINITIALIZED;
+            if (!o.bCopyable || !o.handle || o.memory == UINT32_MAX || !bDefined) {
+                continue;
+            }
+            uint32_t blockSize;
+            uint32_t const blockBytes = FormatBlockBytes(VkFormat(img.format), &blockSize);
+            /* Buffer offsets of image copies are multiples of 4 and of the block size. */
+            VkDeviceSize const align = blockBytes % 4 == 0 ? blockBytes : blockBytes % 2 == 0 ? blockBytes * 2
+                                                                                            : blockBytes * 4;
+            total = (total + align - 1) / align * align;
+            level.dataOffset = dataOffset;
+            level.dataSize = LevelBytes(img, m);
+            dataOffset += level.dataSize;
+            const TraceReadback r = { id, m, total, level.dataSize };
+            Bytes_Append(readbacks, &r, sizeof r);
+            total += level.dataSize;
+        }
+    }
+
+    uint32_t const readbackCount = uint32_t(readbacks.count / sizeof(TraceReadback));
+    if (readbackCount) {
+        const TraceReadback *r = (const TraceReadback *)readbacks.data;
+        VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = total;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        VkBuffer buffer = nullptr;
+        VkDeviceMemory memory = nullptr;
+        void *pMapped = nullptr;
+        VkResult res = ts.next.vkCreateBuffer(ts.device, &bufferInfo, nullptr, &buffer);
+        if (res == VK_SUCCESS) {
+            VkMemoryRequirements req;
+            ts.next.vkGetBufferMemoryRequirements(ts.device, buffer, &req);
+            VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+            allocInfo.allocationSize = req.size;
+            allocInfo.memoryTypeIndex = VKH_FindMemoryType(ts.memoryProps, req.memoryTypeBits,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            res = allocInfo.memoryTypeIndex == UINT32_MAX ? VK_ERROR_FEATURE_NOT_PRESENT
+                : ts.next.vkAllocateMemory(ts.device, &allocInfo, nullptr, &memory);
+        }
+        if (res == VK_SUCCESS) res = ts.next.vkBindBufferMemory(ts.device, buffer, memory, 0);
+        if (res == VK_SUCCESS) res = ts.next.vkMapMemory(ts.device, memory, 0, VK_WHOLE_SIZE, 0, &pMapped);
+
+        if (res == VK_SUCCESS) {
+            VkCommandBuffer const cmd = ts.commandBuffer;
+            VK_CHECK(ts.next.vkResetCommandPool(ts.device, ts.commandPool, 0));
+            VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            VK_CHECK(ts.next.vkBeginCommandBuffer(cmd, &beginInfo));
+
+            /* The queue is idle, the barriers only change layouts, and are undone after the copies. */
+            Bytes barriers = { };
+            for (uint32_t i = 0; i < readbackCount; ++i) {
+                if (r[i].mip == UINT32_MAX) {
+                    continue;
+                }
+                VkImageMemoryBarrier ib = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+                ib.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+                ib.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                ib.oldLayout = VkImageLayout(((const TraceImageLevel *)ts.objects[r[i].id].data.data)[r[i].mip].layout);
+                ib.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                ib.image = (VkImage)ts.objects[r[i].id].handle;
+                ib.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, r[i].mip, 1, 0, VK_REMAINING_ARRAY_LAYERS };
+                Bytes_Append(barriers, &ib, sizeof ib);
+            }
+            VkImageMemoryBarrier *ib = (VkImageMemoryBarrier *)barriers.data;
+            uint32_t const barrierCount = uint32_t(barriers.count / sizeof *ib);
+            if (barrierCount) {
+                ts.next.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                             0, nullptr, 0, nullptr, barrierCount, ib);
+            }
+            for (uint32_t i = 0; i < readbackCount; ++i) {
+                const TraceObject& o = ts.objects[r[i].id];
+                if (r[i].mip == UINT32_MAX) {
+                    const VkBufferCopy region = { 0, r[i].offset, r[i].size };
+                    ts.next.vkCmdCopyBuffer(cmd, (VkBuffer)o.handle, buffer, 1, &region);
+                    continue;
+                }
+                const TraceImage *img = (const TraceImage *)o.info.data;
+                uint32_t const mip = r[i].mip;
+                VkBufferImageCopy region = { };
+                region.bufferOffset = r[i].offset;
+                region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, img->arrayLayers };
+                region.imageExtent = {
+                    Max(img->width >> mip, 1u), Max(img->height >> mip, 1u), Max(img->depth >> mip, 1u)
+                };
+                ts.next.vkCmdCopyImageToBuffer(cmd, (VkImage)o.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer,
+                                               1, &region);
+            }
+            for (uint32_t i = 0; i < barrierCount; ++i) {
+                ib[i].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                ib[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                ib[i].newLayout = ib[i].oldLayout;
+                ib[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            }
+            if (barrierCount) {
+                ts.next.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                                             0, nullptr, 0, nullptr, barrierCount, ib);
+            }
+            Bytes_Free(barriers);
+
+            VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            mb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            ts.next.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                                         1, &mb, 0, nullptr, 0, nullptr);
+            VK_CHECK(ts.next.vkEndCommandBuffer(cmd));
+            VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &cmd;
+            VK_CHECK(ts.next.vkQueueSubmit(queue, 1, &submitInfo, nullptr));
+            VK_CHECK(ts.next.vkQueueWaitIdle(queue));
+
+            for (uint32_t i = 0; i < readbackCount; ++i) {
+                TraceObject& o = ts.objects[r[i].id];
+                // An image's levels are in order, after its TraceImageLevel array.
+                Bytes_Append(o.data, (const uint8_t *)pMapped + r[i].offset, size_t(r[i].size));
+            }
+        } else {
+            printf("trace: couldn't make a %llu byte readback buffer, buffer and image contents are missing\n",
+                   (unsigned long long)total);
+            for (uint32_t i = 0; i < readbackCount; ++i) {
+                if (r[i].mip != UINT32_MAX) {
+                    ((TraceImageLevel *)ts.objects[r[i].id].data.data)[r[i].mip].dataSize = 0;
+                }
+            }
+        }
+        ts.next.vkDestroyBuffer(ts.device, buffer, nullptr);
+        ts.next.vkFreeMemory(ts.device, memory, nullptr);
+    }
+    Bytes_Free(readbacks);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits, VkFence fence)
+{
+    if (ts.bArmed) {
+        bool bCaptured = false;
+        for (uint32_t s = 0; s < submitCount; ++s) {
+            for (uint32_t i = 0; i < pSubmits[s].commandBufferCount; ++i) {
+                const TraceCmdBuffer *cb = FindCmdBuffer(pSubmits[s].pCommandBuffers[i]);
+                bCaptured |= cb && cb->bRecording;
+            }
+        }
+        if (bCaptured) {
+            Snapshot(queue);
+        }
+    }
+    /* Layouts change when the commands run, which is after every earlier submit's. */
+    for (uint32_t s = 0; s < submitCount; ++s) {
+        for (uint32_t i = 0; i < pSubmits[s].commandBufferCount; ++i) {
+            TraceCmdBuffer *cb = FindCmdBuffer(pSubmits[s].pCommandBuffers[i]);
+            if (!cb) {
+                continue;
+            }
+            ApplyLayoutChanges(*cb);
+            if (cb->bRecording && ts.bArmed) {
+                const TraceChunkHeader h = { TraceChunk_CommandBuffer, TRACE_NO_ID, cb->stream.count };
+                Bytes_Append(ts.submitted, &h, sizeof h);
+                Bytes_Append(ts.submitted, cb->stream.data, cb->stream.count);
+                ++ts.submittedCount;
+            }
+            cb->bRecording = false;
+        }
+    }
+    return ts.next.vkQueueSubmit(queue, submitCount, pSubmits, fence);
+}
+
+static bool
+WriteChunk(FILE *f, uint32_t type, uint32_t id, const Bytes& a, const Bytes& b)
+{
+    static const uint8_t Zeros[TRACEFILE_ALIGN] = { };
+    uint64_t const size = a.count + b.count;
+    const TraceChunkHeader h = { type, id, size };
+    return fwrite(&h, sizeof h, 1, f) == 1 &&
+           fwrite(a.data, 1, a.count, f) == a.count &&
+           fwrite(b.data, 1, b.count, f) == b.count &&
+           fwrite(Zeros, 1, size_t(TraceFile_AlignUp(size) - size), f) == TraceFile_AlignUp(size) - size;
+}
+
+static void
+WriteTrace()
+{
+    FILE *f = fopen(ts.path, "wb");
+    if (!f) {
+        printf("trace: can't write %s\n", ts.path);
+        return;
+    }
+    TraceFileHeader h = { TRACEFILE_MAGIC, TRACEFILE_VERSION, ts.objectCount };
+    h.commandBufferCount = ts.submittedCount;
+    h.frameIndex = ts.frameIndex;
+    for (const TraceSwapchain& s : ts.swapchains) {
+        if (s.handle) {
+            h.width = s.extent.width;
+            h.height = s.extent.height;
+        }
+    }
+    for (uint32_t id = 0; id < ts.objectCount; ++id) {
+        h.objectCount += ts.objects[id].bNeeded;
+    }
+    bool bOk = fwrite(&h, sizeof h, 1, f) == 1;
+
+    /* Descriptor sets last, they can refer to objects created after them. */
+    uint64_t dataBytes = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint32_t id = 0; id < ts.objectCount && bOk; ++id) {
+            TraceObject& o = ts.objects[id];
+            if (!o.bNeeded || (o.type == TraceChunk_DescriptorSet) != (pass == 1)) {
+                continue;
+            }
+            if (o.type == TraceChunk_Buffer) {
+                Info<TraceBuffer>(id)->dataSize = o.data.count;
+            } else if (o.type == TraceChunk_DescriptorSet) {
+                Info<TraceDescriptorSet>(id)->descriptorCount = uint32_t(o.data.count / sizeof(TraceDescriptor));
+            }
+            if (o.type == TraceChunk_Buffer || o.type == TraceChunk_Image) {
+                dataBytes += o.data.count;
+            }
+            bOk = WriteChunk(f, o.type, id, o.info, o.data);
+        }
+    }
+    bOk = bOk && fwrite(ts.submitted.data, 1, ts.submitted.count, f) == ts.submitted.count;
+    bOk = (fclose(f) == 0) && bOk;
+    if (bOk) {
+        printf("trace: frame %u to %s, %u of %u objects, %u command buffers, %.1f MiB of contents\n", ts.frameIndex,
+               ts.path, h.objectCount, ts.objectCount, ts.submittedCount, double(dataBytes) / (1 << 20));
+    } else {
+        printf("trace: writing %s failed\n", ts.path);
+    }
+}
+
+//----- Commands -----
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdBeginRenderPass(VkCommandBuffer cmd, const VkRenderPassBeginInfo *pInfo, VkSubpassContents contents)
+{
+    ts.next.vkCmdBeginRenderPass(cmd, pInfo, contents);
+    TraceCmdBuffer *cb = FindCmdBuffer(cmd);
+    if (!cb) {
+        return;
+    }
+    uint32_t const renderPass = Find((uint64_t)pInfo->renderPass, TraceChunk_RenderPass);
+    uint32_t const framebuffer = Find((uint64_t)pInfo->framebuffer, TraceChunk_Framebuffer);
+    /* The attachments end up in their final layouts. */
+    if (renderPass != TRACE_NO_ID && framebuffer != TRACE_NO_ID) {
+        const TraceRenderPass *rp = Info<TraceRenderPass>(renderPass);
+        const TraceAttachment *attachments = (const TraceAttachment *)(rp + 1);
+        const TraceFramebuffer *fb = Info<TraceFramebuffer>(framebuffer);
+        const uint32_t *views = (const uint32_t *)(fb + 1);
+        for (uint32_t i = 0; i < Min(rp->attachmentCount, fb->attachmentCount); ++i) {
+            if (views[i] != TRACE_NO_ID) {
+                const TraceImageView *v = Info<TraceImageView>(views[i]);
+                AddLayoutChange(*cb, v->image, v->baseMip, v->mipCount, VkImageLayout(attachments[i].finalLayout));
+            }
+        }
+    }
+    if (cb->bRecording && ts.bArmed) {
+        Mark(renderPass);
+        Mark(framebuffer);
+        TraceCmdBeginRenderPass *p = (TraceCmdBeginRenderPass *)Cmd(*cb, TraceCmd_BeginRenderPass,
+            sizeof(TraceCmdBeginRenderPass) + pInfo->clearValueCount * sizeof(VkClearValue));
+        p->renderPass = renderPass;
+        p->framebuffer = framebuffer;
+        p->renderArea = { pInfo->renderArea.offset.x, pInfo->renderArea.offset.y,
+                          pInfo->renderArea.extent.width, pInfo->renderArea.extent.height };
+        p->contents = contents;
+        p->clearValueCount = pInfo->clearValueCount;
+        memcpy(p + 1, pInfo->pClearValues, pInfo->clearValueCount * sizeof(VkClearValue));
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdEndRenderPass(VkCommandBuffer cmd)
+{
+    ts.next.vkCmdEndRenderPass(cmd);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        Cmd(*cb, TraceCmd_EndRenderPass, 0);
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdBindPipeline(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+{
+    ts.next.vkCmdBindPipeline(cmd, bindPoint, pipeline);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const id = Use((uint64_t)pipeline, TraceChunk_GraphicsPipeline);
+        TraceCmdBindPipeline *p = (TraceCmdBindPipeline *)Cmd(*cb, TraceCmd_BindPipeline, sizeof *p);
+        p->bindPoint = bindPoint;
+        p->pipeline = id;
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdBindDescriptorSets(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                             uint32_t firstSet, uint32_t setCount, const VkDescriptorSet *pSets,
+                             uint32_t dynamicOffsetCount, const uint32_t *pDynamicOffsets)
+{
+    ts.next.vkCmdBindDescriptorSets(cmd, bindPoint, layout, firstSet, setCount, pSets, dynamicOffsetCount,
+                                    pDynamicOffsets);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const layoutId = Use((uint64_t)layout, TraceChunk_PipelineLayout);
+        TraceCmdBindDescriptorSets *p = (TraceCmdBindDescriptorSets *)Cmd(*cb, TraceCmd_BindDescriptorSets,
+            sizeof *p + (setCount + dynamicOffsetCount) * sizeof(uint32_t));
+        *p = { uint32_t(bindPoint), layoutId, firstSet, setCount, dynamicOffsetCount };
+        uint32_t *ids = (uint32_t *)(p + 1);
+        for (uint32_t i = 0; i < setCount; ++i) {
+            ids[i] = Use((uint64_t)pSets[i], TraceChunk_DescriptorSet);
+        }
+        memcpy(ids + setCount, pDynamicOffsets, dynamicOffsetCount * sizeof(uint32_t));
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdPushConstants(VkCommandBuffer cmd, VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset,
+                        uint32_t size, const void *pValues)
+{
+    ts.next.vkCmdPushConstants(cmd, layout, stages, offset, size, pValues);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const layoutId = Use((uint64_t)layout, TraceChunk_PipelineLayout);
+        TraceCmdPushConstants *p = (TraceCmdPushConstants *)Cmd(*cb, TraceCmd_PushConstants, sizeof *p + size);
+        *p = { layoutId, stages, offset, size };
+        memcpy(p + 1, pValues, size);
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdSetViewport(VkCommandBuffer cmd, uint32_t first, uint32_t count, const VkViewport *pViewports)
+{
+    ts.next.vkCmdSetViewport(cmd, first, count, pViewports);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        TraceCmdSetViewport *p = (TraceCmdSetViewport *)Cmd(*cb, TraceCmd_SetViewport,
+                                                            sizeof *p + count * sizeof(TraceViewport));
+        *p = { first, count };
+        memcpy(p + 1, pViewports, count * sizeof(TraceViewport));
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdSetScissor(VkCommandBuffer cmd, uint32_t first, uint32_t count, const VkRect2D *pScissors)
+{
+    ts.next.vkCmdSetScissor(cmd, first, count, pScissors);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        TraceCmdSetScissor *p = (TraceCmdSetScissor *)Cmd(*cb, TraceCmd_SetScissor,
+                                                          sizeof *p + count * sizeof(TraceRect));
+        *p = { first, count };
+        memcpy(p + 1, pScissors, count * sizeof(TraceRect));
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdBindVertexBuffers(VkCommandBuffer cmd, uint32_t first, uint32_t count, const VkBuffer *pBuffers,
+                            const VkDeviceSize *pOffsets)
+{
+    ts.next.vkCmdBindVertexBuffers(cmd, first, count, pBuffers, pOffsets);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        TraceCmdBindVertexBuffers *p = (TraceCmdBindVertexBuffers *)Cmd(*cb, TraceCmd_BindVertexBuffers,
+            sizeof *p + count * sizeof(TraceVertexBufferBinding));
+        *p = { first, count };
+        TraceVertexBufferBinding *bindings = (TraceVertexBufferBinding *)(p + 1);
+        for (uint32_t i = 0; i < count; ++i) {
+            bindings[i] = { Use((uint64_t)pBuffers[i], TraceChunk_Buffer), 0, pOffsets[i] };
+        }
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdBindIndexBuffer(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    ts.next.vkCmdBindIndexBuffer(cmd, buffer, offset, indexType);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const id = Use((uint64_t)buffer, TraceChunk_Buffer);
+        *(TraceCmdBindIndexBuffer *)Cmd(*cb, TraceCmd_BindIndexBuffer, sizeof(TraceCmdBindIndexBuffer)) = {
+            id, uint32_t(indexType), offset
+        };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdDraw(VkCommandBuffer cmd, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+               uint32_t firstInstance)
+{
+    ts.next.vkCmdDraw(cmd, vertexCount, instanceCount, firstVertex, firstInstance);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        *(TraceCmdDraw *)Cmd(*cb, TraceCmd_Draw, sizeof(TraceCmdDraw)) = {
+            vertexCount, instanceCount, firstVertex, firstInstance
+        };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdDrawIndexed(VkCommandBuffer cmd, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+                      int32_t vertexOffset, uint32_t firstInstance)
+{
+    ts.next.vkCmdDrawIndexed(cmd, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        *(TraceCmdDrawIndexed *)Cmd(*cb, TraceCmd_DrawIndexed, sizeof(TraceCmdDrawIndexed)) = {
+            indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+        };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdDrawIndirect(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+                       uint32_t stride)
+{
+    ts.next.vkCmdDrawIndirect(cmd, buffer, offset, drawCount, stride);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const id = Use((uint64_t)buffer, TraceChunk_Buffer);
+        *(TraceCmdDrawIndirect *)Cmd(*cb, TraceCmd_DrawIndirect, sizeof(TraceCmdDrawIndirect)) = {
+            id, drawCount, offset, stride
+        };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdDispatch(VkCommandBuffer cmd, uint32_t x, uint32_t y, uint32_t z)
+{
+    ts.next.vkCmdDispatch(cmd, x, y, z);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        *(TraceCmdDispatch *)Cmd(*cb, TraceCmd_Dispatch, sizeof(TraceCmdDispatch)) = { x, y, z };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdPipelineBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+                          VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount,
+                          const VkMemoryBarrier *pMemoryBarriers, uint32_t bufferBarrierCount,
+                          const VkBufferMemoryBarrier *pBufferBarriers, uint32_t imageBarrierCount,
+                          const VkImageMemoryBarrier *pImageBarriers)
+{
+    ts.next.vkCmdPipelineBarrier(cmd, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, pMemoryBarriers,
+                                 bufferBarrierCount, pBufferBarriers, imageBarrierCount, pImageBarriers);
+    TraceCmdBuffer *cb = FindCmdBuffer(cmd);
+    if (!cb) {
+        return;
+    }
+    for (uint32_t i = 0; i < imageBarrierCount; ++i) {
+        const VkImageMemoryBarrier& b = pImageBarriers[i];
+        AddLayoutChange(*cb, Find((uint64_t)b.image, TraceChunk_Image), b.subresourceRange.baseMipLevel,
+                        b.subresourceRange.levelCount, b.newLayout);
+    }
+    if (!cb->bRecording || !ts.bArmed) {
+        return;
+    }
+    TraceCmdPipelineBarrier *p = (TraceCmdPipelineBarrier *)Cmd(*cb, TraceCmd_PipelineBarrier,
+        sizeof *p + memoryBarrierCount * sizeof(TraceMemoryBarrier) + bufferBarrierCount * sizeof(TraceBufferBarrier) +
+        imageBarrierCount * sizeof(TraceImageBarrier));
+    *p = { srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, bufferBarrierCount, imageBarrierCount };
+    TraceMemoryBarrier *mb = (TraceMemoryBarrier *)(p + 1);
+    for (uint32_t i = 0; i < memoryBarrierCount; ++i) {
+        mb[i] = { pMemoryBarriers[i].srcAccessMask, pMemoryBarriers[i].dstAccessMask };
+    }
+    TraceBufferBarrier *bb = (TraceBufferBarrier *)(mb + memoryBarrierCount);
+    for (uint32_t i = 0; i < bufferBarrierCount; ++i) {
+        const VkBufferMemoryBarrier& b = pBufferBarriers[i];
+        bb[i] = { b.srcAccessMask, b.dstAccessMask, b.srcQueueFamilyIndex, b.dstQueueFamilyIndex,
+                  Use((uint64_t)b.buffer, TraceChunk_Buffer), 0, b.offset, b.size };
+    }
+    TraceImageBarrier *ib = (TraceImageBarrier *)(bb + bufferBarrierCount);
+    for (uint32_t i = 0; i < imageBarrierCount; ++i) {
+        const VkImageMemoryBarrier& b = pImageBarriers[i];
+        const VkImageSubresourceRange& r = b.subresourceRange;
+        ib[i] = { b.srcAccessMask, b.dstAccessMask, uint32_t(b.oldLayout), uint32_t(b.newLayout),
+                  b.srcQueueFamilyIndex, b.dstQueueFamilyIndex, Use((uint64_t)b.image, TraceChunk_Image),
+                  { r.aspectMask, r.baseMipLevel, r.levelCount, r.baseArrayLayer, r.layerCount } };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdCopyBuffer(VkCommandBuffer cmd, VkBuffer src, VkBuffer dst, uint32_t regionCount,
+                     const VkBufferCopy *pRegions)
+{
+    ts.next.vkCmdCopyBuffer(cmd, src, dst, regionCount, pRegions);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const srcId = Use((uint64_t)src, TraceChunk_Buffer), dstId = Use((uint64_t)dst, TraceChunk_Buffer);
+        TraceCmdCopyBuffer *p = (TraceCmdCopyBuffer *)Cmd(*cb, TraceCmd_CopyBuffer,
+                                                          sizeof *p + regionCount * sizeof(TraceBufferCopy));
+        *p = { srcId, dstId, regionCount };
+        memcpy(p + 1, pRegions, regionCount * sizeof(TraceBufferCopy)); // the same three VkDeviceSize
+    }
+}
+
+static void
+RecordBufferImageCopy(TraceCmdBuffer& cb, uint32_t type, VkBuffer buffer, VkImage image, VkImageLayout layout,
+                      uint32_t regionCount, const VkBufferImageCopy *pRegions)
+{
+    uint32_t const bufferId = Use((uint64_t)buffer, TraceChunk_Buffer);
+    uint32_t const imageId = Use((uint64_t)image, TraceChunk_Image);
+    TraceCmdBufferImageCopy *p = (TraceCmdBufferImageCopy *)Cmd(cb, type,
+        sizeof *p + regionCount * sizeof(TraceBufferImageCopy));
+    *p = { bufferId, imageId, uint32_t(layout), regionCount };
+    TraceBufferImageCopy *regions = (TraceBufferImageCopy *)(p + 1);
+    for (uint32_t i = 0; i < regionCount; ++i) {
+        const VkBufferImageCopy& r = pRegions[i];
+        regions[i] = {
+            r.bufferOffset, r.bufferRowLength, r.bufferImageHeight,
+            { r.imageSubresource.aspectMask, r.imageSubresource.mipLevel, r.imageSubresource.baseArrayLayer,
+              r.imageSubresource.layerCount },
+            { r.imageOffset.x, r.imageOffset.y, r.imageOffset.z },
+            { r.imageExtent.width, r.imageExtent.height, r.imageExtent.depth }
+        };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdCopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, VkImageLayout layout,
+                            uint32_t regionCount, const VkBufferImageCopy *pRegions)
+{
+    ts.next.vkCmdCopyBufferToImage(cmd, buffer, image, layout, regionCount, pRegions);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        RecordBufferImageCopy(*cb, TraceCmd_CopyBufferToImage, buffer, image, layout, regionCount, pRegions);
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdCopyImageToBuffer(VkCommandBuffer cmd, VkImage image, VkImageLayout layout, VkBuffer buffer,
+                            uint32_t regionCount, const VkBufferImageCopy *pRegions)
+{
+    ts.next.vkCmdCopyImageToBuffer(cmd, image, layout, buffer, regionCount, pRegions);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        RecordBufferImageCopy(*cb, TraceCmd_CopyImageToBuffer, buffer, image, layout, regionCount, pRegions);
+    }
+}
+
+static TraceSubresourceLayers
+Layers(const VkImageSubresourceLayers& l)
+{
+    return { l.aspectMask, l.mipLevel, l.baseArrayLayer, l.layerCount };
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdCopyImage(VkCommandBuffer cmd, VkImage src, VkImageLayout srcLayout, VkImage dst, VkImageLayout dstLayout,
+                    uint32_t regionCount, const VkImageCopy *pRegions)
+{
+    ts.next.vkCmdCopyImage(cmd, src, srcLayout, dst, dstLayout, regionCount, pRegions);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const srcId = Use((uint64_t)src, TraceChunk_Image), dstId = Use((uint64_t)dst, TraceChunk_Image);
+        TraceCmdImageCopy *p = (TraceCmdImageCopy *)Cmd(*cb, TraceCmd_CopyImage,
+                                                        sizeof *p + regionCount * sizeof(TraceImageCopy));
+        *p = { srcId, uint32_t(srcLayout), dstId, uint32_t(dstLayout), regionCount };
+        TraceImageCopy *regions = (TraceImageCopy *)(p + 1);
+        for (uint32_t i = 0; i < regionCount; ++i) {
+            const VkImageCopy& r = pRegions[i];
+            regions[i] = {
+                Layers(r.srcSubresource), { r.srcOffset.x, r.srcOffset.y, r.srcOffset.z },
+                Layers(r.dstSubresource), { r.dstOffset.x, r.dstOffset.y, r.dstOffset.z },
+                { r.extent.width, r.extent.height, r.extent.depth }
+            };
+        }
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdBlitImage(VkCommandBuffer cmd, VkImage src, VkImageLayout srcLayout, VkImage dst, VkImageLayout dstLayout,
+                    uint32_t regionCount, const VkImageBlit *pRegions, VkFilter filter)
+{
+    ts.next.vkCmdBlitImage(cmd, src, srcLayout, dst, dstLayout, regionCount, pRegions, filter);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const srcId = Use((uint64_t)src, TraceChunk_Image), dstId = Use((uint64_t)dst, TraceChunk_Image);
+        TraceCmdImageCopy *p = (TraceCmdImageCopy *)Cmd(*cb, TraceCmd_BlitImage,
+                                                        sizeof *p + regionCount * sizeof(TraceImageBlit));
+        *p = { srcId, uint32_t(srcLayout), dstId, uint32_t(dstLayout), regionCount, uint32_t(filter) };
+        TraceImageBlit *regions = (TraceImageBlit *)(p + 1);
+        for (uint32_t i = 0; i < regionCount; ++i) {
+            const VkImageBlit& r = pRegions[i];
+            regions[i].srcSubresource = Layers(r.srcSubresource);
+            regions[i].dstSubresource = Layers(r.dstSubresource);
+            memcpy(regions[i].srcOffsets, r.srcOffsets, sizeof r.srcOffsets); // VkOffset3D is three int32_t
+            memcpy(regions[i].dstOffsets, r.dstOffsets, sizeof r.dstOffsets);
+        }
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdFillBuffer(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data)
+{
+    ts.next.vkCmdFillBuffer(cmd, buffer, offset, size, data);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const id = Use((uint64_t)buffer, TraceChunk_Buffer);
+        *(TraceCmdFillBuffer *)Cmd(*cb, TraceCmd_FillBuffer, sizeof(TraceCmdFillBuffer)) = { id, data, offset, size };
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdUpdateBuffer(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                       const void *pData)
+{
+    ts.next.vkCmdUpdateBuffer(cmd, buffer, offset, size, pData);
+    if (TraceCmdBuffer *cb = Recording(cmd)) {
+        uint32_t const id = Use((uint64_t)buffer, TraceChunk_Buffer);
+        TraceCmdUpdateBuffer *p = (TraceCmdUpdateBuffer *)Cmd(*cb, TraceCmd_UpdateBuffer, sizeof *p + size_t(size));
+        *p = { id, 0, offset, size };
+        memcpy(p + 1, pData, size_t(size));
+    }
+}
+
+//----- API -----
+
+bool
+Trace_Install(const VulkanRenderer& vkr, const char *path)
+{
+    if (FILE *f = fopen(path, "wb")) {
+        fclose(f);
+    } else {
+        printf("trace: can't write %s\n", path);
+        return false;
+    }
+    ts = { };
+    ts.device = vkr.device;
+    ts.physicalDevice = vkr.physicalDevice;
+    ts.memoryProps = vkr.caps.memory;
+    ts.path = path;
+    volkLoadDeviceTable(&ts.next, vkr.device);
+
+    VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = vkr.families.universal;
+    VK_CHECK(ts.next.vkCreateCommandPool(vkr.device, &poolInfo, nullptr, &ts.commandPool));
+    VkCommandBufferAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    allocInfo.commandPool = ts.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VK_CHECK(ts.next.vkAllocateCommandBuffers(vkr.device, &allocInfo, &ts.commandBuffer));
+
+#define TRACE_INSTALL(name) name = Hook_##name;
+    TRACE_HOOKS(TRACE_INSTALL)
+#undef TRACE_INSTALL
+    printf("trace: installed, captures go to %s\n", path);
+    return true;
+}
+
+void
+Trace_Uninstall(VkDevice device)
+{
+    if (!ts.device) {
+        return;
+    }
+#define TRACE_RESTORE(name) name = ts.next.name;
+    TRACE_HOOKS(TRACE_RESTORE)
+#undef TRACE_RESTORE
+    ts.next.vkDestroyCommandPool(device, ts.commandPool, nullptr);
+    for (uint32_t id = 0; id < ts.objectCount; ++id) {
+        Bytes_Free(ts.objects[id].info);
+        Bytes_Free(ts.objects[id].data);
+        free(ts.objects[id].layouts);
+    }
+    for (uint32_t i = 0; i < ts.cmdBufferCount; ++i) {
+        Bytes_Free(ts.cmdBuffers[i].stream);
+        Bytes_Free(ts.cmdBuffers[i].layouts);
+    }
+    free(ts.objects);
+    free(ts.memories);
+    free(ts.cmdBuffers);
+    free(ts.handles);
+    Bytes_Free(ts.submitted);
+    ts = { };
+}
+
+bool
+Trace_IsInstalled()
+{
+    return ts.device != nullptr;
+}
+
+void
+Trace_Request(uint32_t frameIndex)
+{
+    if (ts.device) {
+        ts.bRequest = true;
+        ts.requestFrame = frameIndex;
+    }
+}
+
+bool
+Trace_BeginFrame(uint32_t frameIndex)
+{
+    if (!ts.bRequest || (ts.requestFrame != TRACE_NEXT_FRAME && ts.requestFrame != frameIndex)) {
+        return false;
+    }
+    ts.bRequest = false;
+    ts.bArmed = true;
+    ts.frameIndex = frameIndex;
+    return true;
+}
+
+void
+Trace_EndFrame()
+{
+    if (!ts.bArmed) {
+        return;
+    }
+    ts.bArmed = false;
+    if (ts.submittedCount) {
+        WriteTrace();
+    } else {
+        puts("trace: the frame submitted nothing");
+    }
+    for (uint32_t i = 0; i < lengthof(TraceWarnings); ++i) {
+        if (ts.warnings & (1u << i)) {
+            printf("trace: warning, not captured: %s\n", TraceWarnings[i]);
+        }
+    }
+    ts.warnings = 0;
+    /* Contents are only kept for one capture. Descriptor sets keep theirs, it's their current state. */
+    for (uint32_t id = 0; id < ts.objectCount; ++id) {
+        TraceObject& o = ts.objects[id];
+        o.bNeeded = o.bTaken = false;
+        if (o.type == TraceChunk_Buffer || o.type == TraceChunk_Image) {
+            Bytes_Free(o.data);
+        }
+    }
+    for (uint32_t i = 0; i < ts.cmdBufferCount; ++i) {
+        ts.cmdBuffers[i].bRecording = false;
+    }
+    Bytes_Free(ts.submitted);
+    ts.submittedCount = 0;
+}
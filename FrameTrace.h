@@ -0,0 +1,46 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "TraceFormat.h"
+
+/*
+    Frame trace: writes one frame's command buffers, and every object and byte of data they use, to a .vkt file
+    (TraceFormat.h) that tools/tracereplay plays back headless, as many times as asked, timing each run. A real
+    frame becomes a benchmark that doesn't depend on the window, input, vsync or the clock.
+
+    Trace_Install replaces volk's device-level function pointers with ones that note every object created (the
+    create info, SPIR-V, bound memory, descriptor writes, image layouts after each submit) and then call the
+    real function. That bookkeeping is the whole cost until a frame is captured. It has to be installed right
+    after the device is created, an object it didn't see being created can't be replayed.
+
+    The frame to capture is armed with Trace_BeginFrame, before its command buffers are begun. Those record
+    their commands as well. On the frame's first vkQueueSubmit the queue is drained and the contents of the
+    buffers and images the commands use are read back, so the file holds the state the frame started from.
+    Trace_EndFrame, after the submit, writes the file.
+
+    To be able to read them back, buffers get TRANSFER_SRC usage, and so do images whose format allows it,
+    except transient attachments. Only color images with one sample are read back. Depth/stencil and MSAA
+    images are left out, their contents are normally cleared by the frame anyway.
+
+    Not traced: queries and timestamps (the replay times the frame itself), descriptor copies, specialization
+    constants and texel buffer views, a warning is printed if a frame uses them.
+    Data written by one submit of the captured frame and read by a later one is taken after the first.
+    The records of destroyed objects are kept, so a frame can refer to them through a descriptor written long
+    ago. Vulkan calls are assumed to come from one thread, as they do here.
+*/
+
+#define TRACE_NEXT_FRAME UINT32_MAX
+
+// Returns false if the file can't be written to, nothing is installed then.
+bool Trace_Install(const VulkanRenderer& vkr, const char *path);
+// Puts volk's function pointers back. After everything created with the trace installed is destroyed.
+void Trace_Uninstall(VkDevice device);
+bool Trace_IsInstalled();
+
+// Captures the frame Trace_BeginFrame is called with, or the next one with TRACE_NEXT_FRAME.
+void Trace_Request(uint32_t frameIndex);
+
+// Before any command buffer of the frame is begun. Returns whether it's being captured.
+bool Trace_BeginFrame(uint32_t frameIndex);
+// After the frame's last submit, writes the file.
+void Trace_EndFrame();
@@ -0,0 +1,162 @@
+#include "GpuStats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Results come in bit order, which is the order of the GpuStat values before GpuStat_SamplesPassed. */
+static const VkQueryPipelineStatisticFlags StatisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+#define STATISTIC_COUNT GpuStat_SamplesPassed
+
+void
+GpuStats_Create(GpuStats& s, const VulkanRenderer& vkr, uint32_t slotCount)
+{
+    s = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    s.slotCount = slotCount;
+    s.openScope = UINT32_MAX;
+    s.bHostReset = vkr.caps.features12.hostQueryReset;
+    s.occlusionFlags = vkr.caps.features.occlusionQueryPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0;
+
+    uint32_t const queryCount = slotCount * GPUSTATS_MAX_SCOPES;
+    VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    info.queryType = VK_QUERY_TYPE_OCCLUSION;
+    info.queryCount = queryCount;
+    VK_CHECK(vkCreateQueryPool(vkr.device, &info, nullptr, &s.occlusionPool));
+
+    if (vkr.caps.features.pipelineStatisticsQuery) {
+        info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        info.pipelineStatistics = StatisticFlags;
+        VK_CHECK(vkCreateQueryPool(vkr.device, &info, nullptr, &s.statsPool));
+    } else {
+        puts("GpuStats: no pipelineStatisticsQuery, only occlusion counts");
+    }
+
+    if (s.bHostReset) {
+        vkResetQueryPool(vkr.device, s.occlusionPool, 0, queryCount);
+        if (s.statsPool) {
+            vkResetQueryPool(vkr.device, s.statsPool, 0, queryCount);
+        }
+    }
+}
+
+void
+GpuStats_Destroy(GpuStats& s, VkDevice device)
+{
+    vkDestroyQueryPool(device, s.statsPool, nullptr);
+    vkDestroyQueryPool(device, s.occlusionPool, nullptr);
+    s = { };
+}
+
+void
+GpuStats_CmdBeginFrame(GpuStats& s, VkCommandBuffer cmd, uint32_t slot)
+{
+    s.slot = slot;
+    if (!s.occlusionPool) return;
+    ASSERT(s.writtenMask[slot] == 0 || !s.bHostReset); // GpuStats_ReadSlot wasn't called
+    s.writtenMask[slot] = 0;
+    if (!s.bHostReset) {
+        vkCmdResetQueryPool(cmd, s.occlusionPool, slot * GPUSTATS_MAX_SCOPES, GPUSTATS_MAX_SCOPES);
+        if (s.statsPool) {
+            vkCmdResetQueryPool(cmd, s.statsPool, slot * GPUSTATS_MAX_SCOPES, GPUSTATS_MAX_SCOPES);
+        }
+    }
+}
+
+void
+GpuStats_CmdBegin(GpuStats& s, VkCommandBuffer cmd, const char *name)
+{
+    if (!s.occlusionPool) return;
+    ASSERT(s.openScope == UINT32_MAX); // no nesting
+
+    uint32_t scope = 0;
+    while (scope < s.scopeCount && strcmp(s.scopes[scope].name, name)) {
+        ++scope;
+    }
+    if (scope == s.scopeCount) {
+        if (scope == GPUSTATS_MAX_SCOPES) {
+            return;
+        }
+        s.scopes[s.scopeCount++].name = name;
+    }
+    if (s.writtenMask[s.slot] & (1u << scope)) {
+        ASSERT(!"GpuStats scope used twice in a frame");
+        return;
+    }
+
+    uint32_t const query = s.slot * GPUSTATS_MAX_SCOPES + scope;
+    if (s.statsPool) {
+        vkCmdBeginQuery(cmd, s.statsPool, query, 0);
+    }
+    vkCmdBeginQuery(cmd, s.occlusionPool, query, s.occlusionFlags);
+    s.openScope = scope;
+}
+
+void
+GpuStats_CmdEnd(GpuStats& s, VkCommandBuffer cmd)
+{
+    if (!s.occlusionPool || s.openScope == UINT32_MAX) return; // none open if out of scopes
+
+    uint32_t const query = s.slot * GPUSTATS_MAX_SCOPES + s.openScope;
+    vkCmdEndQuery(cmd, s.occlusionPool, query);
+    if (s.statsPool) {
+        vkCmdEndQuery(cmd, s.statsPool, query);
+    }
+    s.writtenMask[s.slot] |= 1u << s.openScope;
+    s.openScope = UINT32_MAX;
+}
+
+void
+GpuStats_ReadSlot(GpuStats& s, VkDevice device, uint32_t slot)
+{
+    for (uint32_t scope = 0; scope < s.scopeCount; ++scope) {
+        if (!(s.writtenMask[slot] & (1u << scope))) {
+            continue;
+        }
+        uint32_t const query = slot * GPUSTATS_MAX_SCOPES + scope;
+        GpuStatsScope& sc = s.scopes[scope];
+
+        uint64_t values[GpuStat_Count] = { };
+        VkResult res = vkGetQueryPoolResults(device, s.occlusionPool, query, 1, sizeof(uint64_t),
+                                             &values[GpuStat_SamplesPassed], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (res == VK_SUCCESS && s.statsPool) {
+            res = vkGetQueryPoolResults(device, s.statsPool, query, 1, STATISTIC_COUNT * sizeof(uint64_t), values,
+                                        STATISTIC_COUNT * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        }
+        if (res == VK_SUCCESS) {
+            memcpy(sc.values, values, sizeof values);
+            sc.bValid = true;
+        }
+        if (s.bHostReset) {
+            vkResetQueryPool(device, s.occlusionPool, query, 1);
+            if (s.statsPool) {
+                vkResetQueryPool(device, s.statsPool, query, 1);
+            }
+        }
+    }
+    if (s.bHostReset) {
+        s.writtenMask[slot] = 0;
+    }
+}
+
+void
+GpuStats_Print(const GpuStats& s)
+{
+    if (!s.scopeCount) return;
+    puts("GPU stats (last frame read):");
+    for (uint32_t i = 0; i < s.scopeCount; ++i) {
+        const GpuStatsScope& sc = s.scopes[i];
+        const uint64_t *v = sc.values;
+        printf("  %-12s vertices %llu, VS %llu, clip %llu in %llu out, FS %llu, CS %llu, samples passed %llu\n",
+               sc.name, (unsigned long long)v[GpuStat_IaVertices], (unsigned long long)v[GpuStat_VsInvocations],
+               (unsigned long long)v[GpuStat_ClipInvocations], (unsigned long long)v[GpuStat_ClipPrimitives],
+               (unsigned long long)v[GpuStat_FsInvocations], (unsigned long long)v[GpuStat_CsInvocations],
+               (unsigned long long)v[GpuStat_SamplesPassed]);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+
+/*
+    Pipeline statistics and occlusion counts for named scopes of the command buffer, to see how much vertex,
+    fragment and compute work a pass really does: fragment invocations against the samples that passed the
+    depth test show overdraw, clipping invocations against clipping primitives show culled geometry.
+
+    Each scope gets one VK_QUERY_TYPE_PIPELINE_STATISTICS and one VK_QUERY_TYPE_OCCLUSION query per frame slot.
+    Like GpuTimer, results are read once the slot's fence says the work is done, so reading never stalls, and
+    what's shown is a couple of frames old.
+
+    A scope is opened and closed in the same render pass, or both outside of one. Scopes don't nest (only one
+    query of a type can be active), and a name is used at most once per frame. The name pointer is kept, use
+    string literals.
+
+    Needs pipelineStatisticsQuery (enabled in CreateDevice when supported); without it only the occlusion
+    counts are there. The occlusion count is precise when occlusionQueryPrecise is enabled too.
+*/
+
+#define GPUSTATS_MAX_SCOPES 16
+
+enum GpuStat {
+    GpuStat_IaVertices,
+    GpuStat_VsInvocations,
+    GpuStat_ClipInvocations, // primitives that reached clipping
+    GpuStat_ClipPrimitives, // primitives out of clipping, after culling
+    GpuStat_FsInvocations,
+    GpuStat_CsInvocations,
+    GpuStat_SamplesPassed, // occlusion query
+    GpuStat_Count
+};
+
+struct GpuStatsScope {
+    const char *name;
+    uint64_t values[GpuStat_Count]; // last read, 0 until then
+    bool bValid;
+};
+
+struct GpuStats {
+    VkQueryPool statsPool; // null without pipelineStatisticsQuery
+    VkQueryPool occlusionPool; // null if GpuStats_Create wasn't called
+    VkQueryControlFlags occlusionFlags;
+    bool bHostReset; // like GpuTimer
+    uint32_t slotCount;
+    uint32_t slot; // since GpuStats_CmdBeginFrame
+    uint32_t openScope; // UINT32_MAX if none
+
+    GpuStatsScope scopes[GPUSTATS_MAX_SCOPES];
+    uint32_t scopeCount;
+    uint32_t writtenMask[GPUTIMER_MAX_SLOTS]; // scopes recorded in each slot
+};
+
+void GpuStats_Create(GpuStats& s, const VulkanRenderer& vkr, uint32_t slotCount);
+void GpuStats_Destroy(GpuStats& s, VkDevice device);
+
+// Outside a render pass, before the first scope of the frame. Resets the slot's queries unless bHostReset.
+void GpuStats_CmdBeginFrame(GpuStats& s, VkCommandBuffer cmd, uint32_t slot);
+void GpuStats_CmdBegin(GpuStats& s, VkCommandBuffer cmd, const char *name);
+void GpuStats_CmdEnd(GpuStats& s, VkCommandBuffer cmd);
+
+// Once the slot's previous submission is complete, before recording it again. Updates the scopes it wrote.
+void GpuStats_ReadSlot(GpuStats& s, VkDevice device, uint32_t slot);
+
+// The last values of every scope, a line each.
+void GpuStats_Print(const GpuStats& s);
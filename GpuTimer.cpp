@@ -0,0 +1,105 @@
+#include "GpuTimer.h"
+
+#include <stdio.h>
+
+// Queries per slot: begin, end, then all work before the acquire wait done, and the wait's stage reached.
+#define GPUTIMER_QUERIES_PER_SLOT 4
+
+void
+GpuTimer_Create(GpuTimer& t, const VulkanRenderer& vkr, uint32_t slotCount)
+{
+    t = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    t.slotCount = slotCount;
+
+    uint32_t const validBits = vkr.caps.universalTimestampValidBits;
+    if (validBits == 0) {
+        puts("GpuTimer: universal family does not support timestamps, GPU times will read as 0.");
+        return;
+    }
+    t.validMask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+    t.secsPerTick = vkr.caps.props.limits.timestampPeriod * 1e-9f;
+    t.bHostReset = vkr.caps.features12.hostQueryReset;
+
+    VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = slotCount * GPUTIMER_QUERIES_PER_SLOT;
+    VK_CHECK(vkCreateQueryPool(vkr.device, &info, nullptr, &t.queryPool));
+    if (t.bHostReset) {
+        vkResetQueryPool(vkr.device, t.queryPool, 0, info.queryCount);
+    }
+}
+
+void
+GpuTimer_Destroy(GpuTimer& t, VkDevice device)
+{
+    if (t.queryPool) {
+        vkDestroyQueryPool(device, t.queryPool, nullptr);
+        t.queryPool = nullptr;
+    }
+}
+
+void
+GpuTimer_CmdBegin(GpuTimer& t, VkCommandBuffer cmd, uint32_t slot)
+{
+    if (!t.queryPool) return;
+    uint32_t const first = slot * GPUTIMER_QUERIES_PER_SLOT;
+    if (!t.bHostReset) {
+        vkCmdResetQueryPool(cmd, t.queryPool, first, GPUTIMER_QUERIES_PER_SLOT);
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, t.queryPool, first);
+    t.waited[slot] = false;
+}
+
+void
+GpuTimer_CmdEnd(GpuTimer& t, VkCommandBuffer cmd, uint32_t slot)
+{
+    if (!t.queryPool) return;
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, t.queryPool, slot * GPUTIMER_QUERIES_PER_SLOT + 1);
+    t.written[slot] = true;
+}
+
+void
+GpuTimer_CmdAcquireWait(GpuTimer& t, VkCommandBuffer cmd, uint32_t slot, VkPipelineStageFlagBits waitStage)
+{
+    if (!t.queryPool) return;
+    uint32_t const first = slot * GPUTIMER_QUERIES_PER_SLOT;
+    /*  The first is written once what's recorded so far is done (the particle sim, uploads, an offscreen pass),
+        the second not before the semaphore lets waitStage run.
+    */
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, t.queryPool, first + 2);
+    vkCmdWriteTimestamp(cmd, waitStage, t.queryPool, first + 3);
+    t.waited[slot] = true;
+}
+
+bool
+GpuTimer_GetSlotSecs(GpuTimer& t, VkDevice device, uint32_t slot, float *pSecs)
+{
+    *pSecs = 0.0f;
+    if (!t.queryPool || !t.written[slot]) {
+        return false;
+    }
+
+    uint32_t const first = slot * GPUTIMER_QUERIES_PER_SLOT;
+    uint32_t const count = t.waited[slot] ? 4 : 2;
+    uint64_t stamps[GPUTIMER_QUERIES_PER_SLOT];
+    VkResult res = vkGetQueryPoolResults(device, t.queryPool, first, count, count * sizeof stamps[0], stamps,
+                                         sizeof stamps[0], VK_QUERY_RESULT_64_BIT);
+    if (t.bHostReset) {
+        vkResetQueryPool(device, t.queryPool, first, GPUTIMER_QUERIES_PER_SLOT);
+        t.written[slot] = false;
+    }
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    uint64_t delta = (stamps[1] - stamps[0]) & t.validMask;
+    if (count == 4) {
+        /* Idle only if the wait ended after the work before it did, the two can run in either order. */
+        uint64_t const idle = (stamps[3] - stamps[2]) & t.validMask;
+        if (idle < t.validMask / 2 && idle < delta) {
+            delta -= idle;
+        }
+    }
+    *pSecs = float(int64_t(delta)) * t.secsPerTick;
+    return true;
+}
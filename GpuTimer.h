@@ -0,0 +1,41 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    GPU timestamps, one pair of queries per frame slot (same slots as the perframe ring in main.cpp).
+    The pair brackets the slot's command buffer. Results are only read once the slot's fence
+    (or a vkDeviceWaitIdle) says the work is done, so reading never stalls.
+
+    A frame's submit waits on the swapchain acquire, and with vsync that wait can be most of the bracket.
+    GpuTimer_CmdAcquireWait adds a second pair around it: everything before it done, and the wait's stage
+    reached. The gap between the two is idle time and isn't counted, so the controllers fed from this (pacer,
+    adaptive present, dynamic resolution) see the work, not the display. Only the main image's wait is taken out.
+*/
+
+#define GPUTIMER_MAX_SLOTS 4
+
+struct GpuTimer {
+    VkQueryPool queryPool; // null if the universal family has timestampValidBits == 0
+    float secsPerTick; // VkPhysicalDeviceLimits::timestampPeriod is in nanoseconds
+    uint64_t validMask;
+    uint32_t slotCount;
+    bool bHostReset; // hostQueryReset: reset on the CPU after reading, instead of vkCmdResetQueryPool in every command buffer
+    bool written[GPUTIMER_MAX_SLOTS]; // a never-written query would make vkGetQueryPoolResults return VK_NOT_READY
+    bool waited[GPUTIMER_MAX_SLOTS]; // the acquire wait pair was written too
+};
+
+void GpuTimer_Create(GpuTimer& t, const VulkanRenderer& vkr, uint32_t slotCount);
+void GpuTimer_Destroy(GpuTimer& t, VkDevice device);
+
+// Must be recorded outside of a render pass, as it may also reset the slot's queries.
+void GpuTimer_CmdBegin(GpuTimer& t, VkCommandBuffer cmd, uint32_t slot);
+void GpuTimer_CmdEnd(GpuTimer& t, VkCommandBuffer cmd, uint32_t slot);
+// Optional, at most once between Begin and End: right before the first command that uses the acquired image,
+// with the stage the submit waits on its semaphore at.
+void GpuTimer_CmdAcquireWait(GpuTimer& t, VkCommandBuffer cmd, uint32_t slot, VkPipelineStageFlagBits waitStage);
+
+// Only call once the slot's previous submission is known to be complete, and before recording the slot again
+// (with host query reset, this is what resets the slot).
+// Returns false if there is no result for the slot (first use, or no timestamp support).
+bool GpuTimer_GetSlotSecs(GpuTimer& t, VkDevice device, uint32_t slot, float *pSecs);
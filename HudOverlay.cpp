@@ -0,0 +1,423 @@
+#include "HudOverlay.h"
+#include "MemoryBudget.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Matches the push constants in shaders/hud.vert.
+struct HudPushConstants {
+    float clipScale[2];
+    float clipOffset[2];
+};
+
+#define HUD_ATLAS_COLUMNS 16
+#define HUD_ATLAS_WIDTH (HUD_ATLAS_COLUMNS * 4)
+#define HUD_ATLAS_HEIGHT (4 * 6)
+
+/*  3x5 glyphs for ASCII 32-95, one octal digit per row (top first), the high bit of each digit is the left column.
+    E.g. '0' is 075557: 111, 101, 101, 101, 111.
+*/
+static const uint16_t HudFont[64] = {
+    000000, 022202, 055000, 057575, 027272, 051245, 025257, 022000, // space ! " # $ % & '
+    012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244, // ( ) * + , - . /
+    075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, // 0-7
+    075757, 075717, 002020, 002024, 012421, 007070, 042124, 071202, // 8 9 : ; < = > ?
+    075467, 025755, 065656, 034443, 065556, 074647, 074644, 034553, // @ A-G
+    055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552, // H-O
+    065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, // P-W
+    055255, 055222, 071247, 064446, 044211, 062226, 025000, 000007, // X Y Z [ \ ] ^ _
+};
+
+static void
+MakeAtlasPixels(ubyte *pixels)
+{
+    memset(pixels, 0, HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT);
+    for (uint32_t g = 0; g < lengthof(HudFont); ++g) {
+        uint32_t const cellX = g % HUD_ATLAS_COLUMNS * 4, cellY = g / HUD_ATLAS_COLUMNS * 6;
+        for (uint32_t row = 0; row < 5; ++row) {
+            uint32_t const bits = HudFont[g] >> (3 * (4 - row)) & 7;
+            for (uint32_t col = 0; col < 3; ++col) {
+                pixels[(cellY + row) * HUD_ATLAS_WIDTH + cellX + col] = (bits >> (2 - col) & 1) ? 255 : 0;
+            }
+        }
+    }
+}
+
+static bool
+CreateAtlas(HudOverlay& hud, const VulkanRenderer& vkr)
+{
+    VkDevice const device = vkr.device;
+    VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = VK_FORMAT_R8_UNORM;
+    info.extent = { HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, 1 };
+    info.mipLevels = 1;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &info, nullptr, &hud.atlas) != VK_SUCCESS) {
+        return false;
+    }
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(device, hud.atlas, &req);
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = req.size;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(vkr.caps.memory, req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+        MemBudget_Allocate(vkr, allocInfo, MemCategory_Textures, &hud.atlasMemory) != VK_SUCCESS ||
+        vkBindImageMemory(device, hud.atlas, hud.atlasMemory, 0) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    viewInfo.image = hud.atlas;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R8_UNORM;
+    viewInfo.components = COMPONENT_MAPPING_IDENTITY;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &hud.atlasView));
+
+    /* texelFetch ignores the filter, any sampler will do. */
+    VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &hud.sampler));
+
+    if (VKH_CreateBuffer(vkr, HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                         &hud.atlasStaging) != VK_SUCCESS) {
+        return false;
+    }
+    MakeAtlasPixels(static_cast<ubyte *>(hud.atlasStaging.pMapped));
+    return true;
+}
+
+static VkPipeline
+CreateDrawPipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                   VkShaderModule vs, VkShaderModule fs)
+{
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vs, "main" },
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main" },
+    };
+
+    // No attributes, the vertex shader reads the quad buffer.
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    raster.cullMode = VK_CULL_MODE_NONE;
+    raster.lineWidth = 1.0f;
+
+    VkPipelineColorBlendAttachmentState blendAttachment = { true };
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = 0xf;
+
+    VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkPipelineViewportStateCreateInfo viewport = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    // On top of everything, in the order the quads were added.
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = samples;
+
+    const VkDynamicState dynamics[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO, nullptr, 0,
+        lengthof(dynamics), dynamics
+    };
+
+    VkGraphicsPipelineCreateInfo psoInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    psoInfo.stageCount = lengthof(stages);
+    psoInfo.pStages = stages;
+    psoInfo.pVertexInputState = &vertexInput;
+    psoInfo.pInputAssemblyState = &inputAssembly;
+    psoInfo.pViewportState = &viewport;
+    psoInfo.pRasterizationState = &raster;
+    psoInfo.pMultisampleState = &multisample;
+    psoInfo.pDepthStencilState = &depthStencil;
+    psoInfo.pColorBlendState = &blend;
+    psoInfo.pDynamicState = &dynamic;
+    psoInfo.layout = layout;
+    psoInfo.renderPass = renderPass;
+    psoInfo.subpass = 0;
+
+    VkPipeline pso = nullptr;
+    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &psoInfo, nullptr, &pso));
+    return pso;
+}
+
+bool
+Hud_Create(HudOverlay& hud, const VulkanRenderer& vkr, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+           uint32_t slotCount)
+{
+    hud = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    VkDevice const device = vkr.device;
+
+    hud.vs = VKH_LoadShaderModule(device, "shaders/hud.vert.spv");
+    hud.fs = VKH_LoadShaderModule(device, "shaders/hud.frag.spv");
+    bool ok = hud.vs && hud.fs;
+
+    ok = ok && VKH_CreateBuffer(vkr, VkDeviceSize(slotCount) * HUD_MAX_QUADS * sizeof(HudQuad),
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                vkr.caps.bUnifiedMemory ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : 0,
+                                &hud.quads) == VK_SUCCESS;
+    ok = ok && CreateAtlas(hud, vkr);
+
+    if (ok) {
+        const VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT },
+            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &hud.sampler },
+        };
+        VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = lengthof(bindings);
+        layoutInfo.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &hud.setLayout));
+
+        const VkDescriptorPoolSize poolSizes[] = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+        };
+        VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = lengthof(poolSizes);
+        poolInfo.pPoolSizes = poolSizes;
+        VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &hud.descriptorPool));
+
+        VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocInfo.descriptorPool = hud.descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &hud.setLayout;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &hud.set));
+
+        const VkDescriptorBufferInfo bufferInfo = { hud.quads.buffer, 0, VK_WHOLE_SIZE };
+        const VkDescriptorImageInfo imageInfo = { nullptr, hud.atlasView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet writes[2] = {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+        };
+        writes[0].dstSet = hud.set;
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[0].pBufferInfo = &bufferInfo;
+        writes[1].dstSet = hud.set;
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[1].pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device, lengthof(writes), writes, 0, nullptr);
+
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(HudPushConstants) };
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &hud.setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &hud.pipelineLayout));
+
+        hud.pipeline = CreateDrawPipeline(device, hud.pipelineLayout, renderPass, samples, hud.vs, hud.fs);
+        hud.slotCount = slotCount;
+    }
+
+    if (!ok) {
+        puts("HUD: couldn't create the buffers or load shaders/hud.*.spv");
+        Hud_Destroy(hud, device);
+    }
+    return ok;
+}
+
+void
+Hud_Destroy(HudOverlay& hud, VkDevice device)
+{
+    vkDestroyPipeline(device, hud.pipeline, nullptr);
+    vkDestroyShaderModule(device, hud.vs, nullptr);
+    vkDestroyShaderModule(device, hud.fs, nullptr);
+    vkDestroyPipelineLayout(device, hud.pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, hud.descriptorPool, nullptr); // frees the set
+    vkDestroyDescriptorSetLayout(device, hud.setLayout, nullptr);
+    vkDestroySampler(device, hud.sampler, nullptr);
+    vkDestroyImageView(device, hud.atlasView, nullptr);
+    vkDestroyImage(device, hud.atlas, nullptr);
+    MemBudget_Free(device, hud.atlasMemory);
+    VKH_DestroyBuffer(device, hud.atlasStaging);
+    VKH_DestroyBuffer(device, hud.quads);
+    hud = { };
+}
+
+void
+Hud_SetRenderPass(HudOverlay& hud, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples)
+{
+    if (!hud.pipeline) {
+        return;
+    }
+    vkDestroyPipeline(device, hud.pipeline, nullptr);
+    hud.pipeline = CreateDrawPipeline(device, hud.pipelineLayout, renderPass, samples, hud.vs, hud.fs);
+}
+
+void
+Hud_AddSample(HudOverlay& hud, HudGraph graph, float secs)
+{
+    hud.history[graph][hud.historyNext[graph]] = secs;
+    hud.historyNext[graph] = (hud.historyNext[graph] + 1) % HUD_HISTORY;
+    hud.historyCount[graph] = Min(hud.historyCount[graph] + 1, uint32_t(HUD_HISTORY));
+}
+
+void
+Hud_GetStats(const HudOverlay& hud, HudGraph graph, float *pAvgSecs, float *pMaxSecs)
+{
+    uint32_t const n = hud.historyCount[graph];
+    float sum = 0.0f, max = 0.0f;
+    for (uint32_t i = 0; i < n; ++i) {
+        sum += hud.history[graph][i];
+        max = Max(max, hud.history[graph][i]);
+    }
+    *pAvgSecs = n ? sum / float(n) : 0.0f;
+    *pMaxSecs = max;
+}
+
+void
+Hud_Begin(HudOverlay& hud, uint32_t slot)
+{
+    ASSERT(slot < hud.slotCount);
+    hud.slot = slot;
+    hud.quadCount = 0;
+    hud.droppedCount = 0;
+}
+
+static void
+AddQuad(HudOverlay& hud, int x, int y, int w, int h, uint32_t color, uint32_t glyph)
+{
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || x > 0xFFFF || y > 0xFFFF) {
+        return; // off screen, the render area starts at 0
+    }
+    if (hud.quadCount == HUD_MAX_QUADS) {
+        ++hud.droppedCount;
+        return;
+    }
+    HudQuad *const quads = static_cast<HudQuad *>(hud.quads.pMapped) + hud.slot * HUD_MAX_QUADS;
+    HudQuad q;
+    q.x = uint16_t(x);
+    q.y = uint16_t(y);
+    q.w = uint16_t(Min(w, 0xFFFF));
+    q.h = uint16_t(Min(h, 0xFFFF));
+    q.color = color;
+    q.glyph = glyph;
+    quads[hud.quadCount++] = q; // whole, the memory may be write-combined
+}
+
+void
+Hud_Rect(HudOverlay& hud, int x, int y, int w, int h, uint32_t color)
+{
+    AddQuad(hud, x, y, w, h, color, HUD_SOLID);
+}
+
+int
+Hud_Text(HudOverlay& hud, int x, int y, uint32_t color, const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof buf, fmt, args);
+    va_end(args);
+
+    for (const char *p = buf; *p; ++p, x += HUD_CHAR_ADVANCE) {
+        uint32_t c = ubyte(*p);
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        if (c == ' ') continue;
+        if (c < 32 || c > 95) c = '?';
+        AddQuad(hud, x, y, 3 * HUD_GLYPH_SCALE, 5 * HUD_GLYPH_SCALE, color, c - 32);
+    }
+    return x;
+}
+
+void
+Hud_Graph(HudOverlay& hud, HudGraph graph, int x, int y, int w, int h, float fullSecs, uint32_t color)
+{
+    Hud_Rect(hud, x, y, w, h, 0x80000000u); // translucent black panel
+    Hud_Rect(hud, x, y, w, 1, 0x60FFFFFFu);
+    Hud_Rect(hud, x, y + h / 2, w, 1, 0x40FFFFFFu);
+
+    uint32_t const n = hud.historyCount[graph];
+    int const barWidth = Max(w / HUD_HISTORY, 1);
+    int bx = x + w - int(n) * barWidth; // newest at the right edge
+    for (uint32_t i = 0; i < n; ++i, bx += barWidth) {
+        uint32_t const index = (hud.historyNext[graph] + HUD_HISTORY - n + i) % HUD_HISTORY;
+        float const frac = Min(hud.history[graph][index] / fullSecs, 1.0f);
+        int const barHeight = Max(int(frac * float(h) + 0.5f), 1);
+        if (bx >= x) {
+            Hud_Rect(hud, bx, y + h - barHeight, barWidth, barHeight, color);
+        }
+    }
+}
+
+void
+Hud_CmdUpload(HudOverlay& hud, VkCommandBuffer cmd)
+{
+    if (hud.bAtlasUploaded || !hud.pipeline) {
+        return;
+    }
+    VkImageMemoryBarrier b = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    b.srcAccessMask = 0;
+    b.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    b.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    b.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.image = hud.atlas;
+    b.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &b);
+
+    VkBufferImageCopy region = { };
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, 1 };
+    vkCmdCopyBufferToImage(cmd, hud.atlasStaging.buffer, hud.atlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    b.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    b.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    b.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &b);
+    hud.bAtlasUploaded = true;
+}
+
+void
+Hud_CmdDraw(const HudOverlay& hud, CmdEncoder& enc, VkExtent2D extent)
+{
+    if (!hud.quadCount || !hud.bAtlasUploaded) {
+        return;
+    }
+    HudPushConstants pc;
+    pc.clipScale[0] = 2.0f / float(extent.width);
+    pc.clipScale[1] = 2.0f / float(extent.height);
+    pc.clipOffset[0] = -1.0f;
+    pc.clipOffset[1] = -1.0f;
+    CmdEncoder_BindPipeline(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, hud.pipeline);
+    CmdEncoder_BindDescriptorSets(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, hud.pipelineLayout, 0, 1, &hud.set);
+    CmdEncoder_PushConstants(enc, hud.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pc, &pc);
+    CmdEncoder_Draw(enc, 6, hud.quadCount, 0, hud.slot * HUD_MAX_QUADS);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+#include "CmdEncoder.h"
+
+/*
+    In-frame perf overlay: text and frame time graphs drawn as the last thing in the render pass, so it shows in
+    fullscreen and in captures, where the window title doesn't.
+
+    Everything is a quad (a glyph, a graph bar, a background panel) of 16 bytes, written straight into the frame
+    slot's part of a persistently mapped storage buffer, then drawn with one instanced vkCmdDraw(6, quadCount).
+    Glyphs come from a tiny built-in 3x5 font (ASCII 32-95, lower case is drawn as upper case) in an R8 atlas.
+
+    Per frame:
+        - Hud_AddSample for each graph, whenever the time is known (the GPU time a couple of frames late).
+        - Hud_Begin, then Hud_Text / Hud_Rect / Hud_Graph.
+        - Hud_CmdUpload outside the render pass (uploads the atlas the first time, nothing after).
+        - Hud_CmdDraw inside it.
+
+    Needs the .spv files for shaders/hud*, without them Hud_Create fails and there's no overlay.
+*/
+
+#define HUD_MAX_QUADS 4096 // per frame
+#define HUD_HISTORY 128 // samples per graph
+#define HUD_GLYPH_SCALE 2 // pixels per font texel
+#define HUD_CHAR_ADVANCE (4 * HUD_GLYPH_SCALE)
+#define HUD_LINE_HEIGHT (7 * HUD_GLYPH_SCALE)
+
+enum HudGraph {
+    HudGraph_Cpu, // frame start to submit
+    HudGraph_Gpu, // the frame's command buffer, from GpuTimer
+    HudGraph_Acquire, // blocked in vkAcquireNextImageKHR
+    HudGraph_Present, // in vkQueuePresentKHR
+    HudGraph_Count
+};
+
+// Matches shaders/hud.vert.
+struct HudQuad {
+    uint16_t x, y; // pixels from the top left
+    uint16_t w, h;
+    uint32_t color; // RGBA8, R in the low byte
+    uint32_t glyph; // atlas cell, HUD_SOLID for a plain rect
+};
+static_assert(sizeof(HudQuad) == 16, "std430 layout");
+
+#define HUD_SOLID 0xFFFFu
+
+struct HudOverlay {
+    BufferAllocation quads; // slotCount * HUD_MAX_QUADS, host visible and persistently mapped
+    BufferAllocation atlasStaging; // kept, it's tiny
+    VkImage atlas;
+    VkDeviceMemory atlasMemory;
+    VkImageView atlasView;
+    VkSampler sampler;
+    bool bAtlasUploaded;
+
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet set;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkShaderModule vs, fs; // kept for Hud_SetRenderPass
+
+    uint32_t slotCount;
+    uint32_t slot; // since Hud_Begin
+    uint32_t quadCount;
+    uint32_t droppedCount;
+
+    float history[HudGraph_Count][HUD_HISTORY]; // secs, a ring
+    uint32_t historyNext[HudGraph_Count];
+    uint32_t historyCount[HudGraph_Count];
+};
+
+// Returns false if the shaders are missing or something couldn't be created, hud is then zeroed.
+bool Hud_Create(HudOverlay& hud, const VulkanRenderer& vkr, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                uint32_t slotCount);
+void Hud_Destroy(HudOverlay& hud, VkDevice device);
+
+// Recreates the pipeline for a new render pass. The GPU must be idle. Does nothing if hud wasn't created.
+void Hud_SetRenderPass(HudOverlay& hud, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples);
+
+void Hud_AddSample(HudOverlay& hud, HudGraph graph, float secs);
+// Mean and max over the graph's history, 0 if there are no samples.
+void Hud_GetStats(const HudOverlay& hud, HudGraph graph, float *pAvgSecs, float *pMaxSecs);
+
+// After the slot's fence wait.
+void Hud_Begin(HudOverlay& hud, uint32_t slot);
+void Hud_Rect(HudOverlay& hud, int x, int y, int w, int h, uint32_t color);
+// printf style, one line. Returns the x after the last character.
+int Hud_Text(HudOverlay& hud, int x, int y, uint32_t color, const char *fmt, ...);
+// Bars for the history, oldest on the left, scaled so fullSecs is the height h. Lines at 1/2 and full.
+void Hud_Graph(HudOverlay& hud, HudGraph graph, int x, int y, int w, int h, float fullSecs, uint32_t color);
+
+// Outside a render pass, every frame before Hud_CmdDraw.
+void Hud_CmdUpload(HudOverlay& hud, VkCommandBuffer cmd);
+// Inside the render pass. Viewport and scissor must be set to extent.
+void Hud_CmdDraw(const HudOverlay& hud, CmdEncoder& enc, VkExtent2D extent);
@@ -0,0 +1,356 @@
+#include "JobSystem.h"
+
+#include <stdio.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JOBS_PAUSE() _mm_pause()
+#else
+#define JOBS_PAUSE() ((void)0)
+#endif
+
+// Spins over all deques before a worker goes to sleep.
+#define JOBS_IDLE_SPINS 64
+
+static thread_local uint32_t t_jobThreadIndex; // 0 unless set by WorkerMain
+
+uint32_t
+Jobs_GetThreadIndex()
+{
+    return t_jobThreadIndex;
+}
+
+// Owner only. False if full.
+static bool
+Deque_Push(JobDeque& d, Job *job)
+{
+    int64_t const b = d.bottom.load(std::memory_order_relaxed);
+    int64_t const t = d.top.load(std::memory_order_acquire);
+    if (b - t >= JOBS_PER_THREAD) {
+        return false;
+    }
+    d.slots[b & (JOBS_PER_THREAD - 1)].store(job, std::memory_order_release); // the job's fields go with it
+    d.bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+// Owner only. The last job is raced for with thieves.
+static Job *
+Deque_Pop(JobDeque& d)
+{
+    int64_t const b = d.bottom.load(std::memory_order_relaxed) - 1;
+    d.bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = d.top.load(std::memory_order_relaxed);
+    if (t > b) {
+        d.bottom.store(b + 1, std::memory_order_relaxed); // was empty
+        return nullptr;
+    }
+    Job *job = d.slots[b & (JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        if (!d.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr; // a thief got it
+        }
+        d.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+// Any thread. Null if empty or another thief won.
+static Job *
+Deque_Steal(JobDeque& d)
+{
+    int64_t t = d.top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t const b = d.bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+    Job *job = d.slots[t & (JOBS_PER_THREAD - 1)].load(std::memory_order_acquire);
+    if (!d.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+// Own deque first, then the others from a random start.
+static Job *
+FindJob(JobSystem& js, uint32_t self)
+{
+    JobThread& me = js.threads[self];
+    if (Job *job = Deque_Pop(me.deque)) {
+        return job;
+    }
+    me.stealSeed = me.stealSeed * 1664525u + 1013904223u;
+    uint32_t const start = (me.stealSeed >> 16) % js.threadCount;
+    for (uint32_t i = 0; i < js.threadCount; ++i) {
+        uint32_t const victim = (start + i) % js.threadCount;
+        if (victim == self) continue;
+        if (Job *job = Deque_Steal(js.threads[victim].deque)) {
+            ++me.stolen;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+static void
+Execute(JobSystem& js, uint32_t self, Job *job)
+{
+    JobCounter *const counter = job->counter;
+    job->proc(job->arg, job->begin, job->end, self);
+    ++js.threads[self].executed;
+    /* The slot goes back to its owner before the counter, which may be on a stack that's gone right after. */
+    job->bLive.store(false, std::memory_order_release);
+    if (counter) {
+        counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+static void
+WorkerMain(void *arg)
+{
+    JobThread& me = *static_cast<JobThread *>(arg);
+    JobSystem& js = *me.js;
+    uint32_t const self = uint32_t(&me - js.threads);
+    t_jobThreadIndex = self;
+
+    for (;;) {
+        Job *job = nullptr;
+        for (int spin = 0; !job && spin < JOBS_IDLE_SPINS; ++spin) {
+            job = FindJob(js, self);
+            if (!job) JOBS_PAUSE();
+        }
+        if (!job) {
+            if (js.bQuit.load(std::memory_order_acquire)) {
+                break;
+            }
+            /*  Register as a sleeper, then look once more: Jobs_Run pushes and then checks for sleepers, so
+                either it sees this registration and posts, or this sees its job.
+            */
+            js.sleepers.fetch_add(1, std::memory_order_seq_cst);
+            job = FindJob(js, self);
+            if (job || js.bQuit.load(std::memory_order_acquire)) {
+                /* Take the registration back, unless a post was already claimed for it, then eat that post. */
+                int32_t s = js.sleepers.load(std::memory_order_relaxed);
+                while (s > 0 && !js.sleepers.compare_exchange_weak(s, s - 1, std::memory_order_relaxed)) { }
+                if (s <= 0) OS_WaitSemaphore(js.wake);
+            }
+            else {
+                OS_WaitSemaphore(js.wake);
+                continue;
+            }
+            if (!job) {
+                break; // quitting
+            }
+        }
+        Execute(js, self, job);
+    }
+}
+
+// Wakes one sleeping worker, if any are registered.
+static void
+WakeOne(JobSystem& js)
+{
+    int32_t s = js.sleepers.load(std::memory_order_relaxed);
+    while (s > 0) {
+        if (js.sleepers.compare_exchange_weak(s, s - 1, std::memory_order_relaxed)) {
+            OS_PostSemaphore(js.wake);
+            return;
+        }
+    }
+}
+
+void
+Jobs_Create(JobSystem& js, uint32_t workerCount)
+{
+    if (workerCount == UINT32_MAX) {
+        workerCount = OS_GetCpuCount() - 1;
+    }
+    workerCount = Min(workerCount, uint32_t(JOBS_MAX_THREADS - 1));
+    t_jobThreadIndex = 0;
+    js.bQuit.store(false);
+    js.sleepers.store(0);
+    js.threadCount = 1;
+    for (uint32_t i = 0; i < JOBS_MAX_THREADS; ++i) {
+        JobThread& t = js.threads[i];
+        t.deque.top.store(0);
+        t.deque.bottom.store(0);
+        t.js = &js;
+        t.nextJob = 0;
+        for (Job& job : t.pool) {
+            job.bLive.store(false, std::memory_order_relaxed);
+        }
+        t.stealSeed = i * 2654435761u + 1;
+        t.executed = t.stolen = 0;
+        t.thread = { };
+    }
+    if (workerCount && !OS_CreateSemaphore(&js.wake, 0, JOBS_MAX_THREADS)) {
+        workerCount = 0;
+    }
+    /* Set before any worker reads it. A worker that fails to start only leaves an empty deque to steal from. */
+    js.threadCount = workerCount + 1;
+    uint32_t started = 0;
+    for (uint32_t i = 1; i <= workerCount; ++i) {
+        started += OS_StartThread(&js.threads[i].thread, WorkerMain, &js.threads[i]);
+    }
+    printf("jobs: %u worker threads\n", started);
+}
+
+void
+Jobs_Destroy(JobSystem& js)
+{
+    js.bQuit.store(true, std::memory_order_seq_cst);
+    for (uint32_t i = 1; i < js.threadCount; ++i) {
+        WakeOne(js);
+    }
+    for (uint32_t i = 1; i < js.threadCount; ++i) {
+        /* Wake any that registered after the posts above. */
+        while (js.threads[i].thread.handle && js.sleepers.load() > 0) {
+            WakeOne(js);
+            OS_YieldThread();
+        }
+        OS_JoinThread(js.threads[i].thread);
+    }
+    if (js.threadCount > 1) {
+        OS_DestroySemaphore(js.wake);
+    }
+    js.threadCount = 1;
+}
+
+void
+Jobs_Run(JobSystem& js, job_proc proc, void *arg, uint32_t begin, uint32_t end, JobCounter *counter)
+{
+    uint32_t const self = t_jobThreadIndex;
+    JobThread& me = js.threads[self];
+    /*  Slots mostly finish in the order they were handed out, so the next one is usually free. Live ones are
+        skipped: a nested Jobs_ParallelFor can wrap the pool while the outer one's jobs are still queued.
+    */
+    Job *job = nullptr;
+    for (uint32_t i = 0; i < JOBS_PER_THREAD; ++i) {
+        Job *const slot = &me.pool[me.nextJob++ & (JOBS_PER_THREAD - 1)];
+        if (!slot->bLive.load(std::memory_order_acquire)) { // acquire: the executor is done reading it
+            job = slot;
+            break;
+        }
+    }
+    if (!job) {
+        proc(arg, begin, end, self); // every slot is live, the counter never sees this one
+        ++me.executed;
+        return;
+    }
+    job->bLive.store(true, std::memory_order_relaxed); // published by the push, or only read by this thread
+    job->proc = proc;
+    job->arg = arg;
+    job->begin = begin;
+    job->end = end;
+    job->counter = counter;
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (js.threadCount == 1 || !Deque_Push(me.deque, job)) {
+        Execute(js, self, job);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst); // the push before reading sleepers, see WorkerMain
+    WakeOne(js);
+}
+
+void
+Jobs_Wait(JobSystem& js, JobCounter& counter)
+{
+    uint32_t const self = t_jobThreadIndex;
+    while (!Jobs_IsDone(counter)) {
+        if (Job *job = FindJob(js, self)) {
+            Execute(js, self, job);
+        }
+        else {
+            JOBS_PAUSE(); // the rest is running on other threads
+        }
+    }
+}
+
+void
+Jobs_ParallelFor(JobSystem& js, uint32_t count, uint32_t grain, job_proc proc, void *arg)
+{
+    if (count == 0) return;
+    grain = Max(grain, 1u);
+    /* More chunks than threads so the ones that finish early can steal, but not so small they're all overhead. */
+    uint32_t const minGrain = (count + JOBS_PER_THREAD / 2 - 1) / (JOBS_PER_THREAD / 2);
+    grain = Max(grain, minGrain);
+    if (js.threadCount == 1 || count <= grain) {
+        proc(arg, 0, count, t_jobThreadIndex);
+        return;
+    }
+    JobCounter counter;
+    counter.pending.store(0, std::memory_order_relaxed);
+    /* Pushed last to first so the owner pops the start of the range first. */
+    uint32_t const chunks = (count + grain - 1) / grain;
+    for (uint32_t i = chunks; i-- > 0; ) {
+        uint32_t const begin = i * grain;
+        Jobs_Run(js, proc, arg, begin, Min(begin + grain, count), &counter);
+    }
+    Jobs_Wait(js, counter);
+}
+
+static void
+StressSumJob(void *arg, uint32_t begin, uint32_t end, uint32_t threadIndex)
+{
+    (void)threadIndex;
+    uint64_t sum = 0;
+    for (uint32_t i = begin; i < end; ++i) {
+        sum += i;
+    }
+    static_cast<std::atomic<uint64_t> *>(arg)->fetch_add(sum, std::memory_order_relaxed);
+}
+
+struct StressNested {
+    JobSystem *js;
+    std::atomic<uint64_t> total;
+};
+
+// Each index starts a whole Jobs_ParallelFor of its own, enough of them to wrap the pool of the thread running it.
+static void
+StressNestedJob(void *arg, uint32_t begin, uint32_t end, uint32_t threadIndex)
+{
+    (void)threadIndex;
+    StressNested& nested = *static_cast<StressNested *>(arg);
+    for (uint32_t i = begin; i < end; ++i) {
+        Jobs_ParallelFor(*nested.js, 1000, 10, StressSumJob, &nested.total);
+    }
+}
+
+int
+Jobs_RunStressTest(JobSystem& js)
+{
+    int failures = 0;
+    for (uint32_t round = 0; round < 100; ++round) {
+        /* Flat: more chunks than the pool, so slots are reused within one call. */
+        uint32_t const n = 1u << 20;
+        std::atomic<uint64_t> flat(0);
+        Jobs_ParallelFor(js, n, 64, StressSumJob, &flat);
+        uint64_t const flatWant = uint64_t(n) * (n - 1) / 2;
+
+        /* Nested: 64 outer jobs of 100 inner ones each, 6400 from one thread while outer ones are queued. */
+        StressNested nested;
+        nested.js = &js;
+        nested.total.store(0, std::memory_order_relaxed);
+        Jobs_ParallelFor(js, 64, 1, StressNestedJob, &nested);
+        uint64_t const nestedWant = 64 * (uint64_t(1000) * 999 / 2);
+
+        if (flat.load() != flatWant || nested.total.load() != nestedWant) {
+            printf("stress-jobs: round %u: flat %llu (want %llu), nested %llu (want %llu)\n", round,
+                   (unsigned long long)flat.load(), (unsigned long long)flatWant,
+                   (unsigned long long)nested.total.load(), (unsigned long long)nestedWant);
+            ++failures;
+        }
+    }
+    uint64_t executed = 0, stolen = 0;
+    for (uint32_t i = 0; i < js.threadCount; ++i) {
+        executed += js.threads[i].executed;
+        stolen += js.threads[i].stolen;
+    }
+    printf("stress-jobs: %u threads, %llu jobs run, %llu stolen, %d failed rounds\n", js.threadCount,
+           (unsigned long long)executed, (unsigned long long)stolen, failures);
+    return failures ? 1 : 0;
+}
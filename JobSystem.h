@@ -0,0 +1,89 @@
+#pragma once
+
+#include "common.h"
+#include "VulkanSwapchain.h" // os_thread, os_semaphore
+
+#include <atomic>
+
+/*
+    Work-stealing jobs: a worker thread per core (less one for the main thread), each with a Chase-Lev deque.
+    The thread that makes jobs pushes them to the bottom of its own deque and pops from there (newest first,
+    still warm in cache), idle threads steal from the top of others' (oldest first, usually the biggest chunks).
+    Workers sleep on a semaphore when there's nothing to steal, so an idle job system costs nothing.
+
+    A job is a function over a range [begin, end) plus its thread index (0 is the main thread, workers are
+    1..threadCount-1), which selects per-thread memory like FrameArena_Get(fa, slot, threadIndex).
+
+    Dependencies are counters: Jobs_Run adds to the counter, each finished job subtracts, Jobs_Wait returns once
+    it's 0. Waiting runs other jobs meanwhile instead of blocking, so jobs can wait on jobs they started, and the
+    main thread helps with its own work. Jobs_ParallelFor is the common case of all that.
+
+    Jobs may only be started from the main thread (the one that called Jobs_Create) or from inside jobs.
+    Each thread has a pool of JOBS_PER_THREAD jobs, a slot is only reused once its job has finished. With every
+    slot still live (or a full deque) the job runs right away instead, so deep nesting degrades to serial
+    rather than overwriting queued jobs.
+*/
+
+#define JOBS_MAX_THREADS 16
+#define JOBS_PER_THREAD 4096 // power of two, the deque size too
+
+typedef void (*job_proc)(void *arg, uint32_t begin, uint32_t end, uint32_t threadIndex);
+
+struct JobCounter {
+    std::atomic<uint32_t> pending;
+};
+
+struct Job {
+    job_proc proc;
+    void *arg;
+    uint32_t begin, end;
+    JobCounter *counter; // may be null
+    std::atomic<bool> bLive; // from Jobs_Run until Execute is done with it, the slot can't be reused before
+};
+
+/* Chase-Lev: only the owner touches bottom, the owner and thieves race on top with a CAS. No resizing. */
+struct alignas(64) JobDeque {
+    std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) std::atomic<Job *> slots[JOBS_PER_THREAD];
+};
+
+struct JobSystem;
+
+struct JobThread {
+    JobDeque deque;
+    JobSystem *js;
+    Job pool[JOBS_PER_THREAD];
+    uint32_t nextJob; // in pool
+    uint32_t stealSeed;
+    uint64_t executed, stolen; // stats, only written by this thread
+    os_thread thread; // not for thread 0
+};
+
+struct JobSystem {
+    uint32_t threadCount; // including the main thread, 1 if there are no workers
+    std::atomic<bool> bQuit;
+    std::atomic<int32_t> sleepers; // workers registered to wait on wake that no post has been claimed for yet
+    os_semaphore wake;
+    JobThread threads[JOBS_MAX_THREADS];
+};
+
+// workerCount 0 runs everything on the calling thread, UINT32_MAX means one per core less one. Never fails.
+void Jobs_Create(JobSystem& js, uint32_t workerCount);
+// Workers finish what's queued, then exit.
+void Jobs_Destroy(JobSystem& js);
+
+// 0 on the main thread, else the worker's index.
+uint32_t Jobs_GetThreadIndex();
+
+void Jobs_Run(JobSystem& js, job_proc proc, void *arg, uint32_t begin, uint32_t end, JobCounter *counter);
+void Jobs_Wait(JobSystem& js, JobCounter& counter);
+inline bool Jobs_IsDone(const JobCounter& counter) { return counter.pending.load(std::memory_order_acquire) == 0; }
+
+/*  Calls proc over [0, count) in chunks of about grain (at least 1), on every thread, and returns when all are
+    done. Nested use from inside a job is fine.
+*/
+void Jobs_ParallelFor(JobSystem& js, uint32_t count, uint32_t grain, job_proc proc, void *arg);
+
+// --stress-jobs: flat and nested Jobs_ParallelFor sums checked against the expected totals. 0 if all matched.
+int Jobs_RunStressTest(JobSystem& js);
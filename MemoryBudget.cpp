@@ -0,0 +1,230 @@
+#include "MemoryBudget.h"
+
+static const char *const MemCategoryNames[MemCategory_Count] = { "textures", "buffers", "render_targets", "staging" };
+
+//----- Allocation tracking -----
+
+/*  Open addressing on the VkDeviceMemory, linear probing. Twice maxMemoryAllocationCount, which is 4096 on most
+    drivers, so it doesn't fill up, but if it does the allocation just isn't counted.
+*/
+#define MEM_TABLE_CAPACITY 8192
+
+struct MemAllocEntry {
+    uint64_t key; // the VkDeviceMemory, 0 if empty
+    VkDeviceSize size;
+    uint8_t heap;
+    uint8_t category;
+};
+
+struct MemAllocTable {
+    MemAllocEntry entries[MEM_TABLE_CAPACITY];
+    uint32_t count;
+    uint32_t untrackedCount;
+    VkDeviceSize bytes[MemCategory_Count][VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize peakBytes[MemCategory_Count];
+};
+
+static MemAllocTable allocTable;
+
+static inline uint32_t
+HashSlot(uint64_t key)
+{
+    return uint32_t((key * 0x9E3779B97F4A7C15ull) >> 32) & (MEM_TABLE_CAPACITY - 1);
+}
+
+static void
+Track(uint64_t key, VkDeviceSize size, uint32_t heap, MemCategory category)
+{
+    MemAllocTable& t = allocTable;
+    if (t.count >= MEM_TABLE_CAPACITY - 1) {
+        ++t.untrackedCount;
+        return;
+    }
+    uint32_t i = HashSlot(key);
+    while (t.entries[i].key) {
+        i = (i + 1) & (MEM_TABLE_CAPACITY - 1);
+    }
+    t.entries[i] = { key, size, uint8_t(heap), uint8_t(category) };
+    ++t.count;
+
+    t.bytes[category][heap] += size;
+    VkDeviceSize total = 0;
+    for (uint32_t h = 0; h < VK_MAX_MEMORY_HEAPS; ++h) {
+        total += t.bytes[category][h];
+    }
+    t.peakBytes[category] = Max(t.peakBytes[category], total);
+}
+
+static void
+Untrack(uint64_t key)
+{
+    MemAllocTable& t = allocTable;
+    uint32_t i = HashSlot(key);
+    while (t.entries[i].key != key) {
+        if (!t.entries[i].key) {
+            return; // not tracked
+        }
+        i = (i + 1) & (MEM_TABLE_CAPACITY - 1);
+    }
+    MemAllocEntry const e = t.entries[i];
+    t.bytes[e.category][e.heap] -= e.size;
+    --t.count;
+
+    /* Shift later entries of the run back into the hole, unless they're already at or past their home slot. */
+    uint32_t hole = i;
+    for (uint32_t j = (i + 1) & (MEM_TABLE_CAPACITY - 1); t.entries[j].key; j = (j + 1) & (MEM_TABLE_CAPACITY - 1)) {
+        uint32_t const home = HashSlot(t.entries[j].key);
+        if (((j - home) & (MEM_TABLE_CAPACITY - 1)) >= ((j - hole) & (MEM_TABLE_CAPACITY - 1))) {
+            t.entries[hole] = t.entries[j];
+            hole = j;
+        }
+    }
+    t.entries[hole].key = 0;
+}
+
+VkResult
+MemBudget_Allocate(const VulkanRenderer& vkr, const VkMemoryAllocateInfo& info, MemCategory category,
+                   VkDeviceMemory *pMemory)
+{
+    VkResult const res = vkAllocateMemory(vkr.device, &info, nullptr, pMemory);
+    if (res == VK_SUCCESS) {
+        uint32_t const heap = vkr.caps.memory.memoryTypes[info.memoryTypeIndex].heapIndex;
+        Track((uint64_t)*pMemory, info.allocationSize, heap, category);
+    }
+    return res;
+}
+
+void
+MemBudget_Free(VkDevice device, VkDeviceMemory memory)
+{
+    if (memory) {
+        Untrack((uint64_t)memory);
+        vkFreeMemory(device, memory, nullptr);
+    }
+}
+
+VkDeviceSize
+MemBudget_GetCategoryBytes(MemCategory category, uint32_t heap)
+{
+    if (heap != UINT32_MAX) {
+        return allocTable.bytes[category][heap];
+    }
+    VkDeviceSize total = 0;
+    for (uint32_t h = 0; h < VK_MAX_MEMORY_HEAPS; ++h) {
+        total += allocTable.bytes[category][h];
+    }
+    return total;
+}
+
+//----- Sampling -----
+
+void
+MemBudget_Init(MemBudget& mb, const VulkanRenderer& vkr, const char *csvPath)
+{
+    mb = { };
+    mb.heapCount = vkr.caps.memory.memoryHeapCount;
+    mb.bFromDriver = vkr.caps.bMemoryBudget;
+    mb.warnFraction = 0.9f;
+    mb.clearFraction = 0.8f;
+    for (uint32_t h = 0; h < mb.heapCount; ++h) {
+        const VkMemoryHeap& heap = vkr.caps.memory.memoryHeaps[h];
+        mb.heapSize[h] = heap.size;
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            (!(vkr.caps.memory.memoryHeaps[mb.mainHeap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ||
+             heap.size > mb.heapSize[mb.mainHeap])) {
+            mb.mainHeap = h;
+        }
+    }
+
+    if (csvPath) {
+        mb.csv = fopen(csvPath, "w");
+        if (!mb.csv) {
+            printf("memory budget: can't write %s\n", csvPath);
+        } else {
+            fputs("sample", mb.csv);
+            for (uint32_t h = 0; h < mb.heapCount; ++h) {
+                fprintf(mb.csv, ",heap%u_usage,heap%u_budget", h, h);
+            }
+            for (uint32_t c = 0; c < MemCategory_Count; ++c) {
+                fprintf(mb.csv, ",%s", MemCategoryNames[c]);
+            }
+            fputc('\n', mb.csv);
+        }
+    }
+}
+
+void
+MemBudget_Finish(MemBudget& mb)
+{
+    if (mb.csv) {
+        fclose(mb.csv);
+    }
+    mb.csv = nullptr;
+}
+
+void
+MemBudget_Sample(MemBudget& mb, const VulkanRenderer& vkr)
+{
+    if (mb.bFromDriver) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+        VkPhysicalDeviceMemoryProperties2 props = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &budgetProps };
+        vkGetPhysicalDeviceMemoryProperties2(vkr.physicalDevice, &props);
+        for (uint32_t h = 0; h < mb.heapCount; ++h) {
+            mb.usage[h] = budgetProps.heapUsage[h];
+            mb.budget[h] = budgetProps.heapBudget[h];
+        }
+    } else {
+        for (uint32_t h = 0; h < mb.heapCount; ++h) {
+            VkDeviceSize used = 0;
+            for (uint32_t c = 0; c < MemCategory_Count; ++c) {
+                used += allocTable.bytes[c][h];
+            }
+            mb.usage[h] = used;
+            mb.budget[h] = mb.heapSize[h] / 5 * 4;
+        }
+    }
+
+    for (uint32_t h = 0; h < mb.heapCount; ++h) {
+        mb.peakUsage[h] = Max(mb.peakUsage[h], mb.usage[h]);
+        double const fraction = mb.budget[h] ? double(mb.usage[h]) / double(mb.budget[h]) : 0.0;
+        bool const bOver = mb.bOver[h] ? fraction >= mb.clearFraction : fraction >= mb.warnFraction;
+        if (bOver != mb.bOver[h]) {
+            mb.bOver[h] = bOver;
+            printf("memory budget: heap %u %s, %u of %u MiB\n", h, bOver ? "near its budget" : "back under",
+                   uint(mb.usage[h] >> 20), uint(mb.budget[h] >> 20));
+            if (mb.pfnCallback) {
+                mb.pfnCallback(mb.pCallbackUser, h, mb.usage[h], mb.budget[h], bOver);
+            }
+        }
+    }
+
+    if (mb.csv) {
+        fprintf(mb.csv, "%u", mb.sampleCount);
+        for (uint32_t h = 0; h < mb.heapCount; ++h) {
+            fprintf(mb.csv, ",%llu,%llu", (unsigned long long)mb.usage[h], (unsigned long long)mb.budget[h]);
+        }
+        for (uint32_t c = 0; c < MemCategory_Count; ++c) {
+            fprintf(mb.csv, ",%llu", (unsigned long long)MemBudget_GetCategoryBytes(MemCategory(c), UINT32_MAX));
+        }
+        fputc('\n', mb.csv);
+    }
+    ++mb.sampleCount;
+}
+
+void
+MemBudget_Print(const MemBudget& mb)
+{
+    printf("memory (%s):\n", mb.bFromDriver ? "VK_EXT_memory_budget" : "tracked only, no VK_EXT_memory_budget");
+    for (uint32_t h = 0; h < mb.heapCount; ++h) {
+        printf("  heap %u%s: %u MiB used, %u MiB budget, %u MiB peak, %u MiB heap\n", h,
+               h == mb.mainHeap ? " (main)" : "", uint(mb.usage[h] >> 20), uint(mb.budget[h] >> 20),
+               uint(mb.peakUsage[h] >> 20), uint(mb.heapSize[h] >> 20));
+    }
+    for (uint32_t c = 0; c < MemCategory_Count; ++c) {
+        printf("  %s: %u KiB (peak %u KiB)\n", MemCategoryNames[c],
+               uint(MemBudget_GetCategoryBytes(MemCategory(c), UINT32_MAX) >> 10), uint(allocTable.peakBytes[c] >> 10));
+    }
+    if (allocTable.untrackedCount) {
+        printf("  %u allocations not counted, the table was full\n", allocTable.untrackedCount);
+    }
+}
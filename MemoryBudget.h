@@ -0,0 +1,69 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+#include <stdio.h>
+
+/*
+    GPU memory telemetry: per heap, how much is in use and how much the process can use, sampled every frame.
+
+    With VK_EXT_memory_budget (enabled whenever the device has it, see DeviceCaps) both come from the driver,
+    usage then includes everything the process allocated, the swapchain too, and the budget reflects other
+    processes. Without it usage is only what went through MemBudget_Allocate and the budget is 80% of the heap.
+
+    Allocations made through MemBudget_Allocate/MemBudget_Free are also counted per category and heap, which is
+    what says where the memory went. VKH_CreateBuffer does this itself, as Staging for buffers that are only
+    copied from or to, else Buffers. They're looked up by VkDeviceMemory on free, so MemBudget_Free is fine with
+    memory that wasn't tracked. Not thread safe, allocate on the main thread.
+
+    When a heap's usage reaches warnFraction of its budget the callback is called with bOver, and again without
+    once it's back under clearFraction, so something like texture streaming can shed memory and grow back.
+*/
+
+enum MemCategory : uint8_t {
+    MemCategory_Textures,
+    MemCategory_Buffers,
+    MemCategory_RenderTargets,
+    MemCategory_Staging, // upload and readback
+    MemCategory_Count
+};
+
+typedef void (*MemBudgetCallback)(void *pUser, uint32_t heap, VkDeviceSize usage, VkDeviceSize budget, bool bOver);
+
+struct MemBudget {
+    uint32_t heapCount;
+    uint32_t mainHeap; // the largest DEVICE_LOCAL one, what the title shows
+    bool bFromDriver; // VK_EXT_memory_budget
+    VkDeviceSize heapSize[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize usage[VK_MAX_MEMORY_HEAPS]; // last MemBudget_Sample
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize peakUsage[VK_MAX_MEMORY_HEAPS];
+    bool bOver[VK_MAX_MEMORY_HEAPS]; // between the callbacks
+
+    float warnFraction; // 0.9 by default
+    float clearFraction; // 0.8
+    MemBudgetCallback pfnCallback;
+    void *pCallbackUser;
+
+    FILE *csv; // a row per sample, null if not logging
+    uint32_t sampleCount;
+};
+
+// Allocates and counts it under category, on the heap of info.memoryTypeIndex.
+VkResult MemBudget_Allocate(const VulkanRenderer& vkr, const VkMemoryAllocateInfo& info, MemCategory category,
+                            VkDeviceMemory *pMemory);
+// vkFreeMemory, and uncounts it if it was allocated above. Null is fine.
+void MemBudget_Free(VkDevice device, VkDeviceMemory memory);
+
+// What MemBudget_Allocate has live in category on heap, summed over all heaps if heap is UINT32_MAX.
+VkDeviceSize MemBudget_GetCategoryBytes(MemCategory category, uint32_t heap);
+
+// csvPath may be null. Set the callback after this, before the first sample.
+void MemBudget_Init(MemBudget& mb, const VulkanRenderer& vkr, const char *csvPath);
+void MemBudget_Finish(MemBudget& mb);
+
+// Every frame. Calls the callback on a heap going over warnFraction or back under clearFraction.
+void MemBudget_Sample(MemBudget& mb, const VulkanRenderer& vkr);
+
+// Heaps with usage, budget and peak, and the categories. Multiple lines.
+void MemBudget_Print(const MemBudget& mb);
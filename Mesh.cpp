@@ -0,0 +1,394 @@
+#include "Mesh.h"
+#include "VulkanSwapchain.h" // OS_MapFileReadOnly, OS_GetTicks
+
+#include <math.h>
+#include <stddef.h> // offsetof
+#include <stdio.h>
+#include <stdlib.h>
+
+// Matches shaders/mesh.vert.
+struct MeshPushConstants {
+    mat4f clipFromModel;
+    vec4f posScale;
+    vec4f posOffset;
+};
+
+/*  One-shot copy of the staging buffer into the vertex and index buffers on the universal queue.
+    Load time only, so it just waits on a fence.
+*/
+static VkResult
+SubmitStagingCopy(const VulkanRenderer& vkr, const BufferAllocation& staging, const GpuMesh& mesh, VkDeviceSize indexOffset)
+{
+    VkCommandPool pool = VKH_CreateCommandPool(vkr.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, vkr.families.universal);
+    VkCommandBuffer cmd = VKH_AllocateCommandBuffer(vkr.device, pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    const VkBufferCopy vertexRegion = { 0, 0, mesh.vertices.size };
+    vkCmdCopyBuffer(cmd, staging.buffer, mesh.vertices.buffer, 1, &vertexRegion);
+    const VkBufferCopy indexRegion = { indexOffset, 0, mesh.indices.size };
+    vkCmdCopyBuffer(cmd, staging.buffer, mesh.indices.buffer, 1, &indexRegion);
+
+    /* Later submissions read these as vertex input. */
+    VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    mb.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 1, &mb, 0, nullptr, 0, nullptr);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence = nullptr;
+    VkResult res = vkCreateFence(vkr.device, &fenceInfo, nullptr, &fence);
+    if (res == VK_SUCCESS) {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        res = vkQueueSubmit(vkr.universalQueue0, 1, &submitInfo, fence);
+        if (res == VK_SUCCESS) {
+            res = vkWaitForFences(vkr.device, 1, &fence, true, uint64_t(-1));
+        }
+        vkDestroyFence(vkr.device, fence, nullptr);
+    }
+    vkDestroyCommandPool(vkr.device, pool, nullptr);
+    return res;
+}
+
+bool
+Mesh_Load(GpuMesh& mesh, const VulkanRenderer& vkr, const char *path)
+{
+    mesh = { };
+    os_tick_t const beginTicks = OS_GetTicks();
+
+    os_mapped_file file;
+    if (!OS_MapFileReadOnly(path, &file)) {
+        printf("Mesh: can't open %s\n", path);
+        return false;
+    }
+    MeshFileHeader header = { };
+    memcpy(&header, file.data, file.size < sizeof header ? file.size : sizeof header);
+    const char *err = MeshFile_Validate(header, file.size);
+    if (!err) err = MeshFile_ValidateIndices(header, file.data);
+    if (err) {
+        printf("Mesh: %s: %s\n", path, err);
+        OS_UnmapFile(file);
+        return false;
+    }
+
+    const ubyte *const fileBytes = static_cast<const ubyte *>(file.data);
+    VkDeviceSize const vertexBytes = VkDeviceSize(header.vertexCount) * header.vertexStride;
+    VkDeviceSize const indexBytes = VkDeviceSize(header.indexCount) * header.indexSize;
+
+    /* Host visible device-local memory is preferred only when all device-local memory is (integrated GPUs),
+       on a discrete GPU the small host visible window is better left to other things.
+    */
+    VkMemoryPropertyFlags const preferred = vkr.caps.bUnifiedMemory ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : 0;
+    bool ok = VKH_CreateBuffer(vkr, vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, preferred, &mesh.vertices) == VK_SUCCESS &&
+              VKH_CreateBuffer(vkr, indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, preferred, &mesh.indices) == VK_SUCCESS;
+
+    bool bStaged = false;
+    if (ok && mesh.vertices.pMapped && mesh.indices.pMapped) {
+        memcpy(mesh.vertices.pMapped, fileBytes + header.vertexDataOffset, size_t(vertexBytes));
+        memcpy(mesh.indices.pMapped, fileBytes + header.indexDataOffset, size_t(indexBytes));
+        const VkMappedMemoryRange ranges[2] = {
+            { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mesh.vertices.memory, 0, VK_WHOLE_SIZE },
+            { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mesh.indices.memory, 0, VK_WHOLE_SIZE },
+        };
+        VK_CHECK(vkFlushMappedMemoryRanges(vkr.device, 2, ranges)); // a no-op if coherent
+        /* Host writes before vkQueueSubmit are visible to the GPU without a barrier. */
+    } else if (ok) {
+        VkDeviceSize const indexOffset = MeshFile_AlignUp(vertexBytes);
+        BufferAllocation staging;
+        ok = VKH_CreateBuffer(vkr, indexOffset + indexBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                              &staging) == VK_SUCCESS;
+        if (ok) {
+            ubyte *const dst = static_cast<ubyte *>(staging.pMapped);
+            memcpy(dst, fileBytes + header.vertexDataOffset, size_t(vertexBytes));
+            memcpy(dst + indexOffset, fileBytes + header.indexDataOffset, size_t(indexBytes));
+            ok = SubmitStagingCopy(vkr, staging, mesh, indexOffset) == VK_SUCCESS;
+            VKH_DestroyBuffer(vkr.device, staging);
+            bStaged = true;
+        }
+    }
+    OS_UnmapFile(file);
+
+    if (!ok) {
+        printf("Mesh: %s: couldn't create or fill the buffers\n", path);
+        Mesh_Destroy(mesh, vkr.device);
+        return false;
+    }
+
+    mesh.vertexCount = header.vertexCount;
+    mesh.indexCount = header.indexCount;
+    mesh.indexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    mesh.posScale = { header.posScale[0], header.posScale[1], header.posScale[2] };
+    mesh.posOffset = { header.posOffset[0], header.posOffset[1], header.posOffset[2] };
+
+    float const ms = float(OS_GetTicks() - beginTicks) * 1000.0f / float(OS_TicksPerSecond());
+    printf("Mesh: %s: %u vertices, %u triangles, %u KiB, %s, loaded in %.2f ms\n", path,
+           mesh.vertexCount, mesh.indexCount / 3, uint((vertexBytes + indexBytes) >> 10),
+           bStaged ? "staged" : "direct", ms);
+    return true;
+}
+
+void
+Mesh_Destroy(GpuMesh& mesh, VkDevice device)
+{
+    VKH_DestroyBuffer(device, mesh.vertices);
+    VKH_DestroyBuffer(device, mesh.indices);
+    mesh = { };
+}
+
+vec3f
+Mesh_GetCenter(const GpuMesh& mesh)
+{
+    return mesh.posOffset + mesh.posScale * 0.5f;
+}
+
+float
+Mesh_GetRadius(const GpuMesh& mesh)
+{
+    return 0.5f * sqrtf(dot(mesh.posScale, mesh.posScale));
+}
+
+bool
+Mesh_WriteTorus(const char *path, uint32_t rings, uint32_t segments)
+{
+    float const R = 1.0f, r = 0.35f;
+    uint32_t const vertexCount = (rings + 1) * (segments + 1); // seams duplicated for the UVs
+    uint32_t const indexCount = rings * segments * 6;
+
+    float const boxMin[3] = { -(R + r), -(R + r), -r };
+    float const boxMax[3] = { R + r, R + r, r };
+    MeshFileHeader h;
+    MeshFile_InitHeader(h, vertexCount, indexCount, boxMin, boxMax);
+    size_t const fileSize = size_t(MeshFile_GetFileSize(h));
+
+    ubyte *const bytes = (ubyte *)calloc(1, fileSize);
+    if (!bytes) {
+        return false;
+    }
+    memcpy(bytes, &h, sizeof h);
+
+    MeshFileVertex *const v = (MeshFileVertex *)(bytes + h.vertexDataOffset);
+    for (uint32_t i = 0; i <= rings; ++i) {
+        float const u = float(i) / float(rings);
+        vec2f const cu = cos_sin_tau(u);
+        for (uint32_t j = 0; j <= segments; ++j) {
+            float const w = float(j) / float(segments);
+            vec2f const cw = cos_sin_tau(w);
+            float const n[3] = { cu.x * cw.x, cu.y * cw.x, cw.y };
+            float const p[3] = { cu.x * R + n[0] * r, cu.y * R + n[1] * r, n[2] * r };
+            MeshFileVertex& out = v[i * (segments + 1) + j];
+            for (int k = 0; k < 3; ++k) {
+                out.pos[k] = MeshFile_QuantizeUnorm16((p[k] - h.posOffset[k]) / h.posScale[k]);
+            }
+            MeshFile_EncodeOctahedral(n, out.normal);
+            out.uv[0] = MeshFile_FloatToHalf(u * 4);
+            out.uv[1] = MeshFile_FloatToHalf(w);
+        }
+    }
+
+    ubyte *const indexBytes = bytes + h.indexDataOffset;
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < rings; ++i) {
+        for (uint32_t j = 0; j < segments; ++j) {
+            uint32_t const a = i * (segments + 1) + j, b = a + segments + 1;
+            const uint32_t quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+            for (uint32_t idx : quad) {
+                if (h.indexSize == 2) {
+                    ((uint16_t *)indexBytes)[k++] = uint16_t(idx);
+                } else {
+                    ((uint32_t *)indexBytes)[k++] = idx;
+                }
+            }
+        }
+    }
+
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(bytes, 1, fileSize, f) == fileSize;
+    if (f) {
+        ok = (fclose(f) == 0) && ok;
+    }
+    free(bytes);
+    printf("%s %s: %u vertices, %u triangles\n", ok ? "wrote" : "failed to write", path, vertexCount, indexCount / 3);
+    return ok;
+}
+
+
+static VkPipeline
+CreateMeshPipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                   VkShaderModule vs, VkShaderModule fs)
+{
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vs, "main" },
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main" },
+    };
+
+    const VkVertexInputBindingDescription binding = { 0, sizeof(MeshFileVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+    const VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(MeshFileVertex, pos) },
+        { 1, 0, VK_FORMAT_R8G8_SNORM, offsetof(MeshFileVertex, normal) },
+        { 2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(MeshFileVertex, uv) },
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    vertexInput.vertexBindingDescriptionCount = 1;
+    vertexInput.pVertexBindingDescriptions = &binding;
+    vertexInput.vertexAttributeDescriptionCount = lengthof(attributes);
+    vertexInput.pVertexAttributeDescriptions = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    raster.cullMode = VK_CULL_MODE_BACK_BIT;
+    raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    raster.lineWidth = 1.0f;
+
+    VkPipelineColorBlendAttachmentState blendAttachment = { false };
+    blendAttachment.colorWriteMask = 0xf;
+    VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkPipelineViewportStateCreateInfo viewport = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    depthStencil.depthTestEnable = true;
+    depthStencil.depthWriteEnable = true;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = samples;
+
+    const VkDynamicState dynamics[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO, nullptr, 0,
+        lengthof(dynamics), dynamics
+    };
+
+    VkGraphicsPipelineCreateInfo psoInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    psoInfo.stageCount = lengthof(stages);
+    psoInfo.pStages = stages;
+    psoInfo.pVertexInputState = &vertexInput;
+    psoInfo.pInputAssemblyState = &inputAssembly;
+    psoInfo.pViewportState = &viewport;
+    psoInfo.pRasterizationState = &raster;
+    psoInfo.pMultisampleState = &multisample;
+    psoInfo.pDepthStencilState = &depthStencil;
+    psoInfo.pColorBlendState = &blend;
+    psoInfo.pDynamicState = &dynamic;
+    psoInfo.layout = layout;
+    psoInfo.renderPass = renderPass;
+    psoInfo.subpass = 0;
+
+    VkPipeline pso = nullptr;
+    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &psoInfo, nullptr, &pso));
+    return pso;
+}
+
+bool
+MeshPipeline_Create(MeshPipeline& mp, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                    uint32_t slotCount)
+{
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    mp = { };
+    mp.vs = VKH_LoadShaderModule(device, "shaders/mesh.vert.spv");
+    mp.fs = VKH_LoadShaderModule(device, "shaders/mesh.frag.spv");
+    if (!mp.vs || !mp.fs) {
+        MeshPipeline_Destroy(mp, device);
+        return false;
+    }
+
+    const VkDescriptorSetLayoutBinding binding = {
+        0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    setLayoutInfo.bindingCount = 1;
+    setLayoutInfo.pBindings = &binding;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &mp.setLayout));
+
+    const VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slotCount };
+    VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.maxSets = slotCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &mp.descriptorPool));
+
+    VkDescriptorSetLayout setLayouts[GPUTIMER_MAX_SLOTS];
+    for (uint32_t i = 0; i < slotCount; ++i) setLayouts[i] = mp.setLayout;
+    VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = mp.descriptorPool;
+    allocInfo.descriptorSetCount = slotCount;
+    allocInfo.pSetLayouts = setLayouts;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, mp.sets));
+
+    const VkPushConstantRange pushRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants) };
+    VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mp.setLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &mp.layout));
+
+    mp.pso = CreateMeshPipeline(device, mp.layout, renderPass, samples, mp.vs, mp.fs);
+    return true;
+}
+
+void
+MeshPipeline_SetRenderPass(MeshPipeline& mp, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples)
+{
+    if (!mp.pso) {
+        return;
+    }
+    vkDestroyPipeline(device, mp.pso, nullptr);
+    mp.pso = CreateMeshPipeline(device, mp.layout, renderPass, samples, mp.vs, mp.fs);
+}
+
+void
+MeshPipeline_Destroy(MeshPipeline& mp, VkDevice device)
+{
+    vkDestroyPipeline(device, mp.pso, nullptr);
+    vkDestroyPipelineLayout(device, mp.layout, nullptr);
+    vkDestroyDescriptorPool(device, mp.descriptorPool, nullptr); // frees the sets
+    vkDestroyDescriptorSetLayout(device, mp.setLayout, nullptr);
+    vkDestroyShaderModule(device, mp.vs, nullptr);
+    vkDestroyShaderModule(device, mp.fs, nullptr);
+    mp = { };
+}
+
+void
+MeshPipeline_SetTexture(MeshPipeline& mp, VkDevice device, uint32_t slot, VkImageView view, VkSampler sampler)
+{
+    const VkDescriptorImageInfo imageInfo = { sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = mp.sets[slot];
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void
+Mesh_CmdDraw(const GpuMesh& mesh, const MeshPipeline& mp, CmdEncoder& enc, uint32_t slot, const mat4f& clipFromModel)
+{
+    MeshPushConstants pc;
+    pc.clipFromModel = clipFromModel;
+    pc.posScale = make_vec4f(mesh.posScale.x, mesh.posScale.y, mesh.posScale.z, 0);
+    pc.posOffset = make_vec4f(mesh.posOffset.x, mesh.posOffset.y, mesh.posOffset.z, 0);
+
+    CmdEncoder_BindPipeline(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, mp.pso);
+    CmdEncoder_BindDescriptorSets(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, mp.layout, 0, 1, &mp.sets[slot]);
+    CmdEncoder_PushConstants(enc, mp.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pc, &pc);
+    CmdEncoder_BindVertexBuffer(enc, mesh.vertices.buffer, 0);
+    CmdEncoder_BindIndexBuffer(enc, mesh.indices.buffer, 0, mesh.indexType);
+    CmdEncoder_DrawIndexed(enc, mesh.indexCount, 1, 0, 0, 0);
+}
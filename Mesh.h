@@ -0,0 +1,59 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "MeshFormat.h"
+#include "VecMath.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+#include "CmdEncoder.h"
+
+/*
+    A .vkm mesh (see MeshFormat.h) in device-local vertex and index buffers, and the pipeline that draws it.
+
+    Mesh_Load maps the file and copies the vertex and index data as-is into a staging buffer, then
+    vkCmdCopyBuffer's it into the device-local buffers. The vertex input does the dequantization
+    (UNORM16 / SNORM8 / SFLOAT16 formats) plus a scale and offset in the vertex shader.
+    With unified memory the device-local buffers are host visible and the staging copy is skipped.
+*/
+
+struct GpuMesh {
+    BufferAllocation vertices;
+    BufferAllocation indices;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    VkIndexType indexType;
+    vec3f posScale;
+    vec3f posOffset;
+};
+
+// Blocks until the upload is done. Returns false (and prints why) if the file can't be used.
+bool Mesh_Load(GpuMesh& mesh, const VulkanRenderer& vkr, const char *path);
+void Mesh_Destroy(GpuMesh& mesh, VkDevice device);
+
+// Center and radius of the quantization box, good enough to frame the mesh.
+vec3f Mesh_GetCenter(const GpuMesh& mesh);
+float Mesh_GetRadius(const GpuMesh& mesh);
+
+// Writes a torus in the .vkm format, for trying this without any other tools.
+bool Mesh_WriteTorus(const char *path, uint32_t rings, uint32_t segments);
+
+
+struct MeshPipeline {
+    VkShaderModule vs, fs;
+    VkDescriptorSetLayout setLayout; // binding 0: the albedo texture, multiplied with the shading
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sets[GPUTIMER_MAX_SLOTS]; // one per frame slot, so the texture can change every frame
+    VkPipelineLayout layout;
+    VkPipeline pso;
+};
+
+// False if the shaders are missing (see README), mp is then zeroed.
+bool MeshPipeline_Create(MeshPipeline& mp, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                         uint32_t slotCount);
+// The GPU must be idle. Does nothing if mp wasn't created.
+void MeshPipeline_SetRenderPass(MeshPipeline& mp, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples);
+void MeshPipeline_Destroy(MeshPipeline& mp, VkDevice device);
+// Before recording the slot's draws, the slot's previous frame must be complete.
+void MeshPipeline_SetTexture(MeshPipeline& mp, VkDevice device, uint32_t slot, VkImageView view, VkSampler sampler);
+
+// Inside the render pass. Viewport and scissor must be set.
+void Mesh_CmdDraw(const GpuMesh& mesh, const MeshPipeline& mp, CmdEncoder& enc, uint32_t slot, const mat4f& clipFromModel);
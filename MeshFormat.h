@@ -0,0 +1,185 @@
+#pragma once
+
+#include "common.h"
+
+#include <string.h>
+
+/*
+    .vkm mesh files: a header, then the vertex and index data exactly as the GPU reads it, so loading is
+    a map + memcpy into a buffer, nothing is converted per vertex.
+
+    Vertex, 16 bytes:
+        uint16 pos[4]   R16G16B16A16_UNORM, position = posOffset + pos.xyz * posScale, w unused
+        int8 normal[2]  R8G8_SNORM, octahedral
+        uint8 pad[2]
+        uint16 uv[2]    R16G16_SFLOAT
+    (3-component 16-bit formats aren't required to be vertex buffer formats, hence the 4th position component.)
+
+    Indices are uint16 if vertexCount <= 65536, else uint32.
+
+    Shared with the tools, so no Vulkan here. Little-endian only.
+*/
+
+#define MESHFILE_MAGIC 0x4D4C4B56u // "VKLM"
+#define MESHFILE_VERSION 1u
+#define MESHFILE_DATA_ALIGN 16u
+
+struct MeshFileVertex {
+    uint16_t pos[4];
+    int8_t normal[2];
+    uint8_t pad[2];
+    uint16_t uv[2];
+};
+static_assert(sizeof(MeshFileVertex) == 16, "vertex layout");
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize; // 2 or 4
+    uint32_t vertexStride; // sizeof(MeshFileVertex)
+    float posScale[3];
+    float posOffset[3];
+    uint64_t vertexDataOffset; // from the start of the file, MESHFILE_DATA_ALIGN aligned
+    uint64_t indexDataOffset;
+};
+
+// Returns null if the header or the sizes don't make sense for a file of fileSize bytes.
+inline const char *
+MeshFile_Validate(const MeshFileHeader& h, uint64_t fileSize)
+{
+    if (fileSize < sizeof h || h.magic != MESHFILE_MAGIC) return "not a .vkm file";
+    if (h.version != MESHFILE_VERSION) return "unsupported version";
+    if (h.vertexStride != sizeof(MeshFileVertex)) return "unexpected vertex stride";
+    if (h.vertexCount == 0 || h.indexCount == 0) return "empty mesh"; // zero-sized buffers aren't allowed
+    if (h.indexSize != (h.vertexCount <= 65536 ? 2u : 4u)) return "unexpected index size";
+    if (h.indexCount % 3 != 0) return "index count is not a multiple of 3";
+    if (h.vertexDataOffset % MESHFILE_DATA_ALIGN || h.indexDataOffset % MESHFILE_DATA_ALIGN) return "misaligned data";
+    // Each range is checked against what's left after its offset, an offset + size could wrap.
+    if (h.vertexDataOffset < sizeof h || h.vertexDataOffset > h.indexDataOffset ||
+        uint64_t(h.vertexCount) * h.vertexStride > h.indexDataOffset - h.vertexDataOffset ||
+        h.indexDataOffset > fileSize ||
+        uint64_t(h.indexCount) * h.indexSize > fileSize - h.indexDataOffset) return "truncated";
+    return nullptr;
+}
+
+/*  After MeshFile_Validate, with the whole file. Returns null if every index is < vertexCount: robustBufferAccess
+    isn't enabled, so an index past the vertex buffer would read out of bounds on the GPU.
+*/
+inline const char *
+MeshFile_ValidateIndices(const MeshFileHeader& h, const void *fileData)
+{
+    const uint8_t *const p = static_cast<const uint8_t *>(fileData) + h.indexDataOffset;
+    uint32_t maxIndex = 0;
+    if (h.indexSize == 2) {
+        for (uint32_t i = 0; i < h.indexCount; ++i) {
+            uint16_t x;
+            memcpy(&x, p + i * 2u, 2);
+            maxIndex = Max(maxIndex, uint32_t(x));
+        }
+    } else {
+        for (uint32_t i = 0; i < h.indexCount; ++i) {
+            uint32_t x;
+            memcpy(&x, p + size_t(i) * 4u, 4);
+            maxIndex = Max(maxIndex, x);
+        }
+    }
+    return h.indexCount != 0 && maxIndex >= h.vertexCount ? "index out of range" : nullptr;
+}
+
+inline uint64_t
+MeshFile_AlignUp(uint64_t x)
+{
+    return (x + MESHFILE_DATA_ALIGN - 1) & ~uint64_t(MESHFILE_DATA_ALIGN - 1);
+}
+
+//----- Encoding, for whatever writes .vkm files -----
+
+/*  Fills in everything for a tightly packed file: header, vertices, indices, each aligned.
+    The box is what the quantized positions span, a flat axis gets a tiny extent so nothing divides by zero.
+*/
+inline void
+MeshFile_InitHeader(MeshFileHeader& h, uint32_t vertexCount, uint32_t indexCount, const float boxMin[3], const float boxMax[3])
+{
+    h = { };
+    h.magic = MESHFILE_MAGIC;
+    h.version = MESHFILE_VERSION;
+    h.vertexCount = vertexCount;
+    h.indexCount = indexCount;
+    h.indexSize = vertexCount <= 65536 ? 2 : 4;
+    h.vertexStride = sizeof(MeshFileVertex);
+    for (int k = 0; k < 3; ++k) {
+        h.posOffset[k] = boxMin[k];
+        h.posScale[k] = Max(boxMax[k] - boxMin[k], 1e-6f);
+    }
+    h.vertexDataOffset = MeshFile_AlignUp(sizeof h);
+    h.indexDataOffset = MeshFile_AlignUp(h.vertexDataOffset + uint64_t(vertexCount) * h.vertexStride);
+}
+
+inline uint64_t
+MeshFile_GetFileSize(const MeshFileHeader& h)
+{
+    return h.indexDataOffset + uint64_t(h.indexCount) * h.indexSize;
+}
+
+// v in [0, 1]
+inline uint16_t
+MeshFile_QuantizeUnorm16(float v)
+{
+    v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+    return uint16_t(v * 65535.0f + 0.5f);
+}
+
+// v in [-1, 1]
+inline int8_t
+MeshFile_QuantizeSnorm8(float v)
+{
+    v = v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+    return int8_t(v >= 0 ? v * 127.0f + 0.5f : v * 127.0f - 0.5f);
+}
+
+/*  Octahedral normal encoding: project onto the octahedron |x|+|y|+|z| = 1, fold the lower half over the
+    diagonals. n must be normalized. 2x8 bits gives under a degree of error, enough for shading.
+*/
+inline void
+MeshFile_EncodeOctahedral(const float n[3], int8_t out[2])
+{
+    float const invL1 = 1.0f / (Abs(n[0]) + Abs(n[1]) + Abs(n[2]));
+    float x = n[0] * invL1, y = n[1] * invL1;
+    if (n[2] < 0.0f) {
+        float const fx = (1.0f - Abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float const fy = (1.0f - Abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = MeshFile_QuantizeSnorm8(x);
+    out[1] = MeshFile_QuantizeSnorm8(y);
+}
+
+// Round to nearest even, overflow goes to infinity, denormals are kept.
+inline uint16_t
+MeshFile_FloatToHalf(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    uint32_t const sign = (u >> 16) & 0x8000u;
+    uint32_t const absBits = u & 0x7FFFFFFFu;
+    if (absBits >= 0x7F800000u) { // inf or nan
+        return uint16_t(sign | 0x7C00u | (absBits > 0x7F800000u ? 0x200u : 0));
+    }
+    if (absBits >= 0x477FF000u) { // rounds to >= 65520
+        return uint16_t(sign | 0x7C00u);
+    }
+    if (absBits < 0x38800000u) { // below the smallest normal half, 2^-14
+        float af;
+        memcpy(&af, &absBits, 4);
+        float const scaled = af * 16777216.0f; // 2^24, one ulp of a half denormal
+        uint32_t h = uint32_t(scaled);
+        float const rem = scaled - float(h);
+        h += (rem > 0.5f || (rem == 0.5f && (h & 1))) ? 1 : 0;
+        return uint16_t(sign | h);
+    }
+    uint32_t const rounded = absBits + 0xFFFu + ((absBits >> 13) & 1);
+    return uint16_t(sign | ((rounded - 0x38000000u) >> 13));
+}
@@ -0,0 +1,332 @@
+#include "MipGen.h"
+
+#include <stdio.h>
+
+// Matches the push constants in shaders/mipgen.comp.
+struct MipGenPushConstants {
+    int32_t width, height;
+    uint32_t levelCount;
+    uint32_t bSrgb;
+    uint32_t groupsX;
+    uint32_t groupCount;
+};
+
+#define MIPGEN_TILE 64 // level 0 texels per workgroup in x and y
+#define MIPGEN_MAX_GROUPS ((4096 / MIPGEN_TILE) * (4096 / MIPGEN_TILE))
+#define MIPGEN_SCRATCH_HEADER 16 // the counter, padded to the vec4 array
+
+bool
+MipGen_Create(MipGenerator& mg, const VulkanRenderer& vkr)
+{
+    mg = { };
+    VkDevice const device = vkr.device;
+
+    if (!vkr.caps.features.shaderStorageImageWriteWithoutFormat) {
+        puts("MipGen: no shaderStorageImageWriteWithoutFormat, using blits");
+        return false;
+    }
+    VkShaderModule const cs = VKH_LoadShaderModule(device, "shaders/mipgen.comp.spv");
+    if (!cs) {
+        puts("MipGen: shaders/mipgen.comp.spv missing, using blits");
+        return false;
+    }
+
+    bool ok = VKH_CreateBuffer(vkr, MIPGEN_SCRATCH_HEADER + MIPGEN_MAX_GROUPS * 16,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &mg.scratch) == VK_SUCCESS;
+    if (ok) {
+        const VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MIPGEN_MAX_LEVELS - 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+        };
+        VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = lengthof(bindings);
+        layoutInfo.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &mg.setLayout));
+
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MipGenPushConstants) };
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &mg.setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &mg.pipelineLayout));
+
+        VkComputePipelineCreateInfo computeInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        computeInfo.stage = {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT, cs, "main"
+        };
+        computeInfo.layout = mg.pipelineLayout;
+        VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &computeInfo, nullptr, &mg.pipeline));
+
+        VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &mg.sampler));
+    }
+    else {
+        puts("MipGen: couldn't allocate the scratch buffer, using blits");
+    }
+
+    vkDestroyShaderModule(device, cs, nullptr);
+
+    if (!ok) {
+        MipGen_Destroy(mg, device);
+    }
+    return ok;
+}
+
+void
+MipGen_Destroy(MipGenerator& mg, VkDevice device)
+{
+    vkDestroySampler(device, mg.sampler, nullptr);
+    vkDestroyPipeline(device, mg.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, mg.pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, mg.setLayout, nullptr);
+    VKH_DestroyBuffer(device, mg.scratch);
+    mg = { };
+}
+
+VkFormat
+MipGen_GetStorageFormat(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_SRGB: return VK_FORMAT_R8G8B8A8_UNORM;
+    case VK_FORMAT_B8G8R8A8_SRGB: return VK_FORMAT_B8G8R8A8_UNORM;
+    case VK_FORMAT_A8B8G8R8_SRGB_PACK32: return VK_FORMAT_A8B8G8R8_UNORM_PACK32;
+    default: return format;
+    }
+}
+
+VkImageCreateFlags
+MipGen_GetImageCreateFlags(VkFormat format)
+{
+    /* EXTENDED_USAGE: STORAGE usage is then only checked against the views' formats, not the sRGB one. */
+    return MipGen_GetStorageFormat(format) != format ?
+        VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT : 0;
+}
+
+bool
+MipGen_IsSupported(const MipGenerator& mg, const VulkanRenderer& vkr, VkFormat format, VkExtent2D extent)
+{
+    if (!mg.pipeline || extent.width > 4096 || extent.height > 4096) return false;
+
+    VkFormatProperties sampled, storage;
+    vkGetPhysicalDeviceFormatProperties(vkr.physicalDevice, format, &sampled);
+    vkGetPhysicalDeviceFormatProperties(vkr.physicalDevice, MipGen_GetStorageFormat(format), &storage);
+    return (sampled.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
+           (storage.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+static VkImageView
+CreateLevelView(VkDevice device, VkImage image, VkFormat format, uint32_t level, VkImageUsageFlags usage)
+{
+    /* With EXTENDED_USAGE a view inherits the image's usage, limit it to what the view's format can do. */
+    VkImageViewUsageCreateInfo usageInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+    usageInfo.usage = usage;
+
+    VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    viewInfo.pNext = &usageInfo;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.components = COMPONENT_MAPPING_IDENTITY;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+    VkImageView view = nullptr;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+    return view;
+}
+
+void
+MipGen_CreateTarget(const MipGenerator& mg, VkDevice device, VkImage image, VkFormat format, VkExtent2D extent,
+                    uint32_t levelCount, MipGenTarget *pOut)
+{
+    ASSERT(mg.pipeline);
+    ASSERT(levelCount >= 2 && levelCount <= MIPGEN_MAX_LEVELS);
+    ASSERT((Max(extent.width, extent.height) >> (levelCount - 1)) >= 1);
+
+    MipGenTarget& t = *pOut;
+    t = { };
+    t.image = image;
+    t.extent = extent;
+    t.levelCount = levelCount;
+    VkFormat const storageFormat = MipGen_GetStorageFormat(format);
+    t.bSrgb = storageFormat != format;
+
+    t.srcView = CreateLevelView(device, image, format, 0, VK_IMAGE_USAGE_SAMPLED_BIT);
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        t.levelViews[level - 1] = CreateLevelView(device, image, storageFormat, level, VK_IMAGE_USAGE_STORAGE_BIT);
+    }
+
+    const VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MIPGEN_MAX_LEVELS - 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = lengthof(poolSizes);
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &t.descriptorPool));
+
+    VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = t.descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &mg.setLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &t.set));
+
+    /* Every array element must be valid, the ones past the last level repeat it (the shader never stores there). */
+    const VkDescriptorImageInfo srcInfo = { mg.sampler, t.srcView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkDescriptorImageInfo levelInfos[MIPGEN_MAX_LEVELS - 1];
+    for (uint32_t i = 0; i < lengthof(levelInfos); ++i) {
+        levelInfos[i] = { nullptr, t.levelViews[Min(i, levelCount - 2)], VK_IMAGE_LAYOUT_GENERAL };
+    }
+    const VkDescriptorBufferInfo scratchInfo = { mg.scratch.buffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet writes[3] = { };
+    for (VkWriteDescriptorSet& w : writes) {
+        w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        w.dstSet = t.set;
+        w.descriptorCount = 1;
+    }
+    writes[0].dstBinding = 0;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &srcInfo;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = lengthof(levelInfos);
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = levelInfos;
+    writes[2].dstBinding = 2;
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[2].pBufferInfo = &scratchInfo;
+    vkUpdateDescriptorSets(device, lengthof(writes), writes, 0, nullptr);
+}
+
+void
+MipGen_DestroyTarget(VkDevice device, MipGenTarget& t)
+{
+    vkDestroyDescriptorPool(device, t.descriptorPool, nullptr);
+    vkDestroyImageView(device, t.srcView, nullptr);
+    for (VkImageView view : t.levelViews) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    t = { };
+}
+
+void
+MipGen_CmdGenerate(MipGenerator& mg, VkCommandBuffer cmd, const MipGenTarget& t,
+                   VkImageLayout level0Layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+{
+    if (!mg.bScratchCleared) {
+        vkCmdFillBuffer(cmd, mg.scratch.buffer, 0, MIPGEN_SCRATCH_HEADER, 0);
+        srcStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        srcAccess |= VK_ACCESS_TRANSFER_WRITE_BIT;
+        mg.bScratchCleared = true;
+    }
+
+    /* The scratch buffer is shared by all targets, the previous dispatch must be done with it. */
+    VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | (srcAccess & VK_ACCESS_TRANSFER_WRITE_BIT);
+    mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkImageMemoryBarrier ib[2] = { };
+    ib[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    ib[0].srcAccessMask = srcAccess;
+    ib[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    ib[0].oldLayout = level0Layout;
+    ib[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ib[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[0].image = t.image;
+    ib[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    ib[1] = ib[0];
+    ib[1].srcAccessMask = 0;
+    ib[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    ib[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ib[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    ib[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, t.levelCount - 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd, srcStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &mb, 0, nullptr, lengthof(ib), ib);
+
+    MipGenPushConstants pc;
+    pc.width = int32_t(t.extent.width);
+    pc.height = int32_t(t.extent.height);
+    pc.levelCount = t.levelCount;
+    pc.bSrgb = t.bSrgb;
+    pc.groupsX = (t.extent.width + MIPGEN_TILE - 1) / MIPGEN_TILE;
+    uint32_t const groupsY = (t.extent.height + MIPGEN_TILE - 1) / MIPGEN_TILE;
+    pc.groupCount = pc.groupsX * groupsY;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mg.pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mg.pipelineLayout, 0, 1, &t.set, 0, nullptr);
+    vkCmdPushConstants(cmd, mg.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof pc, &pc);
+    vkCmdDispatch(cmd, pc.groupsX, groupsY, 1);
+
+    ib[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    ib[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    ib[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    ib[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &ib[1]);
+}
+
+void
+MipGen_CmdBlitChain(VkCommandBuffer cmd, VkImage image, VkExtent2D extent, uint32_t levelCount,
+                    VkImageLayout level0Layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+{
+    VkImageMemoryBarrier ib[2] = { };
+    ib[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    ib[0].srcAccessMask = srcAccess;
+    ib[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    ib[0].oldLayout = level0Layout;
+    ib[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ib[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[0].image = image;
+    ib[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    ib[1] = ib[0];
+    ib[1].srcAccessMask = 0;
+    ib[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    ib[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ib[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ib[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, levelCount - 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, lengthof(ib), ib);
+
+    int32_t w = int32_t(extent.width), h = int32_t(extent.height);
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        int32_t const nw = Max(w >> 1, 1), nh = Max(h >> 1, 1);
+        VkImageBlit blit = { };
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+        blit.srcOffsets[1] = { w, h, 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        blit.dstOffsets[1] = { nw, nh, 1 };
+        vkCmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+
+        /* The next blit reads this level: a full drain between levels, which is what the compute path avoids. */
+        ib[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        ib[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        ib[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        ib[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        ib[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &ib[1]);
+        w = nw;
+        h = nh;
+    }
+
+    ib[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    ib[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    ib[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ib[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ib[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &ib[0]);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    Mip chain generation from level 0, two ways:
+
+    MipGen_CmdGenerate is a single compute dispatch (shaders/mipgen.comp, after AMD's FidelityFX SPD). Workgroups
+    reduce 64x64 tiles through levels 1-6 in shared memory, and the last one to finish (a global atomic counter
+    decides) does levels 7-12 from the tiles' level 6 texels. One barrier before and one after, whatever the
+    level count.
+
+    MipGen_CmdBlitChain is the usual vkCmdBlitImage per level with a barrier between each, so the GPU drains
+    once per level, mostly for a handful of texels at the end. Works on any format with linear blit support,
+    and is what to fall back to when MipGen_IsSupported says no.
+
+    The compute path writes storage images, which sRGB formats don't support. An sRGB image is created with
+    MipGen_GetImageCreateFlags (MUTABLE_FORMAT | EXTENDED_USAGE) so its levels can be written through UNORM views,
+    the shader does the encode. Level 0 is read through a view in the image's own format, so sRGB is decoded.
+
+    `vklab --bench-mips` times both on the swapchain's format and exits.
+*/
+
+#define MIPGEN_MAX_LEVELS 13 // level 0 and 12 more, i.e. up to 4096x4096
+
+struct MipGenerator {
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkSampler sampler; // nearest, the shader only uses texelFetch
+    BufferAllocation scratch; // the workgroup counter, then one level 6 texel per workgroup
+    bool bScratchCleared; // the first MipGen_CmdGenerate zeroes the counter, the shader leaves it at 0 after
+};
+
+// The views and descriptor set MipGen_CmdGenerate needs for one image.
+struct MipGenTarget {
+    VkImage image;
+    VkExtent2D extent;
+    uint32_t levelCount;
+    bool bSrgb;
+    VkImageView srcView; // level 0, sampled in the image's format
+    VkImageView levelViews[MIPGEN_MAX_LEVELS - 1]; // levels 1.., storage, in MipGen_GetStorageFormat
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet set;
+};
+
+// Returns false, with mg zeroed, if the shader is missing or the device can't do it. The blit chain still works.
+bool MipGen_Create(MipGenerator& mg, const VulkanRenderer& vkr);
+void MipGen_Destroy(MipGenerator& mg, VkDevice device);
+
+// The format the levels are written as: the UNORM twin of an 8-bit sRGB format, else format itself.
+VkFormat MipGen_GetStorageFormat(VkFormat format);
+// Flags for VkImageCreateInfo so the image can be a MipGen target, 0 unless format is sRGB.
+VkImageCreateFlags MipGen_GetImageCreateFlags(VkFormat format);
+
+// Whether an image of this format and size can be a MipGen target (with SAMPLED | STORAGE usage).
+bool MipGen_IsSupported(const MipGenerator& mg, const VulkanRenderer& vkr, VkFormat format, VkExtent2D extent);
+
+// levelCount is at most the full chain and at most MIPGEN_MAX_LEVELS. Check MipGen_IsSupported first.
+void MipGen_CreateTarget(const MipGenerator& mg, VkDevice device, VkImage image, VkFormat format, VkExtent2D extent,
+                         uint32_t levelCount, MipGenTarget *pOut);
+void MipGen_DestroyTarget(VkDevice device, MipGenTarget& t);
+
+/*  Both record outside a render pass. Level 0 is in level0Layout, last written in srcStage with srcAccess (e.g.
+    a copy: TRANSFER, TRANSFER_WRITE); the other levels' contents are discarded. Afterwards every level is in
+    SHADER_READ_ONLY_OPTIMAL and visible to fragment and compute shader reads.
+*/
+void MipGen_CmdGenerate(MipGenerator& mg, VkCommandBuffer cmd, const MipGenTarget& t,
+                        VkImageLayout level0Layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess);
+// image needs TRANSFER_SRC | TRANSFER_DST usage and a format with linear filtered blits.
+void MipGen_CmdBlitChain(VkCommandBuffer cmd, VkImage image, VkExtent2D extent, uint32_t levelCount,
+                         VkImageLayout level0Layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess);
+
+// Times both ways on a few sizes of `format` and prints how far apart their results are. Returns a main() exit code.
+int MipGen_RunBenchmark(const VulkanRenderer& vkr, VkFormat format);
@@ -0,0 +1,317 @@
+#include "MipGen.h"
+#include "GpuTimer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    --bench-mips: for a few sizes, generate the full chain of an image both ways, a number of times each, and
+    print the GPU times. Then read both chains back and compare them texel by texel, for the power of two sizes
+    (where a linear blit of exactly half size is the same 2x2 box the shader uses). The non-square ones check the
+    levels after a side reaches 1, where both only read the one row or column there is.
+*/
+
+#define BENCH_ITERATIONS 20
+
+enum { Method_Compute, Method_Blit, Method_Count };
+
+struct BenchImage {
+    VkImage image;
+    VkDeviceMemory memory;
+};
+
+static bool
+CreateBenchImage(const VulkanRenderer& vkr, VkFormat format, VkExtent2D extent, uint32_t levelCount,
+                 VkImageUsageFlags usage, BenchImage *pOut)
+{
+    *pOut = { };
+    VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.flags = (usage & VK_IMAGE_USAGE_STORAGE_BIT) ? MipGen_GetImageCreateFlags(format) : 0;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = format;
+    info.extent = { extent.width, extent.height, 1 };
+    info.mipLevels = levelCount;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = usage;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(vkr.device, &info, nullptr, &pOut->image) != VK_SUCCESS) return false;
+
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(vkr.device, pOut->image, &req);
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = req.size;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(vkr.caps.memory, req.memoryTypeBits,
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(vkr.device, &allocInfo, nullptr, &pOut->memory) != VK_SUCCESS) {
+        return false;
+    }
+    VK_CHECK(vkBindImageMemory(vkr.device, pOut->image, pOut->memory, 0));
+    return true;
+}
+
+static void
+DestroyBenchImage(VkDevice device, BenchImage& b)
+{
+    vkDestroyImage(device, b.image, nullptr);
+    vkFreeMemory(device, b.memory, nullptr);
+    b = { };
+}
+
+static void
+SubmitAndWait(const VulkanRenderer& vkr, VkCommandBuffer cmd, VkFence fence)
+{
+    VK_CHECK(vkEndCommandBuffer(cmd));
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    VK_CHECK(vkQueueSubmit(vkr.universalQueue0, 1, &submitInfo, fence));
+    VK_CHECK(vkWaitForFences(vkr.device, 1, &fence, true, uint64_t(-1)));
+    VK_CHECK(vkResetFences(vkr.device, 1, &fence));
+}
+
+static void
+BeginCommands(VkCommandBuffer cmd)
+{
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+}
+
+static uint32_t
+FullChainLevels(VkExtent2D extent)
+{
+    uint32_t levels = 1;
+    for (uint32_t d = Max(extent.width, extent.height); d > 1; d >>= 1) ++levels;
+    return levels;
+}
+
+// Bytes of levels [1, levelCount) at 4 bytes per texel, tightly packed one after the other.
+static VkDeviceSize
+ChainBytes(VkExtent2D extent, uint32_t levelCount)
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        bytes += VkDeviceSize(Max(extent.width >> level, 1u)) * Max(extent.height >> level, 1u) * 4;
+    }
+    return bytes;
+}
+
+static void
+CmdCopyChainToBuffer(VkCommandBuffer cmd, VkImage image, VkExtent2D extent, uint32_t levelCount,
+                     VkBuffer buffer, VkDeviceSize offset)
+{
+    VkBufferImageCopy regions[MIPGEN_MAX_LEVELS];
+    uint32_t regionCount = 0;
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        VkBufferImageCopy& r = regions[regionCount++];
+        r = { };
+        r.bufferOffset = offset;
+        r.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        r.imageExtent = { Max(extent.width >> level, 1u), Max(extent.height >> level, 1u), 1 };
+        offset += VkDeviceSize(r.imageExtent.width) * r.imageExtent.height * 4;
+    }
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, regionCount, regions);
+}
+
+static void
+ImageBarrier(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+             VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier ib = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    ib.srcAccessMask = srcAccess;
+    ib.dstAccessMask = dstAccess;
+    ib.oldLayout = oldLayout;
+    ib.newLayout = newLayout;
+    ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib.image = image;
+    ib.subresourceRange = FULL_IMAGE_RANGE_COLOR;
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &ib);
+}
+
+int
+MipGen_RunBenchmark(const VulkanRenderer& vkr, VkFormat format)
+{
+    VkDevice const device = vkr.device;
+
+    /* The comparison reads texels as 4 bytes, and the point is the swapchain's 8-bit (s)RGB formats anyway. */
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB:
+        break;
+    default:
+        printf("bench-mips: format %d isn't 8-bit RGBA, using R8G8B8A8_SRGB\n", int(format));
+        format = VK_FORMAT_R8G8B8A8_SRGB;
+        break;
+    }
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(vkr.physicalDevice, format, &props);
+    VkFormatFeatureFlags const blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    bool const bBlit = (props.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+    MipGenerator mg;
+    MipGen_Create(mg, vkr);
+    GpuTimer timer;
+    GpuTimer_Create(timer, vkr, Method_Count);
+    if (!timer.queryPool) {
+        MipGen_Destroy(mg, device);
+        return 1;
+    }
+
+    VkCommandPool pool = VKH_CreateCommandPool(device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                               vkr.families.universal);
+    VkCommandBuffer cmd = VKH_AllocateCommandBuffer(device, pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence = nullptr;
+    VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+
+    printf("bench-mips: format %d, %d iterations, min/avg GPU ms per full chain\n", int(format), BENCH_ITERATIONS);
+    puts("  size          levels   single dispatch         blit chain       max diff");
+
+    static const VkExtent2D Sizes[] = { {4096, 4096}, {2048, 2048}, {1920, 1080}, {1024, 1024}, {256, 256},
+                                        {2048, 512}, {512, 2048} }; // the last two reach a side of 1 early
+    int exitCode = 0;
+    for (VkExtent2D const extent : Sizes) {
+        uint32_t const levelCount = FullChainLevels(extent);
+        bool const bCompute = MipGen_IsSupported(mg, vkr, format, extent);
+        if (!bCompute && !bBlit) {
+            puts("  neither way supports the format");
+            exitCode = 1;
+            break;
+        }
+
+        VkImageUsageFlags const baseUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                            VK_IMAGE_USAGE_SAMPLED_BIT;
+        BenchImage images[Method_Count] = { };
+        bool ok = true;
+        if (bCompute) {
+            ok = ok && CreateBenchImage(vkr, format, extent, levelCount, baseUsage | VK_IMAGE_USAGE_STORAGE_BIT,
+                                        &images[Method_Compute]);
+        }
+        if (bBlit) {
+            ok = ok && CreateBenchImage(vkr, format, extent, levelCount, baseUsage, &images[Method_Blit]);
+        }
+
+        /* Level 0 is noise, so any mistake in which texels are averaged shows up in the comparison. */
+        VkDeviceSize const level0Bytes = VkDeviceSize(extent.width) * extent.height * 4;
+        VkDeviceSize const chainBytes = ChainBytes(extent, levelCount);
+        BufferAllocation staging = { };
+        ok = ok && VKH_CreateBuffer(vkr, Max(level0Bytes, 2 * chainBytes),
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &staging) == VK_SUCCESS;
+        if (!ok) {
+            printf("  %4ux%-4u  couldn't create the images\n", extent.width, extent.height);
+            for (BenchImage& b : images) DestroyBenchImage(device, b);
+            VKH_DestroyBuffer(device, staging);
+            exitCode = 1;
+            continue;
+        }
+        {
+            uint32_t *texels = static_cast<uint32_t *>(staging.pMapped);
+            uint32_t x = 0x9e3779b9u;
+            for (VkDeviceSize i = 0; i < level0Bytes / 4; ++i) {
+                x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+                texels[i] = x;
+            }
+        }
+
+        BeginCommands(cmd);
+        VkBufferImageCopy region = { };
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { extent.width, extent.height, 1 };
+        for (BenchImage& b : images) {
+            if (!b.image) continue;
+            ImageBarrier(cmd, b.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdCopyBufferToImage(cmd, staging.buffer, b.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+        SubmitAndWait(vkr, cmd, fence);
+
+        MipGenTarget target = { };
+        if (bCompute) {
+            MipGen_CreateTarget(mg, device, images[Method_Compute].image, format, extent, levelCount, &target);
+        }
+
+        /* One submission per run, so a run's start timestamp can't overlap the previous run. */
+        float minMs[Method_Count], sumMs[Method_Count];
+        for (uint32_t m = 0; m < Method_Count; ++m) {
+            minMs[m] = 1e30f;
+            sumMs[m] = 0.0f;
+            if (!images[m].image) continue;
+            for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+                /* Level 0 stays as the first run left it, later runs just regenerate the rest. */
+                VkImageLayout const level0Layout = i ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+                                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                VkPipelineStageFlags const srcStage = i ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+                VkAccessFlags const srcAccess = i ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+
+                BeginCommands(cmd);
+                GpuTimer_CmdBegin(timer, cmd, m);
+                if (m == Method_Compute) {
+                    MipGen_CmdGenerate(mg, cmd, target, level0Layout, srcStage, srcAccess);
+                }
+                else {
+                    MipGen_CmdBlitChain(cmd, images[m].image, extent, levelCount, level0Layout, srcStage, srcAccess);
+                }
+                GpuTimer_CmdEnd(timer, cmd, m);
+                SubmitAndWait(vkr, cmd, fence);
+
+                float secs;
+                GpuTimer_GetSlotSecs(timer, device, m, &secs);
+                minMs[m] = Min(minMs[m], secs * 1000.0f);
+                sumMs[m] += secs * 1000.0f;
+            }
+        }
+
+        char diffText[32] = "-";
+        bool const bPowerOfTwo = !(extent.width & (extent.width - 1)) && !(extent.height & (extent.height - 1));
+        if (bCompute && bBlit && bPowerOfTwo) {
+            BeginCommands(cmd);
+            for (uint32_t m = 0; m < Method_Count; ++m) {
+                ImageBarrier(cmd, images[m].image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+                CmdCopyChainToBuffer(cmd, images[m].image, extent, levelCount, staging.buffer, m * chainBytes);
+            }
+            VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            mb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                                 0, 1, &mb, 0, nullptr, 0, nullptr);
+            SubmitAndWait(vkr, cmd, fence);
+
+            const ubyte *a = static_cast<const ubyte *>(staging.pMapped);
+            const ubyte *b = a + chainBytes;
+            int maxDiff = 0;
+            for (VkDeviceSize i = 0; i < chainBytes; ++i) {
+                maxDiff = Max(maxDiff, Abs(int(a[i]) - int(b[i])));
+            }
+            sprintf(diffText, "%d/255", maxDiff);
+        }
+
+        printf("  %4ux%-4u  %6u  ", extent.width, extent.height, levelCount);
+        for (uint32_t m = 0; m < Method_Count; ++m) {
+            if (images[m].image) printf("%7.3f / %7.3f  ", minMs[m], sumMs[m] / BENCH_ITERATIONS);
+            else printf("%17s  ", "unsupported");
+        }
+        printf("%8s\n", diffText);
+
+        if (bCompute) MipGen_DestroyTarget(device, target);
+        for (BenchImage& b : images) DestroyBenchImage(device, b);
+        VKH_DestroyBuffer(device, staging);
+    }
+
+    vkDestroyFence(device, fence, nullptr);
+    vkDestroyCommandPool(device, pool, nullptr);
+    GpuTimer_Destroy(timer, device);
+    MipGen_Destroy(mg, device);
+    return exitCode;
+}
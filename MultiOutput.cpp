@@ -0,0 +1,273 @@
+#include "MultiOutput.h"
+
+#include <stdio.h>
+
+static void
+OnResizeOutput(void *userPtr, int w, int h, bool isIconic)
+{
+    OutputWindow& o = *static_cast<OutputWindow *>(userPtr);
+    o.bIconic = isIconic;
+    o.windowSize = { uint32_t(w), uint32_t(h) };
+}
+
+static void
+DestroyOutput(OutputWindow& o, const VulkanRenderer& vkr)
+{
+    for (VkSemaphore sema : o.acquireSemas) {
+        vkDestroySemaphore(vkr.device, sema, nullptr);
+    }
+    Swapchain_DestroySwapchainAndSurface(o.sc, vkr.instance, vkr.device);
+    WindowWin32_Destroy(o.window);
+}
+
+static bool
+CreateOutput(OutputWindow& o, const VulkanRenderer& vkr, uint32_t number, uint32_t slotCount,
+             void (*onVirtualKey)(void *, uint32_t, virtual_key_action))
+{
+    o = { };
+    char title[32];
+    sprintf(title, "vklab output %u", number);
+    if (WindowWin32_Create(&o.window, 640, 480, title,
+                           WindowClassFlag_HorizontalRedraw | WindowClassFlag_VerticalRedraw) != 0) {
+        return false;
+    }
+    if (Swapchain_CreateSurfaceOnly(o.sc, vkr.instance, o.window.nativeHandle) != VK_SUCCESS) {
+        WindowWin32_Destroy(o.window);
+        return false;
+    }
+
+    /* The device was picked for the main window's surface, this one may be on an output it can't present to. */
+    VkBool32 bPresentable = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(vkr.physicalDevice, vkr.families.universal, o.sc.surface, &bPresentable);
+    VkSurfaceCapabilitiesKHR surfaceCaps;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vkr.physicalDevice, o.sc.surface, &surfaceCaps));
+    bool bOk = bPresentable && (surfaceCaps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+               Swapchain_InitParams(o.sc, vkr.physicalDevice, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false) == VK_SUCCESS;
+    if (bOk) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(vkr.physicalDevice, o.sc.format, &props);
+        bOk = (props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0;
+    }
+    if (!bOk) {
+        printf("output %u: the surface can't be presented to or blitted to\n", number);
+        DestroyOutput(o, vkr);
+        return false;
+    }
+
+    static const VkSemaphoreCreateInfo SemaCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        VK_CHECK(vkCreateSemaphore(vkr.device, &SemaCreateInfo, nullptr, &o.acquireSemas[i]));
+    }
+    o.imageIndex = UINT32_MAX;
+
+    o.window.user_ptr = &o;
+    o.window.user_cb = { OnResizeOutput, onVirtualKey };
+    Window_Show(o.window);
+    return true;
+}
+
+bool
+MultiOut_Create(MultiOutput& mo, const VulkanRenderer& vkr, const Swapchain& mainSc, uint32_t count,
+                uint32_t slotCount, void (*onVirtualKey)(void *, uint32_t, virtual_key_action))
+{
+    mo = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(vkr.physicalDevice, mainSc.format, &props);
+    if (!(mainSc.imageUsageBits & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) ||
+        !(props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
+        puts("multiple outputs: the swapchain images can't be blitted from");
+        return false;
+    }
+    mo.filter = (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR
+                                                                                                  : VK_FILTER_NEAREST;
+    mo.slotCount = slotCount;
+
+    for (uint32_t i = 0; i < Min(count, uint32_t(MULTIOUT_MAX)); ++i) {
+        mo.count += CreateOutput(mo.outputs[mo.count], vkr, i + 1, slotCount, onVirtualKey);
+    }
+    if (!mo.count) {
+        mo = { };
+        return false;
+    }
+    printf("multiple outputs: %u extra windows, presented with the main one\n", mo.count);
+    return true;
+}
+
+void
+MultiOut_Destroy(MultiOutput& mo, const VulkanRenderer& vkr)
+{
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        DestroyOutput(mo.outputs[i], vkr);
+    }
+    mo = { };
+}
+
+bool
+MultiOut_ShouldClose(const MultiOutput& mo)
+{
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        if (Window_ShouldClose(mo.outputs[i].window)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t
+MultiOut_Acquire(MultiOutput& mo, const VulkanRenderer& vkr, uint32_t slot, present_policy policy,
+                 bool bBeatsRefresh, VkSemaphore *pWaitSemas, VkPipelineStageFlags *pWaitStages)
+{
+    uint32_t waitCount = 0;
+    bool bIdle = false;
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        OutputWindow& o = mo.outputs[i];
+        o.imageIndex = UINT32_MAX;
+        if (o.bFailed || o.bIconic || !o.windowSize.width || !o.windowSize.height) {
+            continue;
+        }
+
+        VkPresentModeKHR const presentMode = Swapchain_ChoosePresentMode(o.sc, policy, bBeatsRefresh);
+        if (!o.sc.swapchain || o.bOutOfDate || o.windowSize != o.sc.lastCreatedExtent ||
+            presentMode != o.sc.presentMode) {
+            /* The old swapchain's images may still be blitted to by frames in flight. */
+            VkSwapchainKHR const oldSwapchain = o.sc.swapchain;
+            if (oldSwapchain && !bIdle) {
+                VK_CHECK(vkDeviceWaitIdle(vkr.device));
+                bIdle = true;
+            }
+            VkResult const res = Swapchain_Create(o.sc, vkr.physicalDevice, vkr.device, o.windowSize, presentMode);
+            if (oldSwapchain) {
+                vkDestroySwapchainKHR(vkr.device, oldSwapchain, nullptr);
+                if (res != VK_SUCCESS) {
+                    o.sc.swapchain = nullptr;
+                }
+            }
+            if (res != VK_SUCCESS) {
+                printf("output %u: vkCreateSwapchainKHR returned %d\n", i + 1, res);
+                o.bFailed = true;
+                continue;
+            }
+            o.bOutOfDate = false;
+        }
+
+        VkResult const res = vkAcquireNextImageKHR(vkr.device, o.sc.swapchain, uint64_t(-1), o.acquireSemas[slot],
+                                                   nullptr, &o.imageIndex);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            o.bOutOfDate = true; // nothing was acquired, the semaphore stays unsignaled
+            o.imageIndex = UINT32_MAX;
+            continue;
+        }
+        if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+            printf("output %u: vkAcquireNextImageKHR returned %d\n", i + 1, res);
+            o.bFailed = true;
+            o.imageIndex = UINT32_MAX;
+            continue;
+        }
+        o.bOutOfDate = res == VK_SUBOPTIMAL_KHR;
+        pWaitSemas[waitCount] = o.acquireSemas[slot];
+        pWaitStages[waitCount] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        ++waitCount;
+    }
+    return waitCount;
+}
+
+void
+MultiOut_CmdBlit(const MultiOutput& mo, VkCommandBuffer cmd, VkImage src, VkExtent2D srcExtent)
+{
+    /*  src was last written by the render pass, the compute output or dynamic resolution's blit, and last read by
+        a frame capture, so wait on all of them. The outputs' old contents can go, the source stage covers the
+        transfer stage their acquire semaphores are waited at.
+    */
+    VkImageMemoryBarrier ib[1 + MULTIOUT_MAX];
+    uint32_t n = 0;
+    ib[n] = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    ib[n].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    ib[n].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    ib[n].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    ib[n].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    ib[n].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[n].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    ib[n].image = src;
+    ib[n].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    ++n;
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        const OutputWindow& o = mo.outputs[i];
+        if (o.imageIndex != UINT32_MAX) {
+            ib[n] = ib[0];
+            ib[n].srcAccessMask = 0;
+            ib[n].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            ib[n].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            ib[n].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            ib[n].image = o.sc.images[o.imageIndex];
+            ++n;
+        }
+    }
+    if (n == 1) {
+        return;
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, n, ib);
+
+    VkImageBlit region;
+    region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.srcOffsets[0] = { 0, 0, 0 };
+    region.srcOffsets[1] = { int32_t(srcExtent.width), int32_t(srcExtent.height), 1 };
+    region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.dstOffsets[0] = { 0, 0, 0 };
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        const OutputWindow& o = mo.outputs[i];
+        if (o.imageIndex != UINT32_MAX) {
+            VkExtent2D const dstExtent = o.sc.lastCreatedExtent;
+            region.dstOffsets[1] = { int32_t(dstExtent.width), int32_t(dstExtent.height), 1 };
+            vkCmdBlitImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, o.sc.images[o.imageIndex],
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, mo.filter);
+        }
+    }
+
+    /* Back for the present, which waits on the submit's semaphore, so no later stage needs to wait. */
+    for (uint32_t i = 0; i < n; ++i) {
+        ib[i].srcAccessMask = i ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+        ib[i].dstAccessMask = 0;
+        ib[i].oldLayout = ib[i].newLayout;
+        ib[i].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 0, nullptr, n, ib);
+}
+
+uint32_t
+MultiOut_GetPresents(const MultiOutput& mo, VkSwapchainKHR *pSwapchains, uint32_t *pImageIndices)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        const OutputWindow& o = mo.outputs[i];
+        if (o.imageIndex != UINT32_MAX) {
+            pSwapchains[n] = o.sc.swapchain;
+            pImageIndices[n] = o.imageIndex;
+            ++n;
+        }
+    }
+    return n;
+}
+
+void
+MultiOut_OnPresented(MultiOutput& mo, const VkResult *pResults)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < mo.count; ++i) {
+        OutputWindow& o = mo.outputs[i];
+        if (o.imageIndex == UINT32_MAX) {
+            continue;
+        }
+        o.imageIndex = UINT32_MAX;
+        VkResult const res = pResults[n++];
+        if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
+            o.bOutOfDate = true;
+        } else if (res != VK_SUCCESS) {
+            printf("output %u: vkQueuePresentKHR returned %d, dropping it\n", i + 1, res);
+            o.bFailed = true;
+        }
+    }
+}
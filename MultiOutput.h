@@ -0,0 +1,74 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "VulkanSwapchain.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+#include "Window.h"
+
+/*
+    Extra output windows, each with its own surface and swapchain, showing the main window's frame scaled to
+    their size. All of them go through the frame's one submit and one vkQueuePresentKHR with the main
+    swapchain, instead of a submit and present round trip per window.
+
+    Per frame: MultiOut_Acquire recreates the swapchains whose window was resized or that the last present
+    reported out of date, then acquires an image from each visible one, giving the semaphores the submit waits
+    on (at VK_PIPELINE_STAGE_TRANSFER_BIT). MultiOut_CmdBlit blits the main swapchain image, once it's final,
+    to each of them. MultiOut_GetPresents appends them to the present's arrays, and MultiOut_OnPresented takes
+    their entries of VkPresentInfoKHR::pResults: OUT_OF_DATE and SUBOPTIMAL recreate that swapchain before its
+    next acquire, any other error takes the output out of the rotation. The main swapchain's result is the
+    caller's to check.
+
+    The main swapchain needs TRANSFER_SRC usage and a format that's a blit source, the outputs' swapchains are
+    created with TRANSFER_DST, and their surfaces have to be presentable from the universal family. An output
+    that can't do all that isn't created. A minimized or zero-area output is skipped until it's back.
+
+    Resizing an output waits for the device to go idle, they're secondary windows and rarely resized.
+    Closing any of them closes the app, like closing the main window.
+*/
+
+#define MULTIOUT_MAX 4
+
+struct OutputWindow {
+    Window window;
+    Swapchain sc;
+    VkExtent2D windowSize; // from WM_SIZE, zero until the window is shown
+    bool bIconic;
+    bool bOutOfDate; // the last acquire or present said so, recreated before the next acquire
+    bool bFailed; // creating, acquiring or presenting failed, not used again
+    VkSemaphore acquireSemas[GPUTIMER_MAX_SLOTS];
+    uint32_t imageIndex; // acquired this frame, UINT32_MAX if the output sits this frame out
+};
+
+struct MultiOutput {
+    OutputWindow outputs[MULTIOUT_MAX];
+    uint32_t count;
+    uint32_t slotCount;
+    VkFilter filter; // linear if the main swapchain's format can be filtered
+};
+
+/*  Opens count windows (at most MULTIOUT_MAX) that show frames of mainSc. Their keys go to onVirtualKey, as the
+    main window's do. Returns false, with mo zeroed, if the main swapchain can't be blitted from or no output
+    could be created.
+*/
+bool MultiOut_Create(MultiOutput& mo, const VulkanRenderer& vkr, const Swapchain& mainSc, uint32_t count,
+                     uint32_t slotCount, void (*onVirtualKey)(void *, uint32_t, virtual_key_action));
+// After vkDeviceWaitIdle.
+void MultiOut_Destroy(MultiOutput& mo, const VulkanRenderer& vkr);
+
+bool MultiOut_ShouldClose(const MultiOutput& mo);
+
+/*  After the main swapchain's acquire, with the frame slot's fence waited on. Writes a semaphore and stage
+    for each output acquired this frame, for the submit to wait on, and returns how many.
+*/
+uint32_t MultiOut_Acquire(MultiOutput& mo, const VulkanRenderer& vkr, uint32_t slot, present_policy policy,
+                          bool bBeatsRefresh, VkSemaphore *pWaitSemas, VkPipelineStageFlags *pWaitStages);
+
+/*  After everything that writes or reads the main swapchain image, src. It's in PRESENT_SRC_KHR and is left
+    there, the outputs' images end in PRESENT_SRC_KHR too.
+*/
+void MultiOut_CmdBlit(const MultiOutput& mo, VkCommandBuffer cmd, VkImage src, VkExtent2D srcExtent);
+
+// Appends the acquired outputs to the present's pSwapchains and pImageIndices, returns how many.
+uint32_t MultiOut_GetPresents(const MultiOutput& mo, VkSwapchainKHR *pSwapchains, uint32_t *pImageIndices);
+// pResults: the entries of VkPresentInfoKHR::pResults for the swapchains MultiOut_GetPresents appended.
+void MultiOut_OnPresented(MultiOutput& mo, const VkResult *pResults);
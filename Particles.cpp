@@ -0,0 +1,333 @@
+#include "Particles.h"
+
+#include <stdio.h>
+
+// Matches shaders/particles_common.glsl.
+struct Particle {
+    vec2f pos;
+    vec2f vel;
+    float age;
+    float life;
+    uint32_t color;
+    float pad;
+};
+static_assert(sizeof(Particle) == 32, "std430 layout");
+
+// Matches the push constants in shaders/particles_sim.comp.
+struct SimPushConstants {
+    vec2f emitterPos;
+    float dt;
+    uint32_t emitCount;
+    uint32_t srcIndex;
+    uint32_t seed;
+};
+
+#define PARTICLES_GROUP_SIZE 256
+#define PARTICLES_MEAN_LIFE_SECS 2.5f // see the emission in particles_sim.comp
+
+static VkPipeline
+CreateDrawPipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                   VkShaderModule vs, VkShaderModule fs)
+{
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vs, "main" },
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main" },
+    };
+
+    // No attributes, the vertex shader reads the particle buffer.
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+    VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    raster.cullMode = VK_CULL_MODE_NONE;
+    raster.lineWidth = 1.0f;
+
+    /* Additive, colors are premultiplied by the fade. Order independent, so the compaction order doesn't matter. */
+    VkPipelineColorBlendAttachmentState blendAttachment = { true };
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = 0xf;
+
+    VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkPipelineViewportStateCreateInfo viewport = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    // No depth test or write, the points are blended in any order anyway.
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = samples;
+
+    const VkDynamicState dynamics[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO, nullptr, 0,
+        lengthof(dynamics), dynamics
+    };
+
+    VkGraphicsPipelineCreateInfo psoInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    psoInfo.stageCount = lengthof(stages);
+    psoInfo.pStages = stages;
+    psoInfo.pVertexInputState = &vertexInput;
+    psoInfo.pInputAssemblyState = &inputAssembly;
+    psoInfo.pViewportState = &viewport;
+    psoInfo.pRasterizationState = &raster;
+    psoInfo.pMultisampleState = &multisample;
+    psoInfo.pDepthStencilState = &depthStencil;
+    psoInfo.pColorBlendState = &blend;
+    psoInfo.pDynamicState = &dynamic;
+    psoInfo.layout = layout;
+    psoInfo.renderPass = renderPass;
+    psoInfo.subpass = 0;
+
+    VkPipeline pso = nullptr;
+    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &psoInfo, nullptr, &pso));
+    return pso;
+}
+
+bool
+Particles_Create(ParticleSystem& ps, const VulkanRenderer& vkr, VkRenderPass renderPass,
+                 VkSampleCountFlagBits samples, uint32_t capacity, uint32_t slotCount)
+{
+    ps = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    capacity = (capacity + PARTICLES_GROUP_SIZE - 1) / PARTICLES_GROUP_SIZE * PARTICLES_GROUP_SIZE;
+    VkDevice const device = vkr.device;
+
+    VkShaderModule const simCS = VKH_LoadShaderModule(device, "shaders/particles_sim.comp.spv");
+    ps.drawVS = VKH_LoadShaderModule(device, "shaders/particles.vert.spv");
+    ps.drawFS = VKH_LoadShaderModule(device, "shaders/particles.frag.spv");
+    bool ok = simCS && ps.drawVS && ps.drawFS;
+
+    if (ok) {
+        VkDeviceSize const bytes = VkDeviceSize(capacity) * sizeof(Particle);
+        for (BufferAllocation& b : ps.particles) {
+            ok = ok && VKH_CreateBuffer(vkr, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &b) == VK_SUCCESS;
+        }
+        ok = ok && VKH_CreateBuffer(vkr, 2 * sizeof(VkDrawIndirectCommand),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &ps.args) == VK_SUCCESS;
+        ok = ok && VKH_CreateBuffer(vkr, GPUTIMER_MAX_SLOTS * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &ps.readback) == VK_SUCCESS;
+        if (!ok) {
+            printf("Particles: couldn't allocate buffers for %u particles\n", capacity);
+        }
+    }
+
+    if (ok) {
+        const VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+        };
+        VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = lengthof(bindings);
+        layoutInfo.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &ps.setLayout));
+
+        const VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * lengthof(bindings) };
+        VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.maxSets = 2;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &ps.descriptorPool));
+
+        const VkDescriptorSetLayout setLayouts[2] = { ps.setLayout, ps.setLayout };
+        VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocInfo.descriptorPool = ps.descriptorPool;
+        allocInfo.descriptorSetCount = 2;
+        allocInfo.pSetLayouts = setLayouts;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, ps.sets));
+
+        for (uint32_t i = 0; i < 2; ++i) {
+            const VkDescriptorBufferInfo infos[3] = {
+                { ps.particles[i].buffer, 0, VK_WHOLE_SIZE },
+                { ps.particles[i ^ 1].buffer, 0, VK_WHOLE_SIZE },
+                { ps.args.buffer, 0, VK_WHOLE_SIZE },
+            };
+            VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            write.dstSet = ps.sets[i];
+            write.dstBinding = 0;
+            write.descriptorCount = 3; // consecutive bindings
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = infos;
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        }
+
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SimPushConstants) };
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &ps.setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &ps.pipelineLayout));
+
+        VkComputePipelineCreateInfo computeInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        computeInfo.stage = {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT, simCS, "main"
+        };
+        computeInfo.layout = ps.pipelineLayout;
+        VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &computeInfo, nullptr, &ps.simPipeline));
+
+        ps.drawPipeline = CreateDrawPipeline(device, ps.pipelineLayout, renderPass, samples, ps.drawVS, ps.drawFS);
+
+        GpuTimer_Create(ps.simTimer, vkr, slotCount);
+
+        ps.capacity = capacity;
+        ps.emitPerSec = float(capacity) / PARTICLES_MEAN_LIFE_SECS;
+        ps.seed = 1;
+        printf("Particles: capacity %u (%u MiB per buffer)\n", capacity, uint(ps.particles[0].size >> 20));
+    }
+
+    vkDestroyShaderModule(device, simCS, nullptr);
+
+    if (!ok) {
+        Particles_Destroy(ps, device);
+    }
+    return ok;
+}
+
+void
+Particles_Destroy(ParticleSystem& ps, VkDevice device)
+{
+    GpuTimer_Destroy(ps.simTimer, device);
+    vkDestroyPipeline(device, ps.drawPipeline, nullptr);
+    vkDestroyPipeline(device, ps.simPipeline, nullptr);
+    vkDestroyShaderModule(device, ps.drawVS, nullptr);
+    vkDestroyShaderModule(device, ps.drawFS, nullptr);
+    vkDestroyPipelineLayout(device, ps.pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, ps.descriptorPool, nullptr); // frees the sets
+    vkDestroyDescriptorSetLayout(device, ps.setLayout, nullptr);
+    for (BufferAllocation& b : ps.particles) {
+        VKH_DestroyBuffer(device, b);
+    }
+    VKH_DestroyBuffer(device, ps.args);
+    VKH_DestroyBuffer(device, ps.readback);
+    ps = { };
+}
+
+void
+Particles_SetRenderPass(ParticleSystem& ps, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples)
+{
+    if (!ps.drawPipeline) {
+        return;
+    }
+    vkDestroyPipeline(device, ps.drawPipeline, nullptr);
+    ps.drawPipeline = CreateDrawPipeline(device, ps.pipelineLayout, renderPass, samples, ps.drawVS, ps.drawFS);
+}
+
+void
+Particles_RetireSlot(ParticleSystem& ps, VkDevice device, uint32_t slot)
+{
+    if (!ps.slotSimulated[slot]) {
+        return;
+    }
+    ps.slotSimulated[slot] = false;
+
+    ps.aliveCount = static_cast<const uint32_t *>(ps.readback.pMapped)[slot];
+    float simSecs;
+    if (GpuTimer_GetSlotSecs(ps.simTimer, device, slot, &simSecs) && simSecs > 0.0f) {
+        float const K = 16.0f;
+        ps.simSecsAvg = ps.simSecsAvg ? ps.simSecsAvg * ((K-1) / K) + simSecs * (1 / K) : simSecs;
+        ps.particlesPerMs = float(ps.aliveCount) / (ps.simSecsAvg * 1000);
+    }
+}
+
+void
+Particles_CmdSimulate(ParticleSystem& ps, VkCommandBuffer cmd, uint32_t slot, float dt, vec2f emitterPos)
+{
+    uint32_t const src = ps.srcIndex, dst = src ^ 1;
+
+    /*  Previous frames on this queue read the buffer written now (compute src, vertex shader, indirect args)
+        and wrote the one read now. A pipeline barrier's first scope covers earlier submissions too.
+    */
+    {
+        VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &mb, 0, nullptr, 0, nullptr);
+    }
+
+    /* Zero dst's alive count, the first time also set up both draws (vertexCount = alive, instanceCount = 1). */
+    if (!ps.bArgsInitialized) {
+        const VkDrawIndirectCommand initial[2] = { { 0, 1, 0, 0 }, { 0, 1, 0, 0 } };
+        vkCmdUpdateBuffer(cmd, ps.args.buffer, 0, sizeof initial, initial);
+        ps.bArgsInitialized = true;
+    } else {
+        vkCmdFillBuffer(cmd, ps.args.buffer, dst * sizeof(VkDrawIndirectCommand), sizeof(uint32_t), 0);
+    }
+    {
+        VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &mb, 0, nullptr, 0, nullptr);
+    }
+
+    float const emit = ps.emitPerSec * dt + ps.emitCarry;
+    SimPushConstants pc;
+    pc.emitterPos = emitterPos;
+    pc.dt = dt;
+    pc.emitCount = emit < float(ps.capacity) ? uint32_t(emit) : ps.capacity;
+    pc.srcIndex = src;
+    pc.seed = ps.seed = ps.seed * 747796405u + 2891336453u; // LCG, only needs to differ per frame
+    ps.emitCarry = emit - float(pc.emitCount);
+    if (ps.emitCarry > 1.0f) ps.emitCarry = 0.0f; // clamped, don't bank it
+
+    GpuTimer_CmdBegin(ps.simTimer, cmd, slot);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ps.simPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ps.pipelineLayout, 0, 1, &ps.sets[src], 0, nullptr);
+    vkCmdPushConstants(cmd, ps.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof pc, &pc);
+    /* Over the whole capacity, most groups past the alive + emitted count exit right away. */
+    vkCmdDispatch(cmd, ps.capacity / PARTICLES_GROUP_SIZE, 1, 1);
+    GpuTimer_CmdEnd(ps.simTimer, cmd, slot);
+
+    {
+        VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &mb, 0, nullptr, 0, nullptr);
+    }
+
+    const VkBufferCopy region = { dst * sizeof(VkDrawIndirectCommand), slot * sizeof(uint32_t), sizeof(uint32_t) };
+    vkCmdCopyBuffer(cmd, ps.args.buffer, ps.readback.buffer, 1, &region);
+    {
+        VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        mb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &mb, 0, nullptr, 0, nullptr);
+    }
+
+    ps.slotSimulated[slot] = true;
+    ps.srcIndex = dst;
+}
+
+void
+Particles_CmdDraw(const ParticleSystem& ps, CmdEncoder& enc)
+{
+    /* ps.srcIndex is the buffer the last simulation wrote, it's binding 1 of the other set. */
+    CmdEncoder_BindPipeline(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, ps.drawPipeline);
+    CmdEncoder_BindDescriptorSets(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, ps.pipelineLayout, 0, 1, &ps.sets[ps.srcIndex ^ 1]);
+    CmdEncoder_DrawIndirect(enc, ps.args.buffer, ps.srcIndex * sizeof(VkDrawIndirectCommand), 1,
+                            sizeof(VkDrawIndirectCommand));
+}
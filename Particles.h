@@ -0,0 +1,65 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "GpuTimer.h"
+#include "VecMath.h"
+#include "CmdEncoder.h"
+
+/*
+    GPU particles: the whole simulation lives in two storage buffers that swap roles every frame.
+
+    Particles_CmdSimulate records, outside the render pass:
+        - a compute dispatch that reads particles[src], emits, integrates and kills, and appends the survivors
+          to particles[dst] with an atomic alive count (compaction, so dst is dense),
+        - a barrier to the vertex shader and indirect draw, and a copy of the alive count for the CPU.
+    Particles_CmdDraw then draws particles[dst] as points inside the render pass with vkCmdDrawIndirect,
+    the vertex shader pulls each particle from the storage buffer by gl_VertexIndex.
+
+    Needs the .spv files for shaders/particles*, without them Particles_Create fails and the app runs without.
+*/
+
+struct ParticleSystem {
+    BufferAllocation particles[2];
+    BufferAllocation args; // VkDrawIndirectCommand[2], args[i].vertexCount is the alive count of particles[i]
+    BufferAllocation readback; // host visible, alive count after each frame slot's simulation
+
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sets[2]; // sets[i] reads particles[i] and writes particles[i^1]
+    VkPipelineLayout pipelineLayout;
+    VkPipeline simPipeline;
+    VkPipeline drawPipeline;
+    VkShaderModule drawVS, drawFS; // kept for Particles_SetRenderPass
+
+    GpuTimer simTimer; // brackets only the dispatch
+
+    uint32_t capacity;
+    uint32_t srcIndex; // flips every simulated frame
+    uint32_t seed;
+    float emitPerSec; // so that the steady-state count is about the capacity
+    float emitCarry; // fraction of a particle left from the last frame
+    bool bArgsInitialized;
+    bool slotSimulated[GPUTIMER_MAX_SLOTS];
+
+    // From the most recently retired simulated frame:
+    uint32_t aliveCount;
+    float simSecsAvg;
+    float particlesPerMs; // alive count / sim time
+};
+
+// Returns false if the shaders are missing or something couldn't be created, ps is then zeroed.
+bool Particles_Create(ParticleSystem& ps, const VulkanRenderer& vkr, VkRenderPass renderPass,
+                      VkSampleCountFlagBits samples, uint32_t capacity, uint32_t slotCount);
+void Particles_Destroy(ParticleSystem& ps, VkDevice device);
+
+// Recreates the draw pipeline for a new render pass. The GPU must be idle. Does nothing if ps wasn't created.
+void Particles_SetRenderPass(ParticleSystem& ps, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples);
+
+// Call after the slot's fence wait, every frame (even if the slot didn't simulate).
+void Particles_RetireSlot(ParticleSystem& ps, VkDevice device, uint32_t slot);
+
+// Outside a render pass. Afterwards particles[ps.srcIndex] holds the new state.
+void Particles_CmdSimulate(ParticleSystem& ps, VkCommandBuffer cmd, uint32_t slot, float dt, vec2f emitterPos);
+
+// Inside the render pass, after Particles_CmdSimulate this frame. Viewport and scissor must be set.
+void Particles_CmdDraw(const ParticleSystem& ps, CmdEncoder& enc);
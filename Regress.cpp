@@ -0,0 +1,328 @@
+#include "Regress.h"
+#include "FrameCapture.h" // FrameCapture_WriteTga
+#include "Mesh.h" // Mesh_WriteTorus
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Order matters: the particle state carries over from one particle scene to the next, like the real app. */
+static const RegressScene Scenes[] = {
+    // name              frames  MSAA  particles  mesh
+    { "triangles",           32,    1,    false, false },
+    { "triangles_msaa4",     32,    4,    false, false },
+    { "mesh",                48,    1,    false, true  },
+    { "mesh_msaa4",          32,    4,    false, true  },
+    { "particles",           64,    1,    true,  false },
+};
+static_assert(lengthof(Scenes) <= REGRESS_MAX_SCENES, "results array");
+
+struct PerfBaseline {
+    double cpuMs, submitMs, gpuMs;
+};
+
+/*  Reads a 24 or 32-bit TGA, raw or RLE, either origin, into RGB. Only what FrameCapture_WriteTga and the usual
+    image editors write. Returns null if it can't, else free() it.
+*/
+static ubyte *
+ReadTgaRgb(const char *path, uint32_t *pWidth, uint32_t *pHeight)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return nullptr;
+
+    ubyte header[18];
+    ubyte *rgb = nullptr;
+    if (fread(header, 1, sizeof header, f) == sizeof header && (header[2] == 2 || header[2] == 10) &&
+        (header[16] == 24 || header[16] == 32) && header[1] == 0) {
+        uint32_t const width = header[12] | (header[13] << 8);
+        uint32_t const height = header[14] | (header[15] << 8);
+        uint32_t const bpp = header[16] / 8u;
+        bool const bRle = header[2] == 10;
+        bool const bTopDown = (header[17] & 0x20) != 0;
+        fseek(f, header[0], SEEK_CUR); // image ID
+
+        size_t const count = size_t(width) * height;
+        rgb = static_cast<ubyte *>(malloc(count * 3 + 1));
+        bool ok = rgb != nullptr;
+        for (size_t i = 0; ok && i < count; ) {
+            uint32_t n = 1;
+            bool bRun = false;
+            if (bRle) {
+                int const packet = fgetc(f);
+                ok = packet != EOF;
+                n = (uint32_t(packet) & 0x7f) + 1;
+                bRun = (packet & 0x80) != 0;
+            }
+            ubyte px[4];
+            for (uint32_t j = 0; ok && j < n && i < count; ++j, ++i) {
+                if (j == 0 || !bRun) ok = fread(px, 1, bpp, f) == bpp;
+                size_t const y = i / width, x = i % width;
+                ubyte *dst = rgb + ((bTopDown ? y : height - 1 - y) * width + x) * 3;
+                dst[0] = px[2];
+                dst[1] = px[1];
+                dst[2] = px[0];
+            }
+        }
+        if (ok) {
+            *pWidth = width;
+            *pHeight = height;
+        }
+        else {
+            free(rgb);
+            rgb = nullptr;
+        }
+    }
+    fclose(f);
+    return rgb;
+}
+
+static bool
+ReadPerfBaseline(const RegressRun& r, const char *scene, PerfBaseline *pOut)
+{
+    char path[sizeof r.dir + 32];
+    sprintf(path, "%s/perf_baseline.txt", r.dir);
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[256];
+    bool found = false;
+    while (!found && fgets(line, sizeof line, f)) {
+        char name[64];
+        if (sscanf(line, "%63s %lf %lf %lf", name, &pOut->cpuMs, &pOut->submitMs, &pOut->gpuMs) == 4) {
+            found = !strcmp(name, scene);
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static bool
+PerfWithin(double ms, double baselineMs)
+{
+    return ms <= baselineMs * REGRESS_PERF_RATIO + REGRESS_PERF_SLACK_MS;
+}
+
+bool
+Regress_Init(RegressRun& r, const char *dir, bool bUpdate, const VulkanRenderer& vkr)
+{
+    r = { };
+    if (strlen(dir) + 1 > sizeof r.dir) {
+        printf("regress: directory name too long: %s\n", dir);
+        return false;
+    }
+    strcpy(r.dir, dir);
+    sprintf(r.meshPath, "%s/regress_torus.vkm", dir);
+    if (!Mesh_WriteTorus(r.meshPath, 96, 48)) {
+        printf("regress: can't write to %s\n", dir);
+        r = { };
+        return false;
+    }
+    strcpy(r.deviceName, vkr.caps.props.deviceName);
+    r.bUpdate = bUpdate;
+    r.scenes = Scenes;
+    r.sceneCount = lengthof(Scenes);
+    for (RegressResult& result : r.results) {
+        result.run = &r;
+        result.imageStatus = "not captured";
+    }
+    r.bActive = true;
+    printf("regress: %u scenes on %s, goldens in %s%s\n", r.sceneCount, r.deviceName, dir,
+           bUpdate ? " (updating)" : "");
+    return true;
+}
+
+const RegressScene *
+Regress_GetScene(const RegressRun& r)
+{
+    return r.sceneIndex < r.sceneCount ? &r.scenes[r.sceneIndex] : nullptr;
+}
+
+float
+Regress_GetClockSecs(const RegressRun& r)
+{
+    return float(r.frameIndex) * REGRESS_FRAME_SECS;
+}
+
+bool
+Regress_IsCaptureFrame(const RegressRun& r)
+{
+    const RegressScene *scene = Regress_GetScene(r);
+    return scene && r.frameInScene + 1 == scene->frameCount;
+}
+
+void *
+Regress_GetCaptureUser(RegressRun& r)
+{
+    return &r.results[r.sceneIndex];
+}
+
+void
+Regress_OnCapture(void *user, const ubyte *pixels, uint32_t width, uint32_t height, bool bBgra)
+{
+    RegressResult& result = *static_cast<RegressResult *>(user);
+    const RegressRun& r = *result.run;
+    const RegressScene& scene = r.scenes[&result - r.results];
+    result.bCaptured = true;
+    result.width = width;
+    result.height = height;
+
+    size_t const count = size_t(width) * height;
+    ubyte *rgb = static_cast<ubyte *>(malloc(count * 3));
+    if (!rgb) {
+        result.imageStatus = "out of memory";
+        return;
+    }
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < count; ++i) {
+        const ubyte *p = pixels + i*4;
+        rgb[i*3 + 0] = bBgra ? p[2] : p[0];
+        rgb[i*3 + 1] = p[1];
+        rgb[i*3 + 2] = bBgra ? p[0] : p[2];
+        for (int c = 0; c < 3; ++c) {
+            hash = (hash ^ rgb[i*3 + c]) * 0x100000001b3ull;
+        }
+    }
+    result.hash = hash;
+
+    char path[sizeof r.dir + 64];
+    sprintf(path, "%s/%s.tga", r.dir, scene.name);
+    uint32_t goldenWidth = 0, goldenHeight = 0;
+    ubyte *golden = r.bUpdate ? nullptr : ReadTgaRgb(path, &goldenWidth, &goldenHeight);
+    if (golden) {
+        if (goldenWidth != width || goldenHeight != height) {
+            result.imageStatus = "size mismatch";
+            result.bImagePass = false;
+        }
+        else {
+            double sumSq = 0.0;
+            for (size_t i = 0; i < count * 3; ++i) {
+                double const d = double(rgb[i]) - double(golden[i]);
+                sumSq += d * d;
+            }
+            double const mse = sumSq / double(count * 3);
+            result.psnrDb = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 999.0;
+            result.imageStatus = mse > 0.0 ? "psnr" : "identical";
+            result.bImagePass = result.psnrDb >= REGRESS_MIN_PSNR_DB;
+        }
+        free(golden);
+    }
+    else if (r.bUpdate) {
+        /* The capture's own pixels, so the writer can do the swizzle and RLE. */
+        ubyte *row = static_cast<ubyte *>(malloc(size_t(width) * 3));
+        bool const ok = row && FrameCapture_WriteTga(path, pixels, width, height, bBgra, row);
+        free(row);
+        result.psnrDb = 999.0;
+        result.imageStatus = ok ? "updated" : "couldn't write golden";
+        result.bImagePass = ok;
+    }
+    else {
+        /* Not written: a run that makes its own golden would pass whatever it drew. */
+        result.imageStatus = "no golden";
+        result.bImagePass = false;
+    }
+    free(rgb);
+}
+
+void
+Regress_EndFrame(RegressRun& r, float cpuSecs, float submitSecs)
+{
+    const RegressScene *scene = Regress_GetScene(r);
+    if (!scene) return;
+    if (r.frameInScene >= REGRESS_WARMUP_FRAMES) {
+        RegressResult& result = r.results[r.sceneIndex];
+        result.cpuMs += cpuSecs * 1000.0;
+        result.submitMs += submitSecs * 1000.0;
+        ++result.timedFrames;
+    }
+    ++r.frameIndex;
+    if (++r.frameInScene == scene->frameCount) {
+        r.frameInScene = 0;
+        ++r.sceneIndex;
+    }
+}
+
+void
+Regress_AddGpuTime(RegressRun& r, float secs)
+{
+    if (r.sceneIndex < r.sceneCount && r.frameInScene >= REGRESS_WARMUP_FRAMES) {
+        RegressResult& result = r.results[r.sceneIndex];
+        result.gpuMs += secs * 1000.0;
+        ++result.gpuFrames;
+    }
+}
+
+int
+Regress_Finish(RegressRun& r)
+{
+    if (!r.bActive) return 1;
+
+    char path[sizeof r.dir + 32];
+    sprintf(path, "%s/results.json", r.dir);
+    FILE *json = fopen(path, "w");
+    if (!json) {
+        printf("regress: can't write %s\n", path);
+        return 1;
+    }
+    fprintf(json, "{\n  \"device\": \"%s\",\n  \"frame_secs\": %g,\n", r.deviceName, double(REGRESS_FRAME_SECS));
+    fprintf(json, "  \"thresholds\": { \"min_psnr_db\": %g, \"perf_ratio\": %g, \"perf_slack_ms\": %g },\n",
+            REGRESS_MIN_PSNR_DB, double(REGRESS_PERF_RATIO), double(REGRESS_PERF_SLACK_MS));
+    fputs("  \"scenes\": [\n", json);
+
+    /* Only --regress-update writes a baseline, whole. Without one every scene fails its perf check. */
+    sprintf(path, "%s/perf_baseline.txt", r.dir);
+    bool const bWriteBaseline = r.bUpdate;
+    FILE *baselineFile = bWriteBaseline ? fopen(path, "w") : nullptr;
+    if (bWriteBaseline && !baselineFile) {
+        printf("regress: can't write %s\n", path);
+    }
+
+    bool bAllPass = true;
+    puts("regress:  scene              image            PSNR     cpu ms  submit ms   gpu ms  perf");
+    for (uint32_t i = 0; i < r.sceneCount; ++i) {
+        RegressResult& result = r.results[i];
+        const char *name = r.scenes[i].name;
+        if (result.timedFrames) {
+            result.cpuMs /= result.timedFrames;
+            result.submitMs /= result.timedFrames;
+        }
+        if (result.gpuFrames) {
+            result.gpuMs /= result.gpuFrames;
+        }
+
+        PerfBaseline base = { };
+        bool const bHasBaseline = !bWriteBaseline && ReadPerfBaseline(r, name, &base);
+        bool const bPerfPass = bWriteBaseline ? baselineFile != nullptr :
+                               bHasBaseline && PerfWithin(result.cpuMs, base.cpuMs) &&
+                               PerfWithin(result.submitMs, base.submitMs) && PerfWithin(result.gpuMs, base.gpuMs);
+        bool const bPass = result.bCaptured && result.bImagePass && bPerfPass;
+        bAllPass = bAllPass && bPass;
+
+        printf("  %-20s %-14s %7.2f  %9.3f  %9.3f  %7.3f  %s\n", name, result.imageStatus, result.psnrDb,
+               result.cpuMs, result.submitMs, result.gpuMs,
+               bWriteBaseline ? "updated" : !bHasBaseline ? "NO BASELINE" : bPerfPass ? "ok" : "REGRESSED");
+
+        fprintf(json, "    { \"name\": \"%s\", \"pass\": %s, \"width\": %u, \"height\": %u, \"hash\": \"%016llx\", "
+                      "\"image\": \"%s\", \"image_pass\": %s, \"psnr_db\": %.2f,\n",
+                name, bPass ? "true" : "false", result.width, result.height, (unsigned long long)result.hash,
+                result.imageStatus, result.bImagePass ? "true" : "false", result.psnrDb);
+        fprintf(json, "      \"cpu_ms\": %.4f, \"submit_ms\": %.4f, \"gpu_ms\": %.4f, \"timed_frames\": %u, ",
+                result.cpuMs, result.submitMs, result.gpuMs, result.timedFrames);
+        if (bHasBaseline) {
+            fprintf(json, "\"baseline\": { \"cpu_ms\": %.4f, \"submit_ms\": %.4f, \"gpu_ms\": %.4f }, ",
+                    base.cpuMs, base.submitMs, base.gpuMs);
+        }
+        fprintf(json, "\"perf_pass\": %s }%s\n", bPerfPass ? "true" : "false", i + 1 < r.sceneCount ? "," : "");
+
+        if (baselineFile) {
+            fprintf(baselineFile, "%s %.4f %.4f %.4f\n", name, result.cpuMs, result.submitMs, result.gpuMs);
+        }
+    }
+    fprintf(json, "  ],\n  \"pass\": %s\n}\n", bAllPass ? "true" : "false");
+    fclose(json);
+    if (baselineFile) {
+        fclose(baselineFile);
+        printf("regress: wrote %s\n", path);
+    }
+    printf("regress: %s, see %s/results.json\n", bAllPass ? "PASS" : "FAIL", r.dir);
+    return bAllPass ? 0 : 1;
+}
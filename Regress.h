@@ -0,0 +1,92 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    Golden-image and performance regression run: `vklab --regress=<dir>`.
+
+    Renders a fixed list of scenes through the normal frame loop, with the clock replaced by a fixed one
+    (REGRESS_FRAME_SECS per frame from 0) so every run draws the same frames. They're rendered into an offscreen
+    image of REGRESS_WIDTH x REGRESS_HEIGHT whatever the window's size or DPI, which is only blitted to the
+    window to be seen. The last frame of each scene is read back from that image through FrameCapture and
+    compared, on its worker thread, with <dir>/<scene>.tga: identical pixels
+    pass, else the PSNR must be at least REGRESS_MIN_PSNR_DB (particle compaction order isn't deterministic,
+    so their additive blend can differ in the last bit). A missing golden fails the scene.
+
+    CPU frame time (update to submitted), vkQueueSubmit time and GPU time are averaged over each scene's frames
+    after the warm-up, and compared with <dir>/perf_baseline.txt: a scene fails if one is more than
+    REGRESS_PERF_RATIO times its baseline plus REGRESS_PERF_SLACK_MS. Everything goes to <dir>/results.json,
+    and the exit code is 0 only if every scene passed. A scene missing from the baseline fails too.
+    --regress-update writes the goldens and the baseline instead of comparing, it's the only thing that does.
+
+    Goldens are only meaningful for one device and driver; for CI pick a software ICD, e.g. VKLAB_GPU=llvmpipe
+    (lavapipe) or VKLAB_GPU=SwiftShader. The window can be resized or minimized, though while it's minimized
+    the loop sleeps.
+*/
+
+#define REGRESS_WIDTH 640
+#define REGRESS_HEIGHT 480
+#define REGRESS_FRAME_SECS (1.0f / 60.0f)
+#define REGRESS_WARMUP_FRAMES 8 // longer than the frames in flight, so timings retired late stay in their scene
+#define REGRESS_MIN_PSNR_DB 40.0
+#define REGRESS_PERF_RATIO 1.15f
+#define REGRESS_PERF_SLACK_MS 0.1f
+#define REGRESS_MAX_SCENES 8
+
+struct RegressScene {
+    const char *name;
+    uint32_t frameCount; // including the warm-up, the last one is compared
+    uint32_t msaaSamples;
+    bool bParticles;
+    bool bMesh;
+};
+
+struct RegressRun;
+
+struct RegressResult {
+    const RegressRun *run;
+    // Written by the capture callback, on the worker thread:
+    bool bCaptured;
+    bool bImagePass;
+    const char *imageStatus; // "identical", "psnr", "no golden", "updated", "size mismatch", ...
+    uint32_t width, height;
+    uint64_t hash; // FNV-1a of the RGB bytes
+    double psnrDb;
+    // Render thread:
+    double cpuMs, submitMs, gpuMs; // sums, then averages in Regress_Finish
+    uint32_t timedFrames, gpuFrames;
+};
+
+struct RegressRun {
+    bool bActive;
+    bool bUpdate;
+    char dir[200];
+    char meshPath[240]; // a torus written into dir, for the mesh scenes
+    char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+    const RegressScene *scenes;
+    uint32_t sceneCount;
+    uint32_t sceneIndex;
+    uint32_t frameInScene;
+    uint32_t frameIndex; // drives the clock
+    RegressResult results[REGRESS_MAX_SCENES];
+};
+
+// False if dir can't be written to. The run is inactive (zeroed) unless this returns true.
+bool Regress_Init(RegressRun& r, const char *dir, bool bUpdate, const VulkanRenderer& vkr);
+
+// Null once every scene is done.
+const RegressScene *Regress_GetScene(const RegressRun& r);
+float Regress_GetClockSecs(const RegressRun& r);
+// The current frame is the one to compare, hand Regress_OnCapture to FrameCapture_RequestCallback with user
+// Regress_GetCaptureUser(r).
+bool Regress_IsCaptureFrame(const RegressRun& r);
+void *Regress_GetCaptureUser(RegressRun& r);
+void Regress_OnCapture(void *user, const ubyte *pixels, uint32_t width, uint32_t height, bool bBgra);
+
+// After the frame is submitted. Advances the clock and the scene.
+void Regress_EndFrame(RegressRun& r, float cpuSecs, float submitSecs);
+// A GPU time that just became available, counted for the current scene once it's warmed up.
+void Regress_AddGpuTime(RegressRun& r, float secs);
+
+// After FrameCapture_Destroy, so every capture has been compared. Writes results.json, returns a main() exit code.
+int Regress_Finish(RegressRun& r);
@@ -0,0 +1,135 @@
+#include "RenderTargets.h"
+#include "MemoryBudget.h"
+
+#include <stdio.h>
+
+VkFormat
+RenderTargets_ChooseDepthFormat(VkPhysicalDevice physicalDevice)
+{
+    const VkFormat candidates[] = {
+        VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D16_UNORM_S8_UINT
+    };
+    for (VkFormat format : candidates) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+VkSampleCountFlagBits
+RenderTargets_ClampSamples(const DeviceCaps& caps, uint32_t requested)
+{
+    VkSampleCountFlags const supported = caps.props.limits.framebufferColorSampleCounts &
+                                         caps.props.limits.framebufferDepthSampleCounts;
+    uint32_t samples = 64;
+    while (samples > 1 && (samples > requested || !(supported & samples))) {
+        samples >>= 1;
+    }
+    return VkSampleCountFlagBits(samples);
+}
+
+// Image plus dedicated memory and a view, *pLazy tells if the memory type is LAZILY_ALLOCATED.
+// Only transient images ask for that memory type.
+static VkResult
+CreateAttachmentImage(const VulkanRenderer& vkr, VkExtent2D extent, VkFormat format, VkSampleCountFlagBits samples,
+                      VkImageUsageFlags usage, bool bTransient, VkImageAspectFlags aspect,
+                      VkImage *pImage, VkDeviceMemory *pMemory, VkImageView *pView, bool *pLazy)
+{
+    VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = format;
+    info.extent = { extent.width, extent.height, 1 };
+    info.mipLevels = 1;
+    info.arrayLayers = 1;
+    info.samples = samples;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = usage | (bTransient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult res = vkCreateImage(vkr.device, &info, nullptr, pImage);
+    if (res != VK_SUCCESS) {
+        return res;
+    }
+
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(vkr.device, *pImage, &req);
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = req.size;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(vkr.caps.memory, req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                   bTransient ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
+    if (allocInfo.memoryTypeIndex == UINT32_MAX) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+    *pLazy = (vkr.caps.memory.memoryTypes[allocInfo.memoryTypeIndex].propertyFlags &
+              VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+    res = MemBudget_Allocate(vkr, allocInfo, MemCategory_RenderTargets, pMemory);
+    if (res != VK_SUCCESS) {
+        return res;
+    }
+    res = vkBindImageMemory(vkr.device, *pImage, *pMemory, 0);
+    if (res != VK_SUCCESS) {
+        return res;
+    }
+
+    VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    viewInfo.image = *pImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.components = COMPONENT_MAPPING_IDENTITY;
+    viewInfo.subresourceRange = { aspect, 0, 1, 0, 1 };
+    return vkCreateImageView(vkr.device, &viewInfo, nullptr, pView);
+}
+
+VkResult
+RenderTargets_Create(RenderTargets& rt, const VulkanRenderer& vkr, VkExtent2D extent,
+                     VkFormat colorFormat, VkFormat depthFormat, VkSampleCountFlagBits samples,
+                     bool bOffscreen)
+{
+    rt = { };
+    rt.samples = samples;
+    rt.extent = extent;
+    rt.colorFormat = colorFormat;
+    rt.depthFormat = depthFormat;
+
+    bool bDepthLazy = false, bColorLazy = true, bOffscreenLazy = false;
+    VkResult res = CreateAttachmentImage(vkr, extent, depthFormat, samples, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                                         true, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+                                         &rt.depthImage, &rt.depthMemory, &rt.depthView, &bDepthLazy);
+    if (res == VK_SUCCESS && samples != VK_SAMPLE_COUNT_1_BIT) {
+        res = CreateAttachmentImage(vkr, extent, colorFormat, samples, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                    true, VK_IMAGE_ASPECT_COLOR_BIT,
+                                    &rt.colorImage, &rt.colorMemory, &rt.colorView, &bColorLazy);
+    }
+    if (res == VK_SUCCESS && bOffscreen) {
+        res = CreateAttachmentImage(vkr, extent, colorFormat, VK_SAMPLE_COUNT_1_BIT,
+                                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                    false, VK_IMAGE_ASPECT_COLOR_BIT,
+                                    &rt.offscreenImage, &rt.offscreenMemory, &rt.offscreenView, &bOffscreenLazy);
+    }
+    if (res != VK_SUCCESS) {
+        printf("RenderTargets: creating %ux%u x%u attachments failed (%d)\n",
+               extent.width, extent.height, uint(samples), int(res));
+        RenderTargets_Destroy(rt, vkr.device);
+        return res;
+    }
+    rt.bLazy = bDepthLazy && bColorLazy;
+    return VK_SUCCESS;
+}
+
+void
+RenderTargets_Destroy(RenderTargets& rt, VkDevice device)
+{
+    vkDestroyImageView(device, rt.colorView, nullptr);
+    vkDestroyImage(device, rt.colorImage, nullptr);
+    MemBudget_Free(device, rt.colorMemory);
+    vkDestroyImageView(device, rt.depthView, nullptr);
+    vkDestroyImage(device, rt.depthImage, nullptr);
+    MemBudget_Free(device, rt.depthMemory);
+    vkDestroyImageView(device, rt.offscreenView, nullptr);
+    vkDestroyImage(device, rt.offscreenImage, nullptr);
+    MemBudget_Free(device, rt.offscreenMemory);
+    rt = { };
+}
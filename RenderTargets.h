@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    The attachments besides the swapchain image: a multisampled color image that gets resolved into the
+    swapchain image inside the render pass, and a depth/stencil image.
+
+    Neither is needed after the render pass (store ops are DONT_CARE), so both are TRANSIENT_ATTACHMENT
+    images in LAZILY_ALLOCATED memory when the device has it. On tilers they then live in tile memory only,
+    on desktop GPUs there is no such memory type and they are ordinary device-local images.
+
+    One set is shared by all frames in flight, the render pass's external dependency orders their use.
+
+    With bOffscreen there's also a single-sampled color image that takes the swapchain image's place in the
+    render pass (dynamic resolution renders into part of it and blits that to the swapchain image, see
+    DynamicResolution.h). It's stored and read after the pass, so it's an ordinary device-local image.
+*/
+
+struct RenderTargets {
+    VkSampleCountFlagBits samples;
+    VkExtent2D extent;
+    VkFormat colorFormat;
+    VkFormat depthFormat;
+
+    VkImage colorImage; // null when samples == 1, the swapchain image is rendered to directly
+    VkDeviceMemory colorMemory;
+    VkImageView colorView;
+
+    VkImage depthImage;
+    VkDeviceMemory depthMemory;
+    VkImageView depthView;
+
+    VkImage offscreenImage; // null unless bOffscreen
+    VkDeviceMemory offscreenMemory;
+    VkImageView offscreenView;
+
+    bool bLazy; // every transient image here is in LAZILY_ALLOCATED memory
+};
+
+// The first of D24S8, D32S8, D16S8 usable as a depth/stencil attachment. VK_FORMAT_UNDEFINED if none.
+VkFormat RenderTargets_ChooseDepthFormat(VkPhysicalDevice physicalDevice);
+
+// The highest sample count <= requested that both color and depth attachments support.
+VkSampleCountFlagBits RenderTargets_ClampSamples(const DeviceCaps& caps, uint32_t requested);
+
+VkResult RenderTargets_Create(RenderTargets& rt, const VulkanRenderer& vkr, VkExtent2D extent,
+                              VkFormat colorFormat, VkFormat depthFormat, VkSampleCountFlagBits samples,
+                              bool bOffscreen);
+void RenderTargets_Destroy(RenderTargets& rt, VkDevice device);
@@ -0,0 +1,292 @@
+#include "ResourceRegistry.h"
+#include "MemoryBudget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *const ResKindNames[ResKind_Count] = { "buffers", "images", "views", "pipelines", "samplers" };
+
+//----- Slots -----
+
+static bool
+Slots_Init(ResSlots& s, uint32_t capacity)
+{
+    s.capacity = capacity;
+    s.highWater = 0;
+    s.freeHead = UINT32_MAX;
+    s.liveCount = 0;
+    s.generations = static_cast<uint16_t *>(malloc(capacity * sizeof(uint16_t)));
+    s.nextFree = static_cast<uint32_t *>(malloc(capacity * sizeof(uint32_t)));
+    return s.generations && s.nextFree;
+}
+
+static void
+Slots_Free(ResSlots& s)
+{
+    free(s.generations);
+    free(s.nextFree);
+    s = { };
+}
+
+// Returns the handle id, 0 if full. *pIndex is the slot.
+static uint32_t
+Slots_Alloc(ResSlots& s, uint32_t *pIndex)
+{
+    uint32_t index = s.freeHead;
+    if (index != UINT32_MAX) {
+        s.freeHead = s.nextFree[index];
+    } else if (s.highWater < s.capacity) {
+        index = s.highWater++;
+        s.generations[index] = 1;
+    } else {
+        return 0;
+    }
+    ++s.liveCount;
+    *pIndex = index;
+    return uint32_t(s.generations[index]) << RES_INDEX_BITS | index;
+}
+
+// Only once the object is destroyed.
+static void
+Slots_PushFree(ResSlots& s, uint32_t index)
+{
+    s.nextFree[index] = s.freeHead;
+    s.freeHead = index;
+}
+
+static ResSlots&
+GetSlots(ResourceRegistry& reg, ResKind kind)
+{
+    switch (kind) {
+    case ResKind_Buffer: return reg.buffers.slots;
+    case ResKind_Image: return reg.images.slots;
+    case ResKind_View: return reg.views.slots;
+    case ResKind_Pipeline: return reg.pipelines.slots;
+    default: return reg.samplers.slots;
+    }
+}
+
+// Destroys the slot's object and nulls it out, the slot itself isn't touched.
+static void
+DestroyObject(ResourceRegistry& reg, VkDevice device, ResKind kind, uint32_t i)
+{
+    switch (kind) {
+    case ResKind_Buffer: {
+        BufferAllocation b = { reg.buffers.buffers[i], reg.buffers.memory[i], reg.buffers.sizes[i], reg.buffers.mapped[i] };
+        VKH_DestroyBuffer(device, b);
+        reg.buffers.buffers[i] = nullptr;
+        reg.buffers.memory[i] = nullptr;
+        reg.buffers.mapped[i] = nullptr;
+    } break;
+    case ResKind_Image:
+        vkDestroyImage(device, reg.images.images[i], nullptr);
+        MemBudget_Free(device, reg.images.memory[i]);
+        reg.images.images[i] = nullptr;
+        reg.images.memory[i] = nullptr;
+        break;
+    case ResKind_View:
+        vkDestroyImageView(device, reg.views.views[i], nullptr);
+        reg.views.views[i] = nullptr;
+        break;
+    case ResKind_Pipeline:
+        vkDestroyPipeline(device, reg.pipelines.pipelines[i], nullptr);
+        reg.pipelines.pipelines[i] = nullptr;
+        break;
+    case ResKind_Sampler:
+        vkDestroySampler(device, reg.samplers.samplers[i], nullptr);
+        reg.samplers.samplers[i] = nullptr;
+        break;
+    default:
+        ASSERT(0);
+    }
+}
+
+//----- Registry -----
+
+template<class T> static bool
+AllocZero(T **p, uint32_t count)
+{
+    *p = static_cast<T *>(calloc(count, sizeof(T)));
+    return *p != nullptr;
+}
+
+bool
+Res_Create(ResourceRegistry& reg, uint32_t capacityPerKind)
+{
+    reg = { };
+    uint32_t const n = Max(Min(capacityPerKind, RES_MAX_PER_KIND), 1u);
+    bool ok = Slots_Init(reg.buffers.slots, n) && AllocZero(&reg.buffers.buffers, n) && AllocZero(&reg.buffers.memory, n) &&
+              AllocZero(&reg.buffers.sizes, n) && AllocZero(&reg.buffers.mapped, n);
+    ok = ok && Slots_Init(reg.images.slots, n) && AllocZero(&reg.images.images, n) && AllocZero(&reg.images.memory, n);
+    ok = ok && Slots_Init(reg.views.slots, n) && AllocZero(&reg.views.views, n);
+    ok = ok && Slots_Init(reg.pipelines.slots, n) && AllocZero(&reg.pipelines.pipelines, n);
+    ok = ok && Slots_Init(reg.samplers.slots, n) && AllocZero(&reg.samplers.samplers, n);
+    ok = ok && AllocZero(&reg.pending, n * ResKind_Count);
+    if (!ok) {
+        puts("resource registry: out of memory");
+        Res_Destroy(reg, nullptr); // nothing to destroy on the device yet
+    }
+    return ok;
+}
+
+void
+Res_Destroy(ResourceRegistry& reg, VkDevice device)
+{
+    Res_Collect(reg, device, reg.frame + 1); // the GPU is idle, nothing pending is in use
+    for (uint32_t k = 0; k < ResKind_Count; ++k) {
+        ResSlots const& slots = GetSlots(reg, ResKind(k));
+        for (uint32_t i = 0; i < slots.highWater; ++i) {
+            DestroyObject(reg, device, ResKind(k), i); // free slots are already null
+        }
+    }
+    Slots_Free(reg.buffers.slots);
+    free(reg.buffers.buffers);
+    free(reg.buffers.memory);
+    free(reg.buffers.sizes);
+    free(reg.buffers.mapped);
+    Slots_Free(reg.images.slots);
+    free(reg.images.images);
+    free(reg.images.memory);
+    Slots_Free(reg.views.slots);
+    free(reg.views.views);
+    Slots_Free(reg.pipelines.slots);
+    free(reg.pipelines.pipelines);
+    Slots_Free(reg.samplers.slots);
+    free(reg.samplers.samplers);
+    free(reg.pending);
+    reg = { };
+}
+
+void
+Res_Collect(ResourceRegistry& reg, VkDevice device, uint32_t completedFrameCount)
+{
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < reg.pendingCount; ++i) {
+        ResPending const p = reg.pending[i];
+        if (int32_t(p.frame - completedFrameCount) < 0) {
+            DestroyObject(reg, device, p.kind, p.index);
+            Slots_PushFree(GetSlots(reg, p.kind), p.index);
+        } else {
+            reg.pending[kept++] = p;
+        }
+    }
+    reg.pendingCount = kept;
+}
+
+BufferHandle
+Res_AddBuffer(ResourceRegistry& reg, VkDevice device, const BufferAllocation& b)
+{
+    uint32_t i;
+    uint32_t const id = Slots_Alloc(reg.buffers.slots, &i);
+    if (!id) {
+        BufferAllocation copy = b;
+        VKH_DestroyBuffer(device, copy);
+        return { 0 };
+    }
+    reg.buffers.buffers[i] = b.buffer;
+    reg.buffers.memory[i] = b.memory;
+    reg.buffers.sizes[i] = b.size;
+    reg.buffers.mapped[i] = b.pMapped;
+    return { id };
+}
+
+ImageHandle
+Res_AddImage(ResourceRegistry& reg, VkDevice device, VkImage image, VkDeviceMemory memory)
+{
+    uint32_t i;
+    uint32_t const id = Slots_Alloc(reg.images.slots, &i);
+    if (!id) {
+        vkDestroyImage(device, image, nullptr);
+        MemBudget_Free(device, memory);
+        return { 0 };
+    }
+    reg.images.images[i] = image;
+    reg.images.memory[i] = memory;
+    return { id };
+}
+
+ViewHandle
+Res_AddView(ResourceRegistry& reg, VkDevice device, VkImageView view)
+{
+    uint32_t i;
+    uint32_t const id = Slots_Alloc(reg.views.slots, &i);
+    if (!id) {
+        vkDestroyImageView(device, view, nullptr);
+        return { 0 };
+    }
+    reg.views.views[i] = view;
+    return { id };
+}
+
+PipelineHandle
+Res_AddPipeline(ResourceRegistry& reg, VkDevice device, VkPipeline pipeline)
+{
+    uint32_t i;
+    uint32_t const id = Slots_Alloc(reg.pipelines.slots, &i);
+    if (!id) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        return { 0 };
+    }
+    reg.pipelines.pipelines[i] = pipeline;
+    return { id };
+}
+
+SamplerHandle
+Res_AddSampler(ResourceRegistry& reg, VkDevice device, VkSampler sampler)
+{
+    uint32_t i;
+    uint32_t const id = Slots_Alloc(reg.samplers.slots, &i);
+    if (!id) {
+        vkDestroySampler(device, sampler, nullptr);
+        return { 0 };
+    }
+    reg.samplers.samplers[i] = sampler;
+    return { id };
+}
+
+BufferHandle
+Res_CreateBuffer(ResourceRegistry& reg, const VulkanRenderer& vkr, VkDeviceSize size, VkBufferUsageFlags usage,
+                 VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    BufferAllocation b;
+    if (VKH_CreateBuffer(vkr, size, usage, required, preferred, &b) != VK_SUCCESS) {
+        return { 0 };
+    }
+    return Res_AddBuffer(reg, vkr.device, b);
+}
+
+/* The generation changes now, so the handle is stale right away, the object goes when the GPU is done with it. */
+static void
+Release(ResourceRegistry& reg, ResKind kind, uint32_t id)
+{
+    ResSlots& slots = GetSlots(reg, kind);
+    uint32_t const index = Res_Resolve(reg, slots, id);
+    if (index == UINT32_MAX) {
+        return; // null, or released already
+    }
+    uint16_t& gen = slots.generations[index];
+    gen = gen == RES_MAX_GENERATION ? 1 : gen + 1;
+    --slots.liveCount;
+    reg.pending[reg.pendingCount++] = { kind, index, reg.frame };
+}
+
+void Res_Release(ResourceRegistry& reg, BufferHandle h) { Release(reg, ResKind_Buffer, h.id); }
+void Res_Release(ResourceRegistry& reg, ImageHandle h) { Release(reg, ResKind_Image, h.id); }
+void Res_Release(ResourceRegistry& reg, ViewHandle h) { Release(reg, ResKind_View, h.id); }
+void Res_Release(ResourceRegistry& reg, PipelineHandle h) { Release(reg, ResKind_Pipeline, h.id); }
+void Res_Release(ResourceRegistry& reg, SamplerHandle h) { Release(reg, ResKind_Sampler, h.id); }
+
+void
+Res_PrintReport(const ResourceRegistry& reg)
+{
+    uint32_t pending[ResKind_Count] = { };
+    for (uint32_t i = 0; i < reg.pendingCount; ++i) {
+        ++pending[reg.pending[i].kind];
+    }
+    printf("resources:");
+    for (uint32_t k = 0; k < ResKind_Count; ++k) {
+        const ResSlots& slots = GetSlots(const_cast<ResourceRegistry&>(reg), ResKind(k));
+        printf(" %s %u live %u pending (max %u),", ResKindNames[k], slots.liveCount, pending[k], slots.highWater);
+    }
+    printf(" %u stale handles used\n", reg.staleCount);
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+/*
+    Vulkan objects behind 32-bit generational handles: RES_INDEX_BITS of slot index and the rest a generation
+    that changes every time the slot is released. A handle that outlived its object no longer matches the slot's
+    generation, so the lookup asserts in debug builds and returns null in release, instead of handing out a
+    destroyed (or worse, reused) VkBuffer. An id of 0 is never valid, so zeroed handles are null.
+
+    Each kind (buffers, images, views, pipelines, samplers) is a pool of parallel arrays indexed by slot, the
+    lookup only touches the generation and the one array it returns from.
+
+    Res_Release doesn't destroy anything, the object may still be in use by frames in flight. It's queued with
+    the current frame number (Res_BeginFrame) and destroyed by Res_Collect once that frame is known complete,
+    only then is the slot reused. Nothing waits on the GPU for it.
+*/
+
+#define RES_INDEX_BITS 20
+#define RES_MAX_PER_KIND (1u << RES_INDEX_BITS)
+#define RES_MAX_GENERATION ((1u << (32 - RES_INDEX_BITS)) - 1)
+
+struct BufferHandle { uint32_t id; };
+struct ImageHandle { uint32_t id; };
+struct ViewHandle { uint32_t id; };
+struct PipelineHandle { uint32_t id; };
+struct SamplerHandle { uint32_t id; };
+
+enum ResKind : uint8_t {
+    ResKind_Buffer,
+    ResKind_Image,
+    ResKind_View,
+    ResKind_Pipeline,
+    ResKind_Sampler,
+    ResKind_Count
+};
+
+// Slot bookkeeping shared by the pools.
+struct ResSlots {
+    uint32_t capacity;
+    uint32_t highWater; // slots [0, highWater) have been used at some point
+    uint32_t freeHead; // UINT32_MAX if none, then the next slot is highWater
+    uint32_t liveCount;
+    uint16_t *generations; // 1..RES_MAX_GENERATION, never 0. Changed on release, so no handle matches a pending slot.
+    uint32_t *nextFree;
+};
+
+struct ResBufferPool {
+    ResSlots slots;
+    VkBuffer *buffers;
+    VkDeviceMemory *memory;
+    VkDeviceSize *sizes;
+    void **mapped;
+};
+
+struct ResImagePool {
+    ResSlots slots;
+    VkImage *images;
+    VkDeviceMemory *memory; // null if it's bound to memory owned elsewhere
+};
+
+struct ResViewPool {
+    ResSlots slots;
+    VkImageView *views;
+};
+
+struct ResPipelinePool {
+    ResSlots slots;
+    VkPipeline *pipelines;
+};
+
+struct ResSamplerPool {
+    ResSlots slots;
+    VkSampler *samplers;
+};
+
+struct ResPending {
+    ResKind kind;
+    uint32_t index;
+    uint32_t frame; // destroyed once this frame is complete
+};
+
+struct ResourceRegistry {
+    ResBufferPool buffers;
+    ResImagePool images;
+    ResViewPool views;
+    ResPipelinePool pipelines;
+    ResSamplerPool samplers;
+
+    ResPending *pending; // in release order, room for every slot of every pool
+    uint32_t pendingCount;
+    uint32_t frame; // from Res_BeginFrame
+    uint32_t staleCount; // lookups and releases with a handle that no longer matched
+};
+
+// capacityPerKind is clamped to RES_MAX_PER_KIND. Returns false, with reg zeroed, if out of memory.
+bool Res_Create(ResourceRegistry& reg, uint32_t capacityPerKind);
+// Destroys everything, live and pending. The GPU must be idle.
+void Res_Destroy(ResourceRegistry& reg, VkDevice device);
+
+// The frame being recorded, releases from now on wait for it to complete.
+inline void Res_BeginFrame(ResourceRegistry& reg, uint32_t frame) { reg.frame = frame; }
+/*  Destroys what was released in frames before completedFrameCount, i.e. every frame with a number below it
+    has finished on the GPU. Call after the frame slot's fence wait.
+*/
+void Res_Collect(ResourceRegistry& reg, VkDevice device, uint32_t completedFrameCount);
+
+// These take ownership. A null handle if the pool is full (and the object is destroyed right away).
+BufferHandle Res_AddBuffer(ResourceRegistry& reg, VkDevice device, const BufferAllocation& b);
+ImageHandle Res_AddImage(ResourceRegistry& reg, VkDevice device, VkImage image, VkDeviceMemory memory);
+ViewHandle Res_AddView(ResourceRegistry& reg, VkDevice device, VkImageView view);
+PipelineHandle Res_AddPipeline(ResourceRegistry& reg, VkDevice device, VkPipeline pipeline);
+SamplerHandle Res_AddSampler(ResourceRegistry& reg, VkDevice device, VkSampler sampler);
+
+// VKH_CreateBuffer into the registry, a null handle on failure.
+BufferHandle Res_CreateBuffer(ResourceRegistry& reg, const VulkanRenderer& vkr, VkDeviceSize size, VkBufferUsageFlags usage,
+                              VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+
+// Deferred, see above. Releasing a null handle does nothing, a stale one asserts in debug builds.
+void Res_Release(ResourceRegistry& reg, BufferHandle h);
+void Res_Release(ResourceRegistry& reg, ImageHandle h);
+void Res_Release(ResourceRegistry& reg, ViewHandle h);
+void Res_Release(ResourceRegistry& reg, PipelineHandle h);
+void Res_Release(ResourceRegistry& reg, SamplerHandle h);
+
+// Slot index if the handle is live, else UINT32_MAX (and asserts in debug builds unless it's null).
+inline uint32_t
+Res_Resolve(ResourceRegistry& reg, const ResSlots& slots, uint32_t id)
+{
+    uint32_t const index = id & (RES_MAX_PER_KIND - 1);
+    if (index < slots.highWater && slots.generations[index] == id >> RES_INDEX_BITS) {
+        return index;
+    }
+    if (id) {
+        ++reg.staleCount;
+        ASSERT(!"stale resource handle, the object was released");
+    }
+    return UINT32_MAX;
+}
+
+inline VkBuffer
+Res_Buffer(ResourceRegistry& reg, BufferHandle h)
+{
+    uint32_t const i = Res_Resolve(reg, reg.buffers.slots, h.id);
+    return i != UINT32_MAX ? reg.buffers.buffers[i] : nullptr;
+}
+
+// Null if not host visible or h isn't live.
+inline void *
+Res_BufferMapped(ResourceRegistry& reg, BufferHandle h)
+{
+    uint32_t const i = Res_Resolve(reg, reg.buffers.slots, h.id);
+    return i != UINT32_MAX ? reg.buffers.mapped[i] : nullptr;
+}
+
+inline VkImage
+Res_Image(ResourceRegistry& reg, ImageHandle h)
+{
+    uint32_t const i = Res_Resolve(reg, reg.images.slots, h.id);
+    return i != UINT32_MAX ? reg.images.images[i] : nullptr;
+}
+
+inline VkImageView
+Res_View(ResourceRegistry& reg, ViewHandle h)
+{
+    uint32_t const i = Res_Resolve(reg, reg.views.slots, h.id);
+    return i != UINT32_MAX ? reg.views.views[i] : nullptr;
+}
+
+inline VkPipeline
+Res_Pipeline(ResourceRegistry& reg, PipelineHandle h)
+{
+    uint32_t const i = Res_Resolve(reg, reg.pipelines.slots, h.id);
+    return i != UINT32_MAX ? reg.pipelines.pipelines[i] : nullptr;
+}
+
+inline VkSampler
+Res_Sampler(ResourceRegistry& reg, SamplerHandle h)
+{
+    uint32_t const i = Res_Resolve(reg, reg.samplers.slots, h.id);
+    return i != UINT32_MAX ? reg.samplers.samplers[i] : nullptr;
+}
+
+// Live and pending counts per kind, one line.
+void Res_PrintReport(const ResourceRegistry& reg);
@@ -0,0 +1,533 @@
+#include "SpriteBatcher.h"
+#include "MemoryBudget.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Matches the push constants in shaders/sprites.vert.
+struct SpritePushConstants {
+    float clipScale[2];
+    float clipOffset[2];
+};
+
+#define SPRITES_TEXTURE_SIZE 64
+#define SPRITES_MIN_CHUNK 16384 // sprites, smaller chunks aren't worth a job
+
+//----- Textures -----
+
+static float
+Saturate(float x)
+{
+    return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+}
+
+/* Premultiplied white, so the coverage goes in all four channels. */
+static void
+MakeTexturePixels(SpriteTexture tex, uint32_t *pixels)
+{
+    float const pixelsPerUnit = SPRITES_TEXTURE_SIZE * 0.5f; // for a 1 pixel wide edge
+    for (uint32_t y = 0; y < SPRITES_TEXTURE_SIZE; ++y) {
+        for (uint32_t x = 0; x < SPRITES_TEXTURE_SIZE; ++x) {
+            float const px = (float(x) + 0.5f) / pixelsPerUnit - 1.0f; // [-1, 1]
+            float const py = (float(y) + 0.5f) / pixelsPerUnit - 1.0f;
+            float const d = sqrtf(px*px + py*py);
+            float a = 0.0f;
+            switch (tex) {
+            case SpriteTex_Disc: a = Saturate(1.0f - d); a *= a; break;
+            case SpriteTex_Ring: a = Saturate((0.15f - fabsf(d - 0.8f)) * pixelsPerUnit); break;
+            case SpriteTex_Square: a = Saturate((1.0f - Max(fabsf(px), fabsf(py))) * pixelsPerUnit); break;
+            case SpriteTex_Diamond: a = Saturate((1.0f - fabsf(px) - fabsf(py)) * pixelsPerUnit); break;
+            default: break;
+            }
+            pixels[y * SPRITES_TEXTURE_SIZE + x] = uint32_t(a * 255.0f + 0.5f) * 0x01010101u;
+        }
+    }
+}
+
+/*  One-shot copy of the staging buffer into the images on the universal queue, like Mesh's staging copy.
+    Creation time only, so it just waits on a fence.
+*/
+static VkResult
+SubmitTextureUpload(const VulkanRenderer& vkr, const BufferAllocation& staging, const VkImage *images)
+{
+    VkCommandPool pool = VKH_CreateCommandPool(vkr.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, vkr.families.universal);
+    VkCommandBuffer cmd = VKH_AllocateCommandBuffer(vkr.device, pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    VkImageMemoryBarrier barriers[SpriteTex_Count];
+    for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+        VkImageMemoryBarrier& b = barriers[i];
+        b = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        b.srcAccessMask = 0;
+        b.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        b.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        b.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.image = images[i];
+        b.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, SpriteTex_Count, barriers);
+
+    VkDeviceSize const imageBytes = SPRITES_TEXTURE_SIZE * SPRITES_TEXTURE_SIZE * sizeof(uint32_t);
+    for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+        VkBufferImageCopy region = { };
+        region.bufferOffset = i * imageBytes;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { SPRITES_TEXTURE_SIZE, SPRITES_TEXTURE_SIZE, 1 };
+        vkCmdCopyBufferToImage(cmd, staging.buffer, images[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    /* Later submissions sample them. */
+    for (VkImageMemoryBarrier& b : barriers) {
+        b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        b.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        b.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        b.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, SpriteTex_Count, barriers);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence = nullptr;
+    VkResult res = vkCreateFence(vkr.device, &fenceInfo, nullptr, &fence);
+    if (res == VK_SUCCESS) {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        res = vkQueueSubmit(vkr.universalQueue0, 1, &submitInfo, fence);
+        if (res == VK_SUCCESS) {
+            res = vkWaitForFences(vkr.device, 1, &fence, true, uint64_t(-1));
+        }
+        vkDestroyFence(vkr.device, fence, nullptr);
+    }
+    vkDestroyCommandPool(vkr.device, pool, nullptr);
+    return res;
+}
+
+// All the textures in one allocation, filled and in SHADER_READ_ONLY.
+static bool
+CreateTextures(SpriteBatcher& sb, const VulkanRenderer& vkr)
+{
+    VkDevice const device = vkr.device;
+    VkDeviceSize offsets[SpriteTex_Count];
+    VkDeviceSize totalBytes = 0;
+    uint32_t typeBits = ~0u;
+    for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+        VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = { SPRITES_TEXTURE_SIZE, SPRITES_TEXTURE_SIZE, 1 };
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(device, &info, nullptr, &sb.images[i]) != VK_SUCCESS) {
+            return false;
+        }
+        VkMemoryRequirements req;
+        vkGetImageMemoryRequirements(device, sb.images[i], &req);
+        offsets[i] = (totalBytes + req.alignment - 1) / req.alignment * req.alignment;
+        totalBytes = offsets[i] + req.size;
+        typeBits &= req.memoryTypeBits;
+    }
+
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = totalBytes;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(vkr.caps.memory, typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+        MemBudget_Allocate(vkr, allocInfo, MemCategory_Textures, &sb.imageMemory) != VK_SUCCESS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+        if (vkBindImageMemory(device, sb.images[i], sb.imageMemory, offsets[i]) != VK_SUCCESS) {
+            return false;
+        }
+        VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = sb.images[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        viewInfo.components = COMPONENT_MAPPING_IDENTITY;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &sb.views[i]));
+    }
+
+    VkDeviceSize const imageBytes = SPRITES_TEXTURE_SIZE * SPRITES_TEXTURE_SIZE * sizeof(uint32_t);
+    BufferAllocation staging;
+    if (VKH_CreateBuffer(vkr, imageBytes * SpriteTex_Count, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                         &staging) != VK_SUCCESS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+        MakeTexturePixels(SpriteTexture(i), static_cast<uint32_t *>(staging.pMapped) + i * (imageBytes / 4));
+    }
+    bool const ok = SubmitTextureUpload(vkr, staging, sb.images) == VK_SUCCESS;
+    VKH_DestroyBuffer(device, staging);
+
+    VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sb.sampler));
+    return ok;
+}
+
+//----- Pipelines -----
+
+static VkPipeline
+CreateDrawPipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass renderPass, VkSampleCountFlagBits samples,
+                   VkShaderModule vs, VkShaderModule fs, SpriteBlend blendMode)
+{
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vs, "main" },
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main" },
+    };
+
+    // No attributes, the vertex shader reads the sprite buffer.
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    raster.cullMode = VK_CULL_MODE_NONE; // rotation and negative sizes flip the winding
+    raster.lineWidth = 1.0f;
+
+    /* Both premultiplied, additive only differs in not darkening what's behind. */
+    VkPipelineColorBlendAttachmentState blendAttachment = { true };
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstColorBlendFactor = blendMode == SpriteBlend_Add ? VK_BLEND_FACTOR_ONE
+                                                                       : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = 0xf;
+
+    VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkPipelineViewportStateCreateInfo viewport = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    // No depth test or write, 2D on top of the scene in layer order.
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = samples;
+
+    const VkDynamicState dynamics[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO, nullptr, 0,
+        lengthof(dynamics), dynamics
+    };
+
+    VkGraphicsPipelineCreateInfo psoInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    psoInfo.stageCount = lengthof(stages);
+    psoInfo.pStages = stages;
+    psoInfo.pVertexInputState = &vertexInput;
+    psoInfo.pInputAssemblyState = &inputAssembly;
+    psoInfo.pViewportState = &viewport;
+    psoInfo.pRasterizationState = &raster;
+    psoInfo.pMultisampleState = &multisample;
+    psoInfo.pDepthStencilState = &depthStencil;
+    psoInfo.pColorBlendState = &blend;
+    psoInfo.pDynamicState = &dynamic;
+    psoInfo.layout = layout;
+    psoInfo.renderPass = renderPass;
+    psoInfo.subpass = 0;
+
+    VkPipeline pso = nullptr;
+    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &psoInfo, nullptr, &pso));
+    return pso;
+}
+
+//----- Batcher -----
+
+bool
+Sprites_Create(SpriteBatcher& sb, const VulkanRenderer& vkr, VkRenderPass renderPass,
+               VkSampleCountFlagBits samples, uint32_t capacity, uint32_t slotCount)
+{
+    sb = { };
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    VkDevice const device = vkr.device;
+
+    /* The one descriptor covers every slot. */
+    uint32_t const maxCapacity = vkr.caps.props.limits.maxStorageBufferRange / sizeof(Sprite) / slotCount;
+    if (capacity > maxCapacity) {
+        printf("Sprites: capacity %u is over the storage buffer range, using %u\n", capacity, maxCapacity);
+        capacity = maxCapacity;
+    }
+    capacity = Max(capacity, 1u);
+
+    sb.vs = VKH_LoadShaderModule(device, "shaders/sprites.vert.spv");
+    sb.fs = VKH_LoadShaderModule(device, "shaders/sprites.frag.spv");
+    bool ok = sb.vs && sb.fs;
+
+    if (ok) {
+        /* Written by the CPU every frame and read once per vertex, device local if it can also be mapped. */
+        VkMemoryPropertyFlags const preferred = vkr.caps.bUnifiedMemory ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : 0;
+        ok = VKH_CreateBuffer(vkr, VkDeviceSize(capacity) * slotCount * sizeof(Sprite), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, preferred,
+                              &sb.sorted) == VK_SUCCESS;
+        sb.sprites = static_cast<Sprite *>(malloc(size_t(capacity) * sizeof(Sprite)));
+        sb.keys = static_cast<uint8_t *>(malloc(capacity));
+        ok = ok && sb.sprites && sb.keys;
+        if (!ok) {
+            printf("Sprites: couldn't allocate buffers for %u sprites\n", capacity);
+        }
+    }
+
+    ok = ok && CreateTextures(sb, vkr);
+
+    if (ok) {
+        const VkDescriptorSetLayoutBinding bufferBinding = {
+            0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT
+        };
+        const VkDescriptorSetLayoutBinding textureBinding = {
+            0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &sb.sampler
+        };
+        VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &bufferBinding;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &sb.bufferSetLayout));
+        layoutInfo.pBindings = &textureBinding;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &sb.textureSetLayout));
+
+        const VkDescriptorPoolSize poolSizes[] = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SpriteTex_Count },
+        };
+        VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.maxSets = 1 + SpriteTex_Count;
+        poolInfo.poolSizeCount = lengthof(poolSizes);
+        poolInfo.pPoolSizes = poolSizes;
+        VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &sb.descriptorPool));
+
+        VkDescriptorSetLayout setLayouts[1 + SpriteTex_Count] = { sb.bufferSetLayout };
+        for (uint32_t i = 0; i < SpriteTex_Count; ++i) setLayouts[1 + i] = sb.textureSetLayout;
+        VkDescriptorSet sets[1 + SpriteTex_Count];
+        VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocInfo.descriptorPool = sb.descriptorPool;
+        allocInfo.descriptorSetCount = lengthof(setLayouts);
+        allocInfo.pSetLayouts = setLayouts;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, sets));
+        sb.bufferSet = sets[0];
+        for (uint32_t i = 0; i < SpriteTex_Count; ++i) sb.textureSets[i] = sets[1 + i];
+
+        const VkDescriptorBufferInfo bufferInfo = { sb.sorted.buffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorImageInfo imageInfos[SpriteTex_Count];
+        VkWriteDescriptorSet writes[1 + SpriteTex_Count];
+        writes[0] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        writes[0].dstSet = sb.bufferSet;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[0].pBufferInfo = &bufferInfo;
+        for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+            imageInfos[i] = { nullptr, sb.views[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }; // immutable sampler
+            VkWriteDescriptorSet& w = writes[1 + i];
+            w = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            w.dstSet = sb.textureSets[i];
+            w.descriptorCount = 1;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            w.pImageInfo = &imageInfos[i];
+        }
+        vkUpdateDescriptorSets(device, lengthof(writes), writes, 0, nullptr);
+
+        const VkDescriptorSetLayout pipelineSetLayouts[2] = { sb.bufferSetLayout, sb.textureSetLayout };
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SpritePushConstants) };
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pipelineLayoutInfo.setLayoutCount = lengthof(pipelineSetLayouts);
+        pipelineLayoutInfo.pSetLayouts = pipelineSetLayouts;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &sb.pipelineLayout));
+
+        Sprites_SetRenderPass(sb, device, renderPass, samples);
+
+        sb.capacity = capacity;
+        sb.slotCount = slotCount;
+        printf("Sprites: capacity %u per frame (%u MiB mapped)\n", capacity, uint(sb.sorted.size >> 20));
+    }
+
+    if (!ok) {
+        puts("Sprites: couldn't create the textures or load shaders/sprites.*.spv");
+        Sprites_Destroy(sb, device);
+    }
+    return ok;
+}
+
+void
+Sprites_Destroy(SpriteBatcher& sb, VkDevice device)
+{
+    for (VkPipeline pso : sb.pipelines) {
+        vkDestroyPipeline(device, pso, nullptr);
+    }
+    vkDestroyShaderModule(device, sb.vs, nullptr);
+    vkDestroyShaderModule(device, sb.fs, nullptr);
+    vkDestroyPipelineLayout(device, sb.pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, sb.descriptorPool, nullptr); // frees the sets
+    vkDestroyDescriptorSetLayout(device, sb.bufferSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, sb.textureSetLayout, nullptr);
+    vkDestroySampler(device, sb.sampler, nullptr);
+    for (uint32_t i = 0; i < SpriteTex_Count; ++i) {
+        vkDestroyImageView(device, sb.views[i], nullptr);
+        vkDestroyImage(device, sb.images[i], nullptr);
+    }
+    MemBudget_Free(device, sb.imageMemory);
+    VKH_DestroyBuffer(device, sb.sorted);
+    free(sb.sprites);
+    free(sb.keys);
+    sb = { };
+}
+
+void
+Sprites_SetRenderPass(SpriteBatcher& sb, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples)
+{
+    if (!sb.pipelineLayout) {
+        return;
+    }
+    for (uint32_t i = 0; i < SpriteBlend_Count; ++i) {
+        vkDestroyPipeline(device, sb.pipelines[i], nullptr);
+        sb.pipelines[i] = CreateDrawPipeline(device, sb.pipelineLayout, renderPass, samples, sb.vs, sb.fs, SpriteBlend(i));
+    }
+}
+
+uint32_t
+Sprites_Reserve(SpriteBatcher& sb, uint32_t count)
+{
+    if (count > sb.capacity - sb.count) {
+        sb.droppedCount += count;
+        return UINT32_MAX;
+    }
+    uint32_t const first = sb.count;
+    sb.count += count;
+    return first;
+}
+
+//----- Sort -----
+
+static void
+ChunkRange(const SpriteBatcher& sb, uint32_t chunk, uint32_t *pBegin, uint32_t *pEnd)
+{
+    uint32_t const perChunk = (sb.preparedCount + sb.chunkCount - 1) / sb.chunkCount;
+    *pBegin = Min(chunk * perChunk, sb.preparedCount);
+    *pEnd = Min(*pBegin + perChunk, sb.preparedCount);
+}
+
+static void
+CountJob(void *arg, uint32_t begin, uint32_t end, uint32_t)
+{
+    SpriteBatcher& sb = *static_cast<SpriteBatcher *>(arg);
+    for (uint32_t chunk = begin; chunk < end; ++chunk) {
+        uint32_t first, last;
+        ChunkRange(sb, chunk, &first, &last);
+        uint32_t counts[SPRITES_KEY_COUNT] = { };
+        for (uint32_t i = first; i < last; ++i) {
+            ++counts[sb.keys[i]];
+        }
+        memcpy(sb.chunkOffsets[chunk], counts, sizeof counts);
+    }
+}
+
+/*  Each chunk writes its sprites of a key to its own range, so no two jobs write the same sprite, and the writes
+    to the mapped (likely write-combined) memory are sequential within each of the few ranges.
+*/
+static void
+ScatterJob(void *arg, uint32_t begin, uint32_t end, uint32_t)
+{
+    SpriteBatcher& sb = *static_cast<SpriteBatcher *>(arg);
+    Sprite *const dst = static_cast<Sprite *>(sb.sorted.pMapped) + size_t(sb.preparedSlot) * sb.capacity;
+    for (uint32_t chunk = begin; chunk < end; ++chunk) {
+        uint32_t first, last;
+        ChunkRange(sb, chunk, &first, &last);
+        uint32_t offsets[SPRITES_KEY_COUNT];
+        memcpy(offsets, sb.chunkOffsets[chunk], sizeof offsets);
+        for (uint32_t i = first; i < last; ++i) {
+            dst[offsets[sb.keys[i]]++] = sb.sprites[i];
+        }
+    }
+}
+
+void
+Sprites_Prepare(SpriteBatcher& sb, JobSystem& js, uint32_t slot, LinearArena& scratch)
+{
+    ASSERT(slot < sb.slotCount);
+    sb.preparedSlot = slot;
+    sb.preparedCount = sb.count;
+    sb.batchCount = 0;
+    if (!sb.count) {
+        return;
+    }
+    sb.chunkCount = Min((sb.count + SPRITES_MIN_CHUNK - 1) / SPRITES_MIN_CHUNK, uint32_t(SPRITES_MAX_CHUNKS));
+    size_t const mark = Arena_GetMark(scratch);
+    sb.chunkOffsets = Arena_PushArray<uint32_t[SPRITES_KEY_COUNT]>(scratch, sb.chunkCount);
+    if (!sb.chunkOffsets) {
+        sb.droppedCount += sb.count;
+        sb.preparedCount = 0;
+        return;
+    }
+
+    Jobs_ParallelFor(js, sb.chunkCount, 1, CountJob, &sb);
+
+    /* Counts to write positions: key major, then chunk, which is what keeps the sort stable. */
+    uint32_t offset = 0;
+    for (uint32_t key = 0; key < SPRITES_KEY_COUNT; ++key) {
+        uint32_t const keyFirst = offset;
+        for (uint32_t chunk = 0; chunk < sb.chunkCount; ++chunk) {
+            uint32_t const n = sb.chunkOffsets[chunk][key];
+            sb.chunkOffsets[chunk][key] = offset;
+            offset += n;
+        }
+        if (offset != keyFirst) {
+            sb.batches[sb.batchCount++] = { key, keyFirst, offset - keyFirst };
+        }
+    }
+
+    Jobs_ParallelFor(js, sb.chunkCount, 1, ScatterJob, &sb);
+    /* Host writes before vkQueueSubmit are visible to the GPU without a barrier, and the memory is coherent. */
+    Arena_PopToMark(scratch, mark);
+    sb.chunkOffsets = nullptr;
+}
+
+void
+Sprites_CmdDraw(const SpriteBatcher& sb, CmdEncoder& enc, VkExtent2D extent)
+{
+    if (!sb.batchCount) {
+        return;
+    }
+    SpritePushConstants pc;
+    pc.clipScale[0] = 2.0f / float(extent.width);
+    pc.clipScale[1] = 2.0f / float(extent.height);
+    pc.clipOffset[0] = -1.0f;
+    pc.clipOffset[1] = -1.0f;
+    CmdEncoder_PushConstants(enc, sb.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pc, &pc);
+    CmdEncoder_BindDescriptorSets(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, sb.pipelineLayout, 0, 1, &sb.bufferSet);
+
+    uint32_t const slotFirstVertex = 6 * sb.preparedSlot * sb.capacity;
+    for (uint32_t i = 0; i < sb.batchCount; ++i) {
+        const SpriteBatch& batch = sb.batches[i];
+        uint32_t const texture = batch.key % SpriteTex_Count;
+        uint32_t const blend = batch.key / SpriteTex_Count % SpriteBlend_Count;
+        /* The encoder drops the binds that are the same as the last batch's. */
+        CmdEncoder_BindPipeline(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, sb.pipelines[blend]);
+        CmdEncoder_BindDescriptorSets(enc, VK_PIPELINE_BIND_POINT_GRAPHICS, sb.pipelineLayout, 1, 1, &sb.textureSets[texture]);
+        CmdEncoder_Draw(enc, 6 * batch.count, 1, slotFirstVertex + 6 * batch.first, 0);
+    }
+}
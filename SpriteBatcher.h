@@ -0,0 +1,140 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+#include "CmdEncoder.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+
+/*
+    2D sprites by vertex pulling: every sprite is 32 bytes in a persistently mapped storage buffer and the vertex
+    shader makes the quad's 6 vertices from gl_VertexIndex, there's no vertex or index buffer. A frame's sprites
+    are drawn with one vkCmdDraw per batch, a batch being the sprites that share a key (layer, blend, texture).
+
+    Per frame:
+        - Sprites_Begin, then Sprites_Add, or Sprites_Reserve and fill in place (from jobs if there are many).
+        - Sprites_Prepare sorts by key into the slot's part of the mapped buffer and makes the batch list. The
+          sort is a counting sort over the few keys, split into chunks that run as jobs, and stable, so sprites
+          with the same key keep the order they were added in.
+        - Sprites_CmdDraw inside the render pass.
+
+    Layers are drawn in order. Within a layer the batches are ordered by blend then texture, not by the order
+    sprites were added, so overlapping sprites that must stay in order need to be on different layers.
+
+    The textures are built in (SpriteTexture), made at creation. Needs the .spv files for shaders/sprites*,
+    without them Sprites_Create fails and the app runs without.
+*/
+
+#define SPRITES_MAX_CHUNKS 64 // sort chunks, a job each
+
+enum SpriteTexture {
+    SpriteTex_Disc, // soft edge
+    SpriteTex_Ring,
+    SpriteTex_Square,
+    SpriteTex_Diamond,
+    SpriteTex_Count
+};
+
+enum SpriteBlend {
+    SpriteBlend_Alpha, // premultiplied: src + dst * (1 - src.a)
+    SpriteBlend_Add,
+    SpriteBlend_Count
+};
+
+#define SPRITES_LAYER_COUNT 4
+#define SPRITES_KEY_COUNT (SPRITES_LAYER_COUNT * SpriteBlend_Count * SpriteTex_Count)
+
+inline uint8_t
+Sprites_MakeKey(uint32_t layer, SpriteBlend blend, SpriteTexture texture)
+{
+    ASSERT(layer < SPRITES_LAYER_COUNT);
+    return uint8_t((layer * SpriteBlend_Count + blend) * SpriteTex_Count + texture);
+}
+
+// Matches shaders/sprites.vert.
+struct Sprite {
+    float x, y; // center, in pixels from the top left of the render area
+    float halfWidth, halfHeight;
+    float rotation; // radians
+    uint32_t color; // RGBA8, R in the low byte, not premultiplied
+    uint32_t uvMin; // UNORM16x2, U in the low half. 0 and 0xFFFFFFFF for the whole texture.
+    uint32_t uvMax;
+};
+static_assert(sizeof(Sprite) == 32, "std430 layout");
+
+struct SpriteBatch {
+    uint32_t key;
+    uint32_t first; // in the slot's sorted sprites
+    uint32_t count;
+};
+
+struct SpriteBatcher {
+    BufferAllocation sorted; // slotCount * capacity sorted sprites, host visible and persistently mapped
+    Sprite *sprites; // capacity unsorted sprites, added to since Sprites_Begin
+    uint8_t *keys; // per sprite
+
+    VkImage images[SpriteTex_Count];
+    VkDeviceMemory imageMemory;
+    VkImageView views[SpriteTex_Count];
+    VkSampler sampler;
+
+    VkDescriptorSetLayout bufferSetLayout; // set 0, the sorted sprites
+    VkDescriptorSetLayout textureSetLayout; // set 1
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet bufferSet; // the whole buffer, the slot is picked with firstVertex
+    VkDescriptorSet textureSets[SpriteTex_Count];
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipelines[SpriteBlend_Count];
+    VkShaderModule vs, fs; // kept for Sprites_SetRenderPass
+
+    uint32_t capacity; // per frame
+    uint32_t slotCount;
+    uint32_t count; // added since Sprites_Begin
+    uint32_t droppedCount; // didn't fit, since Sprites_Begin
+
+    // From the last Sprites_Prepare:
+    uint32_t preparedSlot;
+    uint32_t preparedCount;
+    uint32_t batchCount;
+    SpriteBatch batches[SPRITES_KEY_COUNT];
+
+    // Sort scratch, [chunk][key] counts then write positions, in the arena Sprites_Prepare was given.
+    uint32_t chunkCount;
+    uint32_t (*chunkOffsets)[SPRITES_KEY_COUNT];
+};
+
+// Returns false if the shaders are missing or something couldn't be created, sb is then zeroed.
+bool Sprites_Create(SpriteBatcher& sb, const VulkanRenderer& vkr, VkRenderPass renderPass,
+                    VkSampleCountFlagBits samples, uint32_t capacity, uint32_t slotCount);
+void Sprites_Destroy(SpriteBatcher& sb, VkDevice device);
+
+// Recreates the pipelines for a new render pass. The GPU must be idle. Does nothing if sb wasn't created.
+void Sprites_SetRenderPass(SpriteBatcher& sb, VkDevice device, VkRenderPass renderPass, VkSampleCountFlagBits samples);
+
+inline void Sprites_Begin(SpriteBatcher& sb) { sb.count = 0; sb.droppedCount = 0; }
+
+/*  Room for count sprites. Returns the index of the first, fill in sb.sprites[i] and sb.keys[i] for every i in
+    [first, first + count). Returns UINT32_MAX, and counts them as dropped, if they don't all fit.
+    Not thread safe, reserve from the main thread and fill from jobs.
+*/
+uint32_t Sprites_Reserve(SpriteBatcher& sb, uint32_t count);
+
+inline void
+Sprites_Add(SpriteBatcher& sb, const Sprite& sprite, uint8_t key)
+{
+    if (sb.count < sb.capacity) {
+        sb.sprites[sb.count] = sprite;
+        sb.keys[sb.count++] = key;
+    } else {
+        ++sb.droppedCount;
+    }
+}
+
+/*  Sorts the added sprites into the slot's part of the buffer. After the slot's fence wait, before Sprites_CmdDraw.
+    The sort's scratch is pushed to scratch and popped before returning. If it doesn't fit the frame's sprites are
+    dropped.
+*/
+void Sprites_Prepare(SpriteBatcher& sb, JobSystem& js, uint32_t slot, LinearArena& scratch);
+
+// Inside the render pass, after Sprites_Prepare this frame. Viewport and scissor must be set to extent.
+void Sprites_CmdDraw(const SpriteBatcher& sb, CmdEncoder& enc, VkExtent2D extent);
@@ -0,0 +1,592 @@
+#include "TextureStreamer.h"
+#include "MemoryBudget.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//----- KTX2 -----
+
+static const ubyte Ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header {
+    ubyte identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount; // 0 means the app should generate them, which the streamer doesn't, so rejected
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset, dfdByteLength;
+    uint32_t kvdByteOffset, kvdByteLength;
+    uint64_t sbgdByteOffset, sbgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+// Follows the header, level 0 (the largest) first.
+struct Ktx2Level {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+struct FormatBlock {
+    VkFormat format;
+    ubyte width, height, bytes;
+};
+
+/* The formats this takes, uncompressed ones need a whole texel block size that divides 16. */
+static const FormatBlock FormatBlocks[] = {
+    { VK_FORMAT_R8_UNORM, 1, 1, 1 },
+    { VK_FORMAT_R8_SRGB, 1, 1, 1 },
+    { VK_FORMAT_R8G8_UNORM, 1, 1, 2 },
+    { VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4 },
+    { VK_FORMAT_R8G8B8A8_SRGB, 1, 1, 4 },
+    { VK_FORMAT_B8G8R8A8_UNORM, 1, 1, 4 },
+    { VK_FORMAT_B8G8R8A8_SRGB, 1, 1, 4 },
+    { VK_FORMAT_A2B10G10R10_UNORM_PACK32, 1, 1, 4 },
+    { VK_FORMAT_R16G16B16A16_SFLOAT, 1, 1, 8 },
+    { VK_FORMAT_R32G32B32A32_SFLOAT, 1, 1, 16 },
+    { VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC1_RGB_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC2_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC2_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC3_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC3_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC4_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC4_SNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC5_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC5_SNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC6H_UFLOAT_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC6H_SFLOAT_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC7_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC7_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ASTC_4x4_SRGB_BLOCK, 4, 4, 16 },
+};
+
+#define TEXSTREAM_COPY_ALIGN 16u
+#define TEXSTREAM_TAIL_RESERVE (1u << 20) // staging per slot on top of the budget, for tails
+
+static VkDeviceSize
+AlignCopy(VkDeviceSize x)
+{
+    return (x + TEXSTREAM_COPY_ALIGN - 1) & ~VkDeviceSize(TEXSTREAM_COPY_ALIGN - 1);
+}
+
+static uint32_t
+LevelWidth(const StreamedTexture& t, uint32_t level) { return Max(t.width >> level, 1u); }
+static uint32_t
+LevelHeight(const StreamedTexture& t, uint32_t level) { return Max(t.height >> level, 1u); }
+
+static VkDeviceSize
+LevelRowBytes(const StreamedTexture& t, uint32_t level)
+{
+    return VkDeviceSize((LevelWidth(t, level) + t.blockWidth - 1) / t.blockWidth) * t.blockBytes;
+}
+
+static uint32_t
+LevelRowCount(const StreamedTexture& t, uint32_t level)
+{
+    return (LevelHeight(t, level) + t.blockHeight - 1) / t.blockHeight;
+}
+
+static VkDeviceSize
+TailStagingBytes(const StreamedTexture& t)
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t level = t.tailTop; level < t.levelCount; ++level) {
+        bytes += AlignCopy(LevelRowBytes(t, level) * LevelRowCount(t, level));
+    }
+    return bytes;
+}
+
+// Returns null if the file works, fills in the texture's format and level fields.
+static const char *
+ParseKtx2(StreamedTexture& t, const ubyte *data, size_t size)
+{
+    Ktx2Header h;
+    if (size < sizeof h || memcmp(data, Ktx2Identifier, sizeof Ktx2Identifier)) return "not a KTX2 file";
+    memcpy(&h, data, sizeof h);
+    if (h.supercompressionScheme != 0) return "supercompressed, not supported";
+    if (h.pixelDepth > 1 || h.layerCount > 1 || h.faceCount != 1 || h.pixelHeight == 0) return "not a plain 2D texture";
+    if (h.pixelWidth == 0) return "zero width";
+    if (h.levelCount == 0) return "no stored levels";
+
+    const FormatBlock *block = nullptr;
+    for (const FormatBlock& b : FormatBlocks) {
+        if (b.format == VkFormat(h.vkFormat)) block = &b;
+    }
+    if (!block) return "unsupported format";
+
+    t.format = VkFormat(h.vkFormat);
+    t.width = h.pixelWidth;
+    t.height = h.pixelHeight;
+    t.levelCount = h.levelCount;
+    t.blockWidth = block->width;
+    t.blockHeight = block->height;
+    t.blockBytes = block->bytes;
+    if (t.levelCount > TEXSTREAM_MAX_LEVELS || (Max(t.width, t.height) >> (t.levelCount - 1)) == 0) return "bad level count";
+    if (size < sizeof h + t.levelCount * sizeof(Ktx2Level)) return "truncated";
+
+    for (uint32_t level = 0; level < t.levelCount; ++level) {
+        Ktx2Level l;
+        memcpy(&l, data + sizeof h + level * sizeof l, sizeof l);
+        if (l.byteLength != LevelRowBytes(t, level) * LevelRowCount(t, level)) return "unexpected level size";
+        if (l.byteOffset > size || l.byteLength > size - l.byteOffset) return "truncated";
+        t.levelOffset[level] = l.byteOffset;
+    }
+
+    t.tailTop = t.levelCount - 1;
+    while (t.tailTop > 0 && Max(LevelWidth(t, t.tailTop - 1), LevelHeight(t, t.tailTop - 1)) <= TEXSTREAM_TAIL_DIM) {
+        --t.tailTop;
+    }
+    return nullptr;
+}
+
+//----- Images -----
+
+// Levels [top, levelCount) of the texture, level 0 of the image is top.
+static VkResult
+CreateTextureImage(const VulkanRenderer& vkr, const StreamedTexture& t, uint32_t top,
+                   VkImage *pImage, VkDeviceMemory *pMemory, VkDeviceSize *pBytes)
+{
+    *pMemory = nullptr;
+    VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = t.format;
+    info.extent = { LevelWidth(t, top), LevelHeight(t, top), 1 };
+    info.mipLevels = t.levelCount - top;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult res = vkCreateImage(vkr.device, &info, nullptr, pImage);
+    if (res != VK_SUCCESS) {
+        return res;
+    }
+
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(vkr.device, *pImage, &req);
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = req.size;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(vkr.caps.memory, req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    res = allocInfo.memoryTypeIndex == UINT32_MAX ? VK_ERROR_FEATURE_NOT_PRESENT
+                                                  : MemBudget_Allocate(vkr, allocInfo, MemCategory_Textures, pMemory);
+    if (res == VK_SUCCESS) {
+        res = vkBindImageMemory(vkr.device, *pImage, *pMemory, 0);
+    }
+    if (res != VK_SUCCESS) {
+        vkDestroyImage(vkr.device, *pImage, nullptr);
+        MemBudget_Free(vkr.device, *pMemory);
+        *pImage = nullptr;
+        *pMemory = nullptr;
+        return res;
+    }
+    *pBytes = req.size;
+    return VK_SUCCESS;
+}
+
+static VkImageView
+CreateTextureView(VkDevice device, VkImage image, VkFormat format, uint32_t levelCount)
+{
+    VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.components = COMPONENT_MAPPING_IDENTITY;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+    VkImageView view = nullptr;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+    return view;
+}
+
+/*  Textures are sampled in fragment shaders only. Transitions out of SHADER_READ_ONLY wait for earlier frames'
+    sampling, a barrier's first scope covers earlier submissions on the queue too.
+*/
+#define TEXTURE_READ_STAGE VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+
+static VkImageMemoryBarrier
+ImageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier b = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    b.srcAccessMask = srcAccess;
+    b.dstAccessMask = dstAccess;
+    b.oldLayout = oldLayout;
+    b.newLayout = newLayout;
+    b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.image = image;
+    b.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+    return b;
+}
+
+static void
+CmdToShaderRead(VkCommandBuffer cmd, VkImage image)
+{
+    VkImageMemoryBarrier const b = ImageBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, TEXTURE_READ_STAGE, 0, 0, nullptr, 0, nullptr, 1, &b);
+}
+
+/*  Copies the levels both images have from the texture's current image into newImage (in TRANSFER_DST), newTop
+    being newImage's level 0. The current image is left in TRANSFER_SRC, it's about to be retired.
+*/
+static void
+CmdCopyResidentLevels(VkCommandBuffer cmd, const StreamedTexture& t, VkImage newImage, uint32_t newTop)
+{
+    VkImageMemoryBarrier const b = ImageBarrier(t.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                0, VK_ACCESS_TRANSFER_READ_BIT);
+    vkCmdPipelineBarrier(cmd, TEXTURE_READ_STAGE, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &b);
+
+    VkImageCopy regions[TEXSTREAM_MAX_LEVELS];
+    uint32_t count = 0;
+    for (uint32_t level = Max(t.residentTop, newTop); level < t.levelCount; ++level) {
+        VkImageCopy& r = regions[count++];
+        r.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - t.residentTop, 0, 1 };
+        r.srcOffset = { 0, 0, 0 };
+        r.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - newTop, 0, 1 };
+        r.dstOffset = { 0, 0, 0 };
+        r.extent = { LevelWidth(t, level), LevelHeight(t, level), 1 };
+    }
+    vkCmdCopyImage(cmd, t.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   count, regions);
+}
+
+// The old image, view and memory go to the slot's retire list, the frames in flight may still sample them.
+static void
+SwitchImage(TextureStreamer& ts, VkDevice device, StreamedTexture& t, uint32_t slot,
+            VkImage image, VkDeviceMemory memory, VkDeviceSize memoryBytes, uint32_t top)
+{
+    ASSERT(ts.retiredCount[slot] < lengthof(ts.retired[slot]));
+    ts.retired[slot][ts.retiredCount[slot]++] = { t.image, t.memory, t.view };
+    ts.residentBytes -= t.memoryBytes;
+
+    t.image = image;
+    t.memory = memory;
+    t.memoryBytes = memoryBytes;
+    t.residentTop = top;
+    t.view = CreateTextureView(device, image, t.format, t.levelCount - top);
+}
+
+static void
+DestroyTextureImage(VkDevice device, VkImage image, VkDeviceMemory memory, VkImageView view)
+{
+    vkDestroyImageView(device, view, nullptr);
+    vkDestroyImage(device, image, nullptr);
+    MemBudget_Free(device, memory);
+}
+
+//----- Streamer -----
+
+bool
+TextureStreamer_Create(TextureStreamer& ts, const VulkanRenderer& vkr, uint32_t slotCount, VkDeviceSize budgetBytes)
+{
+    ASSERT(slotCount <= GPUTIMER_MAX_SLOTS);
+    ts = { };
+    ts.slotCount = slotCount;
+    ts.budgetBytes = AlignCopy(budgetBytes);
+    ts.regionBytes = ts.budgetBytes + TEXSTREAM_TAIL_RESERVE;
+    if (VKH_CreateBuffer(vkr, ts.regionBytes * slotCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                         &ts.staging) != VK_SUCCESS) {
+        ts = { };
+        return false;
+    }
+
+    VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = vkr.caps.features.samplerAnisotropy;
+    samplerInfo.maxAnisotropy = Min(8.0f, vkr.caps.props.limits.maxSamplerAnisotropy);
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(vkr.device, &samplerInfo, nullptr, &ts.sampler));
+
+    /* The fallback, white so it doesn't change what it's multiplied with. */
+    static const uint32_t White = 0xFFFFFFFFu;
+    StreamedTexture& t = ts.textures[ts.textureCount++];
+    strcpy(t.name, "fallback");
+    t.data = reinterpret_cast<const ubyte *>(&White);
+    t.format = VK_FORMAT_R8G8B8A8_UNORM;
+    t.width = t.height = 1;
+    t.levelCount = 1;
+    t.blockWidth = t.blockHeight = 1;
+    t.blockBytes = 4;
+    VK_CHECK(CreateTextureImage(vkr, t, 0, &t.image, &t.memory, &t.memoryBytes));
+    t.view = CreateTextureView(vkr.device, t.image, t.format, 1);
+    ts.residentBytes += t.memoryBytes;
+    t.bTailPending = true;
+    return true;
+}
+
+void
+TextureStreamer_Destroy(TextureStreamer& ts, VkDevice device)
+{
+    for (uint32_t slot = 0; slot < ts.slotCount; ++slot) {
+        TextureStreamer_RetireSlot(ts, device, slot);
+    }
+    DestroyTextureImage(device, ts.upgrade.image, ts.upgrade.memory, nullptr);
+    for (uint32_t i = 0; i < ts.textureCount; ++i) {
+        StreamedTexture& t = ts.textures[i];
+        DestroyTextureImage(device, t.image, t.memory, t.view);
+        if (t.file.data) {
+            OS_UnmapFile(t.file);
+        }
+    }
+    vkDestroySampler(device, ts.sampler, nullptr);
+    VKH_DestroyBuffer(device, ts.staging);
+    ts = { };
+}
+
+uint32_t
+TextureStreamer_Load(TextureStreamer& ts, const VulkanRenderer& vkr, const char *path)
+{
+    if (ts.textureCount == TEXSTREAM_MAX_TEXTURES) {
+        printf("Textures: %s: too many textures\n", path);
+        return 0;
+    }
+    StreamedTexture& t = ts.textures[ts.textureCount];
+    t = { };
+    if (!OS_MapFileReadOnly(path, &t.file)) {
+        printf("Textures: can't open %s\n", path);
+        return 0;
+    }
+    t.data = static_cast<const ubyte *>(t.file.data);
+    const char *err = ParseKtx2(t, t.data, t.file.size);
+    if (!err) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(vkr.physicalDevice, t.format, &props);
+        VkFormatFeatureFlags const needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                                            VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        if ((props.optimalTilingFeatures & needed) != needed) {
+            err = "format not supported by the GPU";
+        }
+    }
+    if (!err && TailStagingBytes(t) > TEXSTREAM_TAIL_RESERVE) {
+        err = "mip tail too large, the file needs more mip levels";
+    }
+    if (!err && CreateTextureImage(vkr, t, t.tailTop, &t.image, &t.memory, &t.memoryBytes) != VK_SUCCESS) {
+        err = "couldn't create the image";
+    }
+    if (err) {
+        printf("Textures: %s: %s\n", path, err);
+        OS_UnmapFile(t.file);
+        t = { };
+        return 0;
+    }
+
+    const char *name = strrchr(path, '/');
+    const char *name2 = strrchr(path, '\\');
+    name = name2 > name ? name2 : name;
+    strncpy(t.name, name ? name + 1 : path, sizeof t.name - 1);
+    t.view = CreateTextureView(vkr.device, t.image, t.format, t.levelCount - t.tailTop);
+    t.residentTop = t.tailTop;
+    t.wantTop = t.tailTop;
+    t.bTailPending = true;
+    ts.residentBytes += t.memoryBytes;
+    printf("Textures: %s: %ux%u, %u levels, tail from level %u (%u KiB) resident\n", t.name, t.width, t.height,
+           t.levelCount, t.tailTop, uint(t.memoryBytes >> 10));
+    return ts.textureCount++;
+}
+
+void
+TextureStreamer_SetWantedSize(TextureStreamer& ts, uint32_t texture, uint32_t pixels)
+{
+    if (texture == 0 || texture >= ts.textureCount) {
+        return;
+    }
+    StreamedTexture& t = ts.textures[texture];
+    uint32_t top = t.tailTop;
+    while (top > 0 && Max(LevelWidth(t, top), LevelHeight(t, top)) < pixels) {
+        --top;
+    }
+    t.wantTop = top;
+}
+
+void
+TextureStreamer_RetireSlot(TextureStreamer& ts, VkDevice device, uint32_t slot)
+{
+    for (uint32_t i = 0; i < ts.retiredCount[slot]; ++i) {
+        RetiredTextureImage& r = ts.retired[slot][i];
+        DestroyTextureImage(device, r.image, r.memory, r.view);
+    }
+    ts.retiredCount[slot] = 0;
+}
+
+// Staging space of the slot's region, for this frame's CmdUpdate.
+struct StagingCursor {
+    ubyte *mapped; // region start
+    VkDeviceSize bufferOffset; // of the region
+    VkDeviceSize used;
+    VkDeviceSize size;
+};
+
+static VkDeviceSize
+StageCopy(StagingCursor& sc, const void *src, VkDeviceSize bytes)
+{
+    VkDeviceSize const offset = sc.used;
+    ASSERT(offset + bytes <= sc.size);
+    memcpy(sc.mapped + offset, src, size_t(bytes));
+    sc.used = AlignCopy(offset + bytes);
+    return sc.bufferOffset + offset;
+}
+
+static void
+CmdUploadTail(VkCommandBuffer cmd, VkBuffer staging, StagingCursor& sc, StreamedTexture& t)
+{
+    VkImageMemoryBarrier const b = ImageBarrier(t.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                0, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &b);
+
+    VkBufferImageCopy regions[TEXSTREAM_MAX_LEVELS] = { };
+    uint32_t count = 0;
+    for (uint32_t level = t.tailTop; level < t.levelCount; ++level) {
+        VkBufferImageCopy& r = regions[count++];
+        r.bufferOffset = StageCopy(sc, t.data + t.levelOffset[level], LevelRowBytes(t, level) * LevelRowCount(t, level));
+        r.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - t.tailTop, 0, 1 };
+        r.imageExtent = { LevelWidth(t, level), LevelHeight(t, level), 1 };
+    }
+    vkCmdCopyBufferToImage(cmd, staging, t.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, count, regions);
+    CmdToShaderRead(cmd, t.image);
+    t.bTailPending = false;
+}
+
+// The texture that is furthest from what it wants, 0 if none want more.
+static uint32_t
+PickUpgrade(const TextureStreamer& ts)
+{
+    uint32_t best = 0, bestGap = 0;
+    for (uint32_t i = 1; i < ts.textureCount; ++i) {
+        const StreamedTexture& t = ts.textures[i];
+        if (!t.bTailPending && t.residentTop > t.wantTop && t.residentTop - t.wantTop > bestGap) {
+            best = i;
+            bestGap = t.residentTop - t.wantTop;
+        }
+    }
+    return best;
+}
+
+void
+TextureStreamer_CmdUpdate(TextureStreamer& ts, const VulkanRenderer& vkr, VkCommandBuffer cmd, uint32_t slot)
+{
+    StagingCursor sc = { static_cast<ubyte *>(ts.staging.pMapped) + slot * ts.regionBytes, slot * ts.regionBytes,
+                         0, ts.regionBytes };
+
+    /* Tails first and regardless of the budget, a texture isn't usable without one. Whatever doesn't fit this
+       frame's staging region waits for the next frame. */
+    for (uint32_t i = 0; i < ts.textureCount; ++i) {
+        StreamedTexture& t = ts.textures[i];
+        if (t.bTailPending && sc.used + TailStagingBytes(t) <= sc.size) {
+            CmdUploadTail(cmd, ts.staging.buffer, sc, t);
+        }
+    }
+    VkDeviceSize const tailBytes = sc.used;
+
+    /* Drop levels that are 2+ finer than wanted (one level of hysteresis), this costs only a GPU copy. */
+    for (uint32_t i = 1; i < ts.textureCount; ++i) {
+        StreamedTexture& t = ts.textures[i];
+        if (t.bTailPending || i == ts.upgrade.texture || t.residentTop + 1 >= t.wantTop) {
+            continue;
+        }
+        if (ts.retiredCount[slot] == lengthof(ts.retired[slot])) {
+            break;
+        }
+        VkImage image;
+        VkDeviceMemory memory;
+        VkDeviceSize memoryBytes;
+        if (CreateTextureImage(vkr, t, t.wantTop, &image, &memory, &memoryBytes) != VK_SUCCESS) {
+            continue;
+        }
+        VkImageMemoryBarrier const b = ImageBarrier(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                    0, VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &b);
+        CmdCopyResidentLevels(cmd, t, image, t.wantTop);
+        CmdToShaderRead(cmd, image);
+        ts.residentBytes += memoryBytes;
+        SwitchImage(ts, vkr.device, t, slot, image, memory, memoryBytes, t.wantTop);
+    }
+
+    /* Stream finer levels within the budget. */
+    VkDeviceSize const budgetEnd = Min(sc.used + ts.budgetBytes, sc.size);
+    for (;;) {
+        TextureUpgrade& up = ts.upgrade;
+        if (ts.retiredCount[slot] == lengthof(ts.retired[slot])) {
+            break; // completed enough levels for one frame
+        }
+        if (!up.texture) {
+            uint32_t const texture = PickUpgrade(ts);
+            if (!texture) {
+                break;
+            }
+            StreamedTexture& t = ts.textures[texture];
+            up = { };
+            up.level = t.residentTop - 1;
+            if (CreateTextureImage(vkr, t, up.level, &up.image, &up.memory, &up.memoryBytes) != VK_SUCCESS) {
+                printf("Textures: %s: out of memory for level %u\n", t.name, up.level);
+                t.wantTop = t.residentTop; // until asked again
+                up = { };
+                continue;
+            }
+            up.texture = texture;
+            up.rowCount = LevelRowCount(t, up.level);
+            ts.residentBytes += up.memoryBytes;
+            VkImageMemoryBarrier const b = ImageBarrier(up.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                        0, VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &b);
+        }
+
+        StreamedTexture& t = ts.textures[up.texture];
+        VkDeviceSize const rowBytes = LevelRowBytes(t, up.level);
+        VkDeviceSize const room = budgetEnd > sc.used ? budgetEnd - sc.used : 0;
+        uint32_t rows = uint32_t(Min(room / rowBytes, VkDeviceSize(up.rowCount - up.rowsDone)));
+        if (rows == 0 && sc.used == tailBytes && rowBytes <= sc.size - sc.used) {
+            rows = 1; // a row larger than the whole budget, still make progress
+        }
+        if (rows == 0) {
+            break;
+        }
+
+        VkBufferImageCopy r = { };
+        r.bufferOffset = StageCopy(sc, t.data + t.levelOffset[up.level] + up.rowsDone * rowBytes, rows * rowBytes);
+        r.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        uint32_t const y0 = up.rowsDone * t.blockHeight;
+        uint32_t const y1 = Min((up.rowsDone + rows) * t.blockHeight, LevelHeight(t, up.level));
+        r.imageOffset = { 0, int32_t(y0), 0 };
+        r.imageExtent = { LevelWidth(t, up.level), y1 - y0, 1 };
+        vkCmdCopyBufferToImage(cmd, ts.staging.buffer, up.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &r);
+        up.rowsDone += rows;
+        if (up.rowsDone < up.rowCount) {
+            break; // out of budget
+        }
+
+        /* Level complete: the coarser levels come from the current image, then switch to the new one. */
+        CmdCopyResidentLevels(cmd, t, up.image, up.level);
+        CmdToShaderRead(cmd, up.image);
+        SwitchImage(ts, vkr.device, t, slot, up.image, up.memory, up.memoryBytes, up.level);
+        up = { };
+    }
+
+    ts.uploadedBytesLastFrame = sc.used;
+}
+
+VkImageView
+TextureStreamer_GetView(const TextureStreamer& ts, uint32_t texture)
+{
+    const StreamedTexture& t = ts.textures[texture < ts.textureCount ? texture : 0];
+    return t.bTailPending ? ts.textures[0].view : t.view;
+}
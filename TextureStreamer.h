@@ -0,0 +1,103 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "VulkanSwapchain.h" // os_mapped_file
+#include "GpuTimer.h" // GPUTIMER_MAX_SLOTS
+
+/*
+    Progressive KTX2 texture streaming.
+
+    TextureStreamer_Load maps the file and creates an image holding only the mip tail (levels of at most
+    TEXSTREAM_TAIL_DIM texels), which the next TextureStreamer_CmdUpdate uploads whatever the budget, so a
+    texture is usable the frame it's loaded. Finer levels are streamed one at a time, coarse to fine, towards
+    the size the app asks for with TextureStreamer_SetWantedSize, at most budgetBytes of them per frame.
+
+    An image only ever holds the resident levels. Streaming in a level creates an image one level larger,
+    fills its level 0 from the file (spread over frames if the level doesn't fit the budget), then copies the
+    old levels under it on the GPU and switches to the new view. Asking for a smaller size drops levels the
+    same way, so GPU memory follows the wanted sizes, not the files. Replaced images are destroyed when the
+    frame slot that last used them retires.
+
+    Only plain 2D textures: one layer, one face, no supercompression, with a mip chain down to the tail size.
+    E.g. `toktx --t2 --genmipmap out.ktx2 in.png` (no --encode or --zcmp), or BCn from a tool that writes KTX2.
+*/
+
+#define TEXSTREAM_MAX_TEXTURES 64
+#define TEXSTREAM_MAX_LEVELS 16
+#define TEXSTREAM_TAIL_DIM 128
+
+struct StreamedTexture {
+    os_mapped_file file;
+    const ubyte *data; // file.data, or built in for the fallback
+    char name[64];
+
+    VkFormat format;
+    uint32_t width, height;
+    uint32_t levelCount;
+    uint32_t blockWidth, blockHeight, blockBytes;
+    uint64_t levelOffset[TEXSTREAM_MAX_LEVELS];
+    uint32_t tailTop; // first level of the tail
+
+    // Levels [residentTop, levelCount) are in image, its level 0 is residentTop.
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkDeviceSize memoryBytes;
+    uint32_t residentTop;
+    uint32_t wantTop;
+    bool bTailPending; // created, not uploaded yet
+};
+
+// The next level of one texture being streamed in. At most one at a time, levels are streamed finest-needed-first.
+struct TextureUpgrade {
+    uint32_t texture; // 0 if none, the fallback never gets one
+    uint32_t level; // new residentTop
+    VkImage image;
+    VkDeviceMemory memory;
+    VkDeviceSize memoryBytes;
+    uint32_t rowsDone, rowCount; // rows of blocks of the level
+};
+
+struct RetiredTextureImage {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+};
+
+struct TextureStreamer {
+    BufferAllocation staging; // slotCount regions of regionBytes, a slot only writes its own
+    VkDeviceSize regionBytes;
+    VkDeviceSize budgetBytes; // per frame for streamed levels, tails don't count against it
+    uint32_t slotCount;
+    VkSampler sampler;
+
+    StreamedTexture textures[TEXSTREAM_MAX_TEXTURES]; // [0] is a 1x1 white fallback
+    uint32_t textureCount;
+    TextureUpgrade upgrade;
+
+    RetiredTextureImage retired[GPUTIMER_MAX_SLOTS][2 * TEXSTREAM_MAX_TEXTURES]; // full stops the frame's updates
+    uint32_t retiredCount[GPUTIMER_MAX_SLOTS];
+
+    // Stats
+    VkDeviceSize residentBytes; // device memory of all the images, including the upgrade in progress
+    VkDeviceSize uploadedBytesLastFrame;
+};
+
+bool TextureStreamer_Create(TextureStreamer& ts, const VulkanRenderer& vkr, uint32_t slotCount, VkDeviceSize budgetBytes);
+// The GPU must be idle.
+void TextureStreamer_Destroy(TextureStreamer& ts, VkDevice device);
+
+// Returns the texture handle, or 0 (the fallback) if the file can't be used, after printing why.
+uint32_t TextureStreamer_Load(TextureStreamer& ts, const VulkanRenderer& vkr, const char *path);
+
+// Largest dimension in pixels the texture covers on screen, roughly. Selects the finest level to keep resident.
+void TextureStreamer_SetWantedSize(TextureStreamer& ts, uint32_t texture, uint32_t pixels);
+
+// Call after the slot's fence wait, every frame.
+void TextureStreamer_RetireSlot(TextureStreamer& ts, VkDevice device, uint32_t slot);
+
+// Outside a render pass, before anything samples the textures this frame.
+void TextureStreamer_CmdUpdate(TextureStreamer& ts, const VulkanRenderer& vkr, VkCommandBuffer cmd, uint32_t slot);
+
+// Valid until the next TextureStreamer_CmdUpdate. The fallback's view until the tail is resident.
+VkImageView TextureStreamer_GetView(const TextureStreamer& ts, uint32_t texture);
@@ -0,0 +1,444 @@
+#pragma once
+
+#include "common.h"
+
+/*
+    .vkt trace files: one frame's Vulkan command stream with everything it uses, written by FrameTrace.h and
+    played back by tools/tracereplay.
+
+    A header, then chunks, each a TraceChunkHeader and its payload padded to TRACEFILE_ALIGN:
+        objects, in the order they were created, so what an object refers to always comes before it;
+        then the command buffers, in the order they were submitted.
+
+    Objects are referred to by id, the same ids the capture used, so they are increasing but not dense.
+    header.idLimit bounds them. TRACE_NO_ID is a null handle.
+
+    Payloads are a fixed struct, then its arrays in the order the struct's counts are listed. Vulkan enums and
+    flags are stored as their uint32 values, there are no pointers, pNext chains or handles. Buffer and image
+    payloads end with the contents from before the frame ran.
+
+    A command buffer chunk is a stream of TraceCmdHeader + payload, each padded to TRACEFILE_ALIGN, covering
+    the vkCmd* calls in TraceCmd. Queries and timestamps are left out, the replay times the frame itself.
+
+    Shared with the tools, so no Vulkan here. Little-endian only.
+*/
+
+#define TRACEFILE_MAGIC 0x544C4B56u // "VKLT"
+#define TRACEFILE_VERSION 2u
+#define TRACEFILE_ALIGN 8u
+#define TRACE_NO_ID 0xFFFFFFFFu
+
+struct TraceFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t idLimit; // every id is less
+    uint32_t objectCount;
+    uint32_t commandBufferCount;
+    uint32_t frameIndex; // in the run that captured it
+    uint32_t width, height; // of the swapchain images
+};
+
+enum TraceChunkType {
+    TraceChunk_Buffer,
+    TraceChunk_Image,
+    TraceChunk_ImageView,
+    TraceChunk_Sampler,
+    TraceChunk_ShaderModule,
+    TraceChunk_SetLayout,
+    TraceChunk_PipelineLayout,
+    TraceChunk_RenderPass,
+    TraceChunk_Framebuffer,
+    TraceChunk_GraphicsPipeline,
+    TraceChunk_ComputePipeline,
+    TraceChunk_DescriptorSet,
+    TraceChunk_CommandBuffer,
+    TraceChunk_Count
+};
+
+struct TraceChunkHeader {
+    uint32_t type; // TraceChunkType
+    uint32_t id; // TRACE_NO_ID for command buffers
+    uint64_t size; // of the payload, without padding
+};
+
+//----- Object payloads -----
+
+struct TraceBuffer {
+    uint64_t size;
+    uint32_t usage; // as created by the app, the capture adds TRANSFER_SRC
+    uint32_t memoryFlags; // VkMemoryPropertyFlags of the memory it was bound to
+    uint64_t dataSize; // 0 or size, the bytes follow
+};
+
+struct TraceImageLevel {
+    uint32_t layout; // when the frame started, UNDEFINED if unknown
+    uint32_t pad;
+    uint64_t dataOffset; // from the end of the TraceImageLevel array
+    uint64_t dataSize; // 0 if the contents weren't taken, else tightly packed texel blocks
+};
+
+struct TraceImage {
+    uint32_t flags, imageType, format;
+    uint32_t width, height, depth;
+    uint32_t mipLevels, arrayLayers, samples, tiling, usage;
+    uint32_t memoryFlags;
+    uint32_t bSwapchain; // a swapchain image, the replay makes an ordinary one
+    uint32_t pad;
+    // TraceImageLevel levels[mipLevels], then the data
+};
+
+struct TraceImageView {
+    uint32_t image;
+    uint32_t viewType, format;
+    uint32_t components[4];
+    uint32_t aspect, baseMip, mipCount, baseLayer, layerCount;
+    uint32_t usage; // from VkImageViewUsageCreateInfo, 0 if there was none
+};
+
+struct TraceSampler {
+    uint32_t magFilter, minFilter, mipmapMode;
+    uint32_t addressModeU, addressModeV, addressModeW;
+    float mipLodBias;
+    uint32_t anisotropyEnable;
+    float maxAnisotropy;
+    uint32_t compareEnable, compareOp;
+    float minLod, maxLod;
+    uint32_t borderColor, unnormalizedCoordinates;
+};
+
+struct TraceShaderModule {
+    uint64_t codeSize; // the SPIR-V follows
+};
+
+struct TraceSetLayoutBinding {
+    uint32_t binding, descriptorType, descriptorCount, stageFlags;
+    uint32_t firstImmutableSampler; // descriptorCount of them in samplers, or TRACE_NO_ID if there are none
+};
+
+struct TraceSetLayout {
+    uint32_t flags;
+    uint32_t bindingCount;
+    uint32_t immutableSamplerCount;
+    // TraceSetLayoutBinding bindings[bindingCount], uint32_t samplers[immutableSamplerCount]
+};
+
+struct TracePushRange {
+    uint32_t stageFlags, offset, size;
+};
+
+struct TracePipelineLayout {
+    uint32_t setLayoutCount, pushRangeCount;
+    // uint32_t setLayouts[setLayoutCount], TracePushRange ranges[pushRangeCount]
+};
+
+struct TraceAttachment {
+    uint32_t flags, format, samples;
+    uint32_t loadOp, storeOp, stencilLoadOp, stencilStoreOp;
+    uint32_t initialLayout, finalLayout;
+};
+
+struct TraceAttachmentRef {
+    uint32_t attachment, layout;
+};
+
+/* A subpass's references are consecutive from firstRef: inputs, colors, resolves (colorCount of them if
+   bResolve), then the depth/stencil one if bDepth. */
+struct TraceSubpass {
+    uint32_t bindPoint;
+    uint32_t firstRef, inputCount, colorCount, bResolve, bDepth;
+    uint32_t firstPreserve, preserveCount;
+};
+
+struct TraceDependency {
+    uint32_t srcSubpass, dstSubpass;
+    uint32_t srcStageMask, dstStageMask, srcAccessMask, dstAccessMask, dependencyFlags;
+};
+
+struct TraceRenderPass {
+    uint32_t attachmentCount, subpassCount, dependencyCount, refCount, preserveCount;
+    // TraceAttachment, TraceSubpass, TraceDependency, TraceAttachmentRef arrays, uint32_t preserves[preserveCount]
+};
+
+struct TraceFramebuffer {
+    uint32_t renderPass;
+    uint32_t width, height, layers;
+    uint32_t attachmentCount;
+    // uint32_t views[attachmentCount]
+};
+
+struct TraceShaderStage {
+    uint32_t stage, module;
+    char name[32]; // NUL terminated
+};
+
+struct TraceVertexBinding {
+    uint32_t binding, stride, inputRate;
+};
+
+struct TraceVertexAttribute {
+    uint32_t location, binding, format, offset;
+};
+
+struct TraceBlendAttachment {
+    uint32_t blendEnable;
+    uint32_t srcColor, dstColor, colorOp, srcAlpha, dstAlpha, alphaOp;
+    uint32_t colorWriteMask;
+};
+
+struct TraceStencilOp {
+    uint32_t failOp, passOp, depthFailOp, compareOp, compareMask, writeMask, reference;
+};
+
+struct TraceViewport {
+    float x, y, width, height, minDepth, maxDepth;
+};
+
+struct TraceRect {
+    int32_t x, y;
+    uint32_t width, height;
+};
+
+struct TraceGraphicsPipeline {
+    uint32_t flags, layout, renderPass, subpass;
+    uint32_t stageCount, bindingCount, attributeCount;
+    uint32_t topology, primitiveRestartEnable;
+    // rasterization
+    uint32_t depthClampEnable, rasterizerDiscardEnable, polygonMode, cullMode, frontFace, depthBiasEnable;
+    float depthBiasConstantFactor, depthBiasClamp, depthBiasSlopeFactor, lineWidth;
+    // multisample
+    uint32_t rasterizationSamples, sampleShadingEnable;
+    float minSampleShading;
+    uint32_t alphaToCoverageEnable, alphaToOneEnable;
+    // depth/stencil, only if bDepthStencil
+    uint32_t bDepthStencil;
+    uint32_t depthTestEnable, depthWriteEnable, depthCompareOp, depthBoundsTestEnable, stencilTestEnable;
+    TraceStencilOp front, back;
+    float minDepthBounds, maxDepthBounds;
+    // color blend, only if bColorBlend
+    uint32_t bColorBlend;
+    uint32_t logicOpEnable, logicOp, blendAttachmentCount;
+    float blendConstants[4];
+    // viewport state, the arrays are only there if the counts aren't dynamic
+    uint32_t viewportCount, scissorCount, staticViewportCount, staticScissorCount;
+    uint32_t dynamicStateCount;
+    // TraceShaderStage stages[stageCount], TraceVertexBinding, TraceVertexAttribute, TraceBlendAttachment,
+    // TraceViewport[staticViewportCount], TraceRect[staticScissorCount], uint32_t dynamicStates[dynamicStateCount]
+};
+
+struct TraceComputePipeline {
+    uint32_t flags, layout;
+    TraceShaderStage stage;
+};
+
+/* One array element of a binding, as last written. object is an image view or a buffer, by type. */
+struct TraceDescriptor {
+    uint32_t binding, arrayElement, descriptorType;
+    uint32_t object, sampler, imageLayout;
+    uint64_t offset, range;
+};
+
+struct TraceDescriptorSet {
+    uint32_t setLayout;
+    uint32_t descriptorCount;
+    // TraceDescriptor descriptors[descriptorCount]
+};
+
+//----- Commands -----
+
+enum TraceCmdType {
+    TraceCmd_BeginRenderPass,
+    TraceCmd_EndRenderPass,
+    TraceCmd_BindPipeline,
+    TraceCmd_BindDescriptorSets,
+    TraceCmd_PushConstants,
+    TraceCmd_SetViewport,
+    TraceCmd_SetScissor,
+    TraceCmd_BindVertexBuffers,
+    TraceCmd_BindIndexBuffer,
+    TraceCmd_Draw,
+    TraceCmd_DrawIndexed,
+    TraceCmd_DrawIndirect,
+    TraceCmd_Dispatch,
+    TraceCmd_PipelineBarrier,
+    TraceCmd_CopyBuffer,
+    TraceCmd_CopyBufferToImage,
+    TraceCmd_CopyImageToBuffer,
+    TraceCmd_CopyImage,
+    TraceCmd_BlitImage,
+    TraceCmd_FillBuffer,
+    TraceCmd_UpdateBuffer,
+    TraceCmd_Count
+};
+
+struct TraceCmdHeader {
+    uint32_t type; // TraceCmdType
+    uint32_t size; // of the payload, without padding
+};
+
+struct TraceCmdBeginRenderPass {
+    uint32_t renderPass, framebuffer;
+    TraceRect renderArea;
+    uint32_t contents;
+    uint32_t clearValueCount;
+    // uint32_t clearValues[clearValueCount][4], VkClearValue's bits
+};
+
+struct TraceCmdBindPipeline {
+    uint32_t bindPoint, pipeline;
+};
+
+struct TraceCmdBindDescriptorSets {
+    uint32_t bindPoint, layout, firstSet, setCount, dynamicOffsetCount;
+    // uint32_t sets[setCount], dynamicOffsets[dynamicOffsetCount]
+};
+
+struct TraceCmdPushConstants {
+    uint32_t layout, stageFlags, offset, size;
+    // the bytes
+};
+
+struct TraceCmdSetViewport {
+    uint32_t first, count;
+    // TraceViewport[count]
+};
+
+struct TraceCmdSetScissor {
+    uint32_t first, count;
+    // TraceRect[count]
+};
+
+struct TraceVertexBufferBinding {
+    uint32_t buffer, pad;
+    uint64_t offset;
+};
+
+struct TraceCmdBindVertexBuffers {
+    uint32_t first, count;
+    // TraceVertexBufferBinding[count]
+};
+
+struct TraceCmdBindIndexBuffer {
+    uint32_t buffer, indexType;
+    uint64_t offset;
+};
+
+struct TraceCmdDraw {
+    uint32_t vertexCount, instanceCount, firstVertex, firstInstance;
+};
+
+struct TraceCmdDrawIndexed {
+    uint32_t indexCount, instanceCount, firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+};
+
+struct TraceCmdDrawIndirect {
+    uint32_t buffer, drawCount;
+    uint64_t offset;
+    uint32_t stride, pad;
+};
+
+struct TraceCmdDispatch {
+    uint32_t x, y, z;
+};
+
+struct TraceMemoryBarrier {
+    uint32_t srcAccessMask, dstAccessMask;
+};
+
+struct TraceBufferBarrier {
+    uint32_t srcAccessMask, dstAccessMask, srcQueueFamily, dstQueueFamily;
+    uint32_t buffer, pad;
+    uint64_t offset, size;
+};
+
+struct TraceSubresourceRange {
+    uint32_t aspect, baseMip, mipCount, baseLayer, layerCount;
+};
+
+struct TraceImageBarrier {
+    uint32_t srcAccessMask, dstAccessMask, oldLayout, newLayout, srcQueueFamily, dstQueueFamily;
+    uint32_t image;
+    TraceSubresourceRange range;
+};
+
+struct TraceCmdPipelineBarrier {
+    uint32_t srcStageMask, dstStageMask, dependencyFlags;
+    uint32_t memoryBarrierCount, bufferBarrierCount, imageBarrierCount;
+    // TraceMemoryBarrier, TraceBufferBarrier (8-byte aligned here), TraceImageBarrier arrays
+};
+
+struct TraceBufferCopy {
+    uint64_t srcOffset, dstOffset, size;
+};
+
+struct TraceCmdCopyBuffer {
+    uint32_t src, dst, regionCount, pad;
+    // TraceBufferCopy[regionCount]
+};
+
+struct TraceSubresourceLayers {
+    uint32_t aspect, mip, baseLayer, layerCount;
+};
+
+struct TraceBufferImageCopy {
+    uint64_t bufferOffset;
+    uint32_t bufferRowLength, bufferImageHeight;
+    TraceSubresourceLayers subresource;
+    int32_t offset[3];
+    uint32_t extent[3];
+};
+
+/* CopyBufferToImage and CopyImageToBuffer. */
+struct TraceCmdBufferImageCopy {
+    uint32_t buffer, image, imageLayout, regionCount;
+    // TraceBufferImageCopy[regionCount]
+};
+
+struct TraceImageCopy {
+    TraceSubresourceLayers srcSubresource;
+    int32_t srcOffset[3];
+    TraceSubresourceLayers dstSubresource;
+    int32_t dstOffset[3];
+    uint32_t extent[3];
+};
+
+struct TraceImageBlit {
+    TraceSubresourceLayers srcSubresource;
+    int32_t srcOffsets[2][3];
+    TraceSubresourceLayers dstSubresource;
+    int32_t dstOffsets[2][3];
+};
+
+/* CopyImage (filter unused) and BlitImage. */
+struct TraceCmdImageCopy {
+    uint32_t src, srcLayout, dst, dstLayout, regionCount, filter;
+    // TraceImageCopy or TraceImageBlit [regionCount]
+};
+
+struct TraceCmdFillBuffer {
+    uint32_t buffer, data;
+    uint64_t offset, size;
+};
+
+struct TraceCmdUpdateBuffer {
+    uint32_t buffer, pad;
+    uint64_t offset, size;
+    // the bytes
+};
+
+inline uint64_t
+TraceFile_AlignUp(uint64_t x)
+{
+    return (x + TRACEFILE_ALIGN - 1) & ~uint64_t(TRACEFILE_ALIGN - 1);
+}
+
+// Returns null if the header makes sense for a file of fileSize bytes.
+inline const char *
+TraceFile_Validate(const TraceFileHeader& h, uint64_t fileSize)
+{
+    if (fileSize < sizeof h || h.magic != TRACEFILE_MAGIC) return "not a .vkt file";
+    if (h.version != TRACEFILE_VERSION) return "unsupported version";
+    if (h.objectCount > h.idLimit) return "more objects than ids";
+    return nullptr;
+}
@@ -0,0 +1,277 @@
+#include "VecMath.h"
+
+#include <math.h>
+#include <string.h>
+
+quatf normalize(quatf q)
+{
+    float const invLen = 1.0f / sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    return { q.x * invLen, q.y * invLen, q.z * invLen, q.w * invLen };
+}
+
+/*
+    Lanes for the SoA kernels: vmf is VM_WIDTH floats, vmi is VM_WIDTH int32s.
+    Only what the kernels below need.
+*/
+#if VM_AVX2
+#define VM_WIDTH 8
+typedef __m256 vmf;
+typedef __m256i vmi;
+static inline vmf vmf_load(const float *p) { return _mm256_loadu_ps(p); }
+static inline void vmf_store(float *p, vmf v) { _mm256_storeu_ps(p, v); }
+static inline vmf vmf_set1(float s) { return _mm256_set1_ps(s); }
+static inline vmf vmf_add(vmf a, vmf b) { return _mm256_add_ps(a, b); }
+static inline vmf vmf_sub(vmf a, vmf b) { return _mm256_sub_ps(a, b); }
+static inline vmf vmf_mul(vmf a, vmf b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+static inline vmf vmf_madd(vmf a, vmf b, vmf c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+static inline vmf vmf_madd(vmf a, vmf b, vmf c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+static inline vmi vmf_round_to_int(vmf a) { return _mm256_cvtps_epi32(a); } // MXCSR default: nearest even
+static inline vmf vmi_to_float(vmi a) { return _mm256_cvtepi32_ps(a); }
+static inline vmi vmi_and(vmi a, int32_t b) { return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+static inline vmi vmi_add(vmi a, int32_t b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+static inline vmi vmi_shl30(vmi a) { return _mm256_slli_epi32(a, 30); }
+static inline vmf vmf_xor_bits(vmf a, vmi bits) { return _mm256_xor_ps(a, _mm256_castsi256_ps(bits)); }
+// a where (k & 1), else b
+static inline vmf vmf_select_odd(vmi k, vmf a, vmf b)
+{
+    vmi const odd = _mm256_cmpeq_epi32(vmi_and(k, 1), _mm256_set1_epi32(1));
+    return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(odd));
+}
+#elif VM_SSE2
+#define VM_WIDTH 4
+typedef __m128 vmf;
+typedef __m128i vmi;
+static inline vmf vmf_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void vmf_store(float *p, vmf v) { _mm_storeu_ps(p, v); }
+static inline vmf vmf_set1(float s) { return _mm_set1_ps(s); }
+static inline vmf vmf_add(vmf a, vmf b) { return _mm_add_ps(a, b); }
+static inline vmf vmf_sub(vmf a, vmf b) { return _mm_sub_ps(a, b); }
+static inline vmf vmf_mul(vmf a, vmf b) { return _mm_mul_ps(a, b); }
+static inline vmf vmf_madd(vmf a, vmf b, vmf c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline vmi vmf_round_to_int(vmf a) { return _mm_cvtps_epi32(a); } // MXCSR default: nearest even
+static inline vmf vmi_to_float(vmi a) { return _mm_cvtepi32_ps(a); }
+static inline vmi vmi_and(vmi a, int32_t b) { return _mm_and_si128(a, _mm_set1_epi32(b)); }
+static inline vmi vmi_add(vmi a, int32_t b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+static inline vmi vmi_shl30(vmi a) { return _mm_slli_epi32(a, 30); }
+static inline vmf vmf_xor_bits(vmf a, vmi bits) { return _mm_xor_ps(a, _mm_castsi128_ps(bits)); }
+static inline vmf vmf_select_odd(vmi k, vmf a, vmf b)
+{
+    vmf const odd = _mm_castsi128_ps(_mm_cmpeq_epi32(vmi_and(k, 1), _mm_set1_epi32(1)));
+    return _mm_or_ps(_mm_and_ps(odd, a), _mm_andnot_ps(odd, b)); // no blendv before SSE4.1
+}
+#elif VM_NEON
+#define VM_WIDTH 4
+typedef float32x4_t vmf;
+typedef int32x4_t vmi;
+static inline vmf vmf_load(const float *p) { return vld1q_f32(p); }
+static inline void vmf_store(float *p, vmf v) { vst1q_f32(p, v); }
+static inline vmf vmf_set1(float s) { return vdupq_n_f32(s); }
+static inline vmf vmf_add(vmf a, vmf b) { return vaddq_f32(a, b); }
+static inline vmf vmf_sub(vmf a, vmf b) { return vsubq_f32(a, b); }
+static inline vmf vmf_mul(vmf a, vmf b) { return vmulq_f32(a, b); }
+static inline vmf vmf_madd(vmf a, vmf b, vmf c) { return vmlaq_f32(c, a, b); }
+static inline vmi vmf_round_to_int(vmf a) { return vcvtnq_s32_f32(a); } // ARMv8
+static inline vmf vmi_to_float(vmi a) { return vcvtq_f32_s32(a); }
+static inline vmi vmi_and(vmi a, int32_t b) { return vandq_s32(a, vdupq_n_s32(b)); }
+static inline vmi vmi_add(vmi a, int32_t b) { return vaddq_s32(a, vdupq_n_s32(b)); }
+static inline vmi vmi_shl30(vmi a) { return vshlq_n_s32(a, 30); }
+static inline vmf vmf_xor_bits(vmf a, vmi bits)
+{
+    return vreinterpretq_f32_s32(veorq_s32(vreinterpretq_s32_f32(a), bits));
+}
+static inline vmf vmf_select_odd(vmi k, vmf a, vmf b)
+{
+    return vbslq_f32(vceqq_s32(vmi_and(k, 1), vdupq_n_s32(1)), a, b);
+}
+#else
+#define VM_WIDTH 1
+typedef float vmf;
+typedef int32_t vmi;
+static inline vmf vmf_load(const float *p) { return *p; }
+static inline void vmf_store(float *p, vmf v) { *p = v; }
+static inline vmf vmf_set1(float s) { return s; }
+static inline vmf vmf_add(vmf a, vmf b) { return a + b; }
+static inline vmf vmf_sub(vmf a, vmf b) { return a - b; }
+static inline vmf vmf_mul(vmf a, vmf b) { return a * b; }
+static inline vmf vmf_madd(vmf a, vmf b, vmf c) { return a * b + c; }
+static inline vmi vmf_round_to_int(vmf a) { return vm_detail::RoundToInt(a); }
+static inline vmf vmi_to_float(vmi a) { return float(a); }
+static inline vmi vmi_and(vmi a, int32_t b) { return a & b; }
+static inline vmi vmi_add(vmi a, int32_t b) { return a + b; }
+static inline vmi vmi_shl30(vmi a) { return int32_t(uint32_t(a) << 30); }
+static inline vmf vmf_xor_bits(vmf a, vmi bits)
+{
+    uint32_t u;
+    memcpy(&u, &a, 4);
+    u ^= uint32_t(bits);
+    memcpy(&a, &u, 4);
+    return a;
+}
+static inline vmf vmf_select_odd(vmi k, vmf a, vmf b) { return (k & 1) ? a : b; }
+#endif
+
+/*  Calls body(p) for each group of VM_WIDTH elements, p[s] pointing at the group's first element in stream s.
+    The last partial group runs on zero-padded copies, so bodies never need a scalar tail.
+*/
+struct VmStream { void *base; size_t elemBytes; bool bOutput; };
+
+template<uint N, class Body>
+static inline void
+ForEachGroup(size_t n, const VmStream (&streams)[N], Body body)
+{
+    void *p[N];
+    size_t i = 0;
+    for (; i + VM_WIDTH <= n; i += VM_WIDTH) {
+        for (uint s = 0; s < N; ++s) {
+            p[s] = (ubyte *)streams[s].base + i * streams[s].elemBytes;
+        }
+        body(p);
+    }
+    size_t const rem = n - i;
+    if (rem == 0) {
+        return;
+    }
+
+    /* Zeros are valid inputs for every kernel here. */
+    alignas(32) ubyte scratch[N][VM_WIDTH * sizeof(mat4f)];
+    memset(scratch, 0, sizeof scratch);
+    for (uint s = 0; s < N; ++s) {
+        ASSERT(streams[s].elemBytes <= sizeof(mat4f));
+        if (!streams[s].bOutput) {
+            memcpy(scratch[s], (ubyte *)streams[s].base + i * streams[s].elemBytes, rem * streams[s].elemBytes);
+        }
+        p[s] = scratch[s];
+    }
+    body(p);
+    for (uint s = 0; s < N; ++s) {
+        if (streams[s].bOutput) {
+            memcpy((ubyte *)streams[s].base + i * streams[s].elemBytes, scratch[s], rem * streams[s].elemBytes);
+        }
+    }
+}
+
+#define VM_IN(ptr) VmStream{ (void *)(ptr), sizeof(*(ptr)), false }
+#define VM_OUT(ptr) VmStream{ (ptr), sizeof(*(ptr)), true }
+
+// Same reduction and polynomials as the constexpr cos_sin_tau, VM_WIDTH at a time.
+static inline void
+CosSinTauLanes(vmf revolutions, vmf *pCos, vmf *pSin)
+{
+    vmi const q = vmf_round_to_int(vmf_mul(revolutions, vmf_set1(4.0f)));
+    vmf const f = vmf_sub(revolutions, vmf_mul(vmi_to_float(q), vmf_set1(0.25f)));
+    vmf const f2 = vmf_mul(f, f);
+
+    vmf s = vmf_madd(f2, vmf_set1(vm_detail::S7), vmf_set1(vm_detail::S5));
+    s = vmf_madd(f2, s, vmf_set1(vm_detail::S3));
+    s = vmf_madd(f2, s, vmf_set1(vm_detail::S1));
+    s = vmf_mul(f, s);
+
+    vmf c = vmf_madd(f2, vmf_set1(vm_detail::C8), vmf_set1(vm_detail::C6));
+    c = vmf_madd(f2, c, vmf_set1(vm_detail::C4));
+    c = vmf_madd(f2, c, vmf_set1(vm_detail::C2));
+    c = vmf_madd(f2, c, vmf_set1(1.0f));
+
+    /* Quadrant k: odd k swaps cos/sin, cos is negated for k = 1, 2 and sin for k = 2, 3 (see vm_detail::Quadrant). */
+    vmf const cosR = vmf_select_odd(q, s, c);
+    vmf const sinR = vmf_select_odd(q, c, s);
+    *pCos = vmf_xor_bits(cosR, vmi_shl30(vmi_and(vmi_add(q, 1), 2)));
+    *pSin = vmf_xor_bits(sinR, vmi_shl30(vmi_and(q, 2)));
+}
+
+void
+VM_CosSinTau(const float *revolutions, float *cosOut, float *sinOut, size_t n)
+{
+    const VmStream streams[] = { VM_IN(revolutions), VM_OUT(cosOut), VM_OUT(sinOut) };
+    ForEachGroup(n, streams, [](void *const *p) {
+        vmf c, s;
+        CosSinTauLanes(vmf_load((const float *)p[0]), &c, &s);
+        vmf_store((float *)p[1], c);
+        vmf_store((float *)p[2], s);
+    });
+}
+
+void
+VM_RotScale2D(const float *revolutions, const float *scale, float *c0x, float *c0y, size_t n)
+{
+    const VmStream streams[] = { VM_IN(revolutions), VM_IN(scale), VM_OUT(c0x), VM_OUT(c0y) };
+    ForEachGroup(n, streams, [](void *const *p) {
+        vmf c, s;
+        CosSinTauLanes(vmf_load((const float *)p[0]), &c, &s);
+        vmf const k = vmf_load((const float *)p[1]);
+        vmf_store((float *)p[2], vmf_mul(c, k));
+        vmf_store((float *)p[3], vmf_mul(s, k));
+    });
+}
+
+void
+VM_TransformPoints(const mat4f& m, const float *x, const float *y, const float *z,
+                   float *outX, float *outY, float *outZ, size_t n)
+{
+    const VmStream streams[] = { VM_IN(x), VM_IN(y), VM_IN(z), VM_OUT(outX), VM_OUT(outY), VM_OUT(outZ) };
+    vmf M[4][3];
+    for (int col = 0; col < 4; ++col) {
+        M[col][0] = vmf_set1(m.c[col].x);
+        M[col][1] = vmf_set1(m.c[col].y);
+        M[col][2] = vmf_set1(m.c[col].z);
+    }
+    ForEachGroup(n, streams, [&M](void *const *p) {
+        vmf const px = vmf_load((const float *)p[0]);
+        vmf const py = vmf_load((const float *)p[1]);
+        vmf const pz = vmf_load((const float *)p[2]);
+        for (int row = 0; row < 3; ++row) {
+            vmf r = vmf_madd(M[0][row], px, M[3][row]);
+            r = vmf_madd(M[1][row], py, r);
+            r = vmf_madd(M[2][row], pz, r);
+            vmf_store((float *)p[3 + row], r);
+        }
+    });
+}
+
+void
+VM_ComposeTRS(const TransformsSoA& in, mat4f *out, size_t n)
+{
+    const VmStream streams[] = {
+        VM_IN(in.tx), VM_IN(in.ty), VM_IN(in.tz),
+        VM_IN(in.qx), VM_IN(in.qy), VM_IN(in.qz), VM_IN(in.qw),
+        VM_IN(in.scale), VM_OUT(out)
+    };
+    ForEachGroup(n, streams, [](void *const *p) {
+        vmf const qx = vmf_load((const float *)p[3]);
+        vmf const qy = vmf_load((const float *)p[4]);
+        vmf const qz = vmf_load((const float *)p[5]);
+        vmf const qw = vmf_load((const float *)p[6]);
+        vmf const s = vmf_load((const float *)p[7]);
+        vmf const s2 = vmf_add(s, s);
+
+        vmf const xx = vmf_mul(qx, qx), yy = vmf_mul(qy, qy), zz = vmf_mul(qz, qz);
+        vmf const xy = vmf_mul(qx, qy), xz = vmf_mul(qx, qz), yz = vmf_mul(qy, qz);
+        vmf const wx = vmf_mul(qw, qx), wy = vmf_mul(qw, qy), wz = vmf_mul(qw, qz);
+
+        /* Same terms as mat4_trs. */
+        alignas(32) float lanes[12][VM_WIDTH];
+        vmf_store(lanes[0], vmf_sub(s, vmf_mul(s2, vmf_add(yy, zz))));
+        vmf_store(lanes[1], vmf_mul(s2, vmf_add(xy, wz)));
+        vmf_store(lanes[2], vmf_mul(s2, vmf_sub(xz, wy)));
+        vmf_store(lanes[3], vmf_mul(s2, vmf_sub(xy, wz)));
+        vmf_store(lanes[4], vmf_sub(s, vmf_mul(s2, vmf_add(xx, zz))));
+        vmf_store(lanes[5], vmf_mul(s2, vmf_add(yz, wx)));
+        vmf_store(lanes[6], vmf_mul(s2, vmf_add(xz, wy)));
+        vmf_store(lanes[7], vmf_mul(s2, vmf_sub(yz, wx)));
+        vmf_store(lanes[8], vmf_sub(s, vmf_mul(s2, vmf_add(xx, yy))));
+        vmf_store(lanes[9], vmf_load((const float *)p[0]));
+        vmf_store(lanes[10], vmf_load((const float *)p[1]));
+        vmf_store(lanes[11], vmf_load((const float *)p[2]));
+
+        /* SoA -> AoS, one matrix per lane. */
+        mat4f *const dst = (mat4f *)p[8];
+        for (uint l = 0; l < VM_WIDTH; ++l) {
+            dst[l].c[0] = make_vec4f(lanes[0][l], lanes[1][l], lanes[2][l], 0);
+            dst[l].c[1] = make_vec4f(lanes[3][l], lanes[4][l], lanes[5][l], 0);
+            dst[l].c[2] = make_vec4f(lanes[6][l], lanes[7][l], lanes[8][l], 0);
+            dst[l].c[3] = make_vec4f(lanes[9][l], lanes[10][l], lanes[11][l], 1);
+        }
+    });
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+/*
+    Vector math: vec2f/vec3f/vec4f, mat2f/mat4f (column-major like GLSL), quatf, and a polynomial cos/sin.
+
+    - The 2/3 component types and the scalar functions are constexpr (C++11 style, single return statement).
+    - vec4f and mat4f products go through f32x4, which is SSE2 or NEON when available.
+    - Batched kernels over SoA arrays (VM_*) are in VecMath.cpp, those are 8-wide with AVX2
+      (-mavx2 or /arch:AVX2), else 4-wide with SSE2/NEON, else scalar.
+
+    Angles are in revolutions, [0, 1) maps to [0, 2pi) radians, like the old cos_sin_tau in main.cpp.
+*/
+
+#include "common.h"
+
+#if !defined(VM_NO_SIMD)
+    #if defined(__AVX2__)
+        #define VM_AVX2 1
+        #include <immintrin.h>
+    #endif
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define VM_SSE2 1
+        #include <emmintrin.h>
+    #elif defined(__ARM_NEON) || defined(_M_ARM64)
+        #define VM_NEON 1
+        #include <arm_neon.h>
+    #endif
+#endif
+
+struct vec2f { float x, y; };
+
+struct vec3f { float x, y, z; };
+
+struct vec4f {
+    union {
+        struct {
+            float x, y, z, w;
+        };
+        struct {
+            vec2f xy, zw;
+        };
+    };
+};
+
+// Columns, so mat2(c0, c1) in GLSL. A push constant vec4 holding .xy=c0, .zw=c1 is the same layout.
+struct mat2f { vec2f c0, c1; };
+
+struct mat4f { vec4f c[4]; };
+
+// (x, y, z) is the vector part, w the scalar part.
+struct quatf { float x, y, z, w; };
+
+
+//----- constexpr scalar and 2/3 component ops -----
+
+constexpr vec2f operator+(vec2f a, vec2f b) { return { a.x + b.x, a.y + b.y }; }
+constexpr vec2f operator-(vec2f a, vec2f b) { return { a.x - b.x, a.y - b.y }; }
+constexpr vec2f operator*(vec2f a, float s) { return { a.x * s, a.y * s }; }
+constexpr float dot(vec2f a, vec2f b) { return a.x * b.x + a.y * b.y; }
+constexpr vec2f perp(vec2f a) { return { -a.y, a.x }; } // CCW perpendicular == (UnitZ cross {a.x, a.y, 0}).xy
+
+constexpr vec3f operator+(vec3f a, vec3f b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+constexpr vec3f operator-(vec3f a, vec3f b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+constexpr vec3f operator*(vec3f a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+constexpr float dot(vec3f a, vec3f b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+constexpr vec3f cross(vec3f a, vec3f b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+constexpr vec4f make_vec4f(float x, float y, float z, float w) { return vec4f{ {{ x, y, z, w }} }; }
+
+constexpr vec2f mul(mat2f m, vec2f v) { return m.c0 * v.x + m.c1 * v.y; }
+
+namespace vm_detail {
+    constexpr float Tau = 6.28318530717958647692f;
+
+    /*  Taylor coefficients in revolutions, i.e. sin(Tau*f) = f*(S1 + f^2*(S3 + ...)). After the quadrant reduction
+        |f| <= 1/8, so the truncation error is below (Tau/8)^9/9! ~= 3.1e-7 for sin and (Tau/8)^10/10! ~= 2.5e-8 for cos.
+        Measured max abs error against double precision over [-64, 64] revolutions is in VM_RunBenchmark's output.
+    */
+    constexpr float S1 = Tau;
+    constexpr float S3 = -Tau*Tau*Tau / 6;
+    constexpr float S5 = Tau*Tau*Tau*Tau*Tau / 120;
+    constexpr float S7 = -Tau*Tau*Tau*Tau*Tau*Tau*Tau / 5040;
+    constexpr float C2 = -Tau*Tau / 2;
+    constexpr float C4 = Tau*Tau*Tau*Tau / 24;
+    constexpr float C6 = -Tau*Tau*Tau*Tau*Tau*Tau / 720;
+    constexpr float C8 = Tau*Tau*Tau*Tau*Tau*Tau*Tau*Tau / 40320;
+
+    constexpr float SinPoly(float f, float f2) { return f * (S1 + f2 * (S3 + f2 * (S5 + f2 * S7))); }
+    constexpr float CosPoly(float f2) { return 1 + f2 * (C2 + f2 * (C4 + f2 * (C6 + f2 * C8))); }
+
+    // Half away from zero. Only valid for |x| < 2^31, so cos_sin_tau needs |revolutions| < 2^29.
+    constexpr int32_t RoundToInt(float x) { return int32_t(x >= 0 ? x + 0.5f : x - 0.5f); }
+
+    // Rotate (c, s) by k quarter turns.
+    constexpr vec2f Quadrant(int32_t k, float c, float s)
+    {
+        return (k & 3) == 0 ? vec2f{ c, s } :
+               (k & 3) == 1 ? vec2f{ -s, c } :
+               (k & 3) == 2 ? vec2f{ -c, -s } :
+                              vec2f{ s, -c };
+    }
+    constexpr vec2f CosSinReduced(int32_t q, float f) { return Quadrant(q, CosPoly(f * f), SinPoly(f, f * f)); }
+    constexpr vec2f CosSinTau(float revolutions, int32_t q) { return CosSinReduced(q, revolutions - float(q) * 0.25f); }
+}
+
+/*
+    Returns the cosine and sine using where [0, 1) revolutions maps to [0, 2pi) radians.
+    Polynomial, no libm call, max abs error ~3.5e-7 (see vm_detail).
+*/
+constexpr vec2f cos_sin_tau(float revolutions)
+{
+    return vm_detail::CosSinTau(revolutions, vm_detail::RoundToInt(revolutions * 4));
+}
+
+namespace vm_detail {
+    constexpr mat2f RotScale(vec2f cs, float scale) { return { cs * scale, perp(cs) * scale }; }
+    constexpr quatf AxisCosSin(vec3f a, vec2f cs) { return { a.x * cs.y, a.y * cs.y, a.z * cs.y, cs.x }; }
+}
+
+// Rotation by revolutions, then uniform scale.
+constexpr mat2f mat2_rotation_tau(float revolutions, float scale = 1.0f)
+{
+    return vm_detail::RotScale(cos_sin_tau(revolutions), scale);
+}
+
+constexpr quatf quat_identity() { return { 0, 0, 0, 1 }; }
+
+// axis must be normalized.
+constexpr quatf quat_from_axis_tau(vec3f axis, float revolutions)
+{
+    return vm_detail::AxisCosSin(axis, cos_sin_tau(revolutions * 0.5f));
+}
+
+constexpr quatf quat_mul(quatf a, quatf b)
+{
+    return { a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+             a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+             a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+             a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z };
+}
+
+namespace vm_detail {
+    constexpr vec3f QuatRotate(vec3f u, float w, vec3f v, vec3f t) { return v + t * w + cross(u, t); }
+}
+
+// q must be normalized. v + w*t + u x t, where t = 2 u x v.
+constexpr vec3f quat_rotate(quatf q, vec3f v)
+{
+    return vm_detail::QuatRotate(vec3f{ q.x, q.y, q.z }, q.w, v, cross(vec3f{ q.x, q.y, q.z }, v) * 2.0f);
+}
+
+constexpr mat4f mat4_identity()
+{
+    return { { make_vec4f(1, 0, 0, 0), make_vec4f(0, 1, 0, 0), make_vec4f(0, 0, 1, 0), make_vec4f(0, 0, 0, 1) } };
+}
+
+// Scale, then rotate, then translate. q must be normalized.
+constexpr mat4f mat4_trs(vec3f t, quatf q, float s)
+{
+    return { {
+        make_vec4f((1 - 2*(q.y*q.y + q.z*q.z)) * s, (2*(q.x*q.y + q.w*q.z)) * s, (2*(q.x*q.z - q.w*q.y)) * s, 0),
+        make_vec4f((2*(q.x*q.y - q.w*q.z)) * s, (1 - 2*(q.x*q.x + q.z*q.z)) * s, (2*(q.y*q.z + q.w*q.x)) * s, 0),
+        make_vec4f((2*(q.x*q.z + q.w*q.y)) * s, (2*(q.y*q.z - q.w*q.x)) * s, (1 - 2*(q.x*q.x + q.y*q.y)) * s, 0),
+        make_vec4f(t.x, t.y, t.z, 1)
+    } };
+}
+
+
+//----- f32x4, 4 floats in a register where possible -----
+
+#if VM_SSE2
+typedef __m128 f32x4;
+inline f32x4 f32x4_load(const float *p) { return _mm_loadu_ps(p); }
+inline void f32x4_store(float *p, f32x4 v) { _mm_storeu_ps(p, v); }
+inline f32x4 f32x4_set1(float s) { return _mm_set1_ps(s); }
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+template<int i> inline f32x4 f32x4_splat(f32x4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i)); }
+#elif VM_NEON
+typedef float32x4_t f32x4;
+inline f32x4 f32x4_load(const float *p) { return vld1q_f32(p); }
+inline void f32x4_store(float *p, f32x4 v) { vst1q_f32(p, v); }
+inline f32x4 f32x4_set1(float s) { return vdupq_n_f32(s); }
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return vsubq_f32(a, b); }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+template<int i> inline f32x4 f32x4_splat(f32x4 v) { return vdupq_n_f32(vgetq_lane_f32(v, i)); }
+#else
+struct f32x4 { float v[4]; };
+inline f32x4 f32x4_load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+inline void f32x4_store(float *p, f32x4 v) { for (int i = 0; i < 4; ++i) p[i] = v.v[i]; }
+inline f32x4 f32x4_set1(float s) { return { { s, s, s, s } }; }
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+template<int i> inline f32x4 f32x4_splat(f32x4 v) { return f32x4_set1(v.v[i]); }
+#endif
+
+inline f32x4 f32x4_load(const vec4f& v) { return f32x4_load(&v.x); }
+inline vec4f f32x4_to_vec4f(f32x4 v) { vec4f r; f32x4_store(&r.x, v); return r; }
+
+inline vec4f operator+(const vec4f& a, const vec4f& b) { return f32x4_to_vec4f(f32x4_add(f32x4_load(a), f32x4_load(b))); }
+inline vec4f operator-(const vec4f& a, const vec4f& b) { return f32x4_to_vec4f(f32x4_sub(f32x4_load(a), f32x4_load(b))); }
+inline vec4f operator*(const vec4f& a, float s) { return f32x4_to_vec4f(f32x4_mul(f32x4_load(a), f32x4_set1(s))); }
+
+namespace vm_detail {
+    inline f32x4 MulColumns(const mat4f& m, f32x4 v)
+    {
+        f32x4 r = f32x4_mul(f32x4_load(m.c[0]), f32x4_splat<0>(v));
+        r = f32x4_add(r, f32x4_mul(f32x4_load(m.c[1]), f32x4_splat<1>(v)));
+        r = f32x4_add(r, f32x4_mul(f32x4_load(m.c[2]), f32x4_splat<2>(v)));
+        return f32x4_add(r, f32x4_mul(f32x4_load(m.c[3]), f32x4_splat<3>(v)));
+    }
+}
+
+inline vec4f mul(const mat4f& m, const vec4f& v)
+{
+    return f32x4_to_vec4f(vm_detail::MulColumns(m, f32x4_load(v)));
+}
+
+inline mat4f mul(const mat4f& a, const mat4f& b)
+{
+    mat4f r;
+    for (int i = 0; i < 4; ++i) {
+        f32x4_store(&r.c[i].x, vm_detail::MulColumns(a, f32x4_load(b.c[i])));
+    }
+    return r;
+}
+
+quatf normalize(quatf q);
+
+
+//----- Batched kernels over SoA arrays, see VecMath.cpp -----
+
+// cosOut[i], sinOut[i] = cos_sin_tau(revolutions[i]). Outputs may alias each other but not the input.
+void VM_CosSinTau(const float *revolutions, float *cosOut, float *sinOut, size_t n);
+
+// Column 0 of mat2_rotation_tau(revolutions[i], scale[i]), column 1 is perp(column 0).
+void VM_RotScale2D(const float *revolutions, const float *scale, float *c0x, float *c0y, size_t n);
+
+// Affine transform of points (w = 1), the bottom row of m is ignored.
+void VM_TransformPoints(const mat4f& m, const float *x, const float *y, const float *z,
+                        float *outX, float *outY, float *outZ, size_t n);
+
+// out[i] = mat4_trs(t[i], q[i], s[i]), from SoA inputs to AoS matrices (what a GPU buffer wants).
+struct TransformsSoA {
+    const float *tx, *ty, *tz;
+    const float *qx, *qy, *qz, *qw; // normalized
+    const float *scale;
+};
+void VM_ComposeTRS(const TransformsSoA& in, mat4f *out, size_t n);
+
+// Microbenchmark of the kernels above against the scalar versions, prints results. Returns a main() exit code.
+int VM_RunBenchmark();
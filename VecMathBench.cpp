@@ -0,0 +1,225 @@
+#include "VecMath.h"
+#include "VulkanSwapchain.h" // OS_GetTicks
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    --bench-math: times the SoA kernels in VecMath.cpp against the per-element code they replace,
+    and measures the polynomial cos/sin against double precision.
+
+    Each case runs a few times and the fastest run is kept, the sink stops the compiler from
+    dropping the scalar loops.
+*/
+
+static volatile float g_sink;
+
+struct BenchTimer {
+    os_tick_t start;
+    double nsPerTick;
+};
+
+static BenchTimer BenchTimer_Start()
+{
+    return { OS_GetTicks(), 1e9 / double(OS_TicksPerSecond()) };
+}
+
+static double BenchTimer_NsPer(const BenchTimer& t, size_t n)
+{
+    return double(OS_GetTicks() - t.start) * t.nsPerTick / double(n);
+}
+
+#define BENCH_REPEATS 5
+#define BENCH_BEST(result, ...) do {                         \
+    result = 1e30;                                           \
+    for (int rep_ = 0; rep_ < BENCH_REPEATS; ++rep_) {       \
+        double const ns_ = (__VA_ARGS__);                    \
+        if (ns_ < result) result = ns_;                      \
+    }                                                        \
+} while (0)
+
+static void PrintRow(const char *name, double scalarNs, double batchNs)
+{
+    printf("  %-28s %8.3f ns  -> %8.3f ns  (%.2fx)\n", name, scalarNs, batchNs, scalarNs / batchNs);
+}
+
+int
+VM_RunBenchmark()
+{
+    size_t const n = 1 << 16;
+    size_t const floatCount = 13; // revolutions, scale, xyz in, xyz out, cos, sin, 3 spare
+    float *const mem = (float *)malloc(n * floatCount * sizeof(float) + n * sizeof(mat4f));
+    if (!mem) {
+        puts("bench-math: out of memory");
+        return 1;
+    }
+    float *const revs = mem;
+    float *const scale = revs + n;
+    float *const x = scale + n, *const y = x + n, *const z = y + n;
+    float *const ox = z + n, *const oy = ox + n, *const oz = oy + n;
+    float *const cosOut = oz + n, *const sinOut = cosOut + n;
+    float *const qx = sinOut + n, *const qy = qx + n, *const qz = qy + n;
+    mat4f *const mats = (mat4f *)(qz + n);
+
+    /* Inputs: revolutions spread over [-64, 64], same as the error measurement. */
+    srand(1);
+    for (size_t i = 0; i < n; ++i) {
+        revs[i] = (float(rand()) / float(RAND_MAX) * 2.0f - 1.0f) * 64.0f;
+        scale[i] = 0.5f + float(i & 15) * (1.0f / 16);
+        x[i] = float(i & 255) - 128.0f;
+        y[i] = float((i >> 8) & 255) - 128.0f;
+        z[i] = float(i & 7);
+    }
+
+    printf("bench-math: %u elements, SoA kernels are %s\n", uint(n),
+#if VM_AVX2
+           "AVX2 (8 wide)"
+#elif VM_SSE2
+           "SSE2 (4 wide)"
+#elif VM_NEON
+           "NEON (4 wide)"
+#else
+           "scalar"
+#endif
+           );
+    puts("  per element:                 scalar          batched");
+
+    /* Accuracy, both polynomial paths against double. */
+    {
+        VM_CosSinTau(revs, cosOut, sinOut, n);
+        double maxErrPoly = 0, maxErrBatch = 0, maxErrLibm = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double const rad = double(revs[i]) * 6.283185307179586476925;
+            double const c = cos(rad), s = sin(rad);
+            vec2f const cs = cos_sin_tau(revs[i]);
+            float const radf = revs[i] * vm_detail::Tau;
+            maxErrPoly = Max(maxErrPoly, Max(fabs(cs.x - c), fabs(cs.y - s)));
+            maxErrBatch = Max(maxErrBatch, Max(fabs(cosOut[i] - c), fabs(sinOut[i] - s)));
+            maxErrLibm = Max(maxErrLibm, Max(fabs(cosf(radf) - c), fabs(sinf(radf) - s)));
+        }
+        printf("  max abs error over [-64, 64] revolutions: cos_sin_tau %.3g, VM_CosSinTau %.3g, "
+               "cosf/sinf(float(rev * tau)) %.3g\n", maxErrPoly, maxErrBatch, maxErrLibm);
+    }
+
+    /* cos/sin: libm per element, the constexpr polynomial per element, and the batch. */
+    {
+        double libmNs, polyNs, batchNs;
+        BENCH_BEST(libmNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            float acc = 0;
+            for (size_t i = 0; i < n; ++i) {
+                float const rad = revs[i] * vm_detail::Tau;
+                acc += cosf(rad) + sinf(rad);
+            }
+            g_sink = acc;
+            return BenchTimer_NsPer(t, n);
+        }());
+        BENCH_BEST(polyNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            for (size_t i = 0; i < n; ++i) {
+                vec2f const cs = cos_sin_tau(revs[i]);
+                cosOut[i] = cs.x;
+                sinOut[i] = cs.y;
+            }
+            g_sink = cosOut[n - 1];
+            return BenchTimer_NsPer(t, n);
+        }());
+        BENCH_BEST(batchNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            VM_CosSinTau(revs, cosOut, sinOut, n);
+            g_sink = cosOut[n - 1];
+            return BenchTimer_NsPer(t, n);
+        }());
+        PrintRow("cos+sin (libm)", libmNs, batchNs);
+        PrintRow("cos+sin (cos_sin_tau)", polyNs, batchNs);
+    }
+
+    /* The per-draw rotation in main.cpp. */
+    {
+        double scalarNs, batchNs;
+        BENCH_BEST(scalarNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            for (size_t i = 0; i < n; ++i) {
+                mat2f const m = mat2_rotation_tau(revs[i], scale[i]);
+                ox[i] = m.c0.x;
+                oy[i] = m.c0.y;
+            }
+            g_sink = ox[n - 1];
+            return BenchTimer_NsPer(t, n);
+        }());
+        BENCH_BEST(batchNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            VM_RotScale2D(revs, scale, ox, oy, n);
+            g_sink = ox[n - 1];
+            return BenchTimer_NsPer(t, n);
+        }());
+        PrintRow("2D rotation + scale", scalarNs, batchNs);
+    }
+
+    /* Points through one matrix: AoS mul(mat4f, vec4f) vs SoA. */
+    {
+        mat4f const m = mat4_trs(vec3f{ 1, 2, 3 }, quat_from_axis_tau(vec3f{ 0, 0, 1 }, 0.125f), 2.0f);
+        double scalarNs, batchNs;
+        BENCH_BEST(scalarNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            for (size_t i = 0; i < n; ++i) {
+                vec4f const p = mul(m, make_vec4f(x[i], y[i], z[i], 1));
+                ox[i] = p.x;
+                oy[i] = p.y;
+                oz[i] = p.z;
+            }
+            g_sink = oz[n - 1];
+            return BenchTimer_NsPer(t, n);
+        }());
+        BENCH_BEST(batchNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            VM_TransformPoints(m, x, y, z, ox, oy, oz, n);
+            g_sink = oz[n - 1];
+            return BenchTimer_NsPer(t, n);
+        }());
+        PrintRow("mat4 * point", scalarNs, batchNs);
+    }
+
+    /* TRS composition, the quaternions are built from the revolutions. */
+    {
+        float *const qw = cosOut; // reuse
+        for (size_t i = 0; i < n; ++i) {
+            quatf const q = normalize(quatf{ x[i], y[i] + 1.0f, z[i], revs[i] });
+            qx[i] = q.x;
+            qy[i] = q.y;
+            qz[i] = q.z;
+            qw[i] = q.w;
+        }
+        TransformsSoA const soa = { x, y, z, qx, qy, qz, qw, scale };
+
+        double scalarNs, batchNs;
+        BENCH_BEST(scalarNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            for (size_t i = 0; i < n; ++i) {
+                mats[i] = mat4_trs(vec3f{ x[i], y[i], z[i] }, quatf{ qx[i], qy[i], qz[i], qw[i] }, scale[i]);
+            }
+            g_sink = mats[n - 1].c[0].x;
+            return BenchTimer_NsPer(t, n);
+        }());
+        BENCH_BEST(batchNs, [&]() {
+            BenchTimer t = BenchTimer_Start();
+            VM_ComposeTRS(soa, mats, n);
+            g_sink = mats[n - 1].c[0].x;
+            return BenchTimer_NsPer(t, n);
+        }());
+        PrintRow("compose TRS -> mat4", scalarNs, batchNs);
+
+        /* Both paths should agree, they evaluate the same terms. */
+        float maxDiff = 0;
+        for (size_t i = 0; i < n; i += 97) {
+            mat4f const ref = mat4_trs(vec3f{ x[i], y[i], z[i] }, quatf{ qx[i], qy[i], qz[i], qw[i] }, scale[i]);
+            const float *a = &ref.c[0].x, *b = &mats[i].c[0].x;
+            for (int k = 0; k < 16; ++k) maxDiff = Max(maxDiff, Abs(a[k] - b[k]));
+        }
+        printf("  compose TRS max diff vs mat4_trs: %g\n", maxDiff);
+    }
+
+    free(mem);
+    return 0;
+}
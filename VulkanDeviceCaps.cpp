@@ -0,0 +1,159 @@
+#include "VulkanRenderer.h" // VK_CHECK, includes VulkanDeviceCaps.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Copy a supported feature to the enabled set. */
+#define ENABLE_IF_SUPPORTED(dst, src, member) (dst).member = (src).member
+
+void
+DeviceCaps_Query(DeviceCaps& caps, VkPhysicalDevice physicalDevice)
+{
+    caps = { };
+
+    {
+        caps.props12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+        caps.props11 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES };
+        caps.props11.pNext = &caps.props12;
+        VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        props2.pNext = &caps.props11;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &props2);
+        caps.props = props2.properties;
+        caps.props11.pNext = nullptr;
+    }
+
+    {
+        VkPhysicalDeviceVulkan12Features supported12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+        VkPhysicalDeviceVulkan11Features supported11 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+        supported11.pNext = &supported12;
+        VkPhysicalDeviceFeatures2 supported2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+        supported2.pNext = &supported11;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supported2);
+        const VkPhysicalDeviceFeatures& supported = supported2.features;
+
+        caps.features11 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+        caps.features12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+
+        /*  robustBufferAccess is deliberately left off, it costs bounds checks on every buffer access.
+            Everything else here is free unless used.
+        */
+        ENABLE_IF_SUPPORTED(caps.features, supported, independentBlend);
+        ENABLE_IF_SUPPORTED(caps.features, supported, sampleRateShading);
+        ENABLE_IF_SUPPORTED(caps.features, supported, multiDrawIndirect);
+        ENABLE_IF_SUPPORTED(caps.features, supported, drawIndirectFirstInstance);
+        ENABLE_IF_SUPPORTED(caps.features, supported, fillModeNonSolid); // needed for wireframe triangles
+        ENABLE_IF_SUPPORTED(caps.features, supported, samplerAnisotropy);
+        ENABLE_IF_SUPPORTED(caps.features, supported, textureCompressionBC);
+        ENABLE_IF_SUPPORTED(caps.features, supported, occlusionQueryPrecise);
+        ENABLE_IF_SUPPORTED(caps.features, supported, pipelineStatisticsQuery);
+        ENABLE_IF_SUPPORTED(caps.features, supported, vertexPipelineStoresAndAtomics);
+        ENABLE_IF_SUPPORTED(caps.features, supported, fragmentStoresAndAtomics);
+        ENABLE_IF_SUPPORTED(caps.features, supported, shaderStorageImageReadWithoutFormat);
+        ENABLE_IF_SUPPORTED(caps.features, supported, shaderStorageImageWriteWithoutFormat);
+        ENABLE_IF_SUPPORTED(caps.features, supported, shaderInt16);
+        ENABLE_IF_SUPPORTED(caps.features, supported, shaderInt64);
+
+        ENABLE_IF_SUPPORTED(caps.features11, supported11, storageBuffer16BitAccess);
+        ENABLE_IF_SUPPORTED(caps.features11, supported11, uniformAndStorageBuffer16BitAccess);
+        ENABLE_IF_SUPPORTED(caps.features11, supported11, storagePushConstant16);
+        ENABLE_IF_SUPPORTED(caps.features11, supported11, shaderDrawParameters);
+
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, drawIndirectCount);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, storageBuffer8BitAccess);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, uniformAndStorageBuffer8BitAccess);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, storagePushConstant8);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, shaderFloat16);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, shaderInt8);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, descriptorIndexing);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, shaderSampledImageArrayNonUniformIndexing);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, descriptorBindingPartiallyBound);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, runtimeDescriptorArray);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, scalarBlockLayout);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, imagelessFramebuffer);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, uniformBufferStandardLayout);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, shaderSubgroupExtendedTypes);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, separateDepthStencilLayouts);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, hostQueryReset);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, timelineSemaphore);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, bufferDeviceAddress);
+        ENABLE_IF_SUPPORTED(caps.features12, supported12, subgroupBroadcastDynamicId);
+    }
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &caps.memory);
+    caps.bUnifiedMemory = true;
+    for (uint32_t i = 0; i < caps.memory.memoryTypeCount; ++i) {
+        VkMemoryPropertyFlags const flags = caps.memory.memoryTypes[i].propertyFlags;
+        if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+            caps.bLazilyAllocatedMemory = true;
+        }
+        if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            caps.bUnifiedMemory = false;
+        }
+    }
+    for (uint32_t i = 0; i < caps.memory.memoryHeapCount; ++i) {
+        const VkMemoryHeap& heap = caps.memory.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > caps.deviceLocalBytes) {
+            caps.deviceLocalBytes = heap.size;
+        }
+    }
+
+    uint32_t extCount = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr));
+    VkExtensionProperties *exts = (VkExtensionProperties *)malloc(extCount * sizeof(VkExtensionProperties));
+    if (exts) {
+        VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, exts));
+        for (uint32_t i = 0; i < extCount; ++i) {
+            const char *name = exts[i].extensionName;
+            if (!strcmp(name, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) caps.bMemoryBudget = true;
+            if (!strcmp(name, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) caps.bPushDescriptor = true;
+            if (!strcmp(name, VK_KHR_SWAPCHAIN_MUTABLE_FORMAT_EXTENSION_NAME)) caps.bSwapchainMutableFormat = true;
+        }
+        free(exts);
+    }
+}
+
+int64_t
+DeviceCaps_Score(const DeviceCaps& caps)
+{
+    int64_t typeRank = 0;
+    switch (caps.props.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+    default: break;
+    }
+    /* Heap size in MiB fits well below 2^40, so the type always dominates. */
+    return (typeRank << 40) + int64_t(caps.deviceLocalBytes >> 20);
+}
+
+uint32_t
+DeviceCaps_GetExtensions(const DeviceCaps& caps, const char **names, uint32_t capacity)
+{
+    uint32_t n = 0;
+    ASSERT(capacity >= 4);
+    (void)capacity;
+    names[n++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    if (caps.bMemoryBudget) names[n++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    if (caps.bPushDescriptor) names[n++] = VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME;
+    if (caps.bSwapchainMutableFormat) names[n++] = VK_KHR_SWAPCHAIN_MUTABLE_FORMAT_EXTENSION_NAME;
+    return n;
+}
+
+void
+DeviceCaps_Print(const DeviceCaps& caps)
+{
+    printf("  device-local heap: %u MiB, lazily allocated memory: %d, unified memory: %d\n",
+           uint(caps.deviceLocalBytes >> 20), int(caps.bLazilyAllocatedMemory), int(caps.bUnifiedMemory));
+    printf("  subgroup size: %u, color sample counts: 0x%X, depth sample counts: 0x%X\n",
+           caps.props11.subgroupSize,
+           caps.props.limits.framebufferColorSampleCounts, caps.props.limits.framebufferDepthSampleCounts);
+    printf("  timeline semaphores: %d, host query reset: %d, scalar block layout: %d, float16: %d, int8: %d, "
+           "imageless framebuffer: %d, pipeline statistics: %d\n",
+           int(caps.features12.timelineSemaphore), int(caps.features12.hostQueryReset),
+           int(caps.features12.scalarBlockLayout), int(caps.features12.shaderFloat16), int(caps.features12.shaderInt8),
+           int(caps.features12.imagelessFramebuffer), int(caps.features.pipelineStatisticsQuery));
+    printf("  VK_EXT_memory_budget: %d, VK_KHR_push_descriptor: %d, VK_KHR_swapchain_mutable_format: %d\n",
+           int(caps.bMemoryBudget), int(caps.bPushDescriptor), int(caps.bSwapchainMutableFormat));
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vk_procs.h"
+
+#include "common.h"
+
+/*
+    What a VkPhysicalDevice can do, queried once with the vkGetPhysicalDevice*2 chains.
+
+    The feature structs hold what is *enabled* on the VkDevice (supported & considered useful), not everything
+    that is supported, so code can test e.g. `caps.features12.timelineSemaphore` and know it can rely on it.
+    Their pNext members are null; CreateDevice links copies of them.
+*/
+struct DeviceCaps {
+    VkPhysicalDeviceProperties props;
+    VkPhysicalDeviceVulkan11Properties props11;
+    VkPhysicalDeviceVulkan12Properties props12;
+    VkPhysicalDeviceMemoryProperties memory;
+
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceVulkan11Features features11;
+    VkPhysicalDeviceVulkan12Features features12;
+
+    VkDeviceSize deviceLocalBytes; // largest DEVICE_LOCAL heap
+    uint32_t universalTimestampValidBits;
+    bool bLazilyAllocatedMemory; // some memory type is LAZILY_ALLOCATED, i.e. transient attachments can avoid real memory
+    bool bUnifiedMemory; // every DEVICE_LOCAL type is also HOST_VISIBLE, staging copies can be skipped
+
+    // Optional device extensions, enabled when present:
+    bool bMemoryBudget; // VK_EXT_memory_budget
+    bool bPushDescriptor; // VK_KHR_push_descriptor
+    bool bSwapchainMutableFormat; // VK_KHR_swapchain_mutable_format, for UNORM storage views of sRGB swapchain images
+};
+
+// Fills everything except universalTimestampValidBits, which depends on the chosen family.
+void DeviceCaps_Query(DeviceCaps& caps, VkPhysicalDevice physicalDevice);
+
+/*  Higher is better: discrete > integrated > virtual > CPU > other, then the largest device-local heap.
+    The env var VKLAB_GPU (an index into vkEnumeratePhysicalDevices, or a case-insensitive substring of the
+    device name) overrides this, see PickPhysicalDeviceAndFindFamilies.
+*/
+int64_t DeviceCaps_Score(const DeviceCaps& caps);
+
+// Extension names to pass to vkCreateDevice, including VK_KHR_swapchain. Returns the count.
+uint32_t DeviceCaps_GetExtensions(const DeviceCaps& caps, const char **names, uint32_t capacity);
+
+void DeviceCaps_Print(const DeviceCaps& caps);
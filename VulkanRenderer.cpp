@@ -1,7 +1,10 @@
 #include "VulkanRenderer.h"
+#include "shaders.h"
+#include "MemoryBudget.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #if is_debug
 static VkBool32 VKAPI_CALL
@@ -108,20 +111,42 @@ GetDeviceTypeString(VkPhysicalDeviceType type)
     return size_t(type) < lengthof(DeviceTypeNames) ? DeviceTypeNames[type] : "???";
 }
 
+/*  Case-insensitive substring match, for VKLAB_GPU. */
+static bool
+NameContains(const char *name, const char *sub)
+{
+    for (; *name; ++name) {
+        size_t i = 0;
+        while (sub[i] && name[i] && tolower((unsigned char)name[i]) == tolower((unsigned char)sub[i])) {
+            ++i;
+        }
+        if (!sub[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static VkPhysicalDevice
 PickPhysicalDeviceAndFindFamilies(VkSurfaceKHR surface,
                                   const VkPhysicalDevice *physicalDevices, uint32_t physicalDeviceCount,
-                                  QueueFamilies *families)
+                                  QueueFamilies *families, DeviceCaps *pCaps)
 {
     VkPhysicalDevice selected = 0;
-    VkPhysicalDeviceProperties props;
+    int64_t selectedScore = -1;
+    uint32_t selectedIndex = 0;
     VkQueueFamilyProperties familyProps[32];
 
     ASSERT(families->universal == VK_QUEUE_FAMILY_IGNORED);
 
-    uint32_t gpuIndex = 0;
-    for (; gpuIndex < physicalDeviceCount; ++gpuIndex) {
+    /* VKLAB_GPU=<index> or VKLAB_GPU=<part of the device name> picks a device, if it is usable. */
+    const char *const overrideStr = getenv("VKLAB_GPU");
+    bool const overrideIsIndex = overrideStr && overrideStr[0] >= '0' && overrideStr[0] <= '9';
+
+    DeviceCaps caps;
+    for (uint32_t gpuIndex = 0; gpuIndex < physicalDeviceCount; ++gpuIndex) {
         VkPhysicalDevice const physdev = physicalDevices[gpuIndex];
+        VkPhysicalDeviceProperties props;
         vkGetPhysicalDeviceProperties(physdev, &props);
         printf("GPU[%d]: (%s), type=%s\n", gpuIndex, props.deviceName, GetDeviceTypeString(props.deviceType));
         if (props.apiVersion < VK_API_VERSION_1_2) {
@@ -142,23 +167,43 @@ PickPhysicalDeviceAndFindFamilies(VkSurfaceKHR surface,
                 VK_QUEUE_COMPUTE_BIT |
                 VK_QUEUE_TRANSFER_BIT;
             if ((familyProps[fam].queueFlags & universalFlags) == universalFlags) {
-                VkBool32 supportsPresentation = false;
-                vkGetPhysicalDeviceSurfaceSupportKHR(physdev, fam, surface, &supportsPresentation);
-                if (universalFam < 0) {
+                VkBool32 supportsPresentation = !surface; // headless, nothing to present to
+                if (surface) {
+                    vkGetPhysicalDeviceSurfaceSupportKHR(physdev, fam, surface, &supportsPresentation);
+                }
+                if (universalFam < 0 && supportsPresentation) {
                     universalFam = fam;
                 }
             }
         }
 
-        if (int32_t(universalFam) >= 0) {
+        if (universalFam < 0) {
+            printf("GPU%d has no universal family that can present\n", gpuIndex);
+            continue;
+        }
+
+        DeviceCaps_Query(caps, physdev);
+        int64_t score = DeviceCaps_Score(caps);
+        if (overrideStr && (overrideIsIndex ? uint32_t(atoi(overrideStr)) == gpuIndex
+                                            : NameContains(props.deviceName, overrideStr))) {
+            printf("GPU%d matches VKLAB_GPU=%s\n", gpuIndex, overrideStr);
+            score = INT64_MAX;
+        }
+        printf("GPU%d score: %lld\n", gpuIndex, (long long)score);
+
+        if (score > selectedScore) {
             selected = physdev;
+            selectedScore = score;
+            selectedIndex = gpuIndex;
             families->universal = universalFam;
-            break;
+            caps.universalTimestampValidBits = familyProps[universalFam].timestampValidBits;
+            *pCaps = caps;
         }
     }
 
     if (selected) {
-        printf("Selected GPU[%d] (%s)\n", gpuIndex, props.deviceName);
+        printf("Selected GPU[%d] (%s)\n", selectedIndex, pCaps->props.deviceName);
+        DeviceCaps_Print(*pCaps);
         ASSERT(int32_t(families->universal) >= 0);
         return selected;
     } else {
@@ -169,7 +214,7 @@ PickPhysicalDeviceAndFindFamilies(VkSurfaceKHR surface,
 
 
 static VkDevice
-CreateDevice(VkPhysicalDevice physicalDevice, const QueueFamilies& families)
+CreateDevice(VkPhysicalDevice physicalDevice, const QueueFamilies& families, const DeviceCaps& caps)
 {
     const float queuePriorities[] = { 1.0f };
 
@@ -178,37 +223,25 @@ CreateDevice(VkPhysicalDevice physicalDevice, const QueueFamilies& families)
     queueInfo.queueCount = 1;
     queueInfo.pQueuePriorities = queuePriorities;
 
-    //push descriptors?
-    const char *const extensions[] =
-    {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-    };
-
-    //if (pushDescriptorsSupported) extensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
-
-    //if (checkpointsSupported) extensions.push_back(VK_NV_DEVICE_DIAGNOSTIC_CHECKPOINTS_EXTENSION_NAME);
+    const char *extensions[8];
+    uint32_t const extensionCount = DeviceCaps_GetExtensions(caps, extensions, lengthof(extensions));
 
     /* Difference from VkPhysicalDeviceFeatures (the .features member) is that this has sType/pNext: */
     VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
-    // features2.features.robustBufferAccess = true; // this is not very strict, robustBufferAccess2 has more guarantees.
-    // features2.features.shaderInt16 = true;
-    // features2.features.fillModeNonSolid = true; // needed for wireframe triangles
-    VkPhysicalDeviceVulkan12Features features1_2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
-    // features1_2.timelineSemaphore = true;
-    // features1_2.imagelessFramebuffer = true;
-    // features1_2.scalarBlockLayout = true;
-    // features1_2.shaderFloat16 = true;
-    // features1_2.shaderInt8 = true;
-    // features1_2.storagePushConstant8 = true;
+    features2.features = caps.features;
+    VkPhysicalDeviceVulkan11Features features1_1 = caps.features11;
+    VkPhysicalDeviceVulkan12Features features1_2 = caps.features12;
 
     VkDeviceCreateInfo createInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
     createInfo.queueCreateInfoCount = 1;
     createInfo.pQueueCreateInfos = &queueInfo;
 
     createInfo.ppEnabledExtensionNames = extensions;
-    createInfo.enabledExtensionCount = lengthof(extensions);
+    createInfo.enabledExtensionCount = extensionCount;
 
-    features2.pNext = &features1_2;
+    features1_1.pNext = &features1_2;
+    features1_2.pNext = nullptr;
+    features2.pNext = &features1_1;
     createInfo.pNext = &features2;
 
     VkDevice device = 0;
@@ -228,9 +261,12 @@ VKR_PostInstanceConstruct(VulkanRenderer& vkr, VkSurfaceKHR surface)
 
         vkr.physicalDevice = PickPhysicalDeviceAndFindFamilies(surface,
                                                                physicalDevices, physicalDeviceCount,
-                                                               &vkr.families);
+                                                               &vkr.families, &vkr.caps);
+    }
+    if (!vkr.physicalDevice) {
+        return VK_ERROR_INITIALIZATION_FAILED;
     }
-    vkr.device = CreateDevice(vkr.physicalDevice, vkr.families);
+    vkr.device = CreateDevice(vkr.physicalDevice, vkr.families, vkr.caps);
 
     if (vkr.device) {
         volkLoadDevice(vkr.device);
@@ -294,3 +330,86 @@ VKH_AllocateCommandBuffer(VkDevice device, VkCommandPool cmdPool, VkCommandBuffe
     VK_CHECK(vkAllocateCommandBuffers(device, &bufInfo, &cmdBuffer));
     return cmdBuffer;
 }
+
+VkShaderModule
+VKH_LoadShaderModule(VkDevice device, const char *spvPath)
+{
+    size_t size;
+    uint32_t *code = load_spirv_file(spvPath, &size);
+    if (!code) {
+        return nullptr;
+    }
+    VkShaderModule module = VKH_CreateShaderModule(device, code, size);
+    free(code);
+    return module;
+}
+
+uint32_t
+VKH_FindMemoryType(const VkPhysicalDeviceMemoryProperties& memory, uint32_t typeBits,
+                   VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    uint32_t fallback = UINT32_MAX;
+    for (uint32_t i = 0; i < memory.memoryTypeCount; ++i) {
+        VkMemoryPropertyFlags const flags = memory.memoryTypes[i].propertyFlags;
+        if (!(typeBits & (1u << i)) || (flags & required) != required) {
+            continue;
+        }
+        if ((flags & preferred) == preferred) {
+            return i;
+        }
+        if (fallback == UINT32_MAX) {
+            fallback = i;
+        }
+    }
+    return fallback;
+}
+
+VkResult
+VKH_CreateBuffer(const VulkanRenderer& vkr, VkDeviceSize size, VkBufferUsageFlags usage,
+                 VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, BufferAllocation *pOut)
+{
+    *pOut = { };
+    pOut->size = size;
+
+    VkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    info.size = size;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult res = vkCreateBuffer(vkr.device, &info, nullptr, &pOut->buffer);
+    if (res != VK_SUCCESS) {
+        return res;
+    }
+
+    VkMemoryRequirements req;
+    vkGetBufferMemoryRequirements(vkr.device, pOut->buffer, &req);
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.allocationSize = req.size;
+    allocInfo.memoryTypeIndex = VKH_FindMemoryType(vkr.caps.memory, req.memoryTypeBits, required, preferred);
+    if (allocInfo.memoryTypeIndex == UINT32_MAX) {
+        res = VK_ERROR_FEATURE_NOT_PRESENT;
+    } else {
+        VkBufferUsageFlags const copyOnly = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        res = MemBudget_Allocate(vkr, allocInfo, (usage & ~copyOnly) ? MemCategory_Buffers : MemCategory_Staging,
+                                 &pOut->memory);
+    }
+    if (res == VK_SUCCESS) {
+        res = vkBindBufferMemory(vkr.device, pOut->buffer, pOut->memory, 0);
+    }
+    if (res == VK_SUCCESS &&
+        (vkr.caps.memory.memoryTypes[allocInfo.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        res = vkMapMemory(vkr.device, pOut->memory, 0, VK_WHOLE_SIZE, 0, &pOut->pMapped);
+    }
+    if (res != VK_SUCCESS) {
+        VKH_DestroyBuffer(vkr.device, *pOut);
+    }
+    return res;
+}
+
+void
+VKH_DestroyBuffer(VkDevice device, BufferAllocation& b)
+{
+    /* Freeing mapped memory implicitly unmaps it. */
+    vkDestroyBuffer(device, b.buffer, nullptr);
+    MemBudget_Free(device, b.memory);
+    b = { };
+}
@@ -11,6 +11,7 @@
 */
 
 #include "common.h"
+#include "VulkanDeviceCaps.h"
 
 #if is_debug
 #define VK_CHECK(e) ASSERT((e) == VK_SUCCESS)
@@ -32,6 +33,7 @@ struct VulkanRenderer
 
     VkInstance instance;
     VkPhysicalDevice physicalDevice;
+    DeviceCaps caps; // of physicalDevice, features are the ones enabled on device
 
 #if is_debug
     VkDebugReportCallbackEXT debugReportCallback;
@@ -51,6 +53,7 @@ inline bool operator!=(const VkExtent2D& a, const VkExtent2D& b)
 
 
 VkResult VKR_InitInstanceOnly(VulkanRenderer& r);
+// surface may be null for tools that don't present, any universal family will do then.
 VkResult VKR_PostInstanceConstruct(VulkanRenderer& r, VkSurfaceKHR surface);
 void VKR_Destruct(VulkanRenderer& r);
 
@@ -79,6 +82,32 @@ VKH_CreateShaderModule(VkDevice device, const void *pCode, size_t nBytes)
     return shader;
 }
 
+// From a .spv file, see load_spirv_file. Null if the file can't be loaded.
+VkShaderModule
+VKH_LoadShaderModule(VkDevice device, const char *spvPath);
+
+/*  Returns a memory type index in typeBits that has all of `required`, preferring one that also has all of
+    `preferred`. UINT32_MAX if none.
+*/
+uint32_t
+VKH_FindMemoryType(const VkPhysicalDeviceMemoryProperties& memory, uint32_t typeBits,
+                   VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+
+/* A buffer with its own VkDeviceMemory. Fine for the handful of long-lived buffers here, not for many small ones. */
+struct BufferAllocation {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void *pMapped; // persistently mapped if the memory is HOST_VISIBLE, else null
+};
+
+VkResult
+VKH_CreateBuffer(const VulkanRenderer& vkr, VkDeviceSize size, VkBufferUsageFlags usage,
+                 VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, BufferAllocation *pOut);
+
+void
+VKH_DestroyBuffer(VkDevice device, BufferAllocation& b);
+
 //{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
 #define FULL_IMAGE_RANGE_COLOR VkImageSubresourceRange{ 1, 0, 0xffffffffu, 0, 0xffffffffu }
 //{ VK_COMPONENT_SWIZZLE_IDENTITY... } = { 0... }
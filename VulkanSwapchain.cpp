@@ -79,6 +79,15 @@ Swapchain_Create(Swapchain& sc, VkPhysicalDevice physicalDevice, VkDevice device
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = sc.imageUsageBits;
 
+    const VkFormat viewFormats[2] = { sc.format, sc.storageFormat };
+    VkImageFormatListCreateInfo formatList = { VK_STRUCTURE_TYPE_IMAGE_FORMAT_LIST_CREATE_INFO };
+    if (sc.bMutableFormat) {
+        formatList.viewFormatCount = 2;
+        formatList.pViewFormats = viewFormats;
+        createInfo.flags = VK_SWAPCHAIN_CREATE_MUTABLE_FORMAT_BIT_KHR;
+        createInfo.pNext = &formatList;
+    }
+
     /*  Sharing mode is VK_SHARING_MODE_EXCLUSIVE (0), already zerod by = { } */
     // createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     // createInfo.queueFamilyIndexCount = 0; // ignored when exclusive
@@ -100,6 +109,7 @@ Swapchain_Create(Swapchain& sc, VkPhysicalDevice physicalDevice, VkDevice device
     if (res == 0) {
         sc.swapchain = newSwapchain;
         sc.lastCreatedExtent = createInfo.imageExtent;
+        sc.presentMode = presentMode;
 
         uint32_t n = 0;
         VK_CHECK(vkGetSwapchainImagesKHR(device, sc.swapchain, &n, nullptr));
@@ -113,22 +123,55 @@ Swapchain_Create(Swapchain& sc, VkPhysicalDevice physicalDevice, VkDevice device
 }
 
 //must be called after the surface is created:
+static VkFormat
+UnormAlias(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_SRGB: return VK_FORMAT_R8G8B8A8_UNORM;
+    case VK_FORMAT_B8G8R8A8_SRGB: return VK_FORMAT_B8G8R8A8_UNORM;
+    default: return format;
+    }
+}
+
+static bool
+SupportsStorage(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
 VkResult
-Swapchain_InitParams(Swapchain& sc, VkPhysicalDevice physicalDevice, VkImageUsageFlags imageUsageBits)
+Swapchain_InitParams(Swapchain& sc, VkPhysicalDevice physicalDevice, VkImageUsageFlags imageUsageBits,
+                     bool bMutableFormatAllowed)
 {
-    /* I guess one could want more than one, but I don't think I'll be doing that. */
-    ASSERT(imageUsageBits == VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT ||
-           imageUsageBits == VK_IMAGE_USAGE_TRANSFER_DST_BIT ||
-           imageUsageBits == VK_IMAGE_USAGE_STORAGE_BIT);
+    /*  I guess one could want more than one, but I don't think I'll be doing that.
+        TRANSFER_SRC (for frame capture) can come with any of them, it's dropped if the surface can't do it.
+        STORAGE (compute output) and TRANSFER_DST (dynamic resolution's blit) with COLOR_ATTACHMENT are optional too.
+    */
+    VkImageUsageFlags const optionalUsageBits = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+        ((imageUsageBits & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) ? VK_IMAGE_USAGE_STORAGE_BIT |
+                                                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+    VkImageUsageFlags const mainUsageBits = imageUsageBits & ~optionalUsageBits;
+    ASSERT(mainUsageBits == VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT ||
+           mainUsageBits == VK_IMAGE_USAGE_TRANSFER_DST_BIT ||
+           mainUsageBits == VK_IMAGE_USAGE_STORAGE_BIT);
+    {
+        VkSurfaceCapabilitiesKHR surfaceCaps;
+        VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, sc.surface, &surfaceCaps));
+        imageUsageBits &= surfaceCaps.supportedUsageFlags | mainUsageBits;
+    }
 
     VkFormat format = VK_FORMAT_UNDEFINED;
     // get a surface format
     {
-        VkSurfaceFormatKHR formats[200];
-        uint32_t formatCount = lengthof(formats);
-        VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, sc.surface, &formatCount, formats));
+        /* Once at startup, so a malloc is fine, and there's no count to guess. */
+        uint32_t formatCount = 0;
+        VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, sc.surface, &formatCount, nullptr));
         ASSERT(formatCount);
-        ASSERT(formatCount < lengthof(formats));
+        VkSurfaceFormatKHR *formats = static_cast<VkSurfaceFormatKHR *>(malloc(Max(formatCount, 1u) * sizeof *formats));
+        if (!formats) return VK_ERROR_OUT_OF_HOST_MEMORY;
+        VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, sc.surface, &formatCount, formats));
 
         if (formatCount == 1 && formats[0].format == VK_FORMAT_UNDEFINED) {
             format = VK_FORMAT_R8G8B8A8_UNORM;
@@ -143,22 +186,45 @@ Swapchain_InitParams(Swapchain& sc, VkPhysicalDevice physicalDevice, VkImageUsag
                 }
             }
         }
+        free(formats);
     }
     printf("Using swapchain format %d, sRGB ? %c\n", format, '0'+(format == VK_FORMAT_R8G8B8A8_SRGB ||
                                                                   format == VK_FORMAT_B8G8R8A8_SRGB));
 
+    /* Storage writes don't encode sRGB, so sRGB formats don't support them. Write through a UNORM view instead. */
+    sc.storageFormat = VK_FORMAT_UNDEFINED;
+    sc.bMutableFormat = false;
+    if (imageUsageBits & VK_IMAGE_USAGE_STORAGE_BIT) {
+        VkFormat const alias = UnormAlias(format);
+        if (SupportsStorage(physicalDevice, format)) {
+            sc.storageFormat = format;
+        } else if (alias != format && bMutableFormatAllowed && SupportsStorage(physicalDevice, alias)) {
+            sc.storageFormat = alias;
+            sc.bMutableFormat = true;
+        } else if (mainUsageBits != VK_IMAGE_USAGE_STORAGE_BIT) {
+            imageUsageBits &= ~VK_IMAGE_USAGE_STORAGE_BIT;
+        }
+        printf("Swapchain storage views: format %d%s\n", sc.storageFormat,
+               sc.bMutableFormat ? " (UNORM alias)" : sc.storageFormat ? "" : ", none, no compute output");
+    }
+
     sc.format = format;
     sc.imageUsageBits = imageUsageBits;
 
     sc.swapchain = nullptr;
     sc.lastCreatedExtent = {};
+    sc.presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
 
     VkPresentModeKHR presentModes[8]; // there should be less than this many VK_PRESENT_MODE_* values.
     uint32_t count = lengthof(presentModes);
     vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, sc.surface, &count, presentModes);
+    sc.presentModeMask = 1u << VK_PRESENT_MODE_FIFO_KHR; // required to be supported
     printf("Supported presentation modes: {");
     for (uint i = 0; ;) {
-        printf(" %d", presentModes[i]);
+        printf(" %s", PresentMode_Name(presentModes[i]));
+        if (uint(presentModes[i]) < 32u) {
+            sc.presentModeMask |= 1u << presentModes[i];
+        }
         if (++i == count) { break; }
         putchar(',');
     }
@@ -167,6 +233,77 @@ Swapchain_InitParams(Swapchain& sc, VkPhysicalDevice physicalDevice, VkImageUsag
     return VK_SUCCESS;
 }
 
+const char *
+PresentPolicy_Name(present_policy policy)
+{
+    static const char *const Names[] = { "fifo", "immediate", "mailbox", "fifo_relaxed", "adaptive" };
+    static_assert(lengthof(Names) == uint(present_policy::count), "");
+    return uint(policy) < lengthof(Names) ? Names[uint(policy)] : "???";
+}
+
+const char *
+PresentMode_Name(VkPresentModeKHR mode)
+{
+    static const char *const Names[] = {
+        "IMMEDIATE", // VK_PRESENT_MODE_IMMEDIATE_KHR = 0,
+        "MAILBOX", // VK_PRESENT_MODE_MAILBOX_KHR = 1,
+        "FIFO", // VK_PRESENT_MODE_FIFO_KHR = 2,
+        "FIFO_RELAXED" // VK_PRESENT_MODE_FIFO_RELAXED_KHR = 3,
+    };
+    return uint(mode) < lengthof(Names) ? Names[mode] : "other";
+}
+
+VkPresentModeKHR
+Swapchain_ChoosePresentMode(const Swapchain& sc, present_policy policy, bool bBeatsRefresh)
+{
+    /* Preference lists, first supported wins. FIFO at the end of each, so there is always a match. */
+    static const VkPresentModeKHR Immediate[] = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR Mailbox[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR Relaxed[] = { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR Fifo[] = { VK_PRESENT_MODE_FIFO_KHR };
+
+    const VkPresentModeKHR *prefs = Fifo;
+    uint n = lengthof(Fifo);
+    switch (policy) {
+    case present_policy::immediate: prefs = Immediate; n = lengthof(Immediate); break;
+    case present_policy::mailbox: prefs = Mailbox; n = lengthof(Mailbox); break;
+    case present_policy::fifo_relaxed: prefs = Relaxed; n = lengthof(Relaxed); break;
+    case present_policy::adaptive:
+        if (bBeatsRefresh) { prefs = Mailbox; n = lengthof(Mailbox); }
+        else { prefs = Relaxed; n = lengthof(Relaxed); }
+        break;
+    default: break;
+    }
+
+    for (uint i = 0; i < n; ++i) {
+        if (sc.presentModeMask & (1u << prefs[i])) {
+            return prefs[i];
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+bool
+AdaptivePresent_Update(AdaptivePresentState& s, float workSecs, float refreshSecs)
+{
+    /*  Separate thresholds and a required streak, so a frame time sitting right at the refresh interval
+        doesn't flip the mode (and recreate the swapchain) every few frames.
+    */
+    constexpr uint32_t RequiredStreak = 30;
+    bool const wantsFlip = s.bBeatsRefresh ? (workSecs > refreshSecs * 0.95f)
+                                           : (workSecs < refreshSecs * 0.85f);
+    if (!wantsFlip) {
+        s.streak = 0;
+        return false;
+    }
+    if (++s.streak < RequiredStreak) {
+        return false;
+    }
+    s.streak = 0;
+    s.bBeatsRefresh = !s.bBeatsRefresh;
+    return true;
+}
+
 /*  Yeild the calling threads CPU time by the specified millisecond duration.
     The resolution of this is poor and the actual duration may be much longer.
 */
@@ -175,6 +312,18 @@ void OS_SleepMS(uint32_t ms)
     Sleep(ms);
 }
 
+void OS_YieldThread()
+{
+    SwitchToThread();
+}
+
+uint32_t OS_GetCpuCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? uint32_t(info.dwNumberOfProcessors) : 1u;
+}
+
 int64_t OS_TicksPerSecond()
 {
     LARGE_INTEGER li;
@@ -189,6 +338,132 @@ int64_t OS_GetTicks()
     return li.QuadPart;
 }
 
+/*  Sleep() can overshoot by a whole scheduler quantum (often ~15.6ms), so only sleep while more than
+    2ms away from the deadline, and spin for the rest.
+*/
+void OS_SleepUntilTicks(os_tick_t deadline)
+{
+    int64_t const ticksPerMs = OS_TicksPerSecond() / 1000;
+    for (;;) {
+        os_tick_t const remaining = deadline - OS_GetTicks();
+        if (remaining <= 0) {
+            break;
+        }
+        if (remaining > 2 * ticksPerMs) {
+            Sleep(DWORD(remaining / ticksPerMs) - 2);
+        } else {
+            YieldProcessor();
+        }
+    }
+}
+
+bool OS_MapFileReadOnly(const char *path, os_mapped_file *pFile)
+{
+    *pFile = { };
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    /* A mapping of a 0 byte file fails, treat that as an error too. */
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || uint64_t(size.QuadPart) > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // the mapping keeps the file open
+    if (!mapping) {
+        return false;
+    }
+    const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // and the view keeps the mapping
+    if (!data) {
+        return false;
+    }
+    pFile->data = data;
+    pFile->size = size_t(size.QuadPart);
+    return true;
+}
+
+void OS_UnmapFile(os_mapped_file& file)
+{
+    if (file.data) {
+        UnmapViewOfFile(file.data);
+    }
+    file = { };
+}
+
+struct os_thread_start {
+    void (*proc)(void *arg);
+    void *arg;
+};
+
+static DWORD WINAPI OS_ThreadTrampoline(LPVOID param)
+{
+    os_thread_start const start = *static_cast<os_thread_start *>(param);
+    free(param);
+    start.proc(start.arg);
+    return 0;
+}
+
+bool OS_StartThread(os_thread *pThread, void (*proc)(void *arg), void *arg)
+{
+    pThread->handle = nullptr;
+    os_thread_start *start = static_cast<os_thread_start *>(malloc(sizeof(os_thread_start)));
+    if (!start) {
+        return false;
+    }
+    start->proc = proc;
+    start->arg = arg;
+    HANDLE h = CreateThread(nullptr, 0, OS_ThreadTrampoline, start, 0, nullptr);
+    if (!h) {
+        free(start);
+        return false;
+    }
+    pThread->handle = h;
+    return true;
+}
+
+void OS_JoinThread(os_thread& thread)
+{
+    if (thread.handle) {
+        WaitForSingleObject(thread.handle, INFINITE);
+        CloseHandle(thread.handle);
+        thread.handle = nullptr;
+    }
+}
+
+bool OS_CreateSemaphore(os_semaphore *pSem, uint32_t initialCount, uint32_t maxCount)
+{
+    pSem->handle = CreateSemaphoreA(nullptr, LONG(initialCount), LONG(maxCount), nullptr);
+    return pSem->handle != nullptr;
+}
+
+void OS_DestroySemaphore(os_semaphore& sem)
+{
+    if (sem.handle) {
+        CloseHandle(sem.handle);
+        sem.handle = nullptr;
+    }
+}
+
+void OS_PostSemaphore(os_semaphore& sem)
+{
+    BOOL const ok = ReleaseSemaphore(sem.handle, 1, nullptr);
+    ASSERT(ok); (void)ok; // over maxCount
+}
+
+void OS_WaitSemaphore(os_semaphore& sem)
+{
+    WaitForSingleObject(sem.handle, INFINITE);
+}
+
+bool OS_TryWaitSemaphore(os_semaphore& sem)
+{
+    return WaitForSingleObject(sem.handle, 0) == WAIT_OBJECT_0;
+}
+
 
 #if 0
 float sq2f(int64_t q)
@@ -1,6 +1,8 @@
 #pragma once
 #include "vk_procs.h"
 
+#define SWAPCHAIN_MAX_IMAGES 8
+
 struct Swapchain
 {
     VkSwapchainKHR swapchain; // may change thorughout program.
@@ -8,15 +10,58 @@ struct Swapchain
     VkFormat format;
     VkExtent2D lastCreatedExtent;
     uint32_t imageCount;
-    VkImage images[8];
+    VkImage images[SWAPCHAIN_MAX_IMAGES];
     VkImageUsageFlags imageUsageBits;
+    /*  Format for storage views of the images (compute output), VK_FORMAT_UNDEFINED if imageUsageBits has no
+        STORAGE. sRGB formats can't be storage images, for those it's the UNORM alias and bMutableFormat is set:
+        the swapchain is created with both formats allowed, and views of format must leave out STORAGE usage.
+    */
+    VkFormat storageFormat;
+    bool bMutableFormat;
+    uint32_t presentModeMask; // bit (1 << VkPresentModeKHR) for each mode the surface supports, only the 4 core modes
+    VkPresentModeKHR presentMode; // of the last created swapchain
 };
 
+/*
+    What the app asks for, mapped to a VkPresentModeKHR the surface supports by Swapchain_ChoosePresentMode.
+    Fallbacks never introduce tearing the policy did not already allow, FIFO is always supported.
+*/
+enum class present_policy : uint8_t {
+    fifo,         // vsync
+    immediate,    // tears, falls back to mailbox
+    mailbox,      // newest frame wins at vblank, no tearing, low latency
+    fifo_relaxed, // vsync, but a late frame is shown immediately (may tear) instead of waiting another interval
+    adaptive,     // mailbox while frames beat the refresh interval, fifo_relaxed while they miss it
+    count
+};
+
+const char *PresentPolicy_Name(present_policy policy);
+const char *PresentMode_Name(VkPresentModeKHR mode);
+
+VkPresentModeKHR
+Swapchain_ChoosePresentMode(const Swapchain& sc, present_policy policy, bool bBeatsRefresh);
+
+/*  Hysteresis for present_policy::adaptive. workSecs should be the CPU or GPU time of a frame, whichever is larger,
+    not the frame interval (which is pinned to the refresh interval under vsync).
+    Returns true when bBeatsRefresh flips.
+*/
+struct AdaptivePresentState {
+    bool bBeatsRefresh;
+    uint32_t streak;
+};
+
+bool AdaptivePresent_Update(AdaptivePresentState& s, float workSecs, float refreshSecs);
+
 VkResult
 Swapchain_CreateSurfaceOnly(Swapchain& sc, VkInstance instance, void *nativeWindowHandle);
 
+/*  imageUsageBits has one of COLOR_ATTACHMENT, TRANSFER_DST or STORAGE. TRANSFER_SRC can come with any of them,
+    and STORAGE or TRANSFER_DST with COLOR_ATTACHMENT, these are dropped if the surface or format can't do them.
+    bMutableFormatAllowed: VK_KHR_swapchain_mutable_format is enabled, for storage on sRGB formats.
+*/
 VkResult
-Swapchain_InitParams(Swapchain& sc, VkPhysicalDevice physicalDevice, VkImageUsageFlags imageUsageBits);
+Swapchain_InitParams(Swapchain& sc, VkPhysicalDevice physicalDevice, VkImageUsageFlags imageUsageBits,
+                     bool bMutableFormatAllowed);
 
 VkResult
 Swapchain_Create(Swapchain& sc, VkPhysicalDevice physicalDevice, VkDevice device,
@@ -32,5 +77,39 @@ Swapchain_DestroySwapchainAndSurface(const Swapchain& sc, VkInstance instance, V
 typedef int64_t os_tick_t;
 
 void OS_SleepMS(uint32_t ms);
+void OS_YieldThread(); // lets another ready thread on this core run, if there is one
+uint32_t OS_GetCpuCount(); // logical processors
 int64_t OS_TicksPerSecond();
 int64_t OS_GetTicks();
+void OS_SleepUntilTicks(os_tick_t deadline); // Sleeps coarsely, then spins the last couple of milliseconds.
+
+struct os_mapped_file {
+    const void *data;
+    size_t size;
+};
+
+// Maps a whole file for reading, pages come in on first touch. False if it can't be opened or is empty.
+bool OS_MapFileReadOnly(const char *path, os_mapped_file *pFile);
+void OS_UnmapFile(os_mapped_file& file);
+
+struct os_thread {
+    void *handle;
+};
+
+// Runs proc(arg) on a new thread. False if it couldn't be started.
+bool OS_StartThread(os_thread *pThread, void (*proc)(void *arg), void *arg);
+// Waits for the thread to return, then releases it.
+void OS_JoinThread(os_thread& thread);
+
+/*  Counting semaphore. Post and wait are full memory barriers, so whatever a thread wrote before a post is
+    visible to the thread whose wait it satisfies.
+*/
+struct os_semaphore {
+    void *handle;
+};
+
+bool OS_CreateSemaphore(os_semaphore *pSem, uint32_t initialCount, uint32_t maxCount);
+void OS_DestroySemaphore(os_semaphore& sem);
+void OS_PostSemaphore(os_semaphore& sem);
+void OS_WaitSemaphore(os_semaphore& sem);
+bool OS_TryWaitSemaphore(os_semaphore& sem); // false instead of blocking
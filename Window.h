@@ -41,6 +41,7 @@ void WindowWin32_Destroy(Window& w);
 
 void Window_Show(Window&);
 void Window_SetTitle(Window&, const char *);
+int Window_GetRefreshRateHz(const Window&); // Of the monitor the window is mostly on, 0 if unknown.
 
 bool Window_DispatchMessagesNonblocking(); // Returns true if application should close, does not block if there is no message.
 bool Window_WaitAtLeastOneMessage();
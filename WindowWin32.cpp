@@ -94,8 +94,9 @@ int WindowWin32_Create(Window *window, int width, int height, const char *title,
 
     HINSTANCE const hInstance = GetModuleHandle(nullptr);
 
-    const char *windowClassName;
-    {
+    /* Registered by the first call, later windows share it (and its classStyle). */
+    static const char *windowClassName;
+    if (!windowClassName) {
         WNDCLASSEXA wcex = { sizeof(wcex) };
         wcex.style = classStyle;
         wcex.lpfnWndProc = main_wndproc;//see set wndporc notes below
@@ -178,6 +179,24 @@ void Window_SetTitle(Window& win, const char *s)
     SetWindowTextA((HWND) win.nativeHandle, s);
 }
 
+int Window_GetRefreshRateHz(const Window& win)
+{
+    HMONITOR const monitor = MonitorFromWindow((HWND) win.nativeHandle, MONITOR_DEFAULTTONEAREST);
+    MONITORINFOEXA info = {};
+    info.cbSize = sizeof(info);
+    if (!GetMonitorInfoA(monitor, &info)) {
+        return 0;
+    }
+
+    DEVMODEA mode = {};
+    mode.dmSize = sizeof(mode);
+    if (!EnumDisplaySettingsA(info.szDevice, ENUM_CURRENT_SETTINGS, &mode)) {
+        return 0;
+    }
+    // 0 and 1 mean "hardware default", which isn't useful.
+    return mode.dmDisplayFrequency > 1 ? int(mode.dmDisplayFrequency) : 0;
+}
+
 bool Window_DispatchMessagesNonblocking()
 {
     MSG msg;
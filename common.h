@@ -21,6 +21,7 @@ template<class T, uint N> constexpr uint lengthof(T(& )[N]) { return   N; }
 template<class T, uint N> constexpr T*      endof(T(&a)[N]) { return a+N; }
 
 template<class T> T Max(T a, T b) { return b < a ? a : b; }
+template<class T> T Min(T a, T b) { return a < b ? a : b; }
 
 template<class T> T Abs(T v) { return v < T(0) ? -v : v; }
 
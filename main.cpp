@@ -1,10 +1,36 @@
 #include "VulkanRenderer.h"
 #include "VulkanSwapchain.h"
+#include "GpuTimer.h"
+#include "GpuStats.h"
+#include "FramePacer.h"
+#include "Particles.h"
+#include "SpriteBatcher.h"
+#include "HudOverlay.h"
+#include "RenderTargets.h"
+#include "CmdEncoder.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+#include "MemoryBudget.h"
+#include "ComputeOutput.h"
+#include "DynamicResolution.h"
+#include "MultiOutput.h"
+#include "Mesh.h"
+#include "TextureStreamer.h"
+#include "MipGen.h"
+#include "DrawBench.h"
+#include "FrameCapture.h"
+#include "FrameTrace.h"
+#include "Regress.h"
+#include "VecMath.h"
+#include "shaders.h"
 
 #include "Window.h"
 
 #include <stdio.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 // wraps value to [0, K) exclusive
 inline float Mod(float a, float k)
@@ -17,37 +43,63 @@ inline float SmoothPoly3(float t)
     return t*t*(3 - 2*t);
 }
 
-struct vec2f { float x, y; };
-
-struct vec4f {
-    union {
-        struct {
-            float x, y, z, w;
-        };
-        struct {
-            vec2f xy, zw;
-        };
-    };
-};
-
-/*
-    Returns the cosine and sine using where [0, 1) revolutions maps to [0, 2pi) radians.
-*/
-inline vec2f cos_sin_tau(float revolutions)
-{
-    constexpr float Tau = float(3.14159265358979323846 * 2);
-    float radians = revolutions * Tau;
-    return {
-        cosf(radians),
-        sinf(radians)
-    };
-}
-
 struct App {
-    // The swapchains present mode = (immediatePresentation ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR);
+    // The swapchain's present mode = Swapchain_ChoosePresentMode(presentPolicy, ...), the swapchain is recreated when that changes.
     // FIFO should be vsync with syncInterval=1
-    bool bImmediatePresentation = false;
-    bool bDirtyVsync = false;
+    present_policy presentPolicy = present_policy::fifo;
+    AdaptivePresentState adaptivePresent = { };
+    float refreshSecs = 0.0f; // 0 if unknown, then the adaptive policy stays put
+    // Delay the frame start (and input sampling) until just before the GPU can use the frame, see FramePacer.h
+    bool bLowLatency = false;
+    // Earliest key event not yet consumed by a frame, 0 if none. Used to measure input-to-present latency.
+    os_tick_t pendingInputTicks = 0;
+    // GPU particle simulation, 'P' toggles. Created on first use, a capacity of 0 means it failed.
+    bool bParticles = false;
+    uint32_t particleCapacity = 1u << 21;
+    // --sprites[=N]: N sprites every frame through SpriteBatcher.h (default 1M), fill and sort times in the title
+    bool bSprites = false;
+    uint32_t spriteCount = 1000000;
+    // Frame time graphs and stats drawn into the frame, --hud or 'H'. Created on first use, see HudOverlay.h.
+    bool bHud = false;
+    // --compute-out: the frame is one compute dispatch into the swapchain image, no render pass, see ComputeOutput.h
+    bool bComputeOut = false;
+    // --dynres[=fps]: render at a scale that holds the GPU time to the refresh interval (or fps), see DynamicResolution.h
+    bool bDynRes = false;
+    float dynResFps = 0.0f; // 0 is the refresh rate
+    // --outputs=N: N more windows showing the frame, presented with the main one in one call, see MultiOutput.h
+    uint32_t extraOutputs = 0;
+    // --gpu-stats: pipeline statistics and occlusion counts per pass, in the HUD and at exit, see GpuStats.h
+    bool bGpuStats = false;
+    // Requested MSAA sample count, 'A' cycles 1/2/4/8. Clamped to what the device supports.
+    uint32_t msaaSamples = 1;
+    // .vkm file to draw (see MeshFormat.h), from --mesh=path
+    const char *meshPath = nullptr;
+    // KTX2 texture for the mesh, from --texture=path, streamed in at most textureBudgetKiB per frame
+    const char *texturePath = nullptr;
+    uint32_t textureBudgetKiB = 4096;
+    // Heaps near their memory budget, see MemoryBudget.h. While any is, textures are asked for at a quarter the size.
+    uint32_t memoryHeapsOver = 0;
+    // --mem-csv=path: per-frame heap usage/budget and category totals
+    const char *memCsvPath = nullptr;
+    // --bench-mips: time MipGen's single dispatch against the blit chain on the swapchain format, then exit
+    bool bBenchMips = false;
+    // --bench-draws: ns per vkCmdDraw/PushConstants/BindPipeline and vkQueueSubmit, see DrawBench.h, then exit
+    bool bBenchDraws = false;
+    // 'R' recording writes one raw video file (--capture-raw) instead of a TGA per frame, see FrameCapture.h
+    bool bCaptureRaw = false;
+    // Job system worker threads, --threads=N. Default one per core less the main thread.
+    uint32_t workerThreads = UINT32_MAX;
+    // --stress-jobs: flat and nested Jobs_ParallelFor on workerThreads, checked, then exit. No window or device.
+    bool bStressJobs = false;
+    // --regress=dir: golden image and timing run over fixed scenes, then exit, see Regress.h. --regress-update rewrites.
+    const char *regressDir = nullptr;
+    bool bRegressUpdate = false;
+    // --trace=path: 'T' writes the next frame to a .vkt file for tools/tracereplay, see FrameTrace.h.
+    // --trace-frame=N captures frame N instead, without a key.
+    const char *tracePath = nullptr;
+    uint32_t traceFrame = UINT32_MAX;
+    // Only cleared by the regression scenes that don't want the mesh.
+    bool bDrawMesh = true;
     // AKA "iconic" glfw has a callback for this as well as glfwGetWindowAttrib(window, GLFW_ICONIFIED)
     // The window class could just track this, to be more compatible with glfw which I should just probably use.
     bool isWindowIconic = false;
@@ -62,11 +114,26 @@ struct PerframeObjects {
     VkFence fence;
     VkSemaphore swapchainImageAcquireSema;
     VkSemaphore swapchainImageReleaseSema;
+    os_tick_t submitTicks; // 0 until something is submitted from this slot
+    os_tick_t inputEventTicks; // key event consumed by the frame in flight in this slot, 0 if none
 };
 
 struct SwapchainRenderables {
     VkImageView view;
-    VkFramebuffer framebuffer; // no DSV or any resolve attatchments.
+    VkFramebuffer framebuffer; // attachments as in CreateRenderPass
+    VkImageView storageView; // sc.storageFormat, null if the swapchain has no storage usage
+};
+
+/*  A swapchain that was replaced (resize or present mode change) while frames using it may still be in flight.
+    It and its renderables are destroyed once every frame slot has been waited on since, instead of stalling
+    on vkDeviceWaitIdle at the moment of the swap. On a resize the render targets are retired with it.
+*/
+struct RetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    uint32_t imageCount;
+    uint32_t retireFrame;
+    SwapchainRenderables renderables[SWAPCHAIN_MAX_IMAGES];
+    RenderTargets targets; // zeroed if they were kept
 };
 
 static void
@@ -75,12 +142,32 @@ DestroySwapchainRenderables(VkDevice device, const SwapchainRenderables *a, unsi
     for (unsigned i = 0; i < n; ++i) {
         vkDestroyFramebuffer(device, a[i].framebuffer, nullptr);
         vkDestroyImageView(device, a[i].view, nullptr);
+        vkDestroyImageView(device, a[i].storageView, nullptr);
+    }
+}
+
+// Returns the new count. Call after waiting on the current frame slot's fence, or with bAll after vkDeviceWaitIdle.
+static unsigned
+ReleaseRetiredSwapchains(VkDevice device, RetiredSwapchain *a, unsigned n, uint32_t frameCounter, bool bAll)
+{
+    unsigned kept = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        /* Frames up to retireFrame-1 used it, and frame (retireFrame-1) is in the slot waited on at retireFrame+CAPACITY-1. */
+        if (bAll || frameCounter - a[i].retireFrame >= PERFRAME_CAPACITY - 1) {
+            DestroySwapchainRenderables(device, a[i].renderables, a[i].imageCount);
+            RenderTargets_Destroy(a[i].targets, device);
+            vkDestroySwapchainKHR(device, a[i].swapchain, nullptr);
+        } else {
+            a[kept++] = a[i];
+        }
     }
+    return kept;
 }
 
 // The VkRenderPass only has to be a compatible VkRenderPass
 static void
-CreateSwapchainRenderables(VkDevice device, SwapchainRenderables *a, const Swapchain& sc, VkRenderPass renderPass)
+CreateSwapchainRenderables(VkDevice device, SwapchainRenderables *a, const Swapchain& sc, VkRenderPass renderPass,
+                           const RenderTargets& targets)
 {
     VkImageViewCreateInfo viewCreateInfo = {
         VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -93,44 +180,92 @@ CreateSwapchainRenderables(VkDevice device, SwapchainRenderables *a, const Swapc
         FULL_IMAGE_RANGE_COLOR
     };
 
+    /* Same order as the render pass: rendered color, depth, then the resolve target when multisampled.
+       The offscreen image, when there is one, is used in place of the swapchain image. The size is the targets',
+       the swapchain's except in the regression run. */
+    bool const bMultisampled = targets.samples != VK_SAMPLE_COUNT_1_BIT;
+    VkImageView attachments[3] = { targets.colorView, targets.depthView, nullptr };
+    VkImageView *const pSwapchainView = bMultisampled ? &attachments[2] : &attachments[0];
+
     VkFramebufferCreateInfo fbCreateInfo = {
         VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
         nullptr,
         0, // VkFramebufferCreateFlags
         renderPass,
-        1, // uint32_t attachmentCount, set in loop
-        nullptr, // const VkImageView* pAttachments;
-        sc.lastCreatedExtent.width, sc.lastCreatedExtent.height, 1 // uint32_t width, height, layers;
+        bMultisampled ? 3u : 2u, // uint32_t attachmentCount
+        attachments, // const VkImageView* pAttachments;
+        targets.extent.width, targets.extent.height, 1 // uint32_t width, height, layers;
     };
 
+    /* With a mutable format the sRGB view has to leave out the image's STORAGE usage, the format can't do it. */
+    VkImageViewUsageCreateInfo colorUsage = { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+    colorUsage.usage = sc.imageUsageBits & ~VK_IMAGE_USAGE_STORAGE_BIT;
+    VkImageViewCreateInfo storageViewCreateInfo = viewCreateInfo;
+    storageViewCreateInfo.format = sc.storageFormat;
+    if (sc.bMutableFormat) {
+        viewCreateInfo.pNext = &colorUsage;
+    }
+
     for (unsigned i = 0; i < sc.imageCount; ++i) {
         viewCreateInfo.image = sc.images[i];
         vkCreateImageView(device, &viewCreateInfo, nullptr, &a[i].view);
-        fbCreateInfo.pAttachments = &a[i].view;
+        *pSwapchainView = targets.offscreenView ? targets.offscreenView : a[i].view;
         vkCreateFramebuffer(device, &fbCreateInfo, nullptr, &a[i].framebuffer);
+        a[i].storageView = nullptr;
+        if (sc.storageFormat != VK_FORMAT_UNDEFINED) {
+            storageViewCreateInfo.image = sc.images[i];
+            vkCreateImageView(device, &storageViewCreateInfo, nullptr, &a[i].storageView);
+        }
     }
 }
 
 
+/*  Attachment 0 is what gets rendered to, 1 is depth/stencil. With MSAA, 0 is the multisampled image and
+    2 is the swapchain image it's resolved into at the end of the subpass, else 0 is the swapchain image.
+    Everything but the swapchain image is transient: cleared on load, not stored.
+    With dynamic resolution or the regression run the offscreen image stands in for the swapchain image, and
+    finalLayout is COLOR_ATTACHMENT_OPTIMAL instead of PRESENT_SRC_KHR. Layouts don't affect render pass compatibility.
+*/
 static VkRenderPass
-CreateRenderPass(VkDevice device, VkFormat color0_format)
+CreateRenderPass(VkDevice device, VkFormat color0_format, VkFormat depth_format, VkSampleCountFlagBits samples,
+                 VkImageLayout finalLayout)
 {
-    const VkAttachmentDescription color0_desc = {
+    bool const bMultisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+
+    const VkAttachmentDescription swapchain_desc = {
         0, // VkAttachmentDescriptionFlags flags;
         color0_format, // VkFormat format;
         VK_SAMPLE_COUNT_1_BIT, // VkSampleCountFlagBits samples;
-        VK_ATTACHMENT_LOAD_OP_CLEAR, // VkAttachmentLoadOp loadOp;
+        bMultisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR, // resolve overwrites it all
         VK_ATTACHMENT_STORE_OP_STORE, // VkAttachmentStoreOp storeOp;
         VK_ATTACHMENT_LOAD_OP_DONT_CARE, //VkAttachmentLoadOp stencilLoadOp;
         VK_ATTACHMENT_STORE_OP_DONT_CARE, // VkAttachmentStoreOp stencilStoreOp;
         VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout initialLayout, the layout before vkBeginRenderPass?
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR // VkImageLayout finalLayout, layout auto-changes to this after vkEndRenderPass?
+        finalLayout // VkImageLayout finalLayout, layout auto-changes to this after vkEndRenderPass?
+    };
+
+    const VkAttachmentDescription msaa_desc = {
+        0, color0_format, samples,
+        VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, // only the resolved result is kept
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
+    const VkAttachmentDescription depth_desc = {
+        0, depth_format, samples,
+        VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
     };
 
+    const VkAttachmentDescription descs[3] = { bMultisampled ? msaa_desc : swapchain_desc, depth_desc, swapchain_desc };
+
     const VkAttachmentReference color0_ref = {
         0, // attatchment index
         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL // layout auto-changes to this when this subpass begins?
     };
+    const VkAttachmentReference depth_ref = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+    const VkAttachmentReference resolve_ref = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 
     const VkSubpassDescription subpassDesc = {
         0, // VkSubpassDescriptionFlags flags;
@@ -139,22 +274,36 @@ CreateRenderPass(VkDevice device, VkFormat color0_format)
         nullptr, // const VkAttachmentReference* pInputAttachments;
         1, // num color refs
         &color0_ref,
-        nullptr, // const VkAttachmentReference* pResolveAttachments;
-        nullptr, // const VkAttachmentReference* pDepthStencilAttachment;
+        bMultisampled ? &resolve_ref : nullptr, // const VkAttachmentReference* pResolveAttachments;
+        &depth_ref, // const VkAttachmentReference* pDepthStencilAttachment;
         0, //  preserveAttachmentCount;
         nullptr // const uint32_t* pPreserveAttachments, why isnt this and the above parameter just a bitset?
     };
 
+    /*  The transient images are shared by the frames in flight, so order this pass's attachment writes after the
+        previous frame's. This also makes the swapchain image's layout transition wait for the acquire semaphore,
+        which is waited on at COLOR_ATTACHMENT_OUTPUT.
+    */
+    const VkSubpassDependency dependency = {
+        VK_SUBPASS_EXTERNAL, 0,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        0 // VkDependencyFlags
+    };
+
     const VkRenderPassCreateInfo rpCreateInfo = {
         VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
         nullptr,
         0, // VkRenderPassCreateFlags flags;
-        1, //uint32_t attachmentCount;
-        &color0_desc, // const VkAttachmentDescription* pAttachments;
+        bMultisampled ? 3u : 2u, //uint32_t attachmentCount;
+        descs, // const VkAttachmentDescription* pAttachments;
         1, // uint32_t subpassCount;
         &subpassDesc, // const VkSubpassDescription* pSubpasses;
-        0, // uint32_t dependencyCount,  explicit deps
-        nullptr // const VkSubpassDependency* pDependencies, explicit deps
+        1, // uint32_t dependencyCount,  explicit deps
+        &dependency // const VkSubpassDependency* pDependencies, explicit deps
     };
 
     VkRenderPass rp = 0;
@@ -164,7 +313,7 @@ CreateRenderPass(VkDevice device, VkFormat color0_format)
 
 static VkPipeline
 CreatePipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout psoLayout,
-               VkRenderPass renderPass, uint32_t subpass,
+               VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples,
                VkShaderModule vs, VkShaderModule fs)
 {
     VkPipelineShaderStageCreateInfo stages[2];
@@ -230,12 +379,15 @@ CreatePipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout psoLayou
         1, nullptr // scissor count and values
     };
 
-    // Disable all depth testing.
+    // Both triangles are at z=0, LESS_OR_EQUAL so the second one still draws.
     VkPipelineDepthStencilStateCreateInfo depth_stencil ={ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    depth_stencil.depthTestEnable = true;
+    depth_stencil.depthWriteEnable = true;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 
-    // No multisampling.
+    // Must match the render pass.
     VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisample.rasterizationSamples = samples;
 
     // Specify that these states will be dynamic, i.e. not part of pipeline state object.
     const VkDynamicState dynamics[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
@@ -274,6 +426,17 @@ CreatePipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout psoLayou
 
 App app;
 Window window;
+FrameCapture capture; // 'C' screenshot, 'R' toggles recording. Zeroed if unavailable.
+RegressRun regress; // bActive with --regress
+MultiOutput outputs; // --outputs, their windows' callbacks point into it
+JobSystem jobs; // big (deques and job pools per thread), so not on the stack
+
+/* The regression run renders at a fixed size whatever the window's, see Regress.h. */
+static VkExtent2D
+GetRenderTargetExtent(const Swapchain& sc)
+{
+    return regress.bActive ? VkExtent2D{ REGRESS_WIDTH, REGRESS_HEIGHT } : sc.lastCreatedExtent;
+}
 
 /*  NOTE: A WM_SIZE with wParam=SIZE_MINIMIZED
     passes 0 for both width and height, but a swapchain cannot
@@ -294,11 +457,37 @@ static void OnVirtualKey(void *, uint32_t vkey, virtual_key_action action)
     }
 
     if (action == virtual_key_action::press) {
+        if (!app.pendingInputTicks) {
+            app.pendingInputTicks = OS_GetTicks();
+        }
+
         switch (vkey) {
         /* NOTE: Must use capital letters in cases. */
         case 'V': {
-            app.bDirtyVsync = true;
-            app.bImmediatePresentation ^= 1;
+            app.presentPolicy = present_policy((uint(app.presentPolicy) + 1) % uint(present_policy::count));
+            printf("present policy: %s\n", PresentPolicy_Name(app.presentPolicy));
+        } break;
+        case 'L': {
+            app.bLowLatency ^= 1;
+        } break;
+        case 'P': {
+            app.bParticles ^= 1;
+        } break;
+        case 'H': {
+            app.bHud ^= 1;
+        } break;
+        case 'A': {
+            app.msaaSamples = app.msaaSamples >= 8 ? 1 : app.msaaSamples * 2;
+            printf("MSAA requested: %ux\n", app.msaaSamples);
+        } break;
+        case 'C': {
+            if (capture.worker.handle) FrameCapture_RequestScreenshot(capture);
+        } break;
+        case 'R': {
+            if (capture.worker.handle) FrameCapture_ToggleRecording(capture);
+        } break;
+        case 'T': {
+            Trace_Request(TRACE_NEXT_FRAME);
         } break;
         } // end switch
     }
@@ -309,8 +498,36 @@ static void OnPaint(void *, int, int, int, int)
     puts(__FUNCTION__);
 }
 
-const uint32_t * get_hello_vertex_spirv(size_t *pBytesize);
-const uint32_t * get_hello_fragment_spirv(size_t *pBytesize);
+/* --sprites: a spinning spiral, each sprite a function of its index and the time only, so jobs can fill any range. */
+struct SpriteFillArgs {
+    SpriteBatcher *sb;
+    uint32_t first; // from Sprites_Reserve
+    float secs;
+    VkExtent2D extent;
+};
+
+static void
+FillSpritesJob(void *arg, uint32_t begin, uint32_t end, uint32_t)
+{
+    const SpriteFillArgs& fill = *static_cast<const SpriteFillArgs *>(arg);
+    float const cx = 0.5f * float(fill.extent.width), cy = 0.5f * float(fill.extent.height);
+    float const maxRadius = 0.48f * float(Min(fill.extent.width, fill.extent.height));
+    for (uint32_t i = begin; i < end; ++i) {
+        uint32_t const h = i * 2654435761u;
+        float const u = float(h >> 8) * (1.0f / 16777216.0f); // [0, 1)
+        float const angle = float(i) * 2.39996f + fill.secs * 0.25f / (0.1f + u); // golden angle, inner ones faster
+        float const radius = maxRadius * sqrtf(u);
+        Sprite& s = fill.sb->sprites[fill.first + i];
+        s.x = cx + radius * cosf(angle);
+        s.y = cy + radius * sinf(angle);
+        s.halfWidth = s.halfHeight = 1.0f + float(h & 3);
+        s.rotation = angle;
+        s.color = 0xC0000000u | (h & 0x00FFFFFFu);
+        s.uvMin = 0;
+        s.uvMax = 0xFFFFFFFFu;
+        fill.sb->keys[fill.first + i] = Sprites_MakeKey((h >> 4) & 1, SpriteBlend((h >> 5) & 1), SpriteTexture((h >> 6) & 3));
+    }
+}
 
 struct PushConstants {
     vec4f m;
@@ -328,6 +545,12 @@ Okay, heres how I think push constants work:
 
 */
 
+static void
+OnMemoryPressure(void *, uint32_t, VkDeviceSize, VkDeviceSize, bool bOver)
+{
+    app.memoryHeapsOver += bOver ? 1 : -1;
+}
+
 int main(int argc, char **argv)
 {
     /*  Starting with VK_PRESENT_MODE_IMMEDIATE_KHR and useFences==true seems better than the vkDeviceWaitIdle.
@@ -338,12 +561,132 @@ int main(int argc, char **argv)
 
     for (int i = 1; i < argc; ++i) {
         const char *arg = argv[i];
+        if (arg[0] == '-' && arg[1] == '-') {
+            // Whole-word options, these don't go through the letter scan below.
+            if (!strcmp(arg, "--bench-math")) return VM_RunBenchmark();
+            if (!strcmp(arg, "--bench-mips")) {
+                app.bBenchMips = true; // needs the device, runs after it's created
+                continue;
+            }
+            if (!strcmp(arg, "--bench-draws")) {
+                app.bBenchDraws = true;
+                continue;
+            }
+            if (!strcmp(arg, "--capture-raw")) {
+                app.bCaptureRaw = true;
+                continue;
+            }
+            if (!strncmp(arg, "--msaa=", 7)) {
+                app.msaaSamples = uint32_t(strtoul(arg + 7, nullptr, 10));
+                continue;
+            }
+            if (!strncmp(arg, "--particles", 11)) {
+                app.bParticles = true;
+                if (arg[11] == '=') app.particleCapacity = uint32_t(strtoul(arg + 12, nullptr, 10));
+                continue;
+            }
+            if (!strncmp(arg, "--sprites", 9)) {
+                app.bSprites = true;
+                if (arg[9] == '=') app.spriteCount = uint32_t(strtoul(arg + 10, nullptr, 10));
+                continue;
+            }
+            if (!strcmp(arg, "--hud")) {
+                app.bHud = true;
+                continue;
+            }
+            if (!strcmp(arg, "--compute-out")) {
+                app.bComputeOut = true;
+                continue;
+            }
+            if (!strncmp(arg, "--dynres", 8)) {
+                app.bDynRes = true;
+                if (arg[8] == '=') app.dynResFps = float(atof(arg + 9));
+                continue;
+            }
+            if (!strncmp(arg, "--outputs=", 10)) {
+                app.extraOutputs = uint32_t(strtoul(arg + 10, nullptr, 10));
+                continue;
+            }
+            if (!strcmp(arg, "--gpu-stats")) {
+                app.bGpuStats = true;
+                continue;
+            }
+            if (!strncmp(arg, "--mesh=", 7)) {
+                app.meshPath = arg + 7;
+                continue;
+            }
+            if (!strncmp(arg, "--texture=", 10)) {
+                app.texturePath = arg + 10;
+                continue;
+            }
+            if (!strncmp(arg, "--texture-budget=", 17)) {
+                app.textureBudgetKiB = Max(uint32_t(strtoul(arg + 17, nullptr, 10)), 1u);
+                continue;
+            }
+            if (!strncmp(arg, "--mem-csv=", 10)) {
+                app.memCsvPath = arg + 10;
+                continue;
+            }
+            if (!strncmp(arg, "--threads=", 10)) {
+                app.workerThreads = uint32_t(strtoul(arg + 10, nullptr, 10));
+                continue;
+            }
+            if (!strcmp(arg, "--stress-jobs")) {
+                app.bStressJobs = true; // after --threads is known
+                continue;
+            }
+            if (!strncmp(arg, "--regress=", 10)) {
+                app.regressDir = arg + 10;
+                continue;
+            }
+            if (!strcmp(arg, "--regress-update")) {
+                app.bRegressUpdate = true;
+                continue;
+            }
+            if (!strncmp(arg, "--trace=", 8)) {
+                app.tracePath = arg + 8;
+                continue;
+            }
+            if (!strncmp(arg, "--trace-frame=", 14)) {
+                app.traceFrame = uint32_t(strtoul(arg + 14, nullptr, 10));
+                continue;
+            }
+            if (!strncmp(arg, "--make-test-mesh=", 17)) {
+                return Mesh_WriteTorus(arg + 17, 96, 48) ? 0 : 1;
+            }
+            printf("unknown option %s\n", arg);
+            continue;
+        }
         for (const char *p = arg; *p; ++p) {
-            if ((*p | 32u) == 'i') app.bImmediatePresentation = true;
+            if ((*p | 32u) == 'i') app.presentPolicy = present_policy::immediate;
+            if ((*p | 32u) == 'm') app.presentPolicy = present_policy::mailbox;
+            if ((*p | 32u) == 'r') app.presentPolicy = present_policy::fifo_relaxed;
+            if ((*p | 32u) == 'a') app.presentPolicy = present_policy::adaptive;
             if ((*p | 32u) == 'f') useFences = true;
+            if ((*p | 32u) == 'l') app.bLowLatency = true;
         }
     }
 
+    if (app.bStressJobs) {
+        Jobs_Create(jobs, app.workerThreads);
+        int const rc = Jobs_RunStressTest(jobs);
+        Jobs_Destroy(jobs);
+        return rc;
+    }
+
+    if (app.regressDir) {
+        /* Don't let vsync or a device wait idle decide the timings. */
+        app.presentPolicy = present_policy::immediate;
+        app.bLowLatency = false;
+        app.particleCapacity = 1u << 16;
+        app.bHud = false; // not in the goldens
+        app.bGpuStats = false;
+        app.bComputeOut = false;
+        app.bDynRes = false; // the goldens are full resolution
+        app.extraOutputs = 0;
+        useFences = true;
+    }
+
     printf("useFences: %d\n", int(useFences));
 
     VulkanRenderer vkr;
@@ -363,7 +706,30 @@ int main(int argc, char **argv)
         mainReturnCode = int(err);
         goto L_destroy_surface_and_swapchain;
     }
-    VK_CHECK(Swapchain_InitParams(sc, vkr.physicalDevice, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT));
+    VK_CHECK(Swapchain_InitParams(sc, vkr.physicalDevice,
+                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                  (app.bComputeOut ? VK_IMAGE_USAGE_STORAGE_BIT : 0) |
+                                  (app.bDynRes || app.regressDir ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0),
+                                  vkr.caps.bSwapchainMutableFormat));
+    if (app.bBenchMips) {
+        mainReturnCode = MipGen_RunBenchmark(vkr, sc.format);
+        goto L_destroy_surface_and_swapchain;
+    }
+    if (app.bBenchDraws) {
+        mainReturnCode = DrawBench_Run(vkr);
+        goto L_destroy_surface_and_swapchain;
+    }
+    /* Before anything else is created, the trace can only replay objects it saw being created. */
+    if (app.tracePath && Trace_Install(vkr, app.tracePath) && app.traceFrame != UINT32_MAX) {
+        Trace_Request(app.traceFrame);
+    }
+    if (app.regressDir) {
+        if (!Regress_Init(regress, app.regressDir, app.bRegressUpdate, vkr)) {
+            mainReturnCode = 1;
+            goto L_destroy_surface_and_swapchain;
+        }
+        if (!app.meshPath) app.meshPath = regress.meshPath;
+    }
 
     window.user_ptr = nullptr; // app is global for now
     window.user_cb = {
@@ -382,9 +748,30 @@ int main(int argc, char **argv)
 
         PerframeObjects perframe[PERFRAME_CAPACITY];
 
-        SwapchainRenderables swapchainRenderables[4];
-
-        VkRenderPass renderPass = CreateRenderPass(vkr.device, sc.format);
+        SwapchainRenderables swapchainRenderables[SWAPCHAIN_MAX_IMAGES];
+        RetiredSwapchain retiredSwapchains[4];
+        unsigned numRetiredSwapchains = 0;
+
+        VkFormat const depthFormat = RenderTargets_ChooseDepthFormat(vkr.physicalDevice);
+        ASSERT(depthFormat != VK_FORMAT_UNDEFINED); // one of D24S8 and D32S8 is required to be supported
+        VkSampleCountFlagBits samples = RenderTargets_ClampSamples(vkr.caps, app.msaaSamples);
+        RenderTargets targets = { }; // created with the swapchain
+        VkFilter dynResFilter = VK_FILTER_NEAREST;
+        if (app.bDynRes && (!(sc.imageUsageBits & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+                            !DynRes_ChooseFilter(vkr.physicalDevice, sc.format, &dynResFilter))) {
+            puts("dynamic resolution: the swapchain images can't be blitted to");
+            app.bDynRes = false;
+        }
+        /* The regression run renders offscreen too, at its fixed size, and is shown with the same blit. */
+        if (regress.bActive && (!(sc.imageUsageBits & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+                                !DynRes_ChooseFilter(vkr.physicalDevice, sc.format, &dynResFilter))) {
+            puts("regress: the swapchain images can't be blitted to");
+            mainReturnCode = 1;
+        }
+        bool const bOffscreen = app.bDynRes || regress.bActive;
+        VkImageLayout const passFinalLayout = bOffscreen ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                                         : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        VkRenderPass renderPass = CreateRenderPass(vkr.device, sc.format, depthFormat, samples, passFinalLayout);
 
         const uint32_t *pCode;
         size_t codeByteSize;
@@ -407,13 +794,18 @@ int main(int argc, char **argv)
         VkPipelineLayout pipelineLayout = nullptr;
         VK_CHECK(vkCreatePipelineLayout(vkr.device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 
-        VkPipeline pso = CreatePipeline(vkr.device, VkPipelineCache(nullptr), pipelineLayout, renderPass, 0,
-            helloVS, helloFS);
+        /* Objects that get replaced while frames may be in flight go here, released ones are destroyed once the
+           GPU is past them, see ResourceRegistry.h. */
+        ResourceRegistry resources;
+        if (!Res_Create(resources, 1u << 16)) {
+            mainReturnCode = 1; // the frame loop doesn't start, everything here is still cleaned up
+        }
 
-        // ShaderModules can be destroyed after creating all pipelines that used them.
+        PipelineHandle pso = Res_AddPipeline(resources, vkr.device,
+            CreatePipeline(vkr.device, VkPipelineCache(nullptr), pipelineLayout, renderPass, 0, samples, helloVS, helloFS));
 
-        vkDestroyShaderModule(vkr.device, helloFS, nullptr);
-        vkDestroyShaderModule(vkr.device, helloVS, nullptr);
+        // ShaderModules can be destroyed after creating all pipelines that used them.
+        // These are kept, the pipeline is recreated when the sample count changes.
 
         for (PerframeObjects& pf : perframe) {
             // Consider VK_COMMAND_POOL_CREATE_TRANSIENT_BIT ?
@@ -424,6 +816,74 @@ int main(int argc, char **argv)
 
             vkCreateSemaphore(vkr.device, &BinarySemaCreateInfo, nullptr, &pf.swapchainImageAcquireSema);
             vkCreateSemaphore(vkr.device, &BinarySemaCreateInfo, nullptr, &pf.swapchainImageReleaseSema);
+
+            pf.submitTicks = 0;
+            pf.inputEventTicks = 0;
+        }
+
+        GpuTimer gpuTimer;
+        GpuTimer_Create(gpuTimer, vkr, PERFRAME_CAPACITY);
+        GpuStats gpuStats = { };
+        if (app.bGpuStats) {
+            GpuStats_Create(gpuStats, vkr, PERFRAME_CAPACITY);
+        }
+        ComputeOutput computeOut = { };
+        if (app.bComputeOut && !ComputeOut_Create(computeOut, vkr, sc, PERFRAME_CAPACITY)) {
+            puts("compute output unavailable, using the render pass");
+            app.bComputeOut = false;
+        }
+        if (app.extraOutputs && !MultiOut_Create(outputs, vkr, sc, app.extraOutputs, PERFRAME_CAPACITY, OnVirtualKey)) {
+            puts("extra outputs unavailable");
+        }
+
+        CmdEncoder encoder = { }; // the stats add up between title updates
+
+        MemBudget memBudget;
+        MemBudget_Init(memBudget, vkr, app.memCsvPath);
+        memBudget.pfnCallback = OnMemoryPressure;
+
+        /* Per-frame scratch, see FrameArena.h, one per job thread so jobs can use FrameArena_Get(.., threadIndex). */
+        Jobs_Create(jobs, app.workerThreads);
+        FrameArenas frameArenas;
+        if (!FrameArena_Create(frameArenas, PERFRAME_CAPACITY, jobs.threadCount, 256u << 10)) {
+            mainReturnCode = 1;
+        }
+
+        if (sc.imageUsageBits & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+            FrameCapture_Create(capture, sc.format, app.bCaptureRaw);
+        }
+        else {
+            puts("capture: swapchain images can't be copied from, no screenshots");
+        }
+
+        ParticleSystem particles = { };
+
+        SpriteBatcher sprites = { };
+        float spriteFillSecsAvg = 0.0f, spriteSortSecsAvg = 0.0f;
+        double spriteFillSecsSum = 0.0, spriteSortSecsSum = 0.0;
+        uint32_t spriteFrames = 0;
+        HudOverlay hud = { };
+        float hudSecsAvg = 0.0f; // CPU time building it
+
+        if (app.bSprites && !Sprites_Create(sprites, vkr, renderPass, samples, app.spriteCount, PERFRAME_CAPACITY)) {
+            puts("sprites unavailable");
+        }
+
+        GpuMesh mesh = { };
+        MeshPipeline meshPipeline = { };
+        TextureStreamer textures = { };
+        uint32_t meshTexture = 0; // the fallback if there's no --texture
+        if (app.meshPath && Mesh_Load(mesh, vkr, app.meshPath)) {
+            if (!MeshPipeline_Create(meshPipeline, vkr.device, renderPass, samples, PERFRAME_CAPACITY)) {
+                puts("mesh shaders unavailable");
+                Mesh_Destroy(mesh, vkr.device);
+            } else if (!TextureStreamer_Create(textures, vkr, PERFRAME_CAPACITY, VkDeviceSize(app.textureBudgetKiB) << 10)) {
+                puts("texture streaming unavailable");
+                MeshPipeline_Destroy(meshPipeline, vkr.device);
+                Mesh_Destroy(mesh, vkr.device);
+            } else if (app.texturePath) {
+                meshTexture = TextureStreamer_Load(textures, vkr, app.texturePath);
+            }
         }
 
         int64_t const TicksPerSecI64 = OS_TicksPerSecond();
@@ -432,14 +892,35 @@ int main(int argc, char **argv)
 
         os_tick_t lastTitleTicks = 0;
         float frameDurationAvgSecs = 0.0;
+        os_tick_t lastUpdateTicks = AppBeginTicks;
+
+        FramePacer pacer;
+        FramePacer_Init(pacer, TicksPerSecI64, app.bLowLatency);
+
+        if (int hz = Window_GetRefreshRateHz(window)) {
+            app.refreshSecs = 1.0f / float(hz);
+        }
+
+        /* The budget is fixed at startup, a later change of monitor doesn't move it. */
+        DynResController dynRes;
+        float const dynResFrameSecs = app.dynResFps > 0.0f ? 1.0f / app.dynResFps
+                                    : app.refreshSecs > 0.0f ? app.refreshSecs : 1.0f / 60;
+        DynRes_Init(dynRes, dynResFrameSecs, 0.5f);
+        if (app.bDynRes) {
+            printf("dynamic resolution: GPU time target %.2f ms, %s filter\n", dynRes.targetSecs * 1000,
+                   dynResFilter == VK_FILTER_LINEAR ? "linear" : "nearest");
+        }
 
         /* Say conservatively render 512 (2^9) frames per second. That rate will take 2^23 seconds to overflow a uint32_t.
          * (2^23 secs) / (60*60*24 secs/day) ~=  97 days, that should be fine.
          */
         for (uint32_t frameCounter = -1;;) {
 
+            if (mainReturnCode != 0) {
+                break; // something above couldn't be created
+            }
             Window_DispatchMessagesNonblocking();
-            if (Window_ShouldClose(window)) {
+            if (Window_ShouldClose(window) || MultiOut_ShouldClose(outputs)) {
                 break;
             }
 
@@ -455,35 +936,80 @@ int main(int argc, char **argv)
             }
             ++frameCounter; // starts at -1
 
-            if (app.windowSize != sc.lastCreatedExtent || app.bDirtyVsync) {
-                app.bDirtyVsync = false;
+            if (regress.bActive) {
+                const RegressScene *scene = Regress_GetScene(regress);
+                if (!scene) {
+                    break;
+                }
+                app.msaaSamples = scene->msaaSamples;
+                app.bParticles = scene->bParticles;
+                app.bDrawMesh = scene->bMesh;
+            }
+
+            VkSampleCountFlagBits const wantSamples = RenderTargets_ClampSamples(vkr.caps, app.msaaSamples);
+            if (wantSamples != samples && sc.swapchain) {
+                /* Rare and user driven, so drain the GPU and rebuild everything that depends on the sample count. */
+                VK_CHECK(vkDeviceWaitIdle(vkr.device));
+                numRetiredSwapchains = ReleaseRetiredSwapchains(vkr.device, retiredSwapchains, numRetiredSwapchains,
+                                                                frameCounter, true);
+                DestroySwapchainRenderables(vkr.device, swapchainRenderables, sc.imageCount);
+                RenderTargets_Destroy(targets, vkr.device);
+                Res_Release(resources, pso);
+                vkDestroyRenderPass(vkr.device, renderPass, nullptr);
+
+                samples = wantSamples;
+                renderPass = CreateRenderPass(vkr.device, sc.format, depthFormat, samples, passFinalLayout);
+                pso = Res_AddPipeline(resources, vkr.device, CreatePipeline(vkr.device, VkPipelineCache(nullptr), pipelineLayout,
+                                                                            renderPass, 0, samples, helloVS, helloFS));
+                Particles_SetRenderPass(particles, vkr.device, renderPass, samples);
+                Sprites_SetRenderPass(sprites, vkr.device, renderPass, samples);
+                Hud_SetRenderPass(hud, vkr.device, renderPass, samples);
+                MeshPipeline_SetRenderPass(meshPipeline, vkr.device, renderPass, samples);
+                VK_CHECK(RenderTargets_Create(targets, vkr, GetRenderTargetExtent(sc), sc.format, depthFormat, samples,
+                                              bOffscreen));
+                CreateSwapchainRenderables(vkr.device, swapchainRenderables, sc, renderPass, targets);
+                printf("MSAA: %ux, transient attachments lazily allocated: %d\n", uint(samples), int(targets.bLazy));
+            }
 
+            VkPresentModeKHR const presentMode = Swapchain_ChoosePresentMode(sc, app.presentPolicy,
+                                                                            app.adaptivePresent.bBeatsRefresh);
+            if (app.windowSize != sc.lastCreatedExtent || presentMode != sc.presentMode) {
                 unsigned oldNumImages = sc.imageCount;
                 VkSwapchainKHR oldSwapchain = sc.swapchain;
-                VkPresentModeKHR presentMode = app.bImmediatePresentation ?
-                                               VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR;
                 VkResult createSwapcainRes = Swapchain_Create(sc, vkr.physicalDevice, vkr.device, app.windowSize, presentMode);
                 VK_CHECK(createSwapcainRes);
                 if (sc.imageCount > lengthof(swapchainRenderables)) {
                     return 1;
                 }
 
+                /* Only the swapchain and what references its images is replaced, the old ones are retired, not waited on. */
                 if (oldSwapchain) {
-                    vkDeviceWaitIdle(vkr.device);
-                    DestroySwapchainRenderables(vkr.device, swapchainRenderables, oldNumImages);
-                    vkDestroySwapchainKHR(vkr.device, oldSwapchain, nullptr);
+                    if (numRetiredSwapchains == lengthof(retiredSwapchains)) {
+                        vkDeviceWaitIdle(vkr.device);
+                        numRetiredSwapchains = ReleaseRetiredSwapchains(vkr.device, retiredSwapchains, numRetiredSwapchains,
+                                                                        frameCounter, true);
+                    }
+                    RetiredSwapchain& retired = retiredSwapchains[numRetiredSwapchains++];
+                    retired.swapchain = oldSwapchain;
+                    retired.imageCount = oldNumImages;
+                    retired.retireFrame = frameCounter;
+                    for (unsigned i = 0; i < oldNumImages; ++i) {
+                        retired.renderables[i] = swapchainRenderables[i];
+                    }
+                    retired.targets = { };
                 }
 
-                CreateSwapchainRenderables(vkr.device, swapchainRenderables, sc, renderPass);
+                if (GetRenderTargetExtent(sc) != targets.extent) {
+                    if (oldSwapchain) {
+                        retiredSwapchains[numRetiredSwapchains - 1].targets = targets;
+                    }
+                    VK_CHECK(RenderTargets_Create(targets, vkr, GetRenderTargetExtent(sc), sc.format, depthFormat,
+                                                  samples, bOffscreen));
+                }
+                CreateSwapchainRenderables(vkr.device, swapchainRenderables, sc, renderPass, targets);
             }
 
-            os_tick_t const updateBeginTicks = OS_GetTicks();
-            float elapsedSecs = float(updateBeginTicks - AppBeginTicks) * SecsPerTickF32;
-            float t = Mod(elapsedSecs*0.25, 2.0f);
-            t = t < 1.0f ? t : 2.0f - t;
-            t = SmoothPoly3(t);
-            float c = t * 0.25f;
-            VkClearValue clearValue = { VkClearColorValue{ c, c, c, 1 } };
+            os_tick_t const frameBeginTicks = OS_GetTicks();
 
             unsigned const pfi = frameCounter % PERFRAME_CAPACITY;
 
@@ -499,11 +1025,65 @@ int main(int argc, char **argv)
                 VK_CHECK(vkDeviceWaitIdle(vkr.device));
             }
 
+            numRetiredSwapchains = ReleaseRetiredSwapchains(vkr.device, retiredSwapchains, numRetiredSwapchains,
+                                                            frameCounter, false);
+            {   /* Waiting on this slot means frame (frameCounter - PERFRAME_CAPACITY) and those before it are done,
+                   waiting idle means all of them. */
+                uint32_t const completedFrames = !useFences ? frameCounter
+                                               : frameCounter + 1 >= PERFRAME_CAPACITY ? frameCounter + 1 - PERFRAME_CAPACITY : 0;
+                Res_Collect(resources, vkr.device, completedFrames);
+                Res_BeginFrame(resources, frameCounter);
+            }
+            MemBudget_Sample(memBudget, vkr);
+
+            {   /* The frame previously submitted from this slot is complete, collect its timings. */
+                os_tick_t const fenceReturnTicks = OS_GetTicks();
+                float gpuSecs;
+                bool const hasGpuTime = GpuTimer_GetSlotSecs(gpuTimer, vkr.device, pfi, &gpuSecs);
+                GpuStats_ReadSlot(gpuStats, vkr.device, pfi);
+                DynRes_RetireSlot(dynRes, pfi, gpuSecs, hasGpuTime);
+                os_tick_t const gpuDoneTicks = FramePacer_RetireFrame(pacer, perframe[pfi].submitTicks, fenceReturnTicks,
+                                                                      gpuSecs, hasGpuTime);
+                if (hasGpuTime) {
+                    Hud_AddSample(hud, HudGraph_Gpu, gpuSecs);
+                }
+                if (hasGpuTime && regress.bActive) {
+                    Regress_AddGpuTime(regress, gpuSecs);
+                }
+                if (perframe[pfi].inputEventTicks) {
+                    float const latencySecs = FramePacer_AddLatencySample(pacer, perframe[pfi].inputEventTicks, gpuDoneTicks);
+                    printf("input-to-present: %.2f ms (avg %.2f ms), low latency: %d\n",
+                           latencySecs * 1000, pacer.latencySecsAvg * 1000, int(pacer.enabled));
+                    perframe[pfi].inputEventTicks = 0;
+                }
+                Particles_RetireSlot(particles, vkr.device, pfi);
+                TextureStreamer_RetireSlot(textures, vkr.device, pfi);
+                FrameCapture_RetireSlot(capture, pfi);
+                FrameArena_ResetSlot(frameArenas, pfi);
+            }
+            /*  The render thread's scratch for this frame. The submit's and present's arrays come from it first,
+                sized for the main swapchain and the extra outputs.
+            */
+            LinearArena& frameScratch = FrameArena_Get(frameArenas, pfi, 0);
+            uint32_t const maxSwapchains = 1 + outputs.count;
+            VkSemaphore *const waitSemas = Arena_PushArray<VkSemaphore>(frameScratch, maxSwapchains);
+            VkPipelineStageFlags *const waitDstStageMasks = Arena_PushArray<VkPipelineStageFlags>(frameScratch,
+                                                                                                 maxSwapchains);
+            VkSwapchainKHR *const presentSwapchains = Arena_PushArray<VkSwapchainKHR>(frameScratch, maxSwapchains);
+            uint32_t *const presentImageIndices = Arena_PushArray<uint32_t>(frameScratch, maxSwapchains);
+            VkResult *const presentResults = Arena_PushArrayZero<VkResult>(frameScratch, maxSwapchains);
+            if (!waitSemas || !waitDstStageMasks || !presentSwapchains || !presentImageIndices || !presentResults) {
+                puts("frame arena: no room for the submit");
+                mainReturnCode = 1;
+                break;
+            }
+
             /*  The sync objects aren't waited on here, they are signaled when the returned imageIndex is ready.
                 wait operation on binary semaphore resets it to unsignaled.
                 This call is blocking, so it may be best to call it as late as possible.
             */
             uint32_t imageIndex;
+            os_tick_t const acquireBeginTicks = OS_GetTicks();
             VkResult const acquireImageResult =
                 vkAcquireNextImageKHR(vkr.device, sc.swapchain, uint64_t(-1),
                                       perframe[pfi].swapchainImageAcquireSema, nullptr, &imageIndex);
@@ -514,7 +1094,45 @@ int main(int argc, char **argv)
                 printf("vkAcquireNextImageKHR returned %u\n", acquireImageResult);
                 break;
             }
+            /* The extra outputs' images too, the one submit waits on all of them. */
+            waitSemas[0] = perframe[pfi].swapchainImageAcquireSema;
+            uint32_t const waitCount = 1 + MultiOut_Acquire(outputs, vkr, pfi, app.presentPolicy,
+                                                            app.adaptivePresent.bBeatsRefresh, waitSemas + 1,
+                                                            waitDstStageMasks + 1);
+            Hud_AddSample(hud, HudGraph_Acquire, float(OS_GetTicks() - acquireBeginTicks) * SecsPerTickF32);
+
+            /*  Input and time are sampled after the blocking calls above, not at the top of the loop,
+                so they are as fresh as possible. Low latency mode goes further and also sleeps until just
+                before the GPU can start this frame, then pumps messages again.
+                A resize picked up here is handled next iteration, so render with the swapchain's extent.
+            */
+            pacer.enabled = app.bLowLatency;
+            if (pacer.enabled) {
+                FramePacer_WaitForFrameStart(pacer);
+                Window_DispatchMessagesNonblocking();
+            }
 
+            os_tick_t const updateBeginTicks = OS_GetTicks();
+            perframe[pfi].inputEventTicks = app.pendingInputTicks;
+            app.pendingInputTicks = 0;
+
+            float elapsedSecs = float(updateBeginTicks - AppBeginTicks) * SecsPerTickF32;
+            float dtSecs = Min(float(updateBeginTicks - lastUpdateTicks) * SecsPerTickF32, 0.1f); // clamp hitches
+            if (regress.bActive) {
+                /* Every run draws the same frames. */
+                elapsedSecs = Regress_GetClockSecs(regress);
+                dtSecs = REGRESS_FRAME_SECS;
+            }
+            lastUpdateTicks = updateBeginTicks;
+            float t = Mod(elapsedSecs*0.25, 2.0f);
+            t = t < 1.0f ? t : 2.0f - t;
+            t = SmoothPoly3(t);
+            float c = t * 0.25f;
+            VkClearValue clearValues[2];
+            clearValues[0].color = VkClearColorValue{ c, c, c, 1 };
+            clearValues[1].depthStencil = { 1.0f, 0 };
+
+            bool const bTraceFrame = Trace_BeginFrame(frameCounter);
             VkCommandPool commandPool = perframe[pfi].commandPool;
             VK_CHECK(vkResetCommandPool(vkr.device, commandPool, 0));
             VkCommandBuffer commandBuffer = perframe[pfi].commandBuffer;
@@ -524,85 +1142,364 @@ int main(int argc, char **argv)
 
             VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
-            VkRect2D const renderRect = { {0, 0}, app.windowSize };
+            GpuTimer_CmdBegin(gpuTimer, commandBuffer, pfi);
+            GpuStats_CmdBeginFrame(gpuStats, commandBuffer, pfi);
+
+            /* The compute output replaces the whole render pass, nothing that draws in it runs. */
+            bool const bComputeFrame = app.bComputeOut;
 
-            VkRenderPassBeginInfo rp_begin = {
-                VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
-                renderPass,
-                swapchainRenderables[imageIndex].framebuffer,
-                renderRect,
-                1, &clearValue // array of VkClearValue, indexed by attatchment indicies
+            if (app.bParticles && !particles.capacity && app.particleCapacity) {
+                if (!Particles_Create(particles, vkr, renderPass, samples, app.particleCapacity, PERFRAME_CAPACITY)) {
+                    puts("particles unavailable");
+                    app.particleCapacity = 0; // don't retry every frame
+                }
+            }
+            bool const bDrawParticles = app.bParticles && particles.capacity && !bComputeFrame;
+            if (bDrawParticles) {
+                vec2f const emitter = mat2_rotation_tau(elapsedSecs * 0.2f, 0.5f).c0;
+                GpuStats_CmdBegin(gpuStats, commandBuffer, "particle sim");
+                Particles_CmdSimulate(particles, commandBuffer, pfi, dtSecs, emitter);
+                GpuStats_CmdEnd(gpuStats, commandBuffer);
+            }
+
+            /* With dynamic resolution the pass renders into a scaled corner of the offscreen image. Sprites and the
+               HUD are laid out in output pixels, the viewport scales them down with the rest. The regression run
+               renders all of its fixed-size offscreen image, and lays them out in its pixels. */
+            bool const bDynResFrame = app.bDynRes && !bComputeFrame;
+            bool const bOffscreenFrame = bOffscreen && !bComputeFrame;
+            /* The stage of the first command that touches the acquired image, the submit waits on it there. */
+            VkPipelineStageFlagBits const acquireWaitStage = bComputeFrame ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                           : bOffscreenFrame ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                                                           : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            VkExtent2D const outputExtent = sc.lastCreatedExtent;
+            VkExtent2D const passExtent = regress.bActive ? targets.extent : outputExtent;
+            VkRect2D const renderRect = {
+                {0, 0}, bDynResFrame ? DynRes_BeginFrame(dynRes, pfi, outputExtent) : passExtent
             };
-            // We will add draw commands in the same command buffer.
-            vkCmdBeginRenderPass(commandBuffer, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
 
-            // Bind the graphics pipeline.
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso);
+            bool const bDrawSprites = sprites.capacity != 0 && !bComputeFrame;
+            if (bDrawSprites) {
+                /* This slot's part of the sprite buffer was last read by the frame waited on above. */
+                os_tick_t const fillBeginTicks = OS_GetTicks();
+                Sprites_Begin(sprites);
+                SpriteFillArgs fill = { &sprites, 0, elapsedSecs, passExtent };
+                uint32_t const n = Min(app.spriteCount, sprites.capacity);
+                fill.first = Sprites_Reserve(sprites, n);
+                Jobs_ParallelFor(jobs, n, 4096, FillSpritesJob, &fill);
+                os_tick_t const sortBeginTicks = OS_GetTicks();
+                Sprites_Prepare(sprites, jobs, pfi, frameScratch);
+                os_tick_t const sortEndTicks = OS_GetTicks();
+
+                float const fillSecs = float(sortBeginTicks - fillBeginTicks) * SecsPerTickF32;
+                float const sortSecs = float(sortEndTicks - sortBeginTicks) * SecsPerTickF32;
+                float const K = 16.0f;
+                spriteFillSecsAvg = spriteFrames ? spriteFillSecsAvg * ((K-1) / K) + fillSecs * (1 / K) : fillSecs;
+                spriteSortSecsAvg = spriteFrames ? spriteSortSecsAvg * ((K-1) / K) + sortSecs * (1 / K) : sortSecs;
+                spriteFillSecsSum += fillSecs;
+                spriteSortSecsSum += sortSecs;
+                ++spriteFrames;
+            }
+
+            bool const bDrawMesh = mesh.indexCount && app.bDrawMesh && !bComputeFrame;
+            if (bDrawMesh) {
+                /* The mesh is scaled to 0.45 of the viewport height, want the texture about that size. */
+                TextureStreamer_SetWantedSize(textures, meshTexture,
+                                              uint32_t(0.45f * float(renderRect.extent.height)) >> (app.memoryHeapsOver ? 2 : 0));
+                TextureStreamer_CmdUpdate(textures, vkr, commandBuffer, pfi);
+                MeshPipeline_SetTexture(meshPipeline, vkr.device, pfi, TextureStreamer_GetView(textures, meshTexture),
+                                        textures.sampler);
+            }
+
+            if (app.bHud && !hud.pipeline && !Hud_Create(hud, vkr, renderPass, samples, PERFRAME_CAPACITY)) {
+                puts("HUD unavailable");
+                app.bHud = false;
+            }
+            bool const bDrawHud = app.bHud && hud.pipeline && !bComputeFrame;
+            if (bDrawHud) {
+                /* Last frame's numbers, this one's are still being made. */
+                os_tick_t const hudBeginTicks = OS_GetTicks();
+                static const struct { HudGraph graph; const char *name; uint32_t color; } HudLines[] = {
+                    { HudGraph_Cpu, "cpu", 0xFF50C8FFu },
+                    { HudGraph_Gpu, "gpu", 0xFF50FF50u },
+                    { HudGraph_Acquire, "acquire", 0xFFFFA050u },
+                    { HudGraph_Present, "present", 0xFFFF50FFu },
+                };
+                int const x = 8, graphWidth = 256, graphHeight = 32;
+                int y = 8;
+                Hud_Begin(hud, pfi);
+                Hud_Text(hud, x, y, 0xFFFFFFFFu, "%.0f fps, %s, msaa %ux, hud %.3f ms",
+                         frameDurationAvgSecs > 0.0f ? 1.0f / frameDurationAvgSecs : 0.0f,
+                         PresentMode_Name(sc.presentMode), uint(samples), hudSecsAvg * 1000);
+                y += HUD_LINE_HEIGHT;
+                for (const auto& line : HudLines) {
+                    float avgSecs, maxSecs;
+                    Hud_GetStats(hud, line.graph, &avgSecs, &maxSecs);
+                    Hud_Text(hud, x, y, line.color, "%-8s%6.2f ms, max %6.2f", line.name, avgSecs * 1000, maxSecs * 1000);
+                    y += HUD_LINE_HEIGHT;
+                }
+                for (const auto& line : HudLines) {
+                    Hud_Graph(hud, line.graph, x, y, graphWidth, graphHeight, 1.0f / 30, line.color); // half is 60 Hz
+                    y += graphHeight + 4;
+                }
+                /* Fragment shader invocations per pixel of the frame is roughly the overdraw. */
+                float const pixels = float(renderRect.extent.width) * float(renderRect.extent.height);
+                for (uint32_t i = 0; i < gpuStats.scopeCount; ++i) {
+                    const uint64_t *v = gpuStats.scopes[i].values;
+                    Hud_Text(hud, x, y, 0xFFC0C0C0u, "%-12s vs %7.1fk clip %7.1fk/%7.1fk fs %8.1fk (%.2f/px) cs %7.1fk",
+                             gpuStats.scopes[i].name, v[GpuStat_VsInvocations] * 1e-3, v[GpuStat_ClipInvocations] * 1e-3,
+                             v[GpuStat_ClipPrimitives] * 1e-3, v[GpuStat_FsInvocations] * 1e-3,
+                             float(v[GpuStat_FsInvocations]) / pixels, v[GpuStat_CsInvocations] * 1e-3);
+                    y += HUD_LINE_HEIGHT;
+                }
+                Hud_CmdUpload(hud, commandBuffer);
+                float const K = 16.0f;
+                hudSecsAvg = hudSecsAvg * ((K-1) / K) + float(OS_GetTicks() - hudBeginTicks) * SecsPerTickF32 * (1 / K);
+            }
 
-            VkViewport vp = { 0, 0, float(app.windowSize.width), float(app.windowSize.height), 0.0f, 1.0f };
-            vkCmdSetViewport(commandBuffer, 0, 1, &vp); // first, count
-            vkCmdSetScissor(commandBuffer, 0, 1, &renderRect); // first, count
+            if (!bOffscreenFrame) {
+                GpuTimer_CmdAcquireWait(gpuTimer, commandBuffer, pfi, acquireWaitStage);
+            }
+            if (bComputeFrame) {
+                GpuStats_CmdBegin(gpuStats, commandBuffer, "compute out");
+                ComputeOut_CmdDispatch(computeOut, vkr.device, commandBuffer, pfi, sc.images[imageIndex],
+                                       swapchainRenderables[imageIndex].storageView, outputExtent, elapsedSecs);
+                GpuStats_CmdEnd(gpuStats, commandBuffer);
+            } else {
+                VkRenderPassBeginInfo rp_begin = {
+                    VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
+                    renderPass,
+                    swapchainRenderables[imageIndex].framebuffer,
+                    renderRect,
+                    lengthof(clearValues), clearValues // array of VkClearValue, indexed by attatchment indicies, the resolve doesn't need one
+                };
+                // We will add draw commands in the same command buffer.
+                vkCmdBeginRenderPass(commandBuffer, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+
+                /* Everything drawn in the pass goes through the encoder, what's above recorded directly doesn't matter
+                   to it since it starts knowing nothing. */
+                CmdEncoder_Begin(encoder, commandBuffer);
+
+                // Bind the graphics pipeline.
+                CmdEncoder_BindPipeline(encoder, VK_PIPELINE_BIND_POINT_GRAPHICS, Res_Pipeline(resources, pso));
+
+                VkViewport vp = { 0, 0, float(renderRect.extent.width), float(renderRect.extent.height), 0.0f, 1.0f };
+                CmdEncoder_SetViewport(encoder, vp);
+                CmdEncoder_SetScissor(encoder, renderRect);
+
+                mat2f const R = mat2_rotation_tau(t);
+
+                PushConstants pcData;
+                pcData.m.xy = R.c0;
+                pcData.m.zw = R.c1; // perp(c0)
+                pcData.translation = { t - 0.5f, 0 };
+                GpuStats_CmdBegin(gpuStats, commandBuffer, "triangles");
+                CmdEncoder_PushConstants(encoder, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pcData, &pcData);
+                CmdEncoder_Draw(encoder, 3, 1, 0, 0); // Draw three vertices with one instance.
+                pcData.m.x *= -1;
+                pcData.m.y *= -1;
+                pcData.translation = { 0, t - 0.5f };
+                CmdEncoder_PushConstants(encoder, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pcData, &pcData);
+                CmdEncoder_Draw(encoder, 3, 1, 0, 0); // Draw three vertices with one instance.
+                GpuStats_CmdEnd(gpuStats, commandBuffer);
+
+                if (bDrawMesh) {
+                    /* Spin around a tilted axis, fit the bounding sphere into the middle of the depth range. */
+                    float const aspect = float(renderRect.extent.height) / float(renderRect.extent.width);
+                    mat4f aspectScale = mat4_identity();
+                    aspectScale.c[0].x = aspect;
+                    mat4f const model = mat4_trs({ 0, 0, 0.5f }, quat_from_axis_tau({ 0.6f, 0.8f, 0 }, elapsedSecs * 0.1f),
+                                                 0.45f / Mesh_GetRadius(mesh));
+                    mat4f const recenter = mat4_trs(Mesh_GetCenter(mesh) * -1.0f, quat_identity(), 1.0f);
+                    GpuStats_CmdBegin(gpuStats, commandBuffer, "mesh");
+                    Mesh_CmdDraw(mesh, meshPipeline, encoder, pfi, mul(aspectScale, mul(model, recenter)));
+                    GpuStats_CmdEnd(gpuStats, commandBuffer);
+                }
 
-            vec2f const U = cos_sin_tau(t);
+                if (bDrawParticles) {
+                    GpuStats_CmdBegin(gpuStats, commandBuffer, "particles");
+                    Particles_CmdDraw(particles, encoder);
+                    GpuStats_CmdEnd(gpuStats, commandBuffer);
+                }
 
-            PushConstants pcData;
-            pcData.m.xy = U;
-            pcData.m.zw = { -U.y, U.x }; // CCW perpendicular == (UnitZ cross {U.x, U.y, 0}).xy
-            pcData.translation = { t - 0.5f, 0 };
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pcData, &pcData);
-            vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Draw three vertices with one instance.
-            pcData.m.x *= -1;
-            pcData.m.y *= -1;
-            pcData.translation = { 0, t - 0.5f };
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pcData, &pcData);
-            vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Draw three vertices with one instance.
+                if (bDrawSprites) {
+                    GpuStats_CmdBegin(gpuStats, commandBuffer, "sprites");
+                    Sprites_CmdDraw(sprites, encoder, passExtent);
+                    GpuStats_CmdEnd(gpuStats, commandBuffer);
+                }
 
-            // Complete render pass, changes image layout to PRESENT_SRC
-            vkCmdEndRenderPass(commandBuffer);
+                if (bDrawHud) {
+                    GpuStats_CmdBegin(gpuStats, commandBuffer, "hud");
+                    Hud_CmdDraw(hud, encoder, passExtent);
+                    GpuStats_CmdEnd(gpuStats, commandBuffer);
+                }
+
+                // Complete render pass, changes image layout to PRESENT_SRC (COLOR_ATTACHMENT_OPTIMAL offscreen)
+                vkCmdEndRenderPass(commandBuffer);
+
+                if (regress.bActive) {
+                    /* Captured at the fixed size, before it's scaled to the window. */
+                    if (Regress_IsCaptureFrame(regress)) {
+                        FrameCapture_RequestCallback(capture, Regress_OnCapture, Regress_GetCaptureUser(regress));
+                    }
+                    FrameCapture_CmdCapture(capture, vkr, commandBuffer, pfi, targets.offscreenImage,
+                                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, passExtent);
+                }
+                if (bOffscreenFrame) {
+                    GpuTimer_CmdAcquireWait(gpuTimer, commandBuffer, pfi, acquireWaitStage);
+                    DynRes_CmdBlit(commandBuffer, targets.offscreenImage, renderRect.extent, sc.images[imageIndex],
+                                   outputExtent, dynResFilter);
+                }
+            }
+
+            if (!regress.bActive) {
+                FrameCapture_CmdCapture(capture, vkr, commandBuffer, pfi, sc.images[imageIndex],
+                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, outputExtent);
+            }
+            MultiOut_CmdBlit(outputs, commandBuffer, sc.images[imageIndex], outputExtent);
+
+            GpuTimer_CmdEnd(gpuTimer, commandBuffer, pfi);
 
             VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
             /* Wait on the semaphore to be signaled before executing this stage: */
-            VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            waitDstStageMasks[0] = acquireWaitStage;
 
             VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-            submitInfo.waitSemaphoreCount = 1;
-            submitInfo.pWaitSemaphores = &perframe[pfi].swapchainImageAcquireSema;
-            submitInfo.pWaitDstStageMask = &waitDstStageMask;
+            submitInfo.waitSemaphoreCount = waitCount;
+            submitInfo.pWaitSemaphores = waitSemas;
+            submitInfo.pWaitDstStageMask = waitDstStageMasks;
             submitInfo.commandBufferCount = 1;
             submitInfo.pCommandBuffers = &commandBuffer;
             submitInfo.signalSemaphoreCount = 1;
             submitInfo.pSignalSemaphores = &perframe[pfi].swapchainImageReleaseSema;
 
+            os_tick_t const submitBeginTicks = OS_GetTicks();
             vkQueueSubmit(vkr.universalQueue0, 1, &submitInfo, useFences ? perframe[pfi].fence : nullptr);
 
+            perframe[pfi].submitTicks = OS_GetTicks();
+            Hud_AddSample(hud, HudGraph_Cpu, float(perframe[pfi].submitTicks - updateBeginTicks) * SecsPerTickF32);
+            if (regress.bActive) {
+                Regress_EndFrame(regress, float(perframe[pfi].submitTicks - updateBeginTicks) * SecsPerTickF32,
+                                 float(perframe[pfi].submitTicks - submitBeginTicks) * SecsPerTickF32);
+            }
+            FramePacer_OnSubmit(pacer, updateBeginTicks, perframe[pfi].submitTicks);
+            if (bTraceFrame) {
+                Trace_EndFrame(); // writes the file, after the frame's timing
+            }
+
+            if (app.presentPolicy == present_policy::adaptive && app.refreshSecs > 0.0f) {
+                float const workSecs = Max(pacer.cpuSecsAvg, pacer.gpuSecsAvg);
+                if (AdaptivePresent_Update(app.adaptivePresent, workSecs, app.refreshSecs)) {
+                    printf("adaptive present: frame work %.2f ms %s refresh interval %.2f ms\n", workSecs * 1000,
+                           app.adaptivePresent.bBeatsRefresh ? "beats" : "misses", app.refreshSecs * 1000);
+                }
+            }
+
+            /* Every swapchain acquired this frame in one present, they all wait on the one release semaphore. */
+            presentSwapchains[0] = sc.swapchain;
+            presentImageIndices[0] = imageIndex;
             VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
             presentInfo.waitSemaphoreCount = 1;
             presentInfo.pWaitSemaphores = &perframe[pfi].swapchainImageReleaseSema;
-            presentInfo.swapchainCount = 1;
-            presentInfo.pSwapchains = &sc.swapchain;
-            presentInfo.pImageIndices = &imageIndex;
-
-            VK_CHECK(vkQueuePresentKHR(vkr.universalQueue0, &presentInfo));
+            presentInfo.swapchainCount = 1 + MultiOut_GetPresents(outputs, presentSwapchains + 1,
+                                                                  presentImageIndices + 1);
+            presentInfo.pSwapchains = presentSwapchains;
+            presentInfo.pImageIndices = presentImageIndices;
+            presentInfo.pResults = presentResults;
+
+            os_tick_t const presentBeginTicks = OS_GetTicks();
+            /*  The return value is the worst of all the swapchains' results, so an extra output's error would
+                show up in it too. Only the main swapchain's own result, or an error that isn't about any one
+                swapchain, ends the loop, the outputs deal with theirs.
+            */
+            VkResult const presentResult = vkQueuePresentKHR(vkr.universalQueue0, &presentInfo);
+            bool const bDeviceError = presentResult == VK_ERROR_DEVICE_LOST ||
+                                      presentResult == VK_ERROR_OUT_OF_HOST_MEMORY ||
+                                      presentResult == VK_ERROR_OUT_OF_DEVICE_MEMORY;
+            VkResult const mainResult = bDeviceError ? presentResult : presentResults[0];
+            MultiOut_OnPresented(outputs, presentResults + 1);
+            if (mainResult < 0 && mainResult != VK_ERROR_OUT_OF_DATE_KHR) {
+                printf("vkQueuePresentKHR returned %d\n", mainResult);
+                break;
+            }
+            Hud_AddSample(hud, HudGraph_Present, float(OS_GetTicks() - presentBeginTicks) * SecsPerTickF32);
 
             os_tick_t nowTicks = OS_GetTicks();
             float const K = 16.0f;
-            float const thisDurationSecs = (nowTicks - updateBeginTicks) * SecsPerTickF32;
+            float const thisDurationSecs = (nowTicks - frameBeginTicks) * SecsPerTickF32;
             frameDurationAvgSecs = frameDurationAvgSecs * ((K-1) / K) + thisDurationSecs * (1 / K);
             /* Update the title roughly at second intervals: */
             if (nowTicks - lastTitleTicks > TicksPerSecI64) {
                 lastTitleTicks = nowTicks;
-                char buf[120];
-                sprintf(buf, "vsync: %c, ms: %f", unsigned(app.bImmediatePresentation)^'1', frameDurationAvgSecs * 1000);
+                if (int hz = Window_GetRefreshRateHz(window)) { // the window may have moved to another monitor
+                    app.refreshSecs = 1.0f / float(hz);
+                }
+                char buf[512];
+                int len = sprintf(buf, "present: %s (%s), ms: %f, low latency: %c, input-to-present ms: %.2f, MSAA: %ux",
+                                  PresentPolicy_Name(app.presentPolicy), PresentMode_Name(sc.presentMode),
+                                  frameDurationAvgSecs * 1000, '0'+int(pacer.enabled), pacer.latencySecsLast * 1000,
+                                  uint(samples));
+                len += sprintf(buf + len, ", state cmds: %u sent, %u filtered", CmdEncoder_GetEmittedStateCount(encoder),
+                               CmdEncoder_GetFilteredStateCount(encoder));
+                CmdEncoder_ResetStats(encoder);
+                if (bDrawParticles) {
+                    len += sprintf(buf + len, ", particles: %u, sim ms: %.3f, particles/ms: %.0f",
+                                   particles.aliveCount, particles.simSecsAvg * 1000, particles.particlesPerMs);
+                }
+                if (bDrawSprites) {
+                    len += sprintf(buf + len, ", sprites: %u in %u draws, fill ms: %.2f, sort ms: %.2f",
+                                   sprites.preparedCount, sprites.batchCount, spriteFillSecsAvg * 1000,
+                                   spriteSortSecsAvg * 1000);
+                }
+                if (bDynResFrame) {
+                    len += sprintf(buf + len, ", dynres: %ux%u (%.0f%%), %u changes", renderRect.extent.width,
+                                   renderRect.extent.height, dynRes.scale * 100, dynRes.changes);
+                }
+                len += sprintf(buf + len, ", mem MiB: %u of %u", uint(memBudget.usage[memBudget.mainHeap] >> 20),
+                               uint(memBudget.budget[memBudget.mainHeap] >> 20));
+                if (mesh.indexCount) {
+                    sprintf(buf + len, ", texture KiB: %u resident, %u uploaded last frame",
+                            uint(textures.residentBytes >> 10), uint(textures.uploadedBytesLastFrame >> 10));
+                }
                 Window_SetTitle(window, buf);
             }
         } // end main loop
 
         vkDeviceWaitIdle(vkr.device);
 
+        MemBudget_Print(memBudget);
+        MemBudget_Finish(memBudget);
+        ReleaseRetiredSwapchains(vkr.device, retiredSwapchains, numRetiredSwapchains, 0, true);
+        MultiOut_Destroy(outputs, vkr);
         DestroySwapchainRenderables(vkr.device, swapchainRenderables, sc.imageCount);
-        vkDestroyPipeline(vkr.device, pso, nullptr);
+        RenderTargets_Destroy(targets, vkr.device);
+        GpuTimer_Destroy(gpuTimer, vkr.device);
+        GpuStats_Print(gpuStats);
+        GpuStats_Destroy(gpuStats, vkr.device);
+        ComputeOut_Destroy(computeOut, vkr.device);
+        Particles_Destroy(particles, vkr.device);
+        if (spriteFrames) {
+            printf("sprites: %u per frame, %u frames, fill %.3f ms, sort %.3f ms, GPU frame %.3f ms (recent)\n",
+                   sprites.preparedCount, spriteFrames, spriteFillSecsSum * 1000 / spriteFrames,
+                   spriteSortSecsSum * 1000 / spriteFrames, pacer.gpuSecsAvg * 1000);
+        }
+        Sprites_Destroy(sprites, vkr.device);
+        Hud_Destroy(hud, vkr.device);
+        MeshPipeline_Destroy(meshPipeline, vkr.device);
+        TextureStreamer_Destroy(textures, vkr.device);
+        FrameCapture_Destroy(capture, vkr.device);
+        Jobs_Destroy(jobs);
+        FrameArena_PrintReport(frameArenas);
+        FrameArena_Destroy(frameArenas);
+        if (regress.bActive && mainReturnCode == 0) {
+            mainReturnCode = Regress_Finish(regress); // the captures are all compared now
+        }
+        Mesh_Destroy(mesh, vkr.device);
+        Res_PrintReport(resources);
+        Res_Destroy(resources, vkr.device);
         vkDestroyPipelineLayout(vkr.device, pipelineLayout, nullptr);
+        vkDestroyShaderModule(vkr.device, helloFS, nullptr);
+        vkDestroyShaderModule(vkr.device, helloVS, nullptr);
         vkDestroyRenderPass(vkr.device, renderPass, nullptr);
 
         for (PerframeObjects& pf : perframe) {
@@ -618,6 +1515,7 @@ int main(int argc, char **argv)
 L_destroy_surface_and_swapchain:
     Swapchain_DestroySwapchainAndSurface(sc, vkr.instance, vkr.device);
 L_destroy_vkcore:
+    Trace_Uninstall(vkr.device);
     VKR_Destruct(vkr);
     WindowWin32_Destroy(window);
     return mainReturnCode;
@@ -11,7 +11,10 @@
 
     Can also compile glsl at runtime.
 */
-#include <stdint.h>
+#include "shaders.h"
+
+#include <stdio.h>
+#include <stdlib.h>
 
 
 /*
@@ -210,3 +213,34 @@ const uint32_t * get_hello_fragment_spirv(size_t *pBytesize)
     *pBytesize = sizeof hello_fs_spirv;
     return hello_fs_spirv;
 }
+
+
+uint32_t * load_spirv_file(const char *path, size_t *pBytesize)
+{
+    *pBytesize = 0;
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        printf("can't open %s, was it compiled? see README\n", path);
+        return nullptr;
+    }
+    uint32_t *code = nullptr;
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        size = ftell(f);
+        rewind(f);
+    }
+    if (size >= 20 && size % 4 == 0) { // at least the header
+        code = (uint32_t *)malloc(size);
+        if (code && (fread(code, 1, size, f) != size_t(size) || code[0] != 0x07230203u)) {
+            free(code);
+            code = nullptr;
+        }
+    }
+    fclose(f);
+    if (!code) {
+        printf("%s is not a SPIR-V module\n", path);
+        return nullptr;
+    }
+    *pBytesize = size_t(size);
+    return code;
+}
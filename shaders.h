@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Built in, see shaders.cpp.
+const uint32_t * get_hello_vertex_spirv(size_t *pBytesize);
+const uint32_t * get_hello_fragment_spirv(size_t *pBytesize);
+
+/*  Reads a .spv file compiled from shaders/ (see README), relative to the working directory.
+    Returns null if it can't be read or isn't SPIR-V, else free() the result once the VkShaderModule is made.
+*/
+uint32_t * load_spirv_file(const char *path, size_t *pBytesize);
@@ -0,0 +1,22 @@
+#version 450 core
+
+layout(location = 0) in vec2 glyphTexel;
+layout(location = 1) flat in uint glyph;
+layout(location = 2) in vec4 color;
+
+// R8, 16x4 cells of 4x6 texels, the glyph in the top left 3x5 of its cell.
+layout(set = 0, binding = 1) uniform sampler2D atlas;
+
+layout(location = 0) out vec4 attatchment0;
+
+void main()
+{
+	float coverage = 1.0;
+	if (glyph != 0xFFFFu) {
+		ivec2 cell = ivec2(glyph % 16u, glyph / 16u) * ivec2(4, 6);
+		ivec2 texel = min(ivec2(glyphTexel), ivec2(2, 4));
+		coverage = texelFetch(atlas, cell + texel, 0).r;
+	}
+	if (coverage == 0.0) discard;
+	attatchment0 = vec4(color.rgb, color.a * coverage);
+}
@@ -0,0 +1,36 @@
+#version 450 core
+
+// One instance per quad (glyph, graph bar or panel), pulled from the storage buffer by gl_InstanceIndex,
+// which includes the firstInstance that picks the frame slot. 6 vertices make the quad as in sprites.vert.
+
+// Matches HudQuad in HudOverlay.h.
+struct HudQuad {
+	uint pos; // x | y << 16, pixels from the top left
+	uint size; // w | h << 16
+	uint color; // RGBA8, not premultiplied
+	uint glyph; // atlas cell, 0xFFFF for a solid rect
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Quads { HudQuad quads[]; };
+
+layout(std430, push_constant) uniform PushConstants {
+	vec2 clipScale;
+	vec2 clipOffset;
+} pc;
+
+layout(location = 0) out vec2 glyphTexel; // [0, 3] x [0, 5] across the glyph
+layout(location = 1) flat out uint glyph;
+layout(location = 2) out vec4 color;
+
+void main()
+{
+	HudQuad q = quads[gl_InstanceIndex];
+	uint corner = (0x312210u >> (4 * uint(gl_VertexIndex))) & 3u;
+	vec2 unit = vec2(corner & 1u, corner >> 1);
+
+	vec2 p = vec2(q.pos & 0xFFFFu, q.pos >> 16) + unit * vec2(q.size & 0xFFFFu, q.size >> 16);
+	gl_Position = vec4(p * pc.clipScale + pc.clipOffset, 0, 1);
+	glyphTexel = unit * vec2(3, 5);
+	glyph = q.glyph;
+	color = unpackUnorm4x8(q.color);
+}
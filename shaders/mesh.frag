@@ -0,0 +1,16 @@
+#version 450 core
+
+layout(location = 0) in vec3 normal;
+layout(location = 1) in vec2 uv;
+
+layout(set = 0, binding = 0) uniform sampler2D albedoTex; // 1x1 white if there's no texture
+
+layout(location = 0) out vec4 attatchment0;
+
+void main()
+{
+	vec3 n = normalize(normal);
+	float lambert = max(dot(n, normalize(vec3(0.4, 0.6, -0.7))), 0.0);
+	vec3 albedo = texture(albedoTex, uv).rgb * 0.85;
+	attatchment0 = vec4(albedo * (0.15 + 0.85 * lambert), 1);
+}
@@ -0,0 +1,35 @@
+#version 450 core
+
+// Dequantizes a .vkm vertex (see MeshFormat.h), the UNORM/SNORM/SFLOAT conversions are done by the vertex input.
+
+layout(push_constant) uniform PushConstants {
+	mat4 clipFromModel;
+	vec4 posScale;
+	vec4 posOffset;
+};
+
+layout(location = 0) in vec4 a_pos; // R16G16B16A16_UNORM
+layout(location = 1) in vec2 a_normal; // R8G8_SNORM, octahedral
+layout(location = 2) in vec2 a_uv; // R16G16_SFLOAT
+
+layout(location = 0) out vec3 normal;
+layout(location = 1) out vec2 uv;
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 pos = posOffset.xyz + a_pos.xyz * posScale.xyz;
+	gl_Position = clipFromModel * vec4(pos, 1);
+	/* Good enough for lighting: the model part is a rotation and uniform scale, only the aspect correction
+	   skews the normal a little. */
+	normal = mat3(clipFromModel) * DecodeOctahedral(a_normal);
+	uv = a_uv;
+}
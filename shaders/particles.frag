@@ -0,0 +1,10 @@
+#version 450 core
+
+layout(location = 0) in vec4 color;
+
+layout(location = 0) out vec4 attatchment0;
+
+void main()
+{
+	attatchment0 = color;
+}
@@ -0,0 +1,18 @@
+#version 450 core
+#extension GL_GOOGLE_include_directive : require
+
+// Vertex pulling: no vertex attributes, one point per particle read straight from the storage buffer.
+
+#include "particles_common.glsl"
+
+layout(std430, set = 0, binding = 1) readonly buffer Particles { Particle particles[]; };
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+	Particle p = particles[gl_VertexIndex];
+	gl_Position = vec4(p.pos, 0, 1);
+	gl_PointSize = 1.0;
+	color = unpackUnorm4x8(p.color) * (1.0 - p.age / p.life); // premultiplied, fades out
+}
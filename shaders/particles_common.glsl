@@ -0,0 +1,10 @@
+// Shared by the particle shaders, std430 so 32 bytes per particle (same as struct Particle in Particles.cpp).
+struct Particle {
+	vec2 pos; // clip space
+	vec2 vel;
+	float age;
+	float life;
+	uint color; // unorm RGBA8
+	float pad;
+};
+
@@ -0,0 +1,13 @@
+#version 450 core
+
+layout(location = 0) in vec2 uv;
+layout(location = 1) in vec4 color;
+
+layout(set = 1, binding = 0) uniform sampler2D spriteTex; // premultiplied alpha
+
+layout(location = 0) out vec4 attatchment0;
+
+void main()
+{
+	attatchment0 = texture(spriteTex, uv) * color;
+}
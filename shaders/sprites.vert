@@ -0,0 +1,42 @@
+#version 450 core
+
+// Vertex pulling like hello.vert, but 6 vertices per sprite: gl_VertexIndex / 6 picks the sprite in the storage
+// buffer, gl_VertexIndex % 6 the corner of its two triangles. No vertex or index buffer.
+
+// Matches Sprite in SpriteBatcher.h.
+struct Sprite {
+	vec2 pos; // center, in pixels from the top left
+	vec2 halfSize;
+	float rotation; // radians
+	uint color; // RGBA8, not premultiplied
+	uint uvMin; // UNORM16x2
+	uint uvMax;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Sprites { Sprite sprites[]; };
+
+layout(std430, push_constant) uniform PushConstants {
+	vec2 clipScale; // pixels to clip space: pos * clipScale + clipOffset
+	vec2 clipOffset;
+} pc;
+
+layout(location = 0) out vec2 uv;
+layout(location = 1) out vec4 color;
+
+void main()
+{
+	Sprite s = sprites[gl_VertexIndex / 6];
+
+	// Corners 0,1,2 and 2,1,3 of (x = bit 0, y = bit 1), a nibble each.
+	uint corner = (0x312210u >> (4 * uint(gl_VertexIndex % 6))) & 3u;
+	vec2 unit = vec2(corner & 1u, corner >> 1);
+
+	vec2 cs = vec2(cos(s.rotation), sin(s.rotation));
+	vec2 local = (unit * 2.0 - 1.0) * s.halfSize;
+	vec2 p = s.pos + vec2(local.x * cs.x - local.y * cs.y, local.x * cs.y + local.y * cs.x);
+	gl_Position = vec4(p * pc.clipScale + pc.clipOffset, 0, 1);
+
+	uv = mix(unpackUnorm2x16(s.uvMin), unpackUnorm2x16(s.uvMax), unit);
+	vec4 c = unpackUnorm4x8(s.color);
+	color = vec4(c.rgb * c.a, c.a); // the textures are premultiplied too
+}
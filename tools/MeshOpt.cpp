@@ -0,0 +1,925 @@
+/*
+    meshopt: builds and optimizes .vkm files (see MeshFormat.h) offline, a separate executable from vklab.
+
+        meshopt <in.obj|in.vkm> <out.vkm> [--cache=N] [--threshold=X] [--no-overdraw]
+
+    Three passes, each working on the result of the one before:
+        1. Vertex cache: Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" triangle order.
+        2. Overdraw: split that order into clusters where the cache restarts anyway, and sort the clusters so the
+           outward facing ones are drawn first (Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex
+           Locality and Reduced Overdraw"). --threshold is how much ACMR may be given up for that, 1.05 = 5%.
+        3. Vertex fetch: renumber the vertices in first-use order, so the vertex buffer is read front to back.
+
+    Statistics before and after:
+        ACMR  post-transform cache misses per triangle, FIFO of --cache entries (default 16). 0.5 is the limit.
+        ATVR  misses per vertex, 1.0 is the limit.
+        overfetch  vertex buffer bytes read / vertex buffer size, from a 64 x 64-byte cache line simulation.
+        overdraw  fragments passing the depth test / pixels covered, rasterized from 14 directions, back faces culled.
+
+    Plain C++ and the C library, no Vulkan or Win32, so it builds anywhere.
+*/
+#include "../MeshFormat.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+template<class T> static T *
+Alloc(size_t count)
+{
+    T *p = (T *)malloc(Max(count, size_t(1)) * sizeof(T));
+    if (!p) {
+        puts("out of memory");
+        exit(1);
+    }
+    return p;
+}
+
+template<class T> struct Array {
+    T *data;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+template<class T> static void
+Array_Push(Array<T>& a, const T& v)
+{
+    if (a.count == a.capacity) {
+        a.capacity = Max(a.capacity * 2, 256u);
+        a.data = (T *)realloc(a.data, a.capacity * sizeof(T));
+        if (!a.data) {
+            puts("out of memory");
+            exit(1);
+        }
+    }
+    a.data[a.count++] = v;
+}
+
+struct MeshData {
+    MeshFileVertex *vertices;
+    uint32_t vertexCount;
+    uint32_t *indices;
+    uint32_t indexCount;
+    float boxMin[3], boxMax[3];
+};
+
+static float
+Seconds(clock_t begin)
+{
+    return float(clock() - begin) / float(CLOCKS_PER_SEC);
+}
+
+// NUL terminated.
+static char *
+ReadWholeFile(const char *path, size_t *pSize)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return nullptr;
+    }
+    fseek(f, 0, SEEK_END);
+    long const size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = nullptr;
+    if (size >= 0) {
+        data = Alloc<char>(size_t(size) + 1);
+        if (fread(data, 1, size_t(size), f) != size_t(size)) {
+            free(data);
+            data = nullptr;
+        } else {
+            data[size] = '\0';
+            *pSize = size_t(size);
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+static void
+Normalize3(float v[3])
+{
+    float const len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 0.0f) {
+        v[0] /= len, v[1] /= len, v[2] /= len;
+    } else {
+        v[0] = 0, v[1] = 0, v[2] = 1;
+    }
+}
+
+static void
+Cross3(const float a[3], const float b[3], float out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float
+Dot3(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void
+DecodePositions(const MeshData& m, float *pos)
+{
+    for (uint32_t v = 0; v < m.vertexCount; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            float const scale = Max(m.boxMax[k] - m.boxMin[k], 1e-6f);
+            pos[v * 3 + k] = m.boxMin[k] + float(m.vertices[v].pos[k]) * (1.0f / 65535.0f) * scale;
+        }
+    }
+}
+
+//----- Loading -----
+
+static bool
+LoadVkm(MeshData& m, const char *path)
+{
+    size_t size;
+    char *bytes = ReadWholeFile(path, &size);
+    if (!bytes) {
+        printf("can't read %s\n", path);
+        return false;
+    }
+    MeshFileHeader h = { };
+    memcpy(&h, bytes, Min(size, sizeof h));
+    if (const char *err = MeshFile_Validate(h, size)) {
+        printf("%s: %s\n", path, err);
+        free(bytes);
+        return false;
+    }
+    m.vertexCount = h.vertexCount;
+    m.indexCount = h.indexCount;
+    m.vertices = Alloc<MeshFileVertex>(m.vertexCount);
+    memcpy(m.vertices, bytes + h.vertexDataOffset, size_t(m.vertexCount) * sizeof(MeshFileVertex));
+    m.indices = Alloc<uint32_t>(m.indexCount);
+    for (uint32_t i = 0; i < m.indexCount; ++i) {
+        if (h.indexSize == 2) {
+            uint16_t v;
+            memcpy(&v, bytes + h.indexDataOffset + i * 2, 2);
+            m.indices[i] = v;
+        } else {
+            memcpy(&m.indices[i], bytes + h.indexDataOffset + i * 4, 4);
+        }
+        if (m.indices[i] >= m.vertexCount) {
+            printf("%s: index out of range\n", path);
+            free(bytes);
+            return false;
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        m.boxMin[k] = h.posOffset[k];
+        m.boxMax[k] = h.posOffset[k] + h.posScale[k];
+    }
+    free(bytes);
+    return true;
+}
+
+struct ObjCorner {
+    int p, t, n; // 0-based, -1 if absent
+};
+
+static void
+SkipBlanks(const char *&s)
+{
+    while (*s == ' ' || *s == '\t' || *s == '\r') ++s;
+}
+
+// OBJ indices are 1-based, negative ones count back from the end.
+static bool
+ParseObjIndex(const char *&s, uint32_t count, int *out)
+{
+    char *end;
+    long const i = strtol(s, &end, 10);
+    if (end == s) {
+        return false;
+    }
+    s = end;
+    long const zeroBased = i > 0 ? i - 1 : long(count) + i;
+    if (i == 0 || zeroBased < 0 || zeroBased >= long(count)) {
+        return false;
+    }
+    *out = int(zeroBased);
+    return true;
+}
+
+struct VertexHash {
+    uint32_t *slots; // vertex index, UINT32_MAX if empty
+    uint32_t mask;
+};
+
+static uint32_t
+HashVertex(const MeshFileVertex& v)
+{
+    uint32_t w[4];
+    memcpy(w, &v, sizeof w);
+    uint32_t h = 2166136261u;
+    for (uint32_t x : w) {
+        h = (h ^ x) * 16777619u;
+        h ^= h >> 15;
+    }
+    return h;
+}
+
+/*  Positions are quantized to the bounding box of what the faces use, normals come from the file or are
+    smoothed per position from the face normals, V is flipped (OBJ puts the origin at the bottom left).
+    Corners that quantize to the same vertex are merged.
+*/
+static bool
+LoadObj(MeshData& m, const char *path)
+{
+    size_t size;
+    char *text = ReadWholeFile(path, &size);
+    if (!text) {
+        printf("can't read %s\n", path);
+        return false;
+    }
+
+    Array<float> positions = { }, normals = { }, uvs = { };
+    Array<ObjCorner> corners = { };
+    uint32_t line = 1;
+    bool ok = true;
+    for (const char *s = text; *s && ok; ++line) {
+        SkipBlanks(s);
+        if (s[0] == 'v' && (s[1] == ' ' || s[1] == '\t')) {
+            ++s;
+            for (int k = 0; k < 3; ++k) Array_Push(positions, strtof(s, (char **)&s));
+        } else if (s[0] == 'v' && s[1] == 'n') {
+            s += 2;
+            for (int k = 0; k < 3; ++k) Array_Push(normals, strtof(s, (char **)&s));
+        } else if (s[0] == 'v' && s[1] == 't') {
+            s += 2;
+            float const u = strtof(s, (char **)&s);
+            float const v = strtof(s, (char **)&s);
+            Array_Push(uvs, u);
+            Array_Push(uvs, 1.0f - v);
+        } else if (s[0] == 'f' && (s[1] == ' ' || s[1] == '\t')) {
+            ++s;
+            ObjCorner face[64];
+            uint32_t n = 0;
+            for (;;) {
+                SkipBlanks(s);
+                if (*s == '\n' || *s == '\0' || *s == '#') break;
+                ObjCorner c = { -1, -1, -1 };
+                ok = ParseObjIndex(s, positions.count / 3, &c.p);
+                if (ok && *s == '/') {
+                    ++s;
+                    if (*s != '/') ok = ParseObjIndex(s, uvs.count / 2, &c.t);
+                    if (ok && *s == '/') {
+                        ++s;
+                        ok = ParseObjIndex(s, normals.count / 3, &c.n);
+                    }
+                }
+                if (!ok || n == lengthof(face)) {
+                    ok = false;
+                    break;
+                }
+                face[n++] = c;
+            }
+            for (uint32_t i = 1; ok && i + 1 < n; ++i) { // fan
+                Array_Push(corners, face[0]);
+                Array_Push(corners, face[i]);
+                Array_Push(corners, face[i + 1]);
+            }
+        }
+        while (*s && *s != '\n') ++s; // anything else (o, g, s, usemtl, comments) is ignored
+        if (*s) ++s;
+    }
+    free(text);
+    if (!ok || corners.count == 0) {
+        printf(ok ? "%s: no faces\n" : "%s:%u: bad face\n", path, line - 1);
+        free(positions.data), free(normals.data), free(uvs.data), free(corners.data);
+        return false;
+    }
+
+    uint32_t const positionCount = positions.count / 3;
+    const float *const P = positions.data;
+    float *smooth = nullptr;
+    for (uint32_t i = 0; i < corners.count; ++i) {
+        if (corners.data[i].n < 0) {
+            smooth = Alloc<float>(size_t(positionCount) * 3);
+            memset(smooth, 0, size_t(positionCount) * 3 * sizeof(float));
+            break;
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        m.boxMin[k] = P[corners.data[0].p * 3 + k];
+        m.boxMax[k] = m.boxMin[k];
+    }
+    for (uint32_t i = 0; i < corners.count; i += 3) {
+        const ObjCorner *c = corners.data + i;
+        for (uint32_t j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                m.boxMin[k] = Min(m.boxMin[k], P[c[j].p * 3 + k]);
+                m.boxMax[k] = Max(m.boxMax[k], P[c[j].p * 3 + k]);
+            }
+        }
+        if (smooth) {
+            float e1[3], e2[3], n[3]; // area weighted
+            for (int k = 0; k < 3; ++k) {
+                e1[k] = P[c[1].p * 3 + k] - P[c[0].p * 3 + k];
+                e2[k] = P[c[2].p * 3 + k] - P[c[0].p * 3 + k];
+            }
+            Cross3(e1, e2, n);
+            for (uint32_t j = 0; j < 3; ++j) {
+                for (int k = 0; k < 3; ++k) smooth[c[j].p * 3 + k] += n[k];
+            }
+        }
+    }
+
+    uint32_t tableSize = 1;
+    while (tableSize < corners.count * 2) tableSize *= 2;
+    VertexHash hash = { Alloc<uint32_t>(tableSize), tableSize - 1 };
+    memset(hash.slots, 0xFF, tableSize * sizeof(uint32_t));
+
+    m.vertices = Alloc<MeshFileVertex>(corners.count);
+    m.indices = Alloc<uint32_t>(corners.count);
+    m.vertexCount = 0;
+    m.indexCount = corners.count;
+    for (uint32_t i = 0; i < corners.count; ++i) {
+        ObjCorner const c = corners.data[i];
+        MeshFileVertex v = { };
+        for (int k = 0; k < 3; ++k) {
+            float const extent = Max(m.boxMax[k] - m.boxMin[k], 1e-6f);
+            v.pos[k] = MeshFile_QuantizeUnorm16((P[c.p * 3 + k] - m.boxMin[k]) / extent);
+        }
+        float n[3];
+        memcpy(n, c.n >= 0 ? normals.data + c.n * 3 : smooth + c.p * 3, sizeof n);
+        Normalize3(n);
+        MeshFile_EncodeOctahedral(n, v.normal);
+        if (c.t >= 0) {
+            v.uv[0] = MeshFile_FloatToHalf(uvs.data[c.t * 2]);
+            v.uv[1] = MeshFile_FloatToHalf(uvs.data[c.t * 2 + 1]);
+        }
+
+        uint32_t slot = HashVertex(v) & hash.mask;
+        while (hash.slots[slot] != UINT32_MAX && memcmp(&m.vertices[hash.slots[slot]], &v, sizeof v)) {
+            slot = (slot + 1) & hash.mask;
+        }
+        if (hash.slots[slot] == UINT32_MAX) {
+            hash.slots[slot] = m.vertexCount;
+            m.vertices[m.vertexCount++] = v;
+        }
+        m.indices[i] = hash.slots[slot];
+    }
+
+    free(hash.slots);
+    free(smooth);
+    free(positions.data), free(normals.data), free(uvs.data), free(corners.data);
+    return true;
+}
+
+static bool
+WriteVkm(const MeshData& m, const char *path)
+{
+    MeshFileHeader h;
+    MeshFile_InitHeader(h, m.vertexCount, m.indexCount, m.boxMin, m.boxMax);
+    size_t const fileSize = size_t(MeshFile_GetFileSize(h));
+    ubyte *const bytes = Alloc<ubyte>(fileSize);
+    memset(bytes, 0, fileSize);
+    memcpy(bytes, &h, sizeof h);
+    memcpy(bytes + h.vertexDataOffset, m.vertices, size_t(m.vertexCount) * sizeof(MeshFileVertex));
+    for (uint32_t i = 0; i < m.indexCount; ++i) {
+        if (h.indexSize == 2) {
+            uint16_t const v = uint16_t(m.indices[i]);
+            memcpy(bytes + h.indexDataOffset + i * 2, &v, 2);
+        } else {
+            memcpy(bytes + h.indexDataOffset + i * 4, &m.indices[i], 4);
+        }
+    }
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(bytes, 1, fileSize, f) == fileSize;
+    if (f) {
+        ok = (fclose(f) == 0) && ok;
+    }
+    free(bytes);
+    return ok;
+}
+
+//----- Analysis -----
+
+struct CacheStats {
+    float acmr;
+    float atvr;
+    float overfetch;
+};
+
+#define FETCH_LINE_BYTES 64u
+#define FETCH_CACHE_LINES 64u
+
+/*  FIFO caches with timestamps: an entry is cached if it was inserted less than cacheSize misses ago.
+    Every post-transform miss reads the vertex's cache line, which may itself hit or miss.
+*/
+static CacheStats
+AnalyzeVertexCache(const uint32_t *indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+    uint32_t *const stamp = Alloc<uint32_t>(vertexCount);
+    uint32_t const lineCount = uint32_t((uint64_t(vertexCount) * sizeof(MeshFileVertex) + FETCH_LINE_BYTES - 1) / FETCH_LINE_BYTES);
+    uint32_t *const lineStamp = Alloc<uint32_t>(lineCount);
+    ubyte *const referenced = Alloc<ubyte>(vertexCount);
+    memset(stamp, 0, vertexCount * sizeof(uint32_t));
+    memset(lineStamp, 0, lineCount * sizeof(uint32_t));
+    memset(referenced, 0, vertexCount);
+
+    uint32_t time = cacheSize + 1, lineTime = FETCH_CACHE_LINES + 1;
+    uint32_t misses = 0, lineMisses = 0, uniqueVertices = 0;
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t const v = indices[i];
+        uniqueVertices += referenced[v] ? 0 : 1;
+        referenced[v] = 1;
+        if (time - stamp[v] > cacheSize) {
+            stamp[v] = time++;
+            ++misses;
+            uint32_t const line = uint32_t(uint64_t(v) * sizeof(MeshFileVertex) / FETCH_LINE_BYTES);
+            if (lineTime - lineStamp[line] > FETCH_CACHE_LINES) {
+                lineStamp[line] = lineTime++;
+                ++lineMisses;
+            }
+        }
+    }
+    free(stamp);
+    free(lineStamp);
+    free(referenced);
+
+    CacheStats s;
+    s.acmr = indexCount ? float(misses) / float(indexCount / 3) : 0.0f;
+    s.atvr = uniqueVertices ? float(misses) / float(uniqueVertices) : 0.0f;
+    s.overfetch = uniqueVertices ? float(lineMisses) * FETCH_LINE_BYTES / (float(uniqueVertices) * sizeof(MeshFileVertex)) : 0.0f;
+    return s;
+}
+
+#define OVERDRAW_GRID 256
+
+/*  Orthographic views along the 6 axes and the 8 diagonals, each framing the bounding sphere.
+    Same conventions as vklab: x right, y down, z into the screen, counter-clockwise (in those coordinates,
+    Vulkan's definition) is front facing and back faces are culled, depth test LESS.
+*/
+static float
+AnalyzeOverdraw(const float *pos, const uint32_t *indices, uint32_t indexCount, uint32_t vertexCount,
+                const float boxMin[3], const float boxMax[3])
+{
+    float center[3], radius = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        center[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+        radius += (boxMax[k] - boxMin[k]) * (boxMax[k] - boxMin[k]);
+    }
+    radius = Max(sqrtf(radius) * 0.5f, 1e-6f);
+
+    float *const depth = Alloc<float>(OVERDRAW_GRID * OVERDRAW_GRID);
+    float *const screen = Alloc<float>(size_t(vertexCount) * 3);
+    uint64_t shaded = 0, covered = 0;
+
+    for (int view = 0; view < 14; ++view) {
+        float fwd[3] = { 0, 0, 0 };
+        if (view < 6) {
+            fwd[view >> 1] = (view & 1) ? -1.0f : 1.0f;
+        } else {
+            fwd[0] = (view & 1) ? -1.0f : 1.0f;
+            fwd[1] = (view & 2) ? -1.0f : 1.0f;
+            fwd[2] = (view & 4) ? -1.0f : 1.0f;
+            Normalize3(fwd);
+        }
+        float down[3] = { 0, 1, 0 };
+        if (Abs(fwd[1]) > 0.9f) {
+            down[0] = 1, down[1] = 0;
+        }
+        float const d = Dot3(down, fwd);
+        for (int k = 0; k < 3; ++k) down[k] -= fwd[k] * d;
+        Normalize3(down);
+        float right[3];
+        Cross3(down, fwd, right); // right x down == fwd
+
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            float p[3];
+            for (int k = 0; k < 3; ++k) p[k] = pos[v * 3 + k] - center[k];
+            screen[v * 3 + 0] = (Dot3(p, right) / radius * 0.5f + 0.5f) * OVERDRAW_GRID;
+            screen[v * 3 + 1] = (Dot3(p, down) / radius * 0.5f + 0.5f) * OVERDRAW_GRID;
+            screen[v * 3 + 2] = Dot3(p, fwd);
+        }
+        for (int i = 0; i < OVERDRAW_GRID * OVERDRAW_GRID; ++i) depth[i] = INFINITY;
+
+        for (uint32_t i = 0; i < indexCount; i += 3) {
+            const float *a = screen + indices[i] * 3;
+            const float *b = screen + indices[i + 1] * 3;
+            const float *c = screen + indices[i + 2] * 3;
+            // Twice the signed area in x right, y down coordinates, negative when counter-clockwise on screen.
+            float const area2 = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+            if (area2 >= 0.0f) {
+                continue;
+            }
+            float const inv = 1.0f / area2;
+            int const x0 = Max(int(floorf(Min(a[0], Min(b[0], c[0])))), 0);
+            int const y0 = Max(int(floorf(Min(a[1], Min(b[1], c[1])))), 0);
+            int const x1 = Min(int(ceilf(Max(a[0], Max(b[0], c[0])))), OVERDRAW_GRID - 1);
+            int const y1 = Min(int(ceilf(Max(a[1], Max(b[1], c[1])))), OVERDRAW_GRID - 1);
+            for (int y = y0; y <= y1; ++y) {
+                float const py = float(y) + 0.5f;
+                for (int x = x0; x <= x1; ++x) {
+                    float const px = float(x) + 0.5f;
+                    float const wa = ((c[0] - b[0]) * (py - b[1]) - (c[1] - b[1]) * (px - b[0])) * inv;
+                    float const wb = ((a[0] - c[0]) * (py - c[1]) - (a[1] - c[1]) * (px - c[0])) * inv;
+                    float const wc = 1.0f - wa - wb;
+                    if (wa < 0.0f || wb < 0.0f || wc < 0.0f) {
+                        continue;
+                    }
+                    float const z = wa * a[2] + wb * b[2] + wc * c[2];
+                    float& dst = depth[y * OVERDRAW_GRID + x];
+                    if (z < dst) {
+                        dst = z;
+                        ++shaded;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < OVERDRAW_GRID * OVERDRAW_GRID; ++i) covered += depth[i] < INFINITY ? 1 : 0;
+    }
+    free(depth);
+    free(screen);
+    return covered ? float(double(shaded) / double(covered)) : 0.0f;
+}
+
+//----- Vertex cache -----
+
+/* Forsyth's constants. The scoring models a 32 entry LRU, it does well on FIFO caches of other sizes too. */
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE_SCORE 64
+
+static float s_cachePosScore[FORSYTH_CACHE_SIZE];
+static float s_valenceScore[FORSYTH_MAX_VALENCE_SCORE];
+
+static void
+InitVertexScoreTables()
+{
+    for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+        s_cachePosScore[i] = i < 3 ? 0.75f /* just used, don't favor it */
+                                   : powf(1.0f - float(i - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+    s_valenceScore[0] = 0.0f;
+    for (int i = 1; i < FORSYTH_MAX_VALENCE_SCORE; ++i) {
+        s_valenceScore[i] = 2.0f * powf(float(i), -0.5f); // finish off vertices with few triangles left
+    }
+}
+
+static float
+VertexScore(int cachePos, uint32_t remainingTris)
+{
+    if (remainingTris == 0) {
+        return -1.0f;
+    }
+    float const valence = remainingTris < FORSYTH_MAX_VALENCE_SCORE ? s_valenceScore[remainingTris]
+                                                                    : 2.0f * powf(float(remainingTris), -0.5f);
+    return valence + (cachePos >= 0 ? s_cachePosScore[cachePos] : 0.0f);
+}
+
+static void
+OptimizeVertexCache(uint32_t *dst, const uint32_t *indices, uint32_t indexCount, uint32_t vertexCount)
+{
+    uint32_t const triCount = indexCount / 3;
+
+    // Triangles not yet emitted, per vertex: adjTris[adjOffset[v] .. adjOffset[v] + remaining[v]]
+    uint32_t *const adjOffset = Alloc<uint32_t>(vertexCount + 1);
+    uint32_t *const remaining = Alloc<uint32_t>(vertexCount);
+    uint32_t *const adjTris = Alloc<uint32_t>(indexCount);
+    memset(remaining, 0, vertexCount * sizeof(uint32_t));
+    for (uint32_t i = 0; i < indexCount; ++i) ++remaining[indices[i]];
+    adjOffset[0] = 0;
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        adjOffset[v + 1] = adjOffset[v] + remaining[v];
+        remaining[v] = 0;
+    }
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t const v = indices[i];
+        adjTris[adjOffset[v] + remaining[v]++] = i / 3;
+    }
+
+    int *const cachePos = Alloc<int>(vertexCount);
+    float *const score = Alloc<float>(vertexCount);
+    ubyte *const emitted = Alloc<ubyte>(triCount);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        cachePos[v] = -1;
+        score[v] = VertexScore(-1, remaining[v]);
+    }
+    memset(emitted, 0, triCount);
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3], newCache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    uint32_t inputCursor = 0;
+    uint32_t best = UINT32_MAX;
+
+    for (uint32_t out = 0; out < triCount; ++out) {
+        if (best == UINT32_MAX) {
+            /* Nothing in the cache has triangles left, continue with the next one in input order.
+               Forsyth rescans everything for the best score here, that's quadratic on meshes with many pieces. */
+            while (emitted[inputCursor]) ++inputCursor;
+            best = inputCursor;
+        }
+        const uint32_t *tv = indices + best * 3;
+        memcpy(dst + out * 3, tv, 3 * sizeof(uint32_t));
+        emitted[best] = 1;
+
+        uint32_t newCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t const v = tv[k];
+            uint32_t *const list = adjTris + adjOffset[v];
+            uint32_t const n = remaining[v]--;
+            for (uint32_t j = 0; j < n; ++j) {
+                if (list[j] == best) {
+                    list[j] = list[n - 1];
+                    break;
+                }
+            }
+            if (newCount == 0 || (newCache[0] != v && (newCount == 1 || newCache[1] != v))) { // degenerate triangles
+                newCache[newCount++] = v;
+            }
+        }
+        for (uint32_t i = 0; i < cacheCount; ++i) {
+            uint32_t const v = cache[i];
+            if (v != tv[0] && v != tv[1] && v != tv[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+        // The ones pushed past the end fall out of the cache.
+        for (uint32_t i = 0; i < newCount; ++i) {
+            uint32_t const v = newCache[i];
+            cachePos[v] = i < FORSYTH_CACHE_SIZE ? int(i) : -1;
+            score[v] = VertexScore(cachePos[v], remaining[v]);
+        }
+
+        best = UINT32_MAX;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < newCount; ++i) {
+            uint32_t const v = newCache[i];
+            const uint32_t *list = adjTris + adjOffset[v];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                const uint32_t *t = indices + list[j] * 3;
+                float const s = score[t[0]] + score[t[1]] + score[t[2]];
+                if (s > bestScore) {
+                    bestScore = s;
+                    best = list[j];
+                }
+            }
+        }
+        cacheCount = Min(newCount, uint32_t(FORSYTH_CACHE_SIZE));
+        memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+    }
+
+    free(adjOffset);
+    free(remaining);
+    free(adjTris);
+    free(cachePos);
+    free(score);
+    free(emitted);
+}
+
+//----- Overdraw -----
+
+struct ClusterKey {
+    float key;
+    uint32_t cluster;
+};
+
+static int
+CompareClusterKeys(const void *pa, const void *pb)
+{
+    const ClusterKey& a = *(const ClusterKey *)pa;
+    const ClusterKey& b = *(const ClusterKey *)pb;
+    if (a.key != b.key) return a.key > b.key ? -1 : 1; // descending
+    return a.cluster < b.cluster ? -1 : a.cluster > b.cluster ? 1 : 0; // stable
+}
+
+/*  indices should already be in vertex cache order. Cluster boundaries are where the FIFO simulation misses all
+    3 vertices of a triangle (the cache restarts, so moving the cluster costs nothing), or where the cluster's ACMR
+    so far is within threshold of the whole mesh's (the cache is assumed cold after that split).
+    Clusters are then sorted by how far out they face: dot(cluster centroid - mesh centroid, cluster normal).
+    Triangles facing out from the middle of the mesh tend to be in front of the others from most directions.
+*/
+static uint32_t
+OptimizeOverdraw(uint32_t *dst, const uint32_t *indices, uint32_t indexCount, const float *pos, uint32_t vertexCount,
+                 uint32_t cacheSize, float threshold)
+{
+    uint32_t const triCount = indexCount / 3;
+    float const targetAcmr = AnalyzeVertexCache(indices, indexCount, vertexCount, cacheSize).acmr * threshold;
+
+    uint32_t *const clusterStart = Alloc<uint32_t>(triCount + 1);
+    uint32_t clusterCount = 0;
+    uint32_t *const stamp = Alloc<uint32_t>(vertexCount);
+    memset(stamp, 0, vertexCount * sizeof(uint32_t));
+    uint32_t time = cacheSize + 1;
+    uint32_t clusterTris = 0, clusterMisses = 0;
+    for (uint32_t t = 0; t < triCount; ++t) {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t const v = indices[t * 3 + k];
+            if (time - stamp[v] > cacheSize) {
+                stamp[v] = time++;
+                ++misses;
+            }
+        }
+        bool const bRestart = misses == 3;
+        bool const bCheap = clusterTris > 0 && float(clusterMisses) <= targetAcmr * float(clusterTris);
+        if (clusterTris == 0 || bRestart || bCheap) {
+            if (bCheap && !bRestart) {
+                // Cold cache for the new cluster, as it may end up anywhere.
+                time += cacheSize + 1;
+                misses = 0;
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t const v = indices[t * 3 + k];
+                    if (time - stamp[v] > cacheSize) {
+                        stamp[v] = time++;
+                        ++misses;
+                    }
+                }
+            }
+            clusterStart[clusterCount++] = t;
+            clusterTris = 0;
+            clusterMisses = 0;
+        }
+        ++clusterTris;
+        clusterMisses += misses;
+    }
+    clusterStart[clusterCount] = triCount;
+    free(stamp);
+
+    float *const clusterData = Alloc<float>(size_t(clusterCount) * 7); // area-weighted centroid sum, normal sum, area
+    memset(clusterData, 0, size_t(clusterCount) * 7 * sizeof(float));
+    float meshCentroid[3] = { 0, 0, 0 };
+    float meshArea = 0.0f;
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        float *const cd = clusterData + c * 7;
+        for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            const float *a = pos + indices[t * 3] * 3;
+            const float *b = pos + indices[t * 3 + 1] * 3;
+            const float *cc = pos + indices[t * 3 + 2] * 3;
+            float e1[3], e2[3], n[3];
+            for (int k = 0; k < 3; ++k) {
+                e1[k] = b[k] - a[k];
+                e2[k] = cc[k] - a[k];
+            }
+            Cross3(e1, e2, n);
+            float const area = sqrtf(Dot3(n, n)) * 0.5f;
+            for (int k = 0; k < 3; ++k) {
+                cd[k] += (a[k] + b[k] + cc[k]) * (1.0f / 3.0f) * area;
+                cd[3 + k] += n[k];
+            }
+            cd[6] += area;
+        }
+        for (int k = 0; k < 3; ++k) meshCentroid[k] += cd[k];
+        meshArea += cd[6];
+    }
+    for (int k = 0; k < 3; ++k) meshCentroid[k] /= Max(meshArea, 1e-30f);
+
+    ClusterKey *const keys = Alloc<ClusterKey>(clusterCount);
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        float *const cd = clusterData + c * 7;
+        float d[3];
+        for (int k = 0; k < 3; ++k) d[k] = cd[k] / Max(cd[6], 1e-30f) - meshCentroid[k];
+        float const nLen = sqrtf(Dot3(cd + 3, cd + 3));
+        keys[c].key = nLen > 0.0f ? Dot3(d, cd + 3) / nLen : 0.0f;
+        keys[c].cluster = c;
+    }
+    qsort(keys, clusterCount, sizeof *keys, CompareClusterKeys);
+
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < clusterCount; ++i) {
+        uint32_t const c = keys[i].cluster;
+        uint32_t const n = (clusterStart[c + 1] - clusterStart[c]) * 3;
+        memcpy(dst + out, indices + clusterStart[c] * 3, n * sizeof(uint32_t));
+        out += n;
+    }
+
+    free(keys);
+    free(clusterData);
+    free(clusterStart);
+    return clusterCount;
+}
+
+//----- Vertex fetch -----
+
+// Renumbers the vertices in first-use order, dropping unreferenced ones. Returns the new vertex count.
+static uint32_t
+OptimizeVertexFetch(MeshFileVertex *dstVertices, uint32_t *indices, uint32_t indexCount,
+                    const MeshFileVertex *vertices, uint32_t vertexCount)
+{
+    uint32_t *const remap = Alloc<uint32_t>(vertexCount);
+    memset(remap, 0xFF, vertexCount * sizeof(uint32_t));
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t const v = indices[i];
+        if (remap[v] == UINT32_MAX) {
+            dstVertices[next] = vertices[v];
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+    free(remap);
+    return next;
+}
+
+//----- main -----
+
+static void
+PrintStats(const char *label, const MeshData& m, uint32_t cacheSize, bool bOverdraw)
+{
+    CacheStats const s = AnalyzeVertexCache(m.indices, m.indexCount, m.vertexCount, cacheSize);
+    printf("%-7s ACMR %.3f  ATVR %.3f  overfetch %.3f", label, s.acmr, s.atvr, s.overfetch);
+    if (bOverdraw) {
+        float *const pos = Alloc<float>(size_t(m.vertexCount) * 3);
+        DecodePositions(m, pos);
+        printf("  overdraw %.3f", AnalyzeOverdraw(pos, m.indices, m.indexCount, m.vertexCount, m.boxMin, m.boxMax));
+        free(pos);
+    }
+    printf("\n");
+}
+
+static int
+Usage()
+{
+    puts("usage: meshopt <in.obj|in.vkm> <out.vkm> [--cache=N] [--threshold=X] [--no-overdraw]");
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *inPath = nullptr, *outPath = nullptr;
+    uint32_t cacheSize = 16;
+    float threshold = 1.05f;
+    bool bOverdraw = true;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (!strncmp(arg, "--cache=", 8)) {
+            cacheSize = uint32_t(strtoul(arg + 8, nullptr, 10));
+            if (cacheSize < 3) return Usage();
+        } else if (!strncmp(arg, "--threshold=", 12)) {
+            threshold = strtof(arg + 12, nullptr);
+            if (!(threshold >= 1.0f)) return Usage();
+        } else if (!strcmp(arg, "--no-overdraw")) {
+            bOverdraw = false;
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            printf("unknown option %s\n", arg);
+            return Usage();
+        } else if (!inPath) {
+            inPath = arg;
+        } else if (!outPath) {
+            outPath = arg;
+        } else {
+            return Usage();
+        }
+    }
+    if (!inPath || !outPath) {
+        return Usage();
+    }
+
+    MeshData m = { };
+    size_t const inLen = strlen(inPath);
+    bool const bVkm = inLen >= 4 && !strcmp(inPath + inLen - 4, ".vkm");
+    clock_t t0 = clock();
+    if (!(bVkm ? LoadVkm(m, inPath) : LoadObj(m, inPath))) {
+        return 1;
+    }
+    printf("%s: %u vertices, %u triangles, loaded in %.2f s\n", inPath, m.vertexCount, m.indexCount / 3, Seconds(t0));
+    if (m.indexCount == 0) {
+        puts("nothing to optimize");
+        return 1;
+    }
+    PrintStats("before", m, cacheSize, bOverdraw);
+
+    InitVertexScoreTables();
+    uint32_t *scratch = Alloc<uint32_t>(m.indexCount);
+    t0 = clock();
+    OptimizeVertexCache(scratch, m.indices, m.indexCount, m.vertexCount);
+    float const cacheSecs = Seconds(t0);
+
+    uint32_t clusterCount = 0;
+    t0 = clock();
+    if (bOverdraw) {
+        float *const pos = Alloc<float>(size_t(m.vertexCount) * 3);
+        DecodePositions(m, pos);
+        clusterCount = OptimizeOverdraw(m.indices, scratch, m.indexCount, pos, m.vertexCount, cacheSize, threshold);
+        free(pos);
+    } else {
+        memcpy(m.indices, scratch, m.indexCount * sizeof(uint32_t));
+    }
+    float const overdrawSecs = Seconds(t0);
+    free(scratch);
+
+    t0 = clock();
+    MeshFileVertex *const vertices = Alloc<MeshFileVertex>(m.vertexCount);
+    m.vertexCount = OptimizeVertexFetch(vertices, m.indices, m.indexCount, m.vertices, m.vertexCount);
+    free(m.vertices);
+    m.vertices = vertices;
+    float const fetchSecs = Seconds(t0);
+
+    PrintStats("after", m, cacheSize, bOverdraw);
+    printf("vertex cache %.3f s, overdraw %.3f s (%u clusters), vertex fetch %.3f s\n",
+           cacheSecs, overdrawSecs, clusterCount, fetchSecs);
+
+    bool const ok = WriteVkm(m, outPath);
+    printf("%s %s: %u vertices, %u triangles, %u-bit indices\n", ok ? "wrote" : "failed to write", outPath,
+           m.vertexCount, m.indexCount / 3, m.vertexCount <= 65536 ? 16 : 32);
+    free(m.vertices);
+    free(m.indices);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1321 @@
+/*
+    tracereplay: plays a .vkt frame trace (see TraceFormat.h, written by vklab --trace) back headless and times it,
+    a separate executable from vklab.
+
+        tracereplay <in.vkt> [--frames=N] [--warmup=W] [--csv=out.csv]
+
+    The objects are created once and the buffer and image contents uploaded. Then the frame's command buffers are
+    recorded into one and submitted W + N times (default 5 + 100), waiting for each. Before each run, the buffers
+    the GPU can write to get their contents back, outside the timed part, so every run starts from the same state.
+    Images aren't restored: a frame overwrites its render targets, and uploads to textures write the same data.
+
+    Per run: CPU time to decode, record and submit, GPU time from timestamps around the commands. The first W runs
+    aren't counted. Then min/avg/median/max of each, and with --csv every counted run.
+
+    Swapchain images become ordinary images, PRESENT_SRC_KHR becomes GENERAL. The GPU is the one vklab would pick,
+    VKLAB_GPU works the same.
+*/
+#include "../TraceFormat.h"
+#include "../VulkanRenderer.h"
+#include "../VulkanSwapchain.h" // OS_ functions
+#include "../GpuTimer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Regions and viewports are read straight from the file. */
+static_assert(sizeof(TraceBufferCopy) == sizeof(VkBufferCopy), "");
+static_assert(sizeof(TraceBufferImageCopy) == sizeof(VkBufferImageCopy), "");
+static_assert(sizeof(TraceImageCopy) == sizeof(VkImageCopy), "");
+static_assert(sizeof(TraceImageBlit) == sizeof(VkImageBlit), "");
+static_assert(sizeof(TraceViewport) == sizeof(VkViewport), "");
+static_assert(sizeof(TraceRect) == sizeof(VkRect2D), "");
+
+/* Staging offsets of image levels: a multiple of 4 and of every texel block size (1 to 32 bytes, 3, 6, 12, 24). */
+#define STAGING_IMAGE_ALIGN 96u
+
+template<class T> static T *
+Alloc(size_t count)
+{
+    T *p = (T *)calloc(Max(count, size_t(1)), sizeof(T));
+    if (!p) {
+        puts("out of memory");
+        exit(1);
+    }
+    return p;
+}
+
+struct ReplayObject {
+    const void *payload; // null if the trace has no object with this id
+    uint64_t payloadSize;
+    uint32_t type; // TraceChunkType
+    bool bCreated;
+    bool bRestore; // buffers: the GPU can write to it, contents are put back before each run
+    union {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView view;
+        VkSampler sampler;
+        VkShaderModule module;
+        VkDescriptorSetLayout setLayout;
+        VkPipelineLayout pipelineLayout;
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        VkPipeline pipeline;
+        VkDescriptorSet set;
+    };
+    VkDeviceMemory memory;
+    void *pMapped; // HOST_VISIBLE | HOST_COHERENT memory only
+    const void *data; // buffers: the contents in the file
+    VkDeviceSize stagingOffset; // buffers and images with contents, not mapped
+};
+
+struct CmdStream {
+    const uint8_t *data;
+    uint64_t size;
+};
+
+static struct Replay {
+    VulkanRenderer vkr;
+    ReplayObject *objects; // by id
+    uint32_t idLimit;
+    CmdStream *streams;
+    uint32_t streamCount;
+    VkDescriptorPool descriptorPool;
+    BufferAllocation staging;
+    VkDeviceSize stagingSize;
+    uint32_t skipped; // commands left out of one run, they use an object the trace doesn't have
+    bool bSkipPass; // the render pass couldn't begin, its commands are left out
+    bool bNoPipeline[2]; // graphics, compute
+} rp;
+
+static ReplayObject *
+Get(uint32_t id)
+{
+    return id < rp.idLimit && rp.objects[id].bCreated ? &rp.objects[id] : nullptr;
+}
+
+static VkImageLayout
+Layout(uint32_t layout)
+{
+    return layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? VK_IMAGE_LAYOUT_GENERAL : VkImageLayout(layout);
+}
+
+static VkImageAspectFlags
+AspectOf(uint32_t format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static VkDeviceSize
+AlignUp(VkDeviceSize x, VkDeviceSize align)
+{
+    return (x + align - 1) / align * align;
+}
+
+static const TraceImageLevel *
+ImageLevels(const TraceImage *img)
+{
+    return (const TraceImageLevel *)(img + 1);
+}
+
+/* Where each level with contents goes in the staging buffer, starting at offset. Returns the end. */
+static VkDeviceSize
+StageImageLevels(const TraceImage *img, VkDeviceSize offset, VkDeviceSize *pLevelOffsets)
+{
+    const TraceImageLevel *levels = ImageLevels(img);
+    for (uint32_t m = 0; m < img->mipLevels; ++m) {
+        if (levels[m].dataSize) {
+            offset = AlignUp(offset, STAGING_IMAGE_ALIGN);
+            if (pLevelOffsets) {
+                pLevelOffsets[m] = offset;
+            }
+            offset += levels[m].dataSize;
+        }
+    }
+    return offset;
+}
+
+/* recordedFlags are those of the memory the app used, HOST_VISIBLE is kept, the rest is a preference. */
+static bool
+AllocateMemory(ReplayObject& o, const VkMemoryRequirements& req, uint32_t recordedFlags)
+{
+    const VkPhysicalDeviceMemoryProperties& mp = rp.vkr.caps.memory;
+    VkMemoryPropertyFlags const hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t type = VKH_FindMemoryType(mp, req.memoryTypeBits, recordedFlags & hostFlags, recordedFlags);
+    if (type == UINT32_MAX) {
+        type = VKH_FindMemoryType(mp, req.memoryTypeBits, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    VkMemoryAllocateInfo info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    info.allocationSize = req.size;
+    info.memoryTypeIndex = type;
+    if (type == UINT32_MAX || vkAllocateMemory(rp.vkr.device, &info, nullptr, &o.memory) != VK_SUCCESS) {
+        return false;
+    }
+    if ((mp.memoryTypes[type].propertyFlags & hostFlags) == hostFlags) {
+        VK_CHECK(vkMapMemory(rp.vkr.device, o.memory, 0, VK_WHOLE_SIZE, 0, &o.pMapped));
+    }
+    return true;
+}
+
+//----- Creating the objects -----
+
+static bool
+CreateBuffer(ReplayObject& o)
+{
+    const TraceBuffer *b = (const TraceBuffer *)o.payload;
+    VkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    info.size = b->size;
+    info.usage = b->usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (vkCreateBuffer(rp.vkr.device, &info, nullptr, &o.buffer) != VK_SUCCESS) {
+        return false;
+    }
+    VkMemoryRequirements req;
+    vkGetBufferMemoryRequirements(rp.vkr.device, o.buffer, &req);
+    if (!AllocateMemory(o, req, b->memoryFlags)) {
+        vkDestroyBuffer(rp.vkr.device, o.buffer, nullptr);
+        return false;
+    }
+    VK_CHECK(vkBindBufferMemory(rp.vkr.device, o.buffer, o.memory, 0));
+    if (b->dataSize) {
+        o.data = b + 1;
+        o.bRestore = (b->usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT)) != 0;
+        if (o.pMapped) {
+            memcpy(o.pMapped, o.data, size_t(b->dataSize));
+        } else {
+            o.stagingOffset = AlignUp(rp.stagingSize, 16);
+            rp.stagingSize = o.stagingOffset + b->dataSize;
+        }
+    }
+    return true;
+}
+
+static bool
+CreateImage(ReplayObject& o)
+{
+    const TraceImage *img = (const TraceImage *)o.payload;
+    const TraceImageLevel *levels = ImageLevels(img);
+    bool bData = false;
+    for (uint32_t m = 0; m < img->mipLevels; ++m) {
+        bData |= levels[m].dataSize != 0;
+    }
+    VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.flags = img->flags;
+    info.imageType = VkImageType(img->imageType);
+    info.format = VkFormat(img->format);
+    info.extent = { img->width, img->height, img->depth };
+    info.mipLevels = img->mipLevels;
+    info.arrayLayers = img->arrayLayers;
+    info.samples = VkSampleCountFlagBits(img->samples);
+    info.tiling = VkImageTiling(img->tiling);
+    info.usage = img->usage | (bData ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(rp.vkr.device, &info, nullptr, &o.image) != VK_SUCCESS) {
+        return false;
+    }
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(rp.vkr.device, o.image, &req);
+    if (!AllocateMemory(o, req, img->memoryFlags & ~VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        vkDestroyImage(rp.vkr.device, o.image, nullptr);
+        return false;
+    }
+    VK_CHECK(vkBindImageMemory(rp.vkr.device, o.image, o.memory, 0));
+    if (bData) {
+        o.stagingOffset = AlignUp(rp.stagingSize, STAGING_IMAGE_ALIGN);
+        rp.stagingSize = StageImageLevels(img, o.stagingOffset, nullptr);
+    }
+    return true;
+}
+
+static bool
+CreateImageView(ReplayObject& o)
+{
+    const TraceImageView *v = (const TraceImageView *)o.payload;
+    const ReplayObject *image = Get(v->image);
+    if (!image) {
+        return false;
+    }
+    VkImageViewUsageCreateInfo usageInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+    usageInfo.usage = v->usage;
+    VkImageViewCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    info.pNext = v->usage ? &usageInfo : nullptr;
+    info.image = image->image;
+    info.viewType = VkImageViewType(v->viewType);
+    info.format = VkFormat(v->format);
+    info.components = {
+        VkComponentSwizzle(v->components[0]), VkComponentSwizzle(v->components[1]),
+        VkComponentSwizzle(v->components[2]), VkComponentSwizzle(v->components[3])
+    };
+    info.subresourceRange = { v->aspect, v->baseMip, v->mipCount, v->baseLayer, v->layerCount };
+    return vkCreateImageView(rp.vkr.device, &info, nullptr, &o.view) == VK_SUCCESS;
+}
+
+static bool
+CreateSampler(ReplayObject& o)
+{
+    const TraceSampler *s = (const TraceSampler *)o.payload;
+    VkSamplerCreateInfo info = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    info.magFilter = VkFilter(s->magFilter);
+    info.minFilter = VkFilter(s->minFilter);
+    info.mipmapMode = VkSamplerMipmapMode(s->mipmapMode);
+    info.addressModeU = VkSamplerAddressMode(s->addressModeU);
+    info.addressModeV = VkSamplerAddressMode(s->addressModeV);
+    info.addressModeW = VkSamplerAddressMode(s->addressModeW);
+    info.mipLodBias = s->mipLodBias;
+    info.anisotropyEnable = s->anisotropyEnable;
+    info.maxAnisotropy = s->maxAnisotropy;
+    info.compareEnable = s->compareEnable;
+    info.compareOp = VkCompareOp(s->compareOp);
+    info.minLod = s->minLod;
+    info.maxLod = s->maxLod;
+    info.borderColor = VkBorderColor(s->borderColor);
+    info.unnormalizedCoordinates = s->unnormalizedCoordinates;
+    return vkCreateSampler(rp.vkr.device, &info, nullptr, &o.sampler) == VK_SUCCESS;
+}
+
+static bool
+CreateShaderModule(ReplayObject& o)
+{
+    const TraceShaderModule *m = (const TraceShaderModule *)o.payload;
+    VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+    info.codeSize = size_t(m->codeSize);
+    info.pCode = (const uint32_t *)(m + 1);
+    return vkCreateShaderModule(rp.vkr.device, &info, nullptr, &o.module) == VK_SUCCESS;
+}
+
+static bool
+CreateSetLayout(ReplayObject& o)
+{
+    const TraceSetLayout *l = (const TraceSetLayout *)o.payload;
+    const TraceSetLayoutBinding *src = (const TraceSetLayoutBinding *)(l + 1);
+    const uint32_t *samplerIds = (const uint32_t *)(src + l->bindingCount);
+    VkDescriptorSetLayoutBinding *bindings = Alloc<VkDescriptorSetLayoutBinding>(l->bindingCount);
+    VkSampler *samplers = Alloc<VkSampler>(l->immutableSamplerCount);
+    bool bOk = true;
+    for (uint32_t i = 0; i < l->immutableSamplerCount; ++i) {
+        const ReplayObject *sampler = Get(samplerIds[i]);
+        bOk &= sampler != nullptr;
+        samplers[i] = sampler ? sampler->sampler : nullptr;
+    }
+    for (uint32_t i = 0; i < l->bindingCount; ++i) {
+        bindings[i].binding = src[i].binding;
+        bindings[i].descriptorType = VkDescriptorType(src[i].descriptorType);
+        bindings[i].descriptorCount = src[i].descriptorCount;
+        bindings[i].stageFlags = src[i].stageFlags;
+        if (src[i].firstImmutableSampler != TRACE_NO_ID) {
+            bOk &= src[i].firstImmutableSampler + uint64_t(src[i].descriptorCount) <= l->immutableSamplerCount;
+            bindings[i].pImmutableSamplers = samplers + src[i].firstImmutableSampler;
+        }
+    }
+    VkDescriptorSetLayoutCreateInfo info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    info.flags = l->flags;
+    info.bindingCount = l->bindingCount;
+    info.pBindings = bindings;
+    bOk = bOk && vkCreateDescriptorSetLayout(rp.vkr.device, &info, nullptr, &o.setLayout) == VK_SUCCESS;
+    free(bindings);
+    free(samplers);
+    return bOk;
+}
+
+static bool
+CreatePipelineLayout(ReplayObject& o)
+{
+    const TracePipelineLayout *l = (const TracePipelineLayout *)o.payload;
+    const uint32_t *setIds = (const uint32_t *)(l + 1);
+    const TracePushRange *ranges = (const TracePushRange *)(setIds + l->setLayoutCount);
+    VkDescriptorSetLayout *setLayouts = Alloc<VkDescriptorSetLayout>(l->setLayoutCount);
+    VkPushConstantRange *pushRanges = Alloc<VkPushConstantRange>(l->pushRangeCount);
+    bool bOk = true;
+    for (uint32_t i = 0; i < l->setLayoutCount; ++i) {
+        const ReplayObject *s = Get(setIds[i]);
+        bOk &= s != nullptr;
+        setLayouts[i] = s ? s->setLayout : nullptr;
+    }
+    for (uint32_t i = 0; i < l->pushRangeCount; ++i) {
+        pushRanges[i] = { ranges[i].stageFlags, ranges[i].offset, ranges[i].size };
+    }
+    VkPipelineLayoutCreateInfo info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    info.setLayoutCount = l->setLayoutCount;
+    info.pSetLayouts = setLayouts;
+    info.pushConstantRangeCount = l->pushRangeCount;
+    info.pPushConstantRanges = pushRanges;
+    bOk = bOk && vkCreatePipelineLayout(rp.vkr.device, &info, nullptr, &o.pipelineLayout) == VK_SUCCESS;
+    free(setLayouts);
+    free(pushRanges);
+    return bOk;
+}
+
+static bool
+CreateRenderPass(ReplayObject& o)
+{
+    const TraceRenderPass *r = (const TraceRenderPass *)o.payload;
+    const TraceAttachment *attachments = (const TraceAttachment *)(r + 1);
+    const TraceSubpass *subpasses = (const TraceSubpass *)(attachments + r->attachmentCount);
+    const TraceDependency *dependencies = (const TraceDependency *)(subpasses + r->subpassCount);
+    const TraceAttachmentRef *refs = (const TraceAttachmentRef *)(dependencies + r->dependencyCount);
+    const uint32_t *preserves = (const uint32_t *)(refs + r->refCount);
+
+    VkAttachmentDescription *a = Alloc<VkAttachmentDescription>(r->attachmentCount);
+    VkSubpassDescription *s = Alloc<VkSubpassDescription>(r->subpassCount);
+    VkSubpassDependency *d = Alloc<VkSubpassDependency>(r->dependencyCount);
+    VkAttachmentReference *vkRefs = Alloc<VkAttachmentReference>(r->refCount);
+    for (uint32_t i = 0; i < r->attachmentCount; ++i) {
+        const TraceAttachment& t = attachments[i];
+        a[i].flags = t.flags;
+        a[i].format = VkFormat(t.format);
+        a[i].samples = VkSampleCountFlagBits(t.samples);
+        a[i].loadOp = VkAttachmentLoadOp(t.loadOp);
+        a[i].storeOp = VkAttachmentStoreOp(t.storeOp);
+        a[i].stencilLoadOp = VkAttachmentLoadOp(t.stencilLoadOp);
+        a[i].stencilStoreOp = VkAttachmentStoreOp(t.stencilStoreOp);
+        a[i].initialLayout = Layout(t.initialLayout);
+        a[i].finalLayout = Layout(t.finalLayout);
+    }
+    for (uint32_t i = 0; i < r->refCount; ++i) {
+        vkRefs[i] = { refs[i].attachment, Layout(refs[i].layout) };
+    }
+    for (uint32_t i = 0; i < r->subpassCount; ++i) {
+        const TraceSubpass& t = subpasses[i];
+        const VkAttachmentReference *ref = vkRefs + t.firstRef;
+        s[i].pipelineBindPoint = VkPipelineBindPoint(t.bindPoint);
+        s[i].inputAttachmentCount = t.inputCount;
+        s[i].pInputAttachments = ref;
+        ref += t.inputCount;
+        s[i].colorAttachmentCount = t.colorCount;
+        s[i].pColorAttachments = ref;
+        ref += t.colorCount;
+        if (t.bResolve) {
+            s[i].pResolveAttachments = ref;
+            ref += t.colorCount;
+        }
+        s[i].pDepthStencilAttachment = t.bDepth ? ref : nullptr;
+        s[i].preserveAttachmentCount = t.preserveCount;
+        s[i].pPreserveAttachments = preserves + t.firstPreserve;
+    }
+    for (uint32_t i = 0; i < r->dependencyCount; ++i) {
+        const TraceDependency& t = dependencies[i];
+        d[i] = { t.srcSubpass, t.dstSubpass, t.srcStageMask, t.dstStageMask, t.srcAccessMask, t.dstAccessMask,
+                 t.dependencyFlags };
+    }
+    VkRenderPassCreateInfo info = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+    info.attachmentCount = r->attachmentCount;
+    info.pAttachments = a;
+    info.subpassCount = r->subpassCount;
+    info.pSubpasses = s;
+    info.dependencyCount = r->dependencyCount;
+    info.pDependencies = d;
+    bool const bOk = vkCreateRenderPass(rp.vkr.device, &info, nullptr, &o.renderPass) == VK_SUCCESS;
+    free(a);
+    free(s);
+    free(d);
+    free(vkRefs);
+    return bOk;
+}
+
+static bool
+CreateFramebuffer(ReplayObject& o)
+{
+    const TraceFramebuffer *f = (const TraceFramebuffer *)o.payload;
+    const uint32_t *viewIds = (const uint32_t *)(f + 1);
+    const ReplayObject *renderPass = Get(f->renderPass);
+    VkImageView *views = Alloc<VkImageView>(f->attachmentCount);
+    bool bOk = renderPass != nullptr;
+    for (uint32_t i = 0; i < f->attachmentCount; ++i) {
+        const ReplayObject *v = Get(viewIds[i]);
+        bOk &= v != nullptr;
+        views[i] = v ? v->view : nullptr;
+    }
+    VkFramebufferCreateInfo info = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+    info.renderPass = bOk ? renderPass->renderPass : nullptr;
+    info.attachmentCount = f->attachmentCount;
+    info.pAttachments = views;
+    info.width = f->width;
+    info.height = f->height;
+    info.layers = f->layers;
+    bOk = bOk && vkCreateFramebuffer(rp.vkr.device, &info, nullptr, &o.framebuffer) == VK_SUCCESS;
+    free(views);
+    return bOk;
+}
+
+static bool
+ShaderStage(const TraceShaderStage& t, VkPipelineShaderStageCreateInfo *pStage)
+{
+    const ReplayObject *module = Get(t.module);
+    *pStage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    pStage->stage = VkShaderStageFlagBits(t.stage);
+    pStage->module = module ? module->module : nullptr;
+    pStage->pName = t.name;
+    return module != nullptr;
+}
+
+static VkStencilOpState
+StencilOp(const TraceStencilOp& t)
+{
+    return { VkStencilOp(t.failOp), VkStencilOp(t.passOp), VkStencilOp(t.depthFailOp), VkCompareOp(t.compareOp),
+             t.compareMask, t.writeMask, t.reference };
+}
+
+static bool
+CreateGraphicsPipeline(ReplayObject& o)
+{
+    const TraceGraphicsPipeline *p = (const TraceGraphicsPipeline *)o.payload;
+    const TraceShaderStage *stages = (const TraceShaderStage *)(p + 1);
+    const TraceVertexBinding *bindings = (const TraceVertexBinding *)(stages + p->stageCount);
+    const TraceVertexAttribute *attributes = (const TraceVertexAttribute *)(bindings + p->bindingCount);
+    const TraceBlendAttachment *blend = (const TraceBlendAttachment *)(attributes + p->attributeCount);
+    const TraceViewport *viewports = (const TraceViewport *)(blend + p->blendAttachmentCount);
+    const TraceRect *scissors = (const TraceRect *)(viewports + p->staticViewportCount);
+    const uint32_t *dynamicStates = (const uint32_t *)(scissors + p->staticScissorCount);
+
+    const ReplayObject *layout = Get(p->layout), *renderPass = Get(p->renderPass);
+    bool bOk = layout && renderPass;
+    VkPipelineShaderStageCreateInfo *vkStages = Alloc<VkPipelineShaderStageCreateInfo>(p->stageCount);
+    for (uint32_t i = 0; i < p->stageCount; ++i) {
+        bOk &= ShaderStage(stages[i], &vkStages[i]);
+    }
+    VkVertexInputBindingDescription *vkBindings = Alloc<VkVertexInputBindingDescription>(p->bindingCount);
+    for (uint32_t i = 0; i < p->bindingCount; ++i) {
+        vkBindings[i] = { bindings[i].binding, bindings[i].stride, VkVertexInputRate(bindings[i].inputRate) };
+    }
+    VkVertexInputAttributeDescription *vkAttributes = Alloc<VkVertexInputAttributeDescription>(p->attributeCount);
+    for (uint32_t i = 0; i < p->attributeCount; ++i) {
+        vkAttributes[i] = { attributes[i].location, attributes[i].binding, VkFormat(attributes[i].format),
+                            attributes[i].offset };
+    }
+    VkPipelineColorBlendAttachmentState *vkBlend = Alloc<VkPipelineColorBlendAttachmentState>(p->blendAttachmentCount);
+    for (uint32_t i = 0; i < p->blendAttachmentCount; ++i) {
+        const TraceBlendAttachment& b = blend[i];
+        vkBlend[i] = {
+            b.blendEnable, VkBlendFactor(b.srcColor), VkBlendFactor(b.dstColor), VkBlendOp(b.colorOp),
+            VkBlendFactor(b.srcAlpha), VkBlendFactor(b.dstAlpha), VkBlendOp(b.alphaOp), b.colorWriteMask
+        };
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    vertexInput.vertexBindingDescriptionCount = p->bindingCount;
+    vertexInput.pVertexBindingDescriptions = vkBindings;
+    vertexInput.vertexAttributeDescriptionCount = p->attributeCount;
+    vertexInput.pVertexAttributeDescriptions = vkAttributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO
+    };
+    inputAssembly.topology = VkPrimitiveTopology(p->topology);
+    inputAssembly.primitiveRestartEnable = p->primitiveRestartEnable;
+
+    VkPipelineViewportStateCreateInfo viewport = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewport.viewportCount = p->viewportCount;
+    viewport.pViewports = p->staticViewportCount ? (const VkViewport *)viewports : nullptr;
+    viewport.scissorCount = p->scissorCount;
+    viewport.pScissors = p->staticScissorCount ? (const VkRect2D *)scissors : nullptr;
+
+    VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    raster.depthClampEnable = p->depthClampEnable;
+    raster.rasterizerDiscardEnable = p->rasterizerDiscardEnable;
+    raster.polygonMode = VkPolygonMode(p->polygonMode);
+    raster.cullMode = p->cullMode;
+    raster.frontFace = VkFrontFace(p->frontFace);
+    raster.depthBiasEnable = p->depthBiasEnable;
+    raster.depthBiasConstantFactor = p->depthBiasConstantFactor;
+    raster.depthBiasClamp = p->depthBiasClamp;
+    raster.depthBiasSlopeFactor = p->depthBiasSlopeFactor;
+    raster.lineWidth = p->lineWidth;
+
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = VkSampleCountFlagBits(p->rasterizationSamples);
+    multisample.sampleShadingEnable = p->sampleShadingEnable;
+    multisample.minSampleShading = p->minSampleShading;
+    multisample.alphaToCoverageEnable = p->alphaToCoverageEnable;
+    multisample.alphaToOneEnable = p->alphaToOneEnable;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    depthStencil.depthTestEnable = p->depthTestEnable;
+    depthStencil.depthWriteEnable = p->depthWriteEnable;
+    depthStencil.depthCompareOp = VkCompareOp(p->depthCompareOp);
+    depthStencil.depthBoundsTestEnable = p->depthBoundsTestEnable;
+    depthStencil.stencilTestEnable = p->stencilTestEnable;
+    depthStencil.front = StencilOp(p->front);
+    depthStencil.back = StencilOp(p->back);
+    depthStencil.minDepthBounds = p->minDepthBounds;
+    depthStencil.maxDepthBounds = p->maxDepthBounds;
+
+    VkPipelineColorBlendStateCreateInfo colorBlend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    colorBlend.logicOpEnable = p->logicOpEnable;
+    colorBlend.logicOp = VkLogicOp(p->logicOp);
+    colorBlend.attachmentCount = p->blendAttachmentCount;
+    colorBlend.pAttachments = vkBlend;
+    memcpy(colorBlend.blendConstants, p->blendConstants, sizeof colorBlend.blendConstants);
+
+    VkPipelineDynamicStateCreateInfo dynamic = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+    dynamic.dynamicStateCount = p->dynamicStateCount;
+    dynamic.pDynamicStates = (const VkDynamicState *)dynamicStates;
+
+    VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    info.flags = p->flags;
+    info.stageCount = p->stageCount;
+    info.pStages = vkStages;
+    info.pVertexInputState = &vertexInput;
+    info.pInputAssemblyState = &inputAssembly;
+    info.pViewportState = p->rasterizerDiscardEnable ? nullptr : &viewport;
+    info.pRasterizationState = &raster;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = p->bDepthStencil ? &depthStencil : nullptr;
+    info.pColorBlendState = p->bColorBlend ? &colorBlend : nullptr;
+    info.pDynamicState = p->dynamicStateCount ? &dynamic : nullptr;
+    info.layout = layout ? layout->pipelineLayout : nullptr;
+    info.renderPass = renderPass ? renderPass->renderPass : nullptr;
+    info.subpass = p->subpass;
+    bOk = bOk && vkCreateGraphicsPipelines(rp.vkr.device, nullptr, 1, &info, nullptr, &o.pipeline) == VK_SUCCESS;
+    free(vkStages);
+    free(vkBindings);
+    free(vkAttributes);
+    free(vkBlend);
+    return bOk;
+}
+
+static bool
+CreateComputePipeline(ReplayObject& o)
+{
+    const TraceComputePipeline *p = (const TraceComputePipeline *)o.payload;
+    const ReplayObject *layout = Get(p->layout);
+    VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    info.flags = p->flags;
+    bool const bStage = ShaderStage(p->stage, &info.stage);
+    info.layout = layout ? layout->pipelineLayout : nullptr;
+    return layout && bStage &&
+           vkCreateComputePipelines(rp.vkr.device, nullptr, 1, &info, nullptr, &o.pipeline) == VK_SUCCESS;
+}
+
+/* One pool for every set in the trace, sized from their layouts. */
+static bool
+CreateDescriptorPool()
+{
+    uint32_t counts[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1] = { };
+    uint32_t setCount = 0;
+    for (uint32_t id = 0; id < rp.idLimit; ++id) {
+        const ReplayObject& o = rp.objects[id];
+        if (!o.payload || o.type != TraceChunk_DescriptorSet) {
+            continue;
+        }
+        uint32_t const layoutId = ((const TraceDescriptorSet *)o.payload)->setLayout;
+        if (layoutId >= rp.idLimit || !rp.objects[layoutId].payload) {
+            continue;
+        }
+        const TraceSetLayout *l = (const TraceSetLayout *)rp.objects[layoutId].payload;
+        const TraceSetLayoutBinding *b = (const TraceSetLayoutBinding *)(l + 1);
+        for (uint32_t i = 0; i < l->bindingCount; ++i) {
+            if (b[i].descriptorType < lengthof(counts)) {
+                counts[b[i].descriptorType] += b[i].descriptorCount;
+            }
+        }
+        ++setCount;
+    }
+    if (!setCount) {
+        return true;
+    }
+    VkDescriptorPoolSize sizes[lengthof(counts)];
+    uint32_t sizeCount = 0;
+    for (uint32_t t = 0; t < lengthof(counts); ++t) {
+        if (counts[t]) {
+            sizes[sizeCount++] = { VkDescriptorType(t), counts[t] };
+        }
+    }
+    VkDescriptorPoolCreateInfo info = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    info.maxSets = setCount;
+    info.poolSizeCount = sizeCount;
+    info.pPoolSizes = sizes;
+    return vkCreateDescriptorPool(rp.vkr.device, &info, nullptr, &rp.descriptorPool) == VK_SUCCESS;
+}
+
+/* Whether the set layout gives the binding its samplers, a write then has none. */
+static bool
+HasImmutableSamplers(uint32_t setLayout, uint32_t binding)
+{
+    const TraceSetLayout *l = (const TraceSetLayout *)rp.objects[setLayout].payload;
+    const TraceSetLayoutBinding *b = (const TraceSetLayoutBinding *)(l + 1);
+    for (uint32_t i = 0; i < l->bindingCount; ++i) {
+        if (b[i].binding == binding) {
+            return b[i].firstImmutableSampler != TRACE_NO_ID;
+        }
+    }
+    return false;
+}
+
+static bool
+CreateDescriptorSet(ReplayObject& o)
+{
+    const TraceDescriptorSet *s = (const TraceDescriptorSet *)o.payload;
+    const TraceDescriptor *d = (const TraceDescriptor *)(s + 1);
+    const ReplayObject *layout = Get(s->setLayout);
+    if (!layout || !rp.descriptorPool) {
+        return false;
+    }
+    VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = rp.descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout->setLayout;
+    if (vkAllocateDescriptorSets(rp.vkr.device, &allocInfo, &o.set) != VK_SUCCESS) {
+        return false;
+    }
+    /* One write per descriptor, the ones whose objects are missing are left unwritten. */
+    for (uint32_t i = 0; i < s->descriptorCount; ++i) {
+        VkDescriptorImageInfo imageInfo = { };
+        VkDescriptorBufferInfo bufferInfo = { };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = o.set;
+        write.dstBinding = d[i].binding;
+        write.dstArrayElement = d[i].arrayElement;
+        write.descriptorCount = 1;
+        write.descriptorType = VkDescriptorType(d[i].descriptorType);
+        const ReplayObject *object = Get(d[i].object), *sampler = Get(d[i].sampler);
+        bool const bImmutable = write.descriptorType <= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER &&
+                                HasImmutableSamplers(s->setLayout, d[i].binding);
+        switch (write.descriptorType) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+            object = bImmutable ? nullptr : sampler; // nothing to write then
+            break;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            object = sampler || bImmutable ? object : nullptr;
+            break;
+        default:
+            break;
+        }
+        if (!object) {
+            continue;
+        }
+        if (write.descriptorType <= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+            write.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT) {
+            imageInfo.sampler = sampler ? sampler->sampler : nullptr;
+            imageInfo.imageView = write.descriptorType != VK_DESCRIPTOR_TYPE_SAMPLER ? object->view : nullptr;
+            imageInfo.imageLayout = Layout(d[i].imageLayout);
+            write.pImageInfo = &imageInfo;
+        } else {
+            bufferInfo = { object->buffer, d[i].offset, d[i].range };
+            write.pBufferInfo = &bufferInfo;
+        }
+        vkUpdateDescriptorSets(rp.vkr.device, 1, &write, 0, nullptr);
+    }
+    return true;
+}
+
+/* Objects in id order, what they refer to is always created first. False and a message if the file is bad. */
+static bool
+LoadTrace(const os_mapped_file& file)
+{
+    const TraceFileHeader *h = (const TraceFileHeader *)file.data;
+    const uint8_t *p = (const uint8_t *)(h + 1);
+    const uint8_t *const end = (const uint8_t *)file.data + file.size;
+    rp.idLimit = h->idLimit;
+    rp.objects = Alloc<ReplayObject>(h->idLimit);
+    rp.streams = Alloc<CmdStream>(h->commandBufferCount);
+    while (p + sizeof(TraceChunkHeader) <= end) {
+        const TraceChunkHeader *c = (const TraceChunkHeader *)p;
+        const uint8_t *const payload = (const uint8_t *)(c + 1);
+        if (c->size > uint64_t(end - payload)) {
+            puts("truncated chunk");
+            return false;
+        }
+        p = payload + TraceFile_AlignUp(c->size);
+        if (c->type == TraceChunk_CommandBuffer) {
+            if (rp.streamCount < h->commandBufferCount) {
+                rp.streams[rp.streamCount++] = { payload, c->size };
+            }
+        } else if (c->type < TraceChunk_Count && c->id < rp.idLimit) {
+            rp.objects[c->id].payload = payload;
+            rp.objects[c->id].payloadSize = c->size;
+            rp.objects[c->id].type = c->type;
+        }
+    }
+
+    uint32_t failed = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1 && !CreateDescriptorPool()) {
+            puts("can't create the descriptor pool");
+        }
+        for (uint32_t id = 0; id < rp.idLimit; ++id) {
+            ReplayObject& o = rp.objects[id];
+            if (!o.payload || (o.type == TraceChunk_DescriptorSet) != (pass == 1)) {
+                continue;
+            }
+            switch (o.type) {
+            case TraceChunk_Buffer: o.bCreated = CreateBuffer(o); break;
+            case TraceChunk_Image: o.bCreated = CreateImage(o); break;
+            case TraceChunk_ImageView: o.bCreated = CreateImageView(o); break;
+            case TraceChunk_Sampler: o.bCreated = CreateSampler(o); break;
+            case TraceChunk_ShaderModule: o.bCreated = CreateShaderModule(o); break;
+            case TraceChunk_SetLayout: o.bCreated = CreateSetLayout(o); break;
+            case TraceChunk_PipelineLayout: o.bCreated = CreatePipelineLayout(o); break;
+            case TraceChunk_RenderPass: o.bCreated = CreateRenderPass(o); break;
+            case TraceChunk_Framebuffer: o.bCreated = CreateFramebuffer(o); break;
+            case TraceChunk_GraphicsPipeline: o.bCreated = CreateGraphicsPipeline(o); break;
+            case TraceChunk_ComputePipeline: o.bCreated = CreateComputePipeline(o); break;
+            case TraceChunk_DescriptorSet: o.bCreated = CreateDescriptorSet(o); break;
+            }
+            failed += !o.bCreated;
+        }
+    }
+    if (failed) {
+        printf("%u objects couldn't be created, commands using them are left out\n", failed);
+    }
+    return true;
+}
+
+/* Copies the contents that aren't in mapped memory to the staging buffer, uploads them, and puts every image
+   level in the layout it had when the frame started. */
+static void
+UploadContents(VkCommandBuffer cmd, VkQueue queue)
+{
+    VkDevice const device = rp.vkr.device;
+    if (rp.stagingSize) {
+        VK_CHECK(VKH_CreateBuffer(rp.vkr, rp.stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                                  &rp.staging));
+    }
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    for (uint32_t id = 0; id < rp.idLimit; ++id) {
+        const ReplayObject& o = rp.objects[id];
+        if (!o.bCreated || o.type != TraceChunk_Buffer || !o.data || o.pMapped) {
+            continue;
+        }
+        VkDeviceSize const size = ((const TraceBuffer *)o.payload)->dataSize;
+        memcpy((uint8_t *)rp.staging.pMapped + o.stagingOffset, o.data, size_t(size));
+        const VkBufferCopy region = { o.stagingOffset, 0, size };
+        vkCmdCopyBuffer(cmd, rp.staging.buffer, o.buffer, 1, &region);
+    }
+
+    for (uint32_t id = 0; id < rp.idLimit; ++id) {
+        const ReplayObject& o = rp.objects[id];
+        if (!o.bCreated || o.type != TraceChunk_Image) {
+            continue;
+        }
+        const TraceImage *img = (const TraceImage *)o.payload;
+        const TraceImageLevel *levels = ImageLevels(img);
+        const uint8_t *data = (const uint8_t *)(levels + img->mipLevels);
+        VkDeviceSize levelOffsets[32];
+        StageImageLevels(img, o.stagingOffset, levelOffsets);
+
+        VkImageMemoryBarrier ib = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        ib.image = o.image;
+        for (uint32_t m = 0; m < Min(img->mipLevels, 32u); ++m) {
+            VkImageLayout const layout = Layout(levels[m].layout);
+            ib.subresourceRange = { AspectOf(img->format), m, 1, 0, VK_REMAINING_ARRAY_LAYERS };
+            ib.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            ib.srcAccessMask = 0;
+            if (levels[m].dataSize) {
+                memcpy((uint8_t *)rp.staging.pMapped + levelOffsets[m], data + levels[m].dataOffset,
+                       size_t(levels[m].dataSize));
+                ib.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                ib.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &ib);
+                VkBufferImageCopy region = { };
+                region.bufferOffset = levelOffsets[m];
+                region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, m, 0, img->arrayLayers };
+                region.imageExtent = {
+                    Max(img->width >> m, 1u), Max(img->height >> m, 1u), Max(img->depth >> m, 1u)
+                };
+                vkCmdCopyBufferToImage(cmd, rp.staging.buffer, o.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                       &region);
+                ib.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                ib.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            }
+            if (layout == VK_IMAGE_LAYOUT_UNDEFINED || layout == VK_IMAGE_LAYOUT_PREINITIALIZED) {
+                continue; // left for the frame's own barriers
+            }
+            ib.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            ib.newLayout = layout;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                                 0, nullptr, 0, nullptr, 1, &ib);
+        }
+    }
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, nullptr));
+    VK_CHECK(vkDeviceWaitIdle(device));
+}
+
+//----- Replaying the commands -----
+
+/* Returns false if the command was left out. */
+static bool
+DecodeCmd(VkCommandBuffer cmd, uint32_t type, const void *payload)
+{
+    switch (type) {
+    case TraceCmd_BeginRenderPass: {
+        const TraceCmdBeginRenderPass *c = (const TraceCmdBeginRenderPass *)payload;
+        const ReplayObject *renderPass = Get(c->renderPass), *framebuffer = Get(c->framebuffer);
+        if (!renderPass || !framebuffer) {
+            rp.bSkipPass = true;
+            return false;
+        }
+        VkRenderPassBeginInfo info = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        info.renderPass = renderPass->renderPass;
+        info.framebuffer = framebuffer->framebuffer;
+        info.renderArea = { { c->renderArea.x, c->renderArea.y }, { c->renderArea.width, c->renderArea.height } };
+        info.clearValueCount = c->clearValueCount;
+        info.pClearValues = (const VkClearValue *)(c + 1);
+        vkCmdBeginRenderPass(cmd, &info, VkSubpassContents(c->contents));
+    } return true;
+    case TraceCmd_EndRenderPass:
+        vkCmdEndRenderPass(cmd);
+        return true;
+    case TraceCmd_BindPipeline: {
+        const TraceCmdBindPipeline *c = (const TraceCmdBindPipeline *)payload;
+        const ReplayObject *pipeline = Get(c->pipeline);
+        rp.bNoPipeline[c->bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE] = !pipeline;
+        if (!pipeline) {
+            return false;
+        }
+        vkCmdBindPipeline(cmd, VkPipelineBindPoint(c->bindPoint), pipeline->pipeline);
+    } return true;
+    case TraceCmd_BindDescriptorSets: {
+        const TraceCmdBindDescriptorSets *c = (const TraceCmdBindDescriptorSets *)payload;
+        const uint32_t *ids = (const uint32_t *)(c + 1);
+        const ReplayObject *layout = Get(c->layout);
+        VkDescriptorSet sets[32];
+        if (!layout || c->setCount > lengthof(sets)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < c->setCount; ++i) {
+            const ReplayObject *set = Get(ids[i]);
+            if (!set) {
+                return false;
+            }
+            sets[i] = set->set;
+        }
+        vkCmdBindDescriptorSets(cmd, VkPipelineBindPoint(c->bindPoint), layout->pipelineLayout, c->firstSet,
+                                c->setCount, sets, c->dynamicOffsetCount, ids + c->setCount);
+    } return true;
+    case TraceCmd_PushConstants: {
+        const TraceCmdPushConstants *c = (const TraceCmdPushConstants *)payload;
+        const ReplayObject *layout = Get(c->layout);
+        if (!layout) {
+            return false;
+        }
+        vkCmdPushConstants(cmd, layout->pipelineLayout, c->stageFlags, c->offset, c->size, c + 1);
+    } return true;
+    case TraceCmd_SetViewport: {
+        const TraceCmdSetViewport *c = (const TraceCmdSetViewport *)payload;
+        vkCmdSetViewport(cmd, c->first, c->count, (const VkViewport *)(c + 1));
+    } return true;
+    case TraceCmd_SetScissor: {
+        const TraceCmdSetScissor *c = (const TraceCmdSetScissor *)payload;
+        vkCmdSetScissor(cmd, c->first, c->count, (const VkRect2D *)(c + 1));
+    } return true;
+    case TraceCmd_BindVertexBuffers: {
+        const TraceCmdBindVertexBuffers *c = (const TraceCmdBindVertexBuffers *)payload;
+        const TraceVertexBufferBinding *b = (const TraceVertexBufferBinding *)(c + 1);
+        VkBuffer buffers[32];
+        VkDeviceSize offsets[32];
+        if (c->count > lengthof(buffers)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < c->count; ++i) {
+            const ReplayObject *buffer = Get(b[i].buffer);
+            if (!buffer) {
+                return false;
+            }
+            buffers[i] = buffer->buffer;
+            offsets[i] = b[i].offset;
+        }
+        vkCmdBindVertexBuffers(cmd, c->first, c->count, buffers, offsets);
+    } return true;
+    case TraceCmd_BindIndexBuffer: {
+        const TraceCmdBindIndexBuffer *c = (const TraceCmdBindIndexBuffer *)payload;
+        const ReplayObject *buffer = Get(c->buffer);
+        if (!buffer) {
+            return false;
+        }
+        vkCmdBindIndexBuffer(cmd, buffer->buffer, c->offset, VkIndexType(c->indexType));
+    } return true;
+    case TraceCmd_Draw: {
+        const TraceCmdDraw *c = (const TraceCmdDraw *)payload;
+        if (rp.bNoPipeline[0]) {
+            return false;
+        }
+        vkCmdDraw(cmd, c->vertexCount, c->instanceCount, c->firstVertex, c->firstInstance);
+    } return true;
+    case TraceCmd_DrawIndexed: {
+        const TraceCmdDrawIndexed *c = (const TraceCmdDrawIndexed *)payload;
+        if (rp.bNoPipeline[0]) {
+            return false;
+        }
+        vkCmdDrawIndexed(cmd, c->indexCount, c->instanceCount, c->firstIndex, c->vertexOffset, c->firstInstance);
+    } return true;
+    case TraceCmd_DrawIndirect: {
+        const TraceCmdDrawIndirect *c = (const TraceCmdDrawIndirect *)payload;
+        const ReplayObject *buffer = Get(c->buffer);
+        if (rp.bNoPipeline[0] || !buffer) {
+            return false;
+        }
+        vkCmdDrawIndirect(cmd, buffer->buffer, c->offset, c->drawCount, c->stride);
+    } return true;
+    case TraceCmd_Dispatch: {
+        const TraceCmdDispatch *c = (const TraceCmdDispatch *)payload;
+        if (rp.bNoPipeline[1]) {
+            return false;
+        }
+        vkCmdDispatch(cmd, c->x, c->y, c->z);
+    } return true;
+    case TraceCmd_PipelineBarrier: {
+        const TraceCmdPipelineBarrier *c = (const TraceCmdPipelineBarrier *)payload;
+        const TraceMemoryBarrier *mb = (const TraceMemoryBarrier *)(c + 1);
+        const TraceBufferBarrier *bb = (const TraceBufferBarrier *)(mb + c->memoryBarrierCount);
+        const TraceImageBarrier *ib = (const TraceImageBarrier *)(bb + c->bufferBarrierCount);
+        VkMemoryBarrier *vkMemory = Alloc<VkMemoryBarrier>(c->memoryBarrierCount);
+        VkBufferMemoryBarrier *vkBuffer = Alloc<VkBufferMemoryBarrier>(c->bufferBarrierCount);
+        VkImageMemoryBarrier *vkImage = Alloc<VkImageMemoryBarrier>(c->imageBarrierCount);
+        uint32_t bufferCount = 0, imageCount = 0;
+        for (uint32_t i = 0; i < c->memoryBarrierCount; ++i) {
+            vkMemory[i] = { VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, mb[i].srcAccessMask, mb[i].dstAccessMask };
+        }
+        /* A barrier on a missing object is dropped, the others still apply. */
+        for (uint32_t i = 0; i < c->bufferBarrierCount; ++i) {
+            if (const ReplayObject *buffer = Get(bb[i].buffer)) {
+                vkBuffer[bufferCount++] = {
+                    VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, bb[i].srcAccessMask, bb[i].dstAccessMask,
+                    bb[i].srcQueueFamily, bb[i].dstQueueFamily, buffer->buffer, bb[i].offset, bb[i].size
+                };
+            }
+        }
+        for (uint32_t i = 0; i < c->imageBarrierCount; ++i) {
+            if (const ReplayObject *image = Get(ib[i].image)) {
+                const TraceSubresourceRange& r = ib[i].range;
+                vkImage[imageCount++] = {
+                    VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, ib[i].srcAccessMask, ib[i].dstAccessMask,
+                    Layout(ib[i].oldLayout), Layout(ib[i].newLayout), ib[i].srcQueueFamily, ib[i].dstQueueFamily,
+                    image->image, { r.aspect, r.baseMip, r.mipCount, r.baseLayer, r.layerCount }
+                };
+            }
+        }
+        vkCmdPipelineBarrier(cmd, c->srcStageMask, c->dstStageMask, c->dependencyFlags, c->memoryBarrierCount,
+                             vkMemory, bufferCount, vkBuffer, imageCount, vkImage);
+        free(vkMemory);
+        free(vkBuffer);
+        free(vkImage);
+    } return true;
+    case TraceCmd_CopyBuffer: {
+        const TraceCmdCopyBuffer *c = (const TraceCmdCopyBuffer *)payload;
+        const ReplayObject *src = Get(c->src), *dst = Get(c->dst);
+        if (!src || !dst) {
+            return false;
+        }
+        vkCmdCopyBuffer(cmd, src->buffer, dst->buffer, c->regionCount, (const VkBufferCopy *)(c + 1));
+    } return true;
+    case TraceCmd_CopyBufferToImage:
+    case TraceCmd_CopyImageToBuffer: {
+        const TraceCmdBufferImageCopy *c = (const TraceCmdBufferImageCopy *)payload;
+        const ReplayObject *buffer = Get(c->buffer), *image = Get(c->image);
+        if (!buffer || !image) {
+            return false;
+        }
+        const VkBufferImageCopy *regions = (const VkBufferImageCopy *)(c + 1);
+        if (type == TraceCmd_CopyBufferToImage) {
+            vkCmdCopyBufferToImage(cmd, buffer->buffer, image->image, Layout(c->imageLayout), c->regionCount, regions);
+        } else {
+            vkCmdCopyImageToBuffer(cmd, image->image, Layout(c->imageLayout), buffer->buffer, c->regionCount, regions);
+        }
+    } return true;
+    case TraceCmd_CopyImage:
+    case TraceCmd_BlitImage: {
+        const TraceCmdImageCopy *c = (const TraceCmdImageCopy *)payload;
+        const ReplayObject *src = Get(c->src), *dst = Get(c->dst);
+        if (!src || !dst) {
+            return false;
+        }
+        if (type == TraceCmd_CopyImage) {
+            vkCmdCopyImage(cmd, src->image, Layout(c->srcLayout), dst->image, Layout(c->dstLayout), c->regionCount,
+                           (const VkImageCopy *)(c + 1));
+        } else {
+            vkCmdBlitImage(cmd, src->image, Layout(c->srcLayout), dst->image, Layout(c->dstLayout), c->regionCount,
+                           (const VkImageBlit *)(c + 1), VkFilter(c->filter));
+        }
+    } return true;
+    case TraceCmd_FillBuffer: {
+        const TraceCmdFillBuffer *c = (const TraceCmdFillBuffer *)payload;
+        const ReplayObject *buffer = Get(c->buffer);
+        if (!buffer) {
+            return false;
+        }
+        vkCmdFillBuffer(cmd, buffer->buffer, c->offset, c->size, c->data);
+    } return true;
+    case TraceCmd_UpdateBuffer: {
+        const TraceCmdUpdateBuffer *c = (const TraceCmdUpdateBuffer *)payload;
+        const ReplayObject *buffer = Get(c->buffer);
+        if (!buffer) {
+            return false;
+        }
+        vkCmdUpdateBuffer(cmd, buffer->buffer, c->offset, c->size, c + 1);
+    } return true;
+    default:
+        return false;
+    }
+}
+
+static void
+DecodeStream(VkCommandBuffer cmd, const CmdStream& s)
+{
+    const uint8_t *p = s.data;
+    const uint8_t *const end = s.data + s.size;
+    while (p + sizeof(TraceCmdHeader) <= end) {
+        const TraceCmdHeader *h = (const TraceCmdHeader *)p;
+        p = (const uint8_t *)(h + 1) + TraceFile_AlignUp(h->size);
+        if (rp.bSkipPass) {
+            rp.bSkipPass = h->type != TraceCmd_EndRenderPass;
+            ++rp.skipped;
+            continue;
+        }
+        rp.skipped += !DecodeCmd(cmd, h->type, h + 1);
+    }
+}
+
+/* Puts back what the last run wrote to buffers. The mapped ones are copied on the CPU, before the timing. */
+static void
+CmdRestoreBuffers(VkCommandBuffer cmd)
+{
+    bool bCopied = false;
+    for (uint32_t id = 0; id < rp.idLimit; ++id) {
+        const ReplayObject& o = rp.objects[id];
+        if (o.bCreated && o.bRestore && !o.pMapped) {
+            const VkBufferCopy region = { o.stagingOffset, 0, ((const TraceBuffer *)o.payload)->dataSize };
+            vkCmdCopyBuffer(cmd, rp.staging.buffer, o.buffer, 1, &region);
+            bCopied = true;
+        }
+    }
+    if (bCopied) {
+        VkMemoryBarrier mb = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        mb.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                             1, &mb, 0, nullptr, 0, nullptr);
+    }
+}
+
+static void
+RestoreMappedBuffers()
+{
+    for (uint32_t id = 0; id < rp.idLimit; ++id) {
+        const ReplayObject& o = rp.objects[id];
+        if (o.bCreated && o.bRestore && o.pMapped) {
+            memcpy(o.pMapped, o.data, size_t(((const TraceBuffer *)o.payload)->dataSize));
+        }
+    }
+}
+
+static void
+DestroyObjects()
+{
+    VkDevice const device = rp.vkr.device;
+    for (uint32_t id = rp.idLimit; id--;) {
+        ReplayObject& o = rp.objects[id];
+        if (!o.bCreated) {
+            continue;
+        }
+        switch (o.type) {
+        case TraceChunk_Buffer: vkDestroyBuffer(device, o.buffer, nullptr); break;
+        case TraceChunk_Image: vkDestroyImage(device, o.image, nullptr); break;
+        case TraceChunk_ImageView: vkDestroyImageView(device, o.view, nullptr); break;
+        case TraceChunk_Sampler: vkDestroySampler(device, o.sampler, nullptr); break;
+        case TraceChunk_ShaderModule: vkDestroyShaderModule(device, o.module, nullptr); break;
+        case TraceChunk_SetLayout: vkDestroyDescriptorSetLayout(device, o.setLayout, nullptr); break;
+        case TraceChunk_PipelineLayout: vkDestroyPipelineLayout(device, o.pipelineLayout, nullptr); break;
+        case TraceChunk_RenderPass: vkDestroyRenderPass(device, o.renderPass, nullptr); break;
+        case TraceChunk_Framebuffer: vkDestroyFramebuffer(device, o.framebuffer, nullptr); break;
+        case TraceChunk_GraphicsPipeline:
+        case TraceChunk_ComputePipeline: vkDestroyPipeline(device, o.pipeline, nullptr); break;
+        }
+        if (o.memory) {
+            vkFreeMemory(device, o.memory, nullptr);
+        }
+    }
+    if (rp.descriptorPool) {
+        vkDestroyDescriptorPool(device, rp.descriptorPool, nullptr);
+    }
+    if (rp.staging.buffer) {
+        VKH_DestroyBuffer(device, rp.staging);
+    }
+    free(rp.objects);
+    free(rp.streams);
+}
+
+static int
+CompareFloat(const void *a, const void *b)
+{
+    float const x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static void
+PrintStats(const char *name, float *ms, uint32_t count)
+{
+    if (!count) {
+        printf("  %-4s  no results\n", name);
+        return;
+    }
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        sum += ms[i];
+    }
+    qsort(ms, count, sizeof *ms, CompareFloat);
+    float const median = count & 1 ? ms[count / 2] : 0.5f * (ms[count / 2 - 1] + ms[count / 2]);
+    printf("  %-4s  min %8.3f  avg %8.3f  median %8.3f  max %8.3f ms\n", name, ms[0], float(sum / count), median,
+           ms[count - 1]);
+}
+
+int main(int argc, char **argv)
+{
+    const char *inPath = nullptr;
+    const char *csvPath = nullptr;
+    uint32_t frames = 100, warmup = 5;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--frames=", 9) == 0) {
+            frames = uint32_t(Max(atoi(argv[i] + 9), 1));
+        } else if (strncmp(argv[i], "--warmup=", 9) == 0) {
+            warmup = uint32_t(Max(atoi(argv[i] + 9), 0));
+        } else if (strncmp(argv[i], "--csv=", 6) == 0) {
+            csvPath = argv[i] + 6;
+        } else if (!inPath && argv[i][0] != '-') {
+            inPath = argv[i];
+        } else {
+            printf("unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!inPath) {
+        puts("usage: tracereplay <in.vkt> [--frames=N] [--warmup=W] [--csv=out.csv]");
+        return 1;
+    }
+
+    os_mapped_file file;
+    if (!OS_MapFileReadOnly(inPath, &file)) {
+        printf("can't open %s\n", inPath);
+        return 1;
+    }
+    const TraceFileHeader& header = *(const TraceFileHeader *)file.data;
+    if (const char *err = TraceFile_Validate(header, file.size)) {
+        printf("%s: %s\n", inPath, err);
+        OS_UnmapFile(file);
+        return 1;
+    }
+    printf("%s: frame %u, %ux%u, %u objects, %u command buffers\n", inPath, header.frameIndex, header.width,
+           header.height, header.objectCount, header.commandBufferCount);
+
+    if (VKR_InitInstanceOnly(rp.vkr) != VK_SUCCESS || VKR_PostInstanceConstruct(rp.vkr, nullptr) != VK_SUCCESS ||
+        !rp.vkr.device) {
+        puts("Vulkan 1.2 initialization failed");
+        OS_UnmapFile(file);
+        return 1;
+    }
+    VkDevice const device = rp.vkr.device;
+    VkQueue const queue = rp.vkr.universalQueue0;
+    VkCommandPool const cmdPool = VKH_CreateCommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                                                        rp.vkr.families.universal);
+    VkCommandBuffer const cmd = VKH_AllocateCommandBuffer(device, cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    VkFence fence;
+    VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+    GpuTimer timer;
+    GpuTimer_Create(timer, rp.vkr, 1);
+
+    int exitCode = 1;
+    if (LoadTrace(file)) {
+        UploadContents(cmd, queue);
+        exitCode = 0;
+    }
+
+    float *cpuMs = Alloc<float>(frames), *gpuMs = Alloc<float>(frames);
+    uint32_t gpuCount = 0;
+    FILE *csv = csvPath ? fopen(csvPath, "w") : nullptr;
+    if (csvPath && !csv) {
+        printf("can't write %s\n", csvPath);
+    }
+    if (csv) {
+        fputs("frame,cpu_ms,gpu_ms\n", csv);
+    }
+    double const msPerTick = 1000.0 / double(OS_TicksPerSecond());
+    for (uint32_t run = 0; run < warmup + frames && exitCode == 0; ++run) {
+        RestoreMappedBuffers();
+        VK_CHECK(vkResetCommandPool(device, cmdPool, 0));
+        rp.skipped = 0;
+
+        int64_t const start = OS_GetTicks();
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+        CmdRestoreBuffers(cmd);
+        GpuTimer_CmdBegin(timer, cmd, 0);
+        rp.bSkipPass = false;
+        rp.bNoPipeline[0] = rp.bNoPipeline[1] = true;
+        for (uint32_t i = 0; i < rp.streamCount; ++i) {
+            DecodeStream(cmd, rp.streams[i]);
+        }
+        GpuTimer_CmdEnd(timer, cmd, 0);
+        VK_CHECK(vkEndCommandBuffer(cmd));
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+        float const cpu = float(double(OS_GetTicks() - start) * msPerTick);
+
+        VK_CHECK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+        VK_CHECK(vkResetFences(device, 1, &fence));
+        float gpuSecs = 0.0f;
+        bool const bGpu = GpuTimer_GetSlotSecs(timer, device, 0, &gpuSecs);
+        if (run == 0 && rp.skipped) {
+            printf("%u commands left out, they use objects that couldn't be replayed\n", rp.skipped);
+        }
+        if (run < warmup) {
+            continue;
+        }
+        uint32_t const n = run - warmup;
+        cpuMs[n] = cpu;
+        if (bGpu) {
+            gpuMs[gpuCount++] = gpuSecs * 1000.0f;
+        }
+        if (csv) {
+            fprintf(csv, "%u,%.4f,%.4f\n", n, cpu, bGpu ? gpuSecs * 1000.0f : 0.0f);
+        }
+    }
+    if (csv) {
+        fclose(csv);
+    }
+    if (exitCode == 0) {
+        printf("%u runs after %u warmup:\n", frames, warmup);
+        PrintStats("cpu", cpuMs, frames);
+        PrintStats("gpu", gpuMs, gpuCount);
+    }
+    free(cpuMs);
+    free(gpuMs);
+
+    VK_CHECK(vkDeviceWaitIdle(device));
+    DestroyObjects();
+    GpuTimer_Destroy(timer, device);
+    vkDestroyFence(device, fence, nullptr);
+    vkDestroyCommandPool(device, cmdPool, nullptr);
+    VKR_Destruct(rp.vkr);
+    OS_UnmapFile(file);
+    return exitCode;
+}